@@ -1,15 +1,245 @@
 #pragma once
 
+#include <sys/mman.h>
+
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
-#include <cstdlib>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+#include "numa.h"
+
+// STL allocator returning memory aligned to |alignment| bytes.
+//
+// Blocks up to kMaxPooledBlockSize bytes come from pools of power-of-two size
+// classes. Every thread keeps its own free lists and exchanges batches of
+// blocks with global lists only when its lists run empty or grow too long, so
+// most allocations take no locks and no system calls. Pools carve blocks from
+// slabs which are huge pages, so that a block of every class is aligned to its
+// size. Slabs are never returned to the system.
+//
+// Larger blocks are mapped directly. Blocks aligned to kHugePageSize are
+// advised to be backed by transparent huge pages. An allocator constructed
+// with a NumaPolicy applies it to these blocks before they are touched; pooled
+// blocks share slabs with other allocators and are placed by the default
+// policy.
+
+constexpr size_t kPageSize = 4096;
+constexpr size_t kHugePageSize = 2 << 20;
+constexpr size_t kMaxPooledBlockSize = 256 << 10;
+
+namespace aligned_alloc_internal {
+
+constexpr size_t kMinBlockSizeLog = 4;
+constexpr size_t kMaxPooledBlockSizeLog = 18;
+constexpr size_t kSizeClassesNum =
+    kMaxPooledBlockSizeLog - kMinBlockSizeLog + 1;
+constexpr size_t kSlabSize = kHugePageSize;
+
+static_assert(size_t(1) << kMaxPooledBlockSizeLog == kMaxPooledBlockSize);
+
+// Index of the smallest size class holding |size| bytes.
+inline size_t SizeClass(size_t size) {
+  if (size <= (size_t(1) << kMinBlockSizeLog)) {
+    return 0;
+  }
+  return 64 - __builtin_clzll(size - 1) - kMinBlockSizeLog;
+}
+
+inline size_t BlockSize(size_t size_class) {
+  return size_t(1) << (size_class + kMinBlockSizeLog);
+}
+
+// Number of blocks moved between thread and global lists at once.
+inline size_t BatchSize(size_t size_class) {
+  return std::clamp<size_t>((64 << 10) / BlockSize(size_class), 2, 128);
+}
+
+// Maps |size| bytes aligned to |alignment|, which is a power of two. Throws
+// std::bad_alloc on failure.
+inline void *MapAligned(size_t size, size_t alignment) {
+  size = (size + kPageSize - 1) / kPageSize * kPageSize;
+  alignment = std::max(alignment, kPageSize);
+  // Maps an extra |alignment| bytes and unmaps the unaligned head and tail.
+  const size_t mapped_size = size + alignment - kPageSize;
+  void *mapping = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapping == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  uint8_t *begin = static_cast<uint8_t*>(mapping);
+  uint8_t *aligned = reinterpret_cast<uint8_t*>(
+      (reinterpret_cast<uintptr_t>(begin) + alignment - 1) / alignment *
+      alignment);
+  if (aligned != begin) {
+    munmap(begin, aligned - begin);
+  }
+  const size_t tail_size = begin + mapped_size - (aligned + size);
+  if (tail_size > 0) {
+    munmap(aligned + size, tail_size);
+  }
+  if (alignment >= kHugePageSize) {
+    madvise(aligned, size, MADV_HUGEPAGE);
+  }
+  return aligned;
+}
+
+inline void Unmap(void *p, size_t size) {
+  munmap(p, (size + kPageSize - 1) / kPageSize * kPageSize);
+}
+
+struct FreeBlock {
+  FreeBlock *next;
+};
+
+struct FreeList {
+  FreeBlock *head = nullptr;
+  size_t size = 0;
+
+  void Push(void *p) {
+    FreeBlock *block = static_cast<FreeBlock*>(p);
+    block->next = head;
+    head = block;
+    ++size;
+  }
+
+  void *Pop() {
+    FreeBlock *block = head;
+    head = block->next;
+    --size;
+    return block;
+  }
+};
+
+// Global free lists of all size classes, shared by all threads.
+class CentralPool {
+public:
+  // The pool is never destroyed, since thread caches return their blocks to
+  // it on thread exit, which may happen after destruction of static objects.
+  static CentralPool& Get() {
+    static CentralPool *pool = new CentralPool();
+    return *pool;
+  }
+
+  // Moves up to |blocks_num| free blocks of |size_class| to |list|, carving
+  // them from a new slab if needed.
+  void Refill(size_t size_class, size_t blocks_num, FreeList *list) {
+    ClassPool& pool = pools_[size_class];
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    for (; blocks_num > 0 && pool.free_blocks.size > 0; --blocks_num) {
+      list->Push(pool.free_blocks.Pop());
+    }
+    if (blocks_num == 0) {
+      return;
+    }
+    const size_t block_size = BlockSize(size_class);
+    if (pool.slab_begin == pool.slab_end) {
+      pool.slab_begin = static_cast<uint8_t*>(MapAligned(kSlabSize,
+                                                         kSlabSize));
+      pool.slab_end = pool.slab_begin + kSlabSize;
+    }
+    for (; blocks_num > 0 && pool.slab_begin != pool.slab_end; --blocks_num) {
+      list->Push(pool.slab_begin);
+      pool.slab_begin += block_size;
+    }
+  }
+
+  // Moves up to |blocks_num| blocks from |list| to the global free list.
+  void Release(size_t size_class, size_t blocks_num, FreeList *list) {
+    ClassPool& pool = pools_[size_class];
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    for (; blocks_num > 0 && list->size > 0; --blocks_num) {
+      pool.free_blocks.Push(list->Pop());
+    }
+  }
+
+private:
+  CentralPool() = default;
+
+  struct ClassPool {
+    std::mutex mutex;
+    FreeList free_blocks;
+    // Part of the last slab which wasn't handed out yet.
+    uint8_t *slab_begin = nullptr;
+    uint8_t *slab_end = nullptr;
+  };
+
+  ClassPool pools_[kSizeClassesNum];
+};
+
+// Thread-local free lists. Blocks may be freed by a different thread than the
+// one which allocated them: they simply move to the cache of the freeing
+// thread.
+class ThreadCache {
+public:
+  ~ThreadCache();
+
+  void *Allocate(size_t size_class) {
+    FreeList& list = lists_[size_class];
+    if (list.size == 0) {
+      CentralPool::Get().Refill(size_class, BatchSize(size_class), &list);
+    }
+    return list.Pop();
+  }
+
+  void Deallocate(void *p, size_t size_class) {
+    FreeList& list = lists_[size_class];
+    list.Push(p);
+    const size_t batch_size = BatchSize(size_class);
+    if (list.size > 2 * batch_size) {
+      CentralPool::Get().Release(size_class, batch_size, &list);
+    }
+  }
+
+private:
+  FreeList lists_[kSizeClassesNum];
+};
+
+// Trivially destructible, so that it can be checked by containers destroyed
+// after the cache of their thread.
+inline thread_local bool thread_cache_destroyed = false;
+
+inline ThreadCache::~ThreadCache() {
+  for (size_t size_class = 0; size_class < kSizeClassesNum; ++size_class) {
+    CentralPool::Get().Release(size_class, lists_[size_class].size,
+                               &lists_[size_class]);
+  }
+  thread_cache_destroyed = true;
+}
+
+inline ThreadCache& GetThreadCache() {
+  thread_local ThreadCache cache;
+  return cache;
+}
+
+inline void *AllocatePooled(size_t size_class) {
+  if (thread_cache_destroyed) {
+    FreeList list;
+    CentralPool::Get().Refill(size_class, 1, &list);
+    return list.Pop();
+  }
+  return GetThreadCache().Allocate(size_class);
+}
+
+inline void DeallocatePooled(void *p, size_t size_class) {
+  if (thread_cache_destroyed) {
+    FreeList list;
+    list.Push(p);
+    CentralPool::Get().Release(size_class, 1, &list);
+    return;
+  }
+  GetThreadCache().Deallocate(p, size_class);
+}
+
+}  // namespace aligned_alloc_internal
 
 template <typename T, size_t alignment>
 class AlignedAlloc {
 public:
   static_assert(alignment > 0);
-  static_assert((alignment % sizeof(T)) == 0);
-  static_assert(alignment < 256);
+  static_assert((alignment & (alignment - 1)) == 0);
 
   using value_type = T;
 
@@ -17,26 +247,50 @@ public:
     using other = AlignedAlloc<Other, alignment>;
   };
 
-  void deallocate(T *p, size_t /* not used */) {
+  AlignedAlloc() = default;
+
+  explicit AlignedAlloc(const NumaPolicy& numa_policy) noexcept
+      : numa_policy_(numa_policy) {}
+
+  template <typename Other>
+  AlignedAlloc(const AlignedAlloc<Other, alignment>& other) noexcept
+      : numa_policy_(other.numa_policy()) {}
+
+  void deallocate(T *p, size_t n) {
     assert(p != nullptr);
-    uint8_t *aligned_ptr = reinterpret_cast<uint8_t*>(p);
-    size_t shift = *(aligned_ptr - 1);
-    uint8_t *ptr = aligned_ptr - shift;
-    free(ptr);
+    const size_t size = std::max(n * sizeof(T), alignment);
+    if (size <= kMaxPooledBlockSize) {
+      aligned_alloc_internal::DeallocatePooled(
+          p, aligned_alloc_internal::SizeClass(size));
+    } else {
+      aligned_alloc_internal::Unmap(p, size);
+    }
   }
 
   T* allocate(size_t n) {
-    uint8_t *ptr = static_cast<uint8_t*>(malloc(n * sizeof(T) + alignment));
-    if (ptr == nullptr) {
-      return nullptr;
+    const size_t size = std::max(n * sizeof(T), alignment);
+    if (size <= kMaxPooledBlockSize) {
+      return static_cast<T*>(aligned_alloc_internal::AllocatePooled(
+          aligned_alloc_internal::SizeClass(size)));
     }
-    size_t shift = alignment - (reinterpret_cast<size_t>(ptr) % alignment);
-    uint8_t *aligned_ptr = ptr + shift;
-    *(aligned_ptr - 1) = shift;
-    return reinterpret_cast<T*>(aligned_ptr);
+    void *p = aligned_alloc_internal::MapAligned(size, alignment);
+    ApplyNumaPolicy(p, size, numa_policy_);
+    if (numa_policy_.mode == NumaMode::kFirstTouch) {
+      FirstTouch(p, size, numa_policy_.threads_num);
+    }
+    return static_cast<T*>(p);
+  }
+
+  const NumaPolicy& numa_policy() const {
+    return numa_policy_;
   }
+
+private:
+  NumaPolicy numa_policy_;
 };
 
+// Placement doesn't matter for deallocation, so allocators with different
+// NUMA policies are equal.
 template <typename T, typename U, size_t S1, size_t S2>
 constexpr bool operator==(const AlignedAlloc<T, S1>&, const AlignedAlloc<U, S2>&) noexcept {
   return S1 == S2;
@@ -1,6 +1,12 @@
 #include "aligned_alloc.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <list>
+#include <memory>
+#include <thread>
 #include <vector>
 
 void TestLinearFill(int n) {
@@ -56,9 +62,173 @@ void TestMoveAssignment() {
   std::cout << "ok!" << std::endl;
 }
 
+template <size_t alignment>
+void CheckPageAlignment(size_t n) {
+  std::vector<char, AlignedAlloc<char, alignment>> data(n, 1);
+  assert(((reinterpret_cast<size_t>(data.data())) % alignment) == 0);
+  assert(size_t(std::count(data.begin(), data.end(), 1)) == n);
+}
+
+void TestPageAlignments() {
+  std::cout << "Testing page alignments..." << std::flush;
+
+  for (size_t n : {size_t(1), size_t(100), kPageSize, size_t(5000),
+                   kMaxPooledBlockSize,
+                   kMaxPooledBlockSize + 1, kHugePageSize + 1}) {
+    CheckPageAlignment<256>(n);
+    CheckPageAlignment<kPageSize>(n);
+    CheckPageAlignment<kHugePageSize>(n);
+  }
+
+  std::cout << "ok!" << std::endl;
+}
+
+void TestBlockReuse() {
+  std::cout << "Testing block reuse..." << std::flush;
+
+  // Blocks of one size class don't overlap and are reused after freeing.
+  AlignedAlloc<int, 16> alloc;
+  std::vector<int*> blocks;
+  for (int i = 0; i < 1000; ++i) {
+    blocks.push_back(alloc.allocate(8));
+    std::fill(blocks.back(), blocks.back() + 8, i);
+  }
+  for (int i = 0; i < 1000; ++i) {
+    assert(std::count(blocks[i], blocks[i] + 8, i) == 8);
+  }
+  int *last = blocks.back();
+  alloc.deallocate(last, 8);
+  assert(alloc.allocate(7) == last);
+  for (int *block : blocks) {
+    alloc.deallocate(block, 8);
+  }
+
+  // Containers rebind the allocator to their nodes.
+  std::list<int, AlignedAlloc<int, 32>> list;
+  for (int i = 0; i < 1000; ++i) {
+    list.push_back(i);
+  }
+  int expected = 0;
+  for (int value : list) {
+    assert(value == expected++);
+  }
+
+  std::cout << "ok!" << std::endl;
+}
+
+void TestThreads() {
+  std::cout << "Testing threads..." << std::flush;
+
+  // Blocks allocated by one thread are freed by another one, which exits with
+  // a full cache.
+  using Vector = std::vector<int, AlignedAlloc<int, 64>>;
+  std::vector<Vector> vectors(4000);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&vectors, t]() {
+      for (int i = t * 1000; i < (t + 1) * 1000; ++i) {
+        vectors[i].assign(i % 100 + 1, i);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&vectors, t]() {
+      for (int i = 0; i < 4000; ++i) {
+        if (i % 4 == t) {
+          assert(vectors[i].size() == size_t(i % 100 + 1));
+          assert(vectors[i].back() == i);
+          Vector().swap(vectors[i]);
+        }
+      }
+      for (int i = 0; i < 1000; ++i) {
+        Vector data(i + 1, t);
+        assert(data.front() == t && data.back() == t);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::cout << "ok!" << std::endl;
+}
+
+// STL allocator on top of std::aligned_alloc, for comparison.
+template <typename T, size_t alignment>
+struct StdAlignedAlloc {
+  using value_type = T;
+
+  template <typename Other> struct rebind {
+    using other = StdAlignedAlloc<Other, alignment>;
+  };
+
+  StdAlignedAlloc() = default;
+
+  template <typename Other>
+  StdAlignedAlloc(const StdAlignedAlloc<Other, alignment>&) noexcept {}
+
+  T* allocate(size_t n) {
+    const size_t size = (n * sizeof(T) + alignment - 1) / alignment *
+                        alignment;
+    return static_cast<T*>(std::aligned_alloc(alignment, size));
+  }
+
+  void deallocate(T *p, size_t) {
+    free(p);
+  }
+
+  bool operator==(const StdAlignedAlloc&) const {
+    return true;
+  }
+
+  bool operator!=(const StdAlignedAlloc&) const {
+    return false;
+  }
+};
+
+// Repeatedly builds and destroys a few thousand small vectors, which grow
+// by push_back.
+template <typename Alloc>
+long long MeasureSmallVectorsMs() {
+  auto start = std::chrono::high_resolution_clock::now();
+  size_t total = 0;
+  for (int repeat = 0; repeat < 200; ++repeat) {
+    std::vector<std::vector<int, Alloc>> vectors(2000);
+    for (size_t i = 0; i < vectors.size(); ++i) {
+      for (size_t j = 0; j < i % 64; ++j) {
+        vectors[i].push_back(j);
+      }
+      total += vectors[i].size();
+    }
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  assert(total > 0);
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      end - start).count();
+}
+
+void RunAllocationBenchmark() {
+  std::cout << "Small vectors: std::allocator "
+            << MeasureSmallVectorsMs<std::allocator<int>>()
+            << "ms, std::aligned_alloc "
+            << MeasureSmallVectorsMs<StdAlignedAlloc<int, 64>>()
+            << "ms, AlignedAlloc "
+            << MeasureSmallVectorsMs<AlignedAlloc<int, 64>>() << "ms"
+            << std::endl;
+}
+
 int main() {
   TestLinearFill(100000);
   TestAddressAlignments(1000);
   TestMoveAssignment();
+  TestPageAlignments();
+  TestBlockReuse();
+  TestThreads();
+  std::cout << "All tests passed! :)" << std::endl;
+  RunAllocationBenchmark();
   return 0;
 }
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator which hands out memory from a list of chunks and frees it
+// all at once on destruction. Freeing single blocks is a no-op, so objects
+// living in an arena don't have to be destroyed one by one: trivially
+// destructible ones don't need to be destroyed at all.
+//
+// Chunks grow geometrically from |initial_chunk_size| up to kMaxChunkSize.
+// Blocks larger than a chunk get a chunk of their own.
+class MonotonicArena {
+public:
+  static constexpr size_t kDefaultChunkSize = 4096;
+  static constexpr size_t kMaxChunkSize = 64 << 20;
+
+  explicit MonotonicArena(size_t initial_chunk_size = kDefaultChunkSize)
+      : next_chunk_size_(std::max<size_t>(initial_chunk_size, 64)) {}
+
+  // Allocates from |buffer| first, which is owned by the caller and has to
+  // outlive the arena. Useful for arenas on the stack.
+  MonotonicArena(void *buffer, size_t size)
+      : next_chunk_size_(std::max<size_t>(2 * size, kDefaultChunkSize)),
+        current_(static_cast<uint8_t*>(buffer)),
+        end_(current_ + size) {}
+
+  MonotonicArena(const MonotonicArena&) = delete;
+  MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+  ~MonotonicArena() {
+    for (const Chunk& chunk : chunks_) {
+      free(chunk.begin);
+    }
+  }
+
+  // Returns |size| bytes aligned to |alignment|, which is a power of two.
+  // Throws std::bad_alloc if the system is out of memory.
+  void *Allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+    uintptr_t p = AlignUp(current_, alignment);
+    if (current_ == nullptr || p + size > reinterpret_cast<uintptr_t>(end_)) {
+      NextChunk(size + alignment - 1);
+      p = AlignUp(current_, alignment);
+    }
+    current_ = reinterpret_cast<uint8_t*>(p + size);
+    allocated_bytes_ += size;
+    return reinterpret_cast<void*>(p);
+  }
+
+  void Deallocate(void * /* not used */, size_t /* not used */) {}
+
+  // Total size of the blocks handed out since construction or the last reset.
+  size_t allocated_bytes() const {
+    return allocated_bytes_;
+  }
+
+  // Total size of the chunks owned by the arena.
+  size_t reserved_bytes() const {
+    size_t result = 0;
+    for (const Chunk& chunk : chunks_) {
+      result += chunk.end - chunk.begin;
+    }
+    return result;
+  }
+
+protected:
+  // Makes all chunks available again. The external buffer, if any, isn't
+  // reused.
+  void Rewind() {
+    next_chunk_ = 0;
+    current_ = nullptr;
+    end_ = nullptr;
+    allocated_bytes_ = 0;
+  }
+
+private:
+  struct Chunk {
+    uint8_t *begin;
+    uint8_t *end;
+  };
+
+  static uintptr_t AlignUp(uint8_t *p, size_t alignment) {
+    return (reinterpret_cast<uintptr_t>(p) + alignment - 1) & ~(alignment - 1);
+  }
+
+  // Switches to the first unused chunk of at least |size| bytes, allocating a
+  // new one if there is no such chunk. The rest of the current chunk is lost
+  // until the next rewind.
+  void NextChunk(size_t size) {
+    size_t i = next_chunk_;
+    while (i < chunks_.size() &&
+           size_t(chunks_[i].end - chunks_[i].begin) < size) {
+      ++i;
+    }
+    if (i == chunks_.size()) {
+      const size_t chunk_size = std::max(next_chunk_size_, size);
+      uint8_t *begin = static_cast<uint8_t*>(malloc(chunk_size));
+      if (begin == nullptr) {
+        throw std::bad_alloc();
+      }
+      chunks_.push_back({begin, begin + chunk_size});
+      next_chunk_size_ = std::min(2 * next_chunk_size_, kMaxChunkSize);
+    }
+    // Used chunks are kept in front of the unused ones.
+    std::swap(chunks_[i], chunks_[next_chunk_]);
+    current_ = chunks_[next_chunk_].begin;
+    end_ = chunks_[next_chunk_].end;
+    ++next_chunk_;
+  }
+
+  size_t next_chunk_size_;
+  std::vector<Chunk> chunks_;
+  // Chunks before this one were used since the last rewind.
+  size_t next_chunk_ = 0;
+  uint8_t *current_ = nullptr;
+  uint8_t *end_ = nullptr;
+  size_t allocated_bytes_ = 0;
+};
+
+// MonotonicArena whose memory can be reused: Reset() discards all blocks and
+// keeps the chunks, so that repeated builds of similar structures stop
+// calling malloc after the first one.
+class ResettableArena : public MonotonicArena {
+public:
+  using MonotonicArena::MonotonicArena;
+
+  // All blocks allocated before must not be used afterwards.
+  void Reset() {
+    Rewind();
+  }
+};
+
+// STL allocator taking memory from an arena, which must outlive all
+// containers using it. Allocators are equal if they share the arena.
+template <typename T, typename Arena = MonotonicArena>
+class ArenaAllocator {
+public:
+  using value_type = T;
+
+  template <typename Other> struct rebind {
+    using other = ArenaAllocator<Other, Arena>;
+  };
+
+  explicit ArenaAllocator(Arena *arena) noexcept : arena_(arena) {}
+
+  template <typename Other>
+  ArenaAllocator(const ArenaAllocator<Other, Arena>& other) noexcept
+      : arena_(other.arena()) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T *p, size_t n) {
+    arena_->Deallocate(p, n * sizeof(T));
+  }
+
+  Arena *arena() const {
+    return arena_;
+  }
+
+private:
+  Arena *arena_;
+};
+
+template <typename T, typename U, typename Arena>
+bool operator==(const ArenaAllocator<T, Arena>& a,
+                const ArenaAllocator<U, Arena>& b) noexcept {
+  return a.arena() == b.arena();
+}
+
+template <typename T, typename U, typename Arena>
+bool operator!=(const ArenaAllocator<T, Arena>& a,
+                const ArenaAllocator<U, Arena>& b) noexcept {
+  return a.arena() != b.arena();
+}
+
+// True for allocators whose deallocate() does nothing because their memory is
+// released all at once, like ArenaAllocator. Containers using them can skip
+// visiting trivially destructible elements on teardown.
+template <typename Alloc>
+struct ReleasesInBulk : std::false_type {};
+
+template <typename T, typename Arena>
+struct ReleasesInBulk<ArenaAllocator<T, Arena>> : std::true_type {};
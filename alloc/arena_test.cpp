@@ -0,0 +1,215 @@
+#include "arena.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "../search/cartesian-tree.hpp"
+
+void TestMonotonicArena() {
+  std::cout << "Testing monotonic arena..." << std::flush;
+
+  MonotonicArena arena(256);
+  std::vector<std::pair<uint8_t*, size_t>> blocks;
+  size_t total_size = 0;
+  for (size_t i = 0; i < 1000; ++i) {
+    const size_t size = i % 100 + 1;
+    const size_t alignment = size_t(1) << (i % 8);
+    uint8_t *block = static_cast<uint8_t*>(arena.Allocate(size, alignment));
+    assert((reinterpret_cast<uintptr_t>(block) % alignment) == 0);
+    memset(block, i % 256, size);
+    blocks.emplace_back(block, size);
+    total_size += size;
+  }
+  // Blocks larger than chunks.
+  for (size_t size : {10000, 1 << 20}) {
+    uint8_t *block = static_cast<uint8_t*>(arena.Allocate(size));
+    memset(block, 0xff, size);
+    total_size += size;
+  }
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    for (size_t j = 0; j < blocks[i].second; ++j) {
+      assert(blocks[i].first[j] == i % 256);
+    }
+  }
+  assert(arena.allocated_bytes() == total_size);
+  assert(arena.reserved_bytes() >= total_size);
+
+  std::cout << "ok!" << std::endl;
+}
+
+void TestExternalBuffer() {
+  std::cout << "Testing arena with external buffer..." << std::flush;
+
+  alignas(16) uint8_t buffer[256];
+  MonotonicArena arena(buffer, sizeof(buffer));
+  for (int i = 0; i < 16; ++i) {
+    uint8_t *block = static_cast<uint8_t*>(arena.Allocate(16, 16));
+    assert(block == buffer + 16 * i);
+  }
+  assert(arena.reserved_bytes() == 0);
+  uint8_t *block = static_cast<uint8_t*>(arena.Allocate(1));
+  assert(block < buffer || block >= buffer + sizeof(buffer));
+  assert(arena.reserved_bytes() > 0);
+
+  std::cout << "ok!" << std::endl;
+}
+
+void TestResettableArena() {
+  std::cout << "Testing resettable arena..." << std::flush;
+
+  ResettableArena arena(128);
+  std::vector<void*> first_blocks;
+  for (int i = 0; i < 100; ++i) {
+    first_blocks.push_back(arena.Allocate(24, 8));
+  }
+  const size_t reserved_bytes = arena.reserved_bytes();
+  for (int repeat = 0; repeat < 10; ++repeat) {
+    arena.Reset();
+    assert(arena.allocated_bytes() == 0);
+    std::vector<void*> blocks;
+    for (int i = 0; i < 100; ++i) {
+      blocks.push_back(arena.Allocate(24, 8));
+    }
+    // The same chunks are reused.
+    assert(arena.reserved_bytes() == reserved_bytes);
+    assert(blocks.front() == first_blocks.front());
+  }
+
+  // A block larger than all chunks gets a new one, and later resets reuse it.
+  arena.Reset();
+  arena.Allocate(1 << 16);
+  const size_t grown_reserved_bytes = arena.reserved_bytes();
+  assert(grown_reserved_bytes > reserved_bytes);
+  arena.Reset();
+  arena.Allocate(1 << 16);
+  assert(arena.reserved_bytes() == grown_reserved_bytes);
+
+  std::cout << "ok!" << std::endl;
+}
+
+void TestArenaAllocator() {
+  std::cout << "Testing arena allocator..." << std::flush;
+
+  MonotonicArena arena;
+  ArenaAllocator<int> alloc(&arena);
+  std::vector<int, ArenaAllocator<int>> data(alloc);
+  for (int i = 0; i < 10000; ++i) {
+    data.push_back(i);
+  }
+  std::list<int, ArenaAllocator<int>> list(alloc);
+  std::map<int, double, std::less<int>,
+           ArenaAllocator<std::pair<const int, double>>> map(alloc);
+  for (int i = 0; i < 1000; ++i) {
+    list.push_front(i);
+    map[i] = i / 2.0;
+  }
+  for (int i = 0; i < 10000; ++i) {
+    assert(data[i] == i);
+  }
+  assert(list.front() == 999 && list.back() == 0);
+  assert(map.size() == 1000 && map[10] == 5.0);
+
+  assert(ArenaAllocator<double>(alloc) == alloc);
+  MonotonicArena other_arena;
+  assert(ArenaAllocator<int>(&other_arena) != alloc);
+
+  std::cout << "ok!" << std::endl;
+}
+
+template <typename Func>
+long long MeasureMs(const Func& func) {
+  auto start = std::chrono::high_resolution_clock::now();
+  func();
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      end - start).count();
+}
+
+// Build and teardown times of node-based structures with the default
+// allocator and with an arena.
+void RunArenaBenchmark() {
+  constexpr int kSize = 1000000;
+  std::mt19937 gen(42);
+  std::vector<int> data(kSize);
+  for (int& value : data) {
+    value = gen();
+  }
+
+  const long long tree_ms = MeasureMs([&]() {
+    auto tree = CartesianTree<int>::Init(data);
+    assert(tree.GetNodesNum() == kSize);
+  });
+  const long long arena_tree_ms = MeasureMs([&]() {
+    MonotonicArena arena;
+    auto tree = CartesianTree<int, ArenaAllocator<int>>::Init(
+        data, ArenaAllocator<int>(&arena));
+    assert(tree.GetNodesNum() == kSize);
+  });
+  std::cout << "CartesianTree of " << kSize << " nodes: std::allocator "
+            << tree_ms << "ms, MonotonicArena " << arena_tree_ms << "ms"
+            << std::endl;
+
+  const long long map_ms = MeasureMs([&]() {
+    std::map<int, int> map;
+    for (int i = 0; i < kSize; ++i) {
+      map.emplace(data[i], i);
+    }
+  });
+  const long long arena_map_ms = MeasureMs([&]() {
+    MonotonicArena arena;
+    using Alloc = ArenaAllocator<std::pair<const int, int>>;
+    std::map<int, int, std::less<int>, Alloc> map{Alloc(&arena)};
+    for (int i = 0; i < kSize; ++i) {
+      map.emplace(data[i], i);
+    }
+  });
+  std::cout << "std::map of " << kSize << " elements: std::allocator "
+            << map_ms << "ms, MonotonicArena " << arena_map_ms << "ms"
+            << std::endl;
+
+  // Adjacency lists of a random graph, rebuilt several times.
+  constexpr int kVertices = 100000;
+  constexpr int kRepeats = 5;
+  const long long graph_ms = MeasureMs([&]() {
+    for (int repeat = 0; repeat < kRepeats; ++repeat) {
+      std::vector<std::vector<std::pair<int, double>>> g(kVertices);
+      for (int i = 0; i < kSize; ++i) {
+        g[unsigned(data[i]) % kVertices].emplace_back(i % kVertices, 1.0);
+      }
+    }
+  });
+  const long long arena_graph_ms = MeasureMs([&]() {
+    ResettableArena arena;
+    using Edge = std::pair<int, double>;
+    using Edges = std::vector<Edge, ArenaAllocator<Edge>>;
+    for (int repeat = 0; repeat < kRepeats; ++repeat) {
+      arena.Reset();
+      std::vector<Edges, ArenaAllocator<Edges>> g(
+          kVertices, Edges(ArenaAllocator<Edge>(&arena)),
+          ArenaAllocator<Edges>(&arena));
+      for (int i = 0; i < kSize; ++i) {
+        g[unsigned(data[i]) % kVertices].emplace_back(i % kVertices, 1.0);
+      }
+    }
+  });
+  std::cout << kRepeats << " builds of adjacency lists with " << kSize
+            << " edges: std::allocator " << graph_ms
+            << "ms, ResettableArena " << arena_graph_ms << "ms" << std::endl;
+}
+
+int main() {
+  TestMonotonicArena();
+  TestExternalBuffer();
+  TestResettableArena();
+  TestArenaAllocator();
+  std::cout << "All tests passed! :)" << std::endl;
+  RunArenaBenchmark();
+  return 0;
+}
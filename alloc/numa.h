@@ -0,0 +1,181 @@
+#pragma once
+
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Placement of memory on NUMA nodes, applied with the mbind and set_mempolicy
+// system calls directly, so that libnuma isn't needed. On machines with a
+// single node, or where the calls are unavailable (old kernels, seccomp
+// filters in containers), policies silently do nothing: memory is placed as
+// if no policy was given.
+enum class NumaMode : uint8_t {
+  // Whatever the policy of the thread is, usually kLocal.
+  kDefault,
+  // On the node of the CPU which touches a page first.
+  kLocal,
+  // Pages round-robin over all nodes. Best for memory shared by all threads
+  // without a clear owner.
+  kInterleave,
+  // Only on |node|.
+  kBind,
+  // Like kLocal, but pages are touched right after allocation by
+  // |threads_num| new threads, the i-th of which touches the i-th contiguous
+  // part. The threads are not pinned and are not the threads which later
+  // process the data, so every part lands on the node where the scheduler
+  // happened to run its thread. This spreads a buffer over the nodes instead
+  // of putting it all on the node of the allocating thread, but it doesn't
+  // place a part next to its reader.
+  kFirstTouch,
+};
+
+struct NumaPolicy {
+  NumaMode mode = NumaMode::kDefault;
+  size_t node = 0;
+  size_t threads_num = 0;
+
+  static NumaPolicy Local() {
+    return {NumaMode::kLocal, 0, 0};
+  }
+
+  static NumaPolicy Interleave() {
+    return {NumaMode::kInterleave, 0, 0};
+  }
+
+  static NumaPolicy Bind(size_t node) {
+    return {NumaMode::kBind, node, 0};
+  }
+
+  // 0 threads means std::thread::hardware_concurrency().
+  static NumaPolicy FirstTouch(size_t threads_num = 0) {
+    return {NumaMode::kFirstTouch, 0, threads_num};
+  }
+};
+
+inline bool operator==(const NumaPolicy& a, const NumaPolicy& b) {
+  return a.mode == b.mode && a.node == b.node && a.threads_num == b.threads_num;
+}
+
+inline bool operator!=(const NumaPolicy& a, const NumaPolicy& b) {
+  return !(a == b);
+}
+
+namespace numa_internal {
+
+constexpr size_t kMaxNodesNum = 64;
+constexpr size_t kPageSize = 4096;
+
+// Parses a list of ranges like "0-3,8" in /sys/devices/system/node/online.
+inline size_t ReadNodesNum() {
+  std::ifstream in("/sys/devices/system/node/online");
+  std::string ranges;
+  if (!(in >> ranges)) {
+    return 1;
+  }
+  size_t max_node = 0;
+  size_t value = 0;
+  for (char c : ranges + ",") {
+    if (c >= '0' && c <= '9') {
+      value = value * 10 + (c - '0');
+    } else {
+      max_node = std::max(max_node, value);
+      value = 0;
+    }
+  }
+  return std::min(max_node + 1, kMaxNodesNum);
+}
+
+// Returns the mode and the node mask of |policy| for mbind and set_mempolicy.
+inline int ModeAndMask(const NumaPolicy& policy, size_t nodes_num,
+                       unsigned long *mask) {
+  switch (policy.mode) {
+    case NumaMode::kInterleave:
+      *mask = nodes_num == kMaxNodesNum ? ~0UL : (1UL << nodes_num) - 1;
+      return MPOL_INTERLEAVE;
+    case NumaMode::kBind:
+      *mask = 1UL << policy.node;
+      return MPOL_BIND;
+    case NumaMode::kLocal:
+    case NumaMode::kFirstTouch:
+      *mask = 0;
+      return MPOL_LOCAL;
+    case NumaMode::kDefault:
+      break;
+  }
+  *mask = 0;
+  return MPOL_DEFAULT;
+}
+
+}  // namespace numa_internal
+
+// Number of NUMA nodes of the machine, 1 if it can't be determined.
+inline size_t NumaNodesNum() {
+  static const size_t nodes_num = numa_internal::ReadNodesNum();
+  return nodes_num;
+}
+
+// Applies |policy| to the pages of [p; p + size), which must start at a page
+// boundary and must not have been touched yet: pages already backed by memory
+// are not moved. Returns false if the policy couldn't be applied.
+inline bool ApplyNumaPolicy(void *p, size_t size, const NumaPolicy& policy) {
+  if (policy.mode == NumaMode::kDefault) {
+    return true;
+  }
+  const size_t nodes_num = NumaNodesNum();
+  if (policy.mode == NumaMode::kBind && policy.node >= nodes_num) {
+    return false;
+  }
+  unsigned long mask;
+  const int mode = numa_internal::ModeAndMask(policy, nodes_num, &mask);
+  return syscall(SYS_mbind, p, size, mode, mode == MPOL_LOCAL ? nullptr : &mask,
+                 numa_internal::kMaxNodesNum + 1, 0) == 0;
+}
+
+// Applies |policy| to all further allocations of the calling thread, which
+// are not covered by a policy of their own. kFirstTouch acts as kLocal.
+inline bool SetThreadNumaPolicy(const NumaPolicy& policy) {
+  const size_t nodes_num = NumaNodesNum();
+  if (policy.mode == NumaMode::kBind && policy.node >= nodes_num) {
+    return false;
+  }
+  unsigned long mask;
+  const int mode = numa_internal::ModeAndMask(policy, nodes_num, &mask);
+  return syscall(SYS_set_mempolicy, mode,
+                 mode == MPOL_LOCAL || mode == MPOL_DEFAULT ? nullptr : &mask,
+                 numa_internal::kMaxNodesNum + 1) == 0;
+}
+
+// Backs [p; p + size) with memory by writing zeros to one byte of every page
+// from |threads_num| threads, each of which takes a contiguous part.
+inline void FirstTouch(void *p, size_t size, size_t threads_num) {
+  if (threads_num == 0) {
+    threads_num = std::max(1U, std::thread::hardware_concurrency());
+  }
+  volatile uint8_t *begin = static_cast<uint8_t*>(p);
+  const size_t pages_num =
+      (size + numa_internal::kPageSize - 1) / numa_internal::kPageSize;
+  threads_num = std::max<size_t>(1, std::min(threads_num, pages_num));
+  auto touch = [begin, size, pages_num, threads_num](size_t i) {
+    const size_t pages_begin = pages_num * i / threads_num;
+    const size_t pages_end = pages_num * (i + 1) / threads_num;
+    for (size_t page = pages_begin; page < pages_end; ++page) {
+      begin[std::min(page * numa_internal::kPageSize, size - 1)] = 0;
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < threads_num; ++i) {
+    threads.emplace_back(touch, i);
+  }
+  touch(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
@@ -0,0 +1,170 @@
+#include "numa.h"
+
+#include <sys/mman.h>
+
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "aligned_alloc.h"
+
+// Returns the policy mode of the page at |p|, or -1 if it can't be queried.
+int GetPageNumaMode(void *p) {
+  int mode;
+  if (syscall(SYS_get_mempolicy, &mode, nullptr, 0, p, MPOL_F_ADDR) != 0) {
+    return -1;
+  }
+  return mode;
+}
+
+size_t GetResidentPagesNum(void *p, size_t size) {
+  std::vector<unsigned char> pages((size + kPageSize - 1) / kPageSize);
+  assert(mincore(p, size, pages.data()) == 0);
+  size_t result = 0;
+  for (unsigned char page : pages) {
+    result += page & 1;
+  }
+  return result;
+}
+
+void TestNumaPolicies() {
+  std::cout << "Testing NUMA policies..." << std::flush;
+
+  assert(NumaNodesNum() >= 1);
+  constexpr size_t kSize = 4 << 20;
+  const std::pair<NumaPolicy, int> policies[] = {
+      {NumaPolicy::Local(), MPOL_LOCAL},
+      {NumaPolicy::Interleave(), MPOL_INTERLEAVE},
+      {NumaPolicy::Bind(0), MPOL_BIND},
+  };
+  for (const auto& [policy, mode] : policies) {
+    AlignedAlloc<float, 64> alloc(policy);
+    std::vector<float, AlignedAlloc<float, 64>> data(kSize, 1.0f, alloc);
+    assert(data.get_allocator().numa_policy() == policy);
+    assert(std::accumulate(data.begin(), data.end(), 0.0) == kSize);
+    // The syscalls may be forbidden, e.g. in containers.
+    const int page_mode = GetPageNumaMode(data.data());
+    assert(page_mode == -1 || page_mode == mode ||
+           (mode == MPOL_LOCAL && page_mode == MPOL_DEFAULT));
+  }
+
+  // Nodes which don't exist are ignored.
+  assert(!ApplyNumaPolicy(nullptr, 0, NumaPolicy::Bind(NumaNodesNum())));
+  // Even if they don't fit into 16 bits.
+  assert(!ApplyNumaPolicy(nullptr, 0, NumaPolicy::Bind(1 << 16)));
+  AlignedAlloc<int, 64> alloc(NumaPolicy::Bind(NumaNodesNum()));
+  int *p = alloc.allocate(kSize);
+  p[0] = p[kSize - 1] = 1;
+  alloc.deallocate(p, kSize);
+
+  // Rebound allocators keep the policy.
+  AlignedAlloc<double, 64> rebound(AlignedAlloc<char, 64>(
+      NumaPolicy::Interleave()));
+  assert(rebound.numa_policy() == NumaPolicy::Interleave());
+  assert((rebound == AlignedAlloc<double, 64>()));
+
+  std::cout << "ok!" << std::endl;
+}
+
+void TestFirstTouch() {
+  std::cout << "Testing first touch..." << std::flush;
+
+  constexpr size_t kSize = 16 << 20;
+  for (size_t threads_num : {1, 3, 8}) {
+    AlignedAlloc<uint8_t, kPageSize> alloc(
+        NumaPolicy::FirstTouch(threads_num));
+    uint8_t *p = alloc.allocate(kSize);
+    assert(GetResidentPagesNum(p, kSize) == kSize / kPageSize);
+    alloc.deallocate(p, kSize);
+  }
+  assert(NumaPolicy::FirstTouch(1 << 16).threads_num == 1 << 16);
+  // Without first touch only the mapping is created.
+  AlignedAlloc<uint8_t, kPageSize> alloc;
+  uint8_t *p = alloc.allocate(kSize);
+  assert(GetResidentPagesNum(p, kSize) < kSize / kPageSize);
+  alloc.deallocate(p, kSize);
+
+  std::cout << "ok!" << std::endl;
+}
+
+void TestThreadPolicy() {
+  std::cout << "Testing thread NUMA policy..." << std::flush;
+
+  std::thread thread([]() {
+    if (SetThreadNumaPolicy(NumaPolicy::Interleave())) {
+      int mode;
+      assert(syscall(SYS_get_mempolicy, &mode, nullptr, 0, nullptr, 0) == 0);
+      assert(mode == MPOL_INTERLEAVE);
+      assert(SetThreadNumaPolicy(NumaPolicy()));
+    }
+    assert(!SetThreadNumaPolicy(NumaPolicy::Bind(NumaNodesNum())));
+  });
+  thread.join();
+
+  std::cout << "ok!" << std::endl;
+}
+
+// Sums |data| from |threads_num| threads, each reading a contiguous part, the
+// same split which FirstTouch uses.
+double ParallelSum(const float *data, size_t size, size_t threads_num) {
+  std::vector<double> sums(threads_num);
+  auto sum = [&](size_t i) {
+    const float *begin = data + size * i / threads_num;
+    const float *end = data + size * (i + 1) / threads_num;
+    sums[i] = std::accumulate(begin, end, 0.0);
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < threads_num; ++i) {
+    threads.emplace_back(sum, i);
+  }
+  sum(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return std::accumulate(sums.begin(), sums.end(), 0.0);
+}
+
+// Read bandwidth of all threads over a buffer placed by every policy. The
+// placement matters only on machines with several nodes.
+void RunBandwidthBenchmark() {
+  constexpr size_t kSize = 64 << 20;
+  constexpr int kRepeats = 5;
+  const size_t threads_num = std::max(1U, std::thread::hardware_concurrency());
+  const std::pair<const char*, NumaPolicy> policies[] = {
+      {"default", NumaPolicy()},
+      {"local", NumaPolicy::Local()},
+      {"interleave", NumaPolicy::Interleave()},
+      {"bind to node 0", NumaPolicy::Bind(0)},
+      {"first touch", NumaPolicy::FirstTouch(threads_num)},
+  };
+  std::cout << NumaNodesNum() << " NUMA nodes, " << threads_num << " threads"
+            << std::endl;
+  for (const auto& [name, policy] : policies) {
+    AlignedAlloc<float, 64> alloc(policy);
+    float *data = alloc.allocate(kSize);
+    // Initialized by the main thread, as std::vector would do.
+    std::fill(data, data + kSize, 1.0f);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int repeat = 0; repeat < kRepeats; ++repeat) {
+      assert(ParallelSum(data, kSize, threads_num) == kSize);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << name << ": "
+              << kRepeats * kSize * sizeof(float) / seconds / (1 << 30)
+              << " GiB/s" << std::endl;
+    alloc.deallocate(data, kSize);
+  }
+}
+
+int main() {
+  TestNumaPolicies();
+  TestFirstTouch();
+  TestThreadPolicy();
+  std::cout << "All tests passed! :)" << std::endl;
+  RunBandwidthBenchmark();
+  return 0;
+}
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <execinfo.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <vector>
+
+// Counters of allocations: bytes live and at peak, numbers of allocations and
+// deallocations, and a histogram of requested sizes. Optionally records call
+// stacks of every n-th allocation. Counters are atomic, so a single instance
+// may be shared by all threads.
+//
+// TrackingAlloc reports to an AllocationStats instance, and
+// tracking_new_delete.h reports all allocations of a program to HeapStats().
+class AllocationStats {
+public:
+  // Bucket k of the histogram counts allocations of [2^k; 2^(k + 1)) bytes,
+  // bucket 0 also counts empty ones.
+  static constexpr size_t kHistogramSize = 64;
+  static constexpr size_t kMaxStackDepth = 16;
+
+  struct Snapshot {
+    size_t live_bytes;
+    size_t peak_bytes;
+    size_t total_bytes;
+    size_t allocations_num;
+    size_t deallocations_num;
+    size_t histogram[kHistogramSize];
+  };
+
+  struct StackSample {
+    size_t allocations_num = 0;
+    size_t bytes = 0;
+  };
+
+  AllocationStats() {
+    Reset();
+  }
+  AllocationStats(const AllocationStats&) = delete;
+  AllocationStats& operator=(const AllocationStats&) = delete;
+
+  void RecordAllocation(size_t size) {
+    const size_t live_bytes =
+        live_bytes_.fetch_add(size, std::memory_order_relaxed) + size;
+    size_t peak_bytes = peak_bytes_.load(std::memory_order_relaxed);
+    while (live_bytes > peak_bytes &&
+           !peak_bytes_.compare_exchange_weak(peak_bytes, live_bytes,
+                                              std::memory_order_relaxed)) {
+    }
+    total_bytes_.fetch_add(size, std::memory_order_relaxed);
+    const size_t allocations_num =
+        allocations_num_.fetch_add(1, std::memory_order_relaxed);
+    histogram_[HistogramBucket(size)].fetch_add(1, std::memory_order_relaxed);
+    const size_t sampling_period =
+        sampling_period_.load(std::memory_order_relaxed);
+    if (sampling_period != 0 && allocations_num % sampling_period == 0) {
+      SampleStack(size);
+    }
+  }
+
+  void RecordDeallocation(size_t size) {
+    live_bytes_.fetch_sub(size, std::memory_order_relaxed);
+    deallocations_num_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  Snapshot GetSnapshot() const {
+    Snapshot snapshot;
+    snapshot.live_bytes = live_bytes_.load(std::memory_order_relaxed);
+    snapshot.peak_bytes = peak_bytes_.load(std::memory_order_relaxed);
+    snapshot.total_bytes = total_bytes_.load(std::memory_order_relaxed);
+    snapshot.allocations_num =
+        allocations_num_.load(std::memory_order_relaxed);
+    snapshot.deallocations_num =
+        deallocations_num_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < kHistogramSize; ++i) {
+      snapshot.histogram[i] = histogram_[i].load(std::memory_order_relaxed);
+    }
+    return snapshot;
+  }
+
+  // Zeroes all counters except live bytes, which would become negative
+  // after freeing blocks allocated before, and starts the peak from them.
+  void Reset() {
+    peak_bytes_.store(live_bytes_.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+    total_bytes_.store(0, std::memory_order_relaxed);
+    allocations_num_.store(0, std::memory_order_relaxed);
+    deallocations_num_.store(0, std::memory_order_relaxed);
+    for (auto& count : histogram_) {
+      count.store(0, std::memory_order_relaxed);
+    }
+    std::lock_guard<std::mutex> lock(samples_mutex_);
+    stack_samples_.clear();
+  }
+
+  // Records the call stack of every |period|-th allocation; 0 disables
+  // sampling. Samples are stored in a map, whose own allocations are counted
+  // by HeapStats() but never sampled.
+  void SetStackSamplingPeriod(size_t period) {
+    sampling_period_.store(period, std::memory_order_relaxed);
+  }
+
+  std::vector<std::pair<std::vector<void*>, StackSample>> GetStackSamples()
+      const {
+    std::lock_guard<std::mutex> lock(samples_mutex_);
+    return {stack_samples_.begin(), stack_samples_.end()};
+  }
+
+  // Prints |max_stacks_num| stacks with the most sampled bytes.
+  void PrintStackSamples(std::ostream& out, size_t max_stacks_num) const;
+
+  static size_t HistogramBucket(size_t size) {
+    return size <= 1 ? 0 : 63 - __builtin_clzll(size);
+  }
+
+private:
+  // Whether the current thread is sampling a stack already: backtrace() and
+  // the samples map may allocate.
+  static bool& InSampling() {
+    thread_local bool in_sampling = false;
+    return in_sampling;
+  }
+
+  void SampleStack(size_t size) {
+    bool& in_sampling = InSampling();
+    if (in_sampling) {
+      return;
+    }
+    in_sampling = true;
+    void *frames[kMaxStackDepth];
+    const int frames_num = backtrace(frames, kMaxStackDepth);
+    std::vector<void*> stack(frames, frames + frames_num);
+    {
+      std::lock_guard<std::mutex> lock(samples_mutex_);
+      StackSample& sample = stack_samples_[std::move(stack)];
+      ++sample.allocations_num;
+      sample.bytes += size;
+    }
+    in_sampling = false;
+  }
+
+  std::atomic<size_t> live_bytes_{0};
+  std::atomic<size_t> peak_bytes_;
+  std::atomic<size_t> total_bytes_;
+  std::atomic<size_t> allocations_num_;
+  std::atomic<size_t> deallocations_num_;
+  std::atomic<size_t> histogram_[kHistogramSize];
+  std::atomic<size_t> sampling_period_{0};
+  mutable std::mutex samples_mutex_;
+  std::map<std::vector<void*>, StackSample> stack_samples_;
+};
+
+inline void AllocationStats::PrintStackSamples(std::ostream& out,
+                                               size_t max_stacks_num) const {
+  bool& in_sampling = InSampling();
+  const bool was_in_sampling = in_sampling;
+  in_sampling = true;
+  auto samples = GetStackSamples();
+  std::sort(samples.begin(), samples.end(),
+            [](const auto& a, const auto& b) {
+              return a.second.bytes > b.second.bytes;
+            });
+  samples.resize(std::min(samples.size(), max_stacks_num));
+  for (const auto& [stack, sample] : samples) {
+    out << sample.allocations_num << " sampled allocations, " << sample.bytes
+        << " bytes:" << std::endl;
+    char **symbols = backtrace_symbols(stack.data(), stack.size());
+    for (size_t i = 0; i < stack.size(); ++i) {
+      out << "    " << (symbols != nullptr ? symbols[i] : "?") << std::endl;
+    }
+    free(symbols);
+  }
+  in_sampling = was_in_sampling;
+}
+
+inline std::ostream& operator<<(std::ostream& out,
+                                const AllocationStats::Snapshot& snapshot) {
+  return out << snapshot.allocations_num << " allocations ("
+             << snapshot.total_bytes << " bytes), "
+             << snapshot.deallocations_num << " deallocations, "
+             << snapshot.live_bytes << " bytes live, " << snapshot.peak_bytes
+             << " bytes at peak";
+}
+
+// Stats of the global operator new and delete, which are recorded only if
+// tracking_new_delete.h is included by the program.
+inline AllocationStats& HeapStats() {
+  // Constructed in place, since operator new itself reports here, and never
+  // destroyed, since objects may be freed during static destruction.
+  alignas(AllocationStats) static uint8_t storage[sizeof(AllocationStats)];
+  static AllocationStats *stats = new (storage) AllocationStats();
+  return *stats;
+}
+
+// STL allocator which records allocations of |Alloc| in |stats|. Rebound
+// copies share the stats, so e.g. nodes of a std::map are counted too.
+template <typename T, typename Alloc = std::allocator<T>>
+class TrackingAlloc {
+public:
+  using value_type = T;
+
+  template <typename Other> struct rebind {
+    using other = TrackingAlloc<
+        Other, typename std::allocator_traits<Alloc>::template rebind_alloc<
+                   Other>>;
+  };
+
+  explicit TrackingAlloc(AllocationStats *stats, const Alloc& alloc = Alloc())
+      : stats_(stats), alloc_(alloc) {}
+
+  template <typename Other, typename OtherAlloc>
+  TrackingAlloc(const TrackingAlloc<Other, OtherAlloc>& other)
+      : stats_(other.stats()), alloc_(other.alloc()) {}
+
+  T* allocate(size_t n) {
+    T *p = std::allocator_traits<Alloc>::allocate(alloc_, n);
+    stats_->RecordAllocation(n * sizeof(T));
+    return p;
+  }
+
+  void deallocate(T *p, size_t n) {
+    stats_->RecordDeallocation(n * sizeof(T));
+    std::allocator_traits<Alloc>::deallocate(alloc_, p, n);
+  }
+
+  AllocationStats *stats() const {
+    return stats_;
+  }
+
+  const Alloc& alloc() const {
+    return alloc_;
+  }
+
+private:
+  AllocationStats *stats_;
+  Alloc alloc_;
+};
+
+template <typename T, typename U, typename A1, typename A2>
+bool operator==(const TrackingAlloc<T, A1>& a, const TrackingAlloc<U, A2>& b) {
+  return a.stats() == b.stats() && a.alloc() == b.alloc();
+}
+
+template <typename T, typename U, typename A1, typename A2>
+bool operator!=(const TrackingAlloc<T, A1>& a, const TrackingAlloc<U, A2>& b) {
+  return !(a == b);
+}
@@ -0,0 +1,160 @@
+#include "tracking_alloc.h"
+
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "aligned_alloc.h"
+#include "tracking_new_delete.h"
+
+void TestTrackingAlloc() {
+  std::cout << "Testing tracking allocator..." << std::flush;
+
+  AllocationStats stats;
+  {
+    std::vector<int, TrackingAlloc<int>> data{TrackingAlloc<int>(&stats)};
+    data.reserve(100);
+    AllocationStats::Snapshot snapshot = stats.GetSnapshot();
+    assert(snapshot.allocations_num == 1);
+    assert(snapshot.live_bytes == 100 * sizeof(int));
+    assert(snapshot.histogram[AllocationStats::HistogramBucket(400)] == 1);
+    assert(AllocationStats::HistogramBucket(400) == 8);
+    data.reserve(1000);
+    snapshot = stats.GetSnapshot();
+    assert(snapshot.allocations_num == 2 && snapshot.deallocations_num == 1);
+    assert(snapshot.live_bytes == 1000 * sizeof(int));
+    assert(snapshot.peak_bytes == 1100 * sizeof(int));
+    assert(snapshot.total_bytes == 1100 * sizeof(int));
+  }
+  AllocationStats::Snapshot snapshot = stats.GetSnapshot();
+  assert(snapshot.live_bytes == 0 && snapshot.deallocations_num == 2);
+
+  // Nodes of rebound allocators are counted in the same stats.
+  stats.Reset();
+  using Alloc = TrackingAlloc<std::pair<const int, int>,
+                              AlignedAlloc<std::pair<const int, int>, 64>>;
+  std::map<int, int, std::less<int>, Alloc> map{Alloc(&stats)};
+  for (int i = 0; i < 100; ++i) {
+    map[i] = i;
+  }
+  snapshot = stats.GetSnapshot();
+  assert(snapshot.allocations_num == 100);
+  assert(snapshot.live_bytes == snapshot.total_bytes);
+  assert(reinterpret_cast<uintptr_t>(&*map.begin()) % 16 == 0);
+  map.clear();
+  assert(stats.GetSnapshot().live_bytes == 0);
+
+  std::cout << "ok!" << std::endl;
+}
+
+void TestStackSampling() {
+  std::cout << "Testing stack sampling..." << std::flush;
+
+  AllocationStats stats;
+  stats.SetStackSamplingPeriod(10);
+  TrackingAlloc<double> alloc(&stats);
+  for (int i = 0; i < 100; ++i) {
+    alloc.deallocate(alloc.allocate(4), 4);
+  }
+  size_t sampled_allocations_num = 0;
+  size_t sampled_bytes = 0;
+  for (const auto& [stack, sample] : stats.GetStackSamples()) {
+    assert(!stack.empty());
+    sampled_allocations_num += sample.allocations_num;
+    sampled_bytes += sample.bytes;
+  }
+  assert(sampled_allocations_num == 10);
+  assert(sampled_bytes == 10 * 4 * sizeof(double));
+
+  stats.Reset();
+  assert(stats.GetStackSamples().empty());
+
+  std::cout << "ok!" << std::endl;
+}
+
+void TestHeapStats() {
+  std::cout << "Testing heap stats..." << std::flush;
+
+  HeapStats().Reset();
+  const AllocationStats::Snapshot before = HeapStats().GetSnapshot();
+  {
+    auto value = std::make_unique<int>(5);
+    std::vector<char> data(1 << 20);
+    AllocationStats::Snapshot snapshot = HeapStats().GetSnapshot();
+    assert(snapshot.allocations_num == before.allocations_num + 2);
+    assert(snapshot.live_bytes >= before.live_bytes + (1 << 20) + sizeof(int));
+  }
+  AllocationStats::Snapshot after = HeapStats().GetSnapshot();
+  assert(after.live_bytes == before.live_bytes);
+  assert(after.deallocations_num == before.deallocations_num + 2);
+  assert(after.peak_bytes >= before.live_bytes + (1 << 20));
+
+  // Over-aligned and array allocations from several threads.
+  struct alignas(128) Aligned {
+    char data[128];
+  };
+  {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([]() {
+        for (int i = 0; i < 1000; ++i) {
+          auto aligned = std::make_unique<Aligned>();
+          assert(reinterpret_cast<uintptr_t>(aligned.get()) % 128 == 0);
+          auto array = std::make_unique<int[]>(i + 1);
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+  after = HeapStats().GetSnapshot();
+  assert(after.live_bytes == before.live_bytes);
+  assert(after.allocations_num >= before.allocations_num + 2 + 8000);
+
+  std::cout << "ok!" << std::endl;
+}
+
+// Reports the time and the heap usage of building a vector and a map.
+void RunTrackingBenchmark() {
+  constexpr int kSize = 1000000;
+  auto measure = [](const char *name, const auto& func) {
+    HeapStats().Reset();
+    const size_t live_bytes = HeapStats().GetSnapshot().live_bytes;
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    const AllocationStats::Snapshot snapshot = HeapStats().GetSnapshot();
+    std::cout << name << ": "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     end - start).count()
+              << "ms, " << snapshot.allocations_num << " allocations, peak "
+              << (snapshot.peak_bytes - live_bytes) / 1024 << "KiB"
+              << std::endl;
+  };
+  measure("std::vector<int> by push_back", []() {
+    std::vector<int> data;
+    for (int i = 0; i < kSize; ++i) {
+      data.push_back(i);
+    }
+  });
+  measure("std::map<int, int>", []() {
+    std::map<int, int> map;
+    for (int i = 0; i < kSize; ++i) {
+      map[i] = i;
+    }
+  });
+}
+
+int main() {
+  TestTrackingAlloc();
+  TestStackSampling();
+  TestHeapStats();
+  std::cout << "All tests passed! :)" << std::endl;
+  RunTrackingBenchmark();
+  return 0;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <malloc.h>
+
+#include <cstdlib>
+#include <new>
+
+#include "tracking_alloc.h"
+
+// Replaces the global operator new and delete with ones which record all heap
+// allocations of the program in HeapStats(). Must be included by exactly one
+// translation unit, usually the one with main().
+//
+// Sizes are taken from malloc_usable_size, so that unsized deletes are
+// accounted correctly; they may exceed the requested sizes by a few bytes.
+
+namespace tracking_new_delete_internal {
+
+inline void *Allocate(size_t size, size_t alignment) {
+  void *p = alignment <= alignof(std::max_align_t)
+                ? malloc(size)
+                : aligned_alloc(alignment,
+                                (size + alignment - 1) / alignment * alignment);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  HeapStats().RecordAllocation(malloc_usable_size(p));
+  return p;
+}
+
+inline void Deallocate(void *p) {
+  if (p != nullptr) {
+    HeapStats().RecordDeallocation(malloc_usable_size(p));
+    free(p);
+  }
+}
+
+}  // namespace tracking_new_delete_internal
+
+void *operator new(size_t size) {
+  return tracking_new_delete_internal::Allocate(size, 0);
+}
+
+void *operator new[](size_t size) {
+  return tracking_new_delete_internal::Allocate(size, 0);
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+  return tracking_new_delete_internal::Allocate(size, size_t(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+  return tracking_new_delete_internal::Allocate(size, size_t(alignment));
+}
+
+void operator delete(void *p) noexcept {
+  tracking_new_delete_internal::Deallocate(p);
+}
+
+void operator delete[](void *p) noexcept {
+  tracking_new_delete_internal::Deallocate(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  tracking_new_delete_internal::Deallocate(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+  tracking_new_delete_internal::Deallocate(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+  tracking_new_delete_internal::Deallocate(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept {
+  tracking_new_delete_internal::Deallocate(p);
+}
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept {
+  tracking_new_delete_internal::Deallocate(p);
+}
+
+void operator delete[](void *p, size_t, std::align_val_t) noexcept {
+  tracking_new_delete_internal::Deallocate(p);
+}
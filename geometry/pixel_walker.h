@@ -1,6 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
 
 class PixelWalker {
 public:
@@ -25,7 +29,7 @@ private:
   float dy_;
 };
 
-PixelWalker::PixelWalker(int start_x, int start_y, float angle)
+inline PixelWalker::PixelWalker(int start_x, int start_y, float angle)
     : cur_x_(start_x), cur_y_(start_y) {
   dx_ = cos(angle);
   dy_ = sin(angle);
@@ -33,3 +37,126 @@ PixelWalker::PixelWalker(int start_x, int start_y, float angle)
   dx_ /= norm;
   dy_ /= norm;
 }
+
+// Walks pixels along a ray like PixelWalker, but with integer Bresenham steps:
+// the coordinate along the major axis of the direction changes by one on
+// every step, and the other one is the floor of the exact coordinate on the
+// ray, kept as a fraction. So the walk doesn't drift on rays of any length
+// and next() has no floating-point operations, which also makes the sequence
+// the same on all platforms for a given direction.
+//
+// Pixel (x, y) covers [x; x + 1) x [y; y + 1), so walks from different starts
+// are shifted copies of each other. PixelWalker truncates coordinates towards
+// zero instead, so the two walk the same pixels while coordinates stay
+// non-negative, up to float rounding of PixelWalker on coordinates which are
+// integers in exact math; with negative coordinates they differ.
+class IntegerPixelWalker {
+public:
+  // Angles are quantized to directions with kDirectionBits bits of precision,
+  // the precision of float, which PixelWalker uses as well. This is the only
+  // place where floating-point math is used.
+  static constexpr int kDirectionBits = 24;
+
+  // Component of the direction vector for |value| in [-1; 1], a cosine or
+  // sine of the angle.
+  static int64_t QuantizeDirection(float value) {
+    return std::llround(value * float(int64_t(1) << kDirectionBits));
+  }
+
+  // Direction vector of |angle|, which must be finite. Components below the
+  // rounding error of the angle itself are zero, e.g. sin(M_PI) in float is
+  // -8.7e-8, and rays along an axis stay on it as they do with PixelWalker.
+  // The error is capped at the one of angles around pi: cos and sin reduce
+  // huge angles exactly, and their direction must not be zeroed.
+  static void QuantizeAngle(float angle, int64_t *dir_x, int64_t *dir_y) {
+    assert(std::isfinite(angle));
+    // Rounding error of angles in [2; 4), which include pi.
+    constexpr float kMaxAngleError = 0x1p-22f;
+    const float abs_angle = std::fabs(angle);
+    const float angle_error = std::min(
+        std::nextafter(abs_angle, INFINITY) - abs_angle, kMaxAngleError);
+    const float cos = std::cos(angle);
+    const float sin = std::sin(angle);
+    *dir_x = std::fabs(cos) <= angle_error ? 0 : QuantizeDirection(cos);
+    *dir_y = std::fabs(sin) <= angle_error ? 0 : QuantizeDirection(sin);
+  }
+
+  IntegerPixelWalker(int start_x, int start_y, float angle);
+
+  // Walks in the direction of the vector (|dir_x|, |dir_y|), which must be
+  // non-zero. For a vector to a target pixel the walk reaches that pixel.
+  IntegerPixelWalker(int start_x, int start_y, int64_t dir_x, int64_t dir_y);
+
+  int getX() const {
+    return cur_x_;
+  }
+
+  int getY() const {
+    return cur_y_;
+  }
+
+  // Same as |steps| calls of next(), in constant time.
+  void advance(int64_t steps) {
+    const __int128 fraction =
+        major_delta_ - 1 - error_ + __int128(steps) * minor_delta_;
+    const int64_t carries = fraction / major_delta_;
+    error_ = major_delta_ - 1 - int64_t(fraction % major_delta_);
+    cur_x_ += steps * major_step_x_ + carries * minor_step_x_;
+    cur_y_ += steps * major_step_y_ + carries * minor_step_y_;
+  }
+
+  void next() {
+    const int64_t error = error_ - minor_delta_;
+    const int64_t wrapped_error = error + major_delta_;
+    const bool carry = error < 0;
+    error_ = carry ? wrapped_error : error;
+    cur_x_ += major_step_x_ + (carry ? minor_step_x_ : 0);
+    cur_y_ += major_step_y_ + (carry ? minor_step_y_ : 0);
+  }
+
+private:
+  int cur_x_;
+  int cur_y_;
+  // Unit steps along the major axis on every call and along the minor axis
+  // on every carry.
+  int major_step_x_ = 0;
+  int major_step_y_ = 0;
+  int minor_step_x_ = 0;
+  int minor_step_y_ = 0;
+  int64_t major_delta_;
+  int64_t minor_delta_;
+  // The fractional part of the minor offset is
+  // (major_delta_ - 1 - error_) / major_delta_. Along negative minor steps it
+  // starts at (major_delta_ - 1) / major_delta_ instead of zero, so the
+  // offset is rounded up and the coordinate is rounded down.
+  int64_t error_;
+};
+
+inline IntegerPixelWalker::IntegerPixelWalker(int start_x, int start_y,
+                                              float angle) {
+  int64_t dir_x;
+  int64_t dir_y;
+  QuantizeAngle(angle, &dir_x, &dir_y);
+  *this = IntegerPixelWalker(start_x, start_y, dir_x, dir_y);
+}
+
+inline IntegerPixelWalker::IntegerPixelWalker(int start_x, int start_y,
+                                              int64_t dir_x, int64_t dir_y)
+    : cur_x_(start_x), cur_y_(start_y) {
+  assert(dir_x != 0 || dir_y != 0);
+  const int sign_x = dir_x < 0 ? -1 : 1;
+  const int sign_y = dir_y < 0 ? -1 : 1;
+  if (std::llabs(dir_x) >= std::llabs(dir_y)) {
+    major_step_x_ = sign_x;
+    minor_step_y_ = sign_y;
+    major_delta_ = std::llabs(dir_x);
+    minor_delta_ = std::llabs(dir_y);
+  } else {
+    major_step_y_ = sign_y;
+    minor_step_x_ = sign_x;
+    major_delta_ = std::llabs(dir_y);
+    minor_delta_ = std::llabs(dir_x);
+  }
+  const bool negative_minor = minor_step_x_ + minor_step_y_ < 0;
+  error_ = negative_minor ? 0 : major_delta_ - 1;
+}
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "pixel_walker.h"
+
+// Walks many rays at once: a packet of lanes advances with the integer steps
+// of IntegerPixelWalker, one ray per lane, so every ray visits exactly the
+// pixels IntegerPixelWalker visits. When a ray ends, its lane is masked out
+// and refilled with the next ray, so packets stay full until the rays run
+// out.
+//
+// With AVX-512 (-mavx512f) packets have 16 lanes, with AVX2 (-mavx2) 8 lanes,
+// otherwise rays are walked one by one with the same code.
+
+struct PixelRay {
+  int start_x;
+  int start_y;
+  float angle;
+  // Number of steps; the start pixel itself isn't visited.
+  int length;
+};
+
+namespace pixel_walker_packet_internal {
+
+#if defined(__AVX512F__)
+
+struct Int32x16 {
+  using Vector = __m512i;
+  static constexpr int kLanes = 16;
+
+  static Vector Load(const int32_t *p) {
+    return _mm512_loadu_si512(p);
+  }
+  static void Store(int32_t *p, Vector v) {
+    _mm512_storeu_si512(p, v);
+  }
+  static Vector Set1(int32_t value) {
+    return _mm512_set1_epi32(value);
+  }
+  static Vector Add(Vector a, Vector b) {
+    return _mm512_add_epi32(a, b);
+  }
+  static Vector Sub(Vector a, Vector b) {
+    return _mm512_sub_epi32(a, b);
+  }
+  static Vector And(Vector a, Vector b) {
+    return _mm512_and_si512(a, b);
+  }
+  // All ones in lanes where |v| is negative, zeros elsewhere. The masked
+  // form avoids a false -Wmaybe-uninitialized of GCC on _mm512_srai_epi32.
+  static Vector NegativeMask(Vector v) {
+    return _mm512_mask_srai_epi32(v, 0xffff, v, 31);
+  }
+  // Bit i is set if lane i of |v| is zero.
+  static uint32_t ZeroLanes(Vector v) {
+    return _mm512_cmpeq_epi32_mask(v, _mm512_setzero_si512());
+  }
+};
+
+using Int32xN = Int32x16;
+
+#elif defined(__AVX2__)
+
+struct Int32x8 {
+  using Vector = __m256i;
+  static constexpr int kLanes = 8;
+
+  static Vector Load(const int32_t *p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+  static void Store(int32_t *p, Vector v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+  }
+  static Vector Set1(int32_t value) {
+    return _mm256_set1_epi32(value);
+  }
+  static Vector Add(Vector a, Vector b) {
+    return _mm256_add_epi32(a, b);
+  }
+  static Vector Sub(Vector a, Vector b) {
+    return _mm256_sub_epi32(a, b);
+  }
+  static Vector And(Vector a, Vector b) {
+    return _mm256_and_si256(a, b);
+  }
+  static Vector NegativeMask(Vector v) {
+    return _mm256_srai_epi32(v, 31);
+  }
+  static uint32_t ZeroLanes(Vector v) {
+    return _mm256_movemask_ps(_mm256_castsi256_ps(
+        _mm256_cmpeq_epi32(v, _mm256_setzero_si256())));
+  }
+};
+
+using Int32xN = Int32x8;
+
+#else
+
+struct Int32x1 {
+  using Vector = int32_t;
+  static constexpr int kLanes = 1;
+
+  static Vector Load(const int32_t *p) {
+    return *p;
+  }
+  static void Store(int32_t *p, Vector v) {
+    *p = v;
+  }
+  static Vector Set1(int32_t value) {
+    return value;
+  }
+  static Vector Add(Vector a, Vector b) {
+    return a + b;
+  }
+  static Vector Sub(Vector a, Vector b) {
+    return a - b;
+  }
+  static Vector And(Vector a, Vector b) {
+    return a & b;
+  }
+  static Vector NegativeMask(Vector v) {
+    return v >> 31;
+  }
+  static uint32_t ZeroLanes(Vector v) {
+    return v == 0;
+  }
+};
+
+using Int32xN = Int32x1;
+
+#endif
+
+// Per-lane state of the walk, see IntegerPixelWalker. Directions of angles
+// have at most kDirectionBits bits, so 32-bit lanes are enough.
+enum LaneField {
+  kX,
+  kY,
+  kError,
+  kMajorDelta,
+  kMinorDelta,
+  kMajorStepX,
+  kMajorStepY,
+  kMinorStepX,
+  kMinorStepY,
+  kRemaining,
+  kRayId,
+  kLaneFieldsNum,
+};
+
+static_assert(IntegerPixelWalker::kDirectionBits < 31);
+
+// Sets up lane |lane| of |state| to walk |ray|.
+inline void InitLane(const PixelRay& ray, int32_t ray_id, int lane,
+                     int32_t (*state)[Int32xN::kLanes]) {
+  int64_t dir_x;
+  int64_t dir_y;
+  IntegerPixelWalker::QuantizeAngle(ray.angle, &dir_x, &dir_y);
+  const int32_t sign_x = dir_x < 0 ? -1 : 1;
+  const int32_t sign_y = dir_y < 0 ? -1 : 1;
+  const bool x_major = std::llabs(dir_x) >= std::llabs(dir_y);
+  state[kX][lane] = ray.start_x;
+  state[kY][lane] = ray.start_y;
+  state[kMajorDelta][lane] = std::llabs(x_major ? dir_x : dir_y);
+  state[kMinorDelta][lane] = std::llabs(x_major ? dir_y : dir_x);
+  // See IntegerPixelWalker::error_.
+  const bool negative_minor = (x_major ? sign_y : sign_x) < 0;
+  state[kError][lane] = negative_minor ? 0 : state[kMajorDelta][lane] - 1;
+  state[kMajorStepX][lane] = x_major ? sign_x : 0;
+  state[kMajorStepY][lane] = x_major ? 0 : sign_y;
+  state[kMinorStepX][lane] = x_major ? 0 : sign_x;
+  state[kMinorStepY][lane] = x_major ? sign_y : 0;
+  state[kRemaining][lane] = ray.length;
+  state[kRayId][lane] = ray_id;
+}
+
+// Parks an unused lane: it keeps stepping in place and never ends.
+inline void ClearLane(int lane, int32_t (*state)[Int32xN::kLanes]) {
+  for (int field = 0; field < kLaneFieldsNum; ++field) {
+    state[field][lane] = 0;
+  }
+  state[kMajorDelta][lane] = 1;
+  state[kRemaining][lane] = -1;
+}
+
+}  // namespace pixel_walker_packet_internal
+
+constexpr int kPixelWalkerPacketLanes =
+    pixel_walker_packet_internal::Int32xN::kLanes;
+
+// Walks |rays_num| rays and reports every visited pixel to |sink| in bulk:
+// sink(ray_ids, xs, ys, count) gets arrays of |count| pixels, where
+// (xs[i], ys[i]) is a pixel of ray rays[ray_ids[i]]. Pixels of every ray come
+// in the order of the walk, but pixels of different rays are interleaved.
+template <typename Sink>
+void WalkRays(const PixelRay *rays, size_t rays_num, Sink&& sink) {
+  using namespace pixel_walker_packet_internal;
+  using V = Int32xN;
+  constexpr int kLanes = V::kLanes;
+  constexpr size_t kBufferSize = 256 * kLanes;
+  constexpr uint32_t kAllLanes = (uint64_t(1) << kLanes) - 1;
+
+  alignas(64) int32_t state[kLaneFieldsNum][kLanes];
+  alignas(64) int32_t ray_ids[kBufferSize];
+  alignas(64) int32_t xs[kBufferSize];
+  alignas(64) int32_t ys[kBufferSize];
+  size_t buffer_size = 0;
+
+  // Rays of zero length are skipped. Returns the mask of lanes which got a
+  // ray.
+  size_t next_ray = 0;
+  auto refill = [&](uint32_t lanes) {
+    uint32_t filled = 0;
+    for (int lane = 0; lane < kLanes; ++lane) {
+      if ((lanes >> lane & 1) == 0) {
+        continue;
+      }
+      while (next_ray < rays_num && rays[next_ray].length <= 0) {
+        ++next_ray;
+      }
+      if (next_ray < rays_num) {
+        InitLane(rays[next_ray], next_ray, lane, state);
+        ++next_ray;
+        filled |= uint32_t(1) << lane;
+      } else {
+        ClearLane(lane, state);
+      }
+    }
+    return filled;
+  };
+
+  uint32_t active = refill(kAllLanes);
+  while (active != 0) {
+    typename V::Vector x = V::Load(state[kX]);
+    typename V::Vector y = V::Load(state[kY]);
+    typename V::Vector error = V::Load(state[kError]);
+    typename V::Vector remaining = V::Load(state[kRemaining]);
+    const typename V::Vector major_delta = V::Load(state[kMajorDelta]);
+    const typename V::Vector minor_delta = V::Load(state[kMinorDelta]);
+    const typename V::Vector major_step_x = V::Load(state[kMajorStepX]);
+    const typename V::Vector major_step_y = V::Load(state[kMajorStepY]);
+    const typename V::Vector minor_step_x = V::Load(state[kMinorStepX]);
+    const typename V::Vector minor_step_y = V::Load(state[kMinorStepY]);
+    const typename V::Vector ray_id = V::Load(state[kRayId]);
+    const typename V::Vector one = V::Set1(1);
+    // Steps all lanes until one of the rays ends.
+    uint32_t ended = 0;
+    while (ended == 0) {
+      error = V::Sub(error, minor_delta);
+      const typename V::Vector carry = V::NegativeMask(error);
+      error = V::Add(error, V::And(major_delta, carry));
+      x = V::Add(x, V::Add(major_step_x, V::And(minor_step_x, carry)));
+      y = V::Add(y, V::Add(major_step_y, V::And(minor_step_y, carry)));
+      remaining = V::Sub(remaining, one);
+      if (active == kAllLanes) {
+        V::Store(ray_ids + buffer_size, ray_id);
+        V::Store(xs + buffer_size, x);
+        V::Store(ys + buffer_size, y);
+        buffer_size += kLanes;
+      } else {
+        alignas(64) int32_t lane_xs[kLanes];
+        alignas(64) int32_t lane_ys[kLanes];
+        V::Store(lane_xs, x);
+        V::Store(lane_ys, y);
+        for (int lane = 0; lane < kLanes; ++lane) {
+          if (active >> lane & 1) {
+            ray_ids[buffer_size] = state[kRayId][lane];
+            xs[buffer_size] = lane_xs[lane];
+            ys[buffer_size] = lane_ys[lane];
+            ++buffer_size;
+          }
+        }
+      }
+      if (buffer_size + kLanes > kBufferSize) {
+        sink(static_cast<const int32_t*>(ray_ids),
+             static_cast<const int32_t*>(xs), static_cast<const int32_t*>(ys),
+             buffer_size);
+        buffer_size = 0;
+      }
+      ended = V::ZeroLanes(remaining) & active;
+    }
+    V::Store(state[kX], x);
+    V::Store(state[kY], y);
+    V::Store(state[kError], error);
+    V::Store(state[kRemaining], remaining);
+    active = (active & ~ended) | refill(ended);
+  }
+  if (buffer_size > 0) {
+    sink(static_cast<const int32_t*>(ray_ids),
+         static_cast<const int32_t*>(xs), static_cast<const int32_t*>(ys),
+         buffer_size);
+  }
+}
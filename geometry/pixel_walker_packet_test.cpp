@@ -0,0 +1,154 @@
+#include "pixel_walker_packet.h"
+
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+std::vector<PixelRay> GenerateRays(size_t rays_num, int max_length,
+                                   std::mt19937& gen) {
+  std::uniform_real_distribution<float> angle_distribution(0.0f, 2 * M_PI);
+  std::uniform_int_distribution<int> start_distribution(-1000, 1000);
+  std::uniform_int_distribution<int> length_distribution(0, max_length);
+  std::vector<PixelRay> rays(rays_num);
+  for (PixelRay& ray : rays) {
+    ray = {start_distribution(gen), start_distribution(gen),
+           angle_distribution(gen), length_distribution(gen)};
+  }
+  return rays;
+}
+
+void RunTestMatchesIntegerWalker() {
+  std::mt19937 gen(42);
+  for (size_t rays_num : {0, 1, 7, 100, 1000}) {
+    const std::vector<PixelRay> rays = GenerateRays(rays_num, 300, gen);
+    std::vector<std::vector<std::pair<int, int>>> pixels(rays_num);
+    size_t calls_num = 0;
+    WalkRays(rays.data(), rays.size(),
+             [&](const int32_t *ray_ids, const int32_t *xs, const int32_t *ys,
+                 size_t count) {
+               assert(count > 0);
+               ++calls_num;
+               for (size_t i = 0; i < count; ++i) {
+                 pixels[ray_ids[i]].emplace_back(xs[i], ys[i]);
+               }
+             });
+    assert(rays_num > 0 || calls_num == 0);
+    for (size_t i = 0; i < rays_num; ++i) {
+      assert(pixels[i].size() == size_t(rays[i].length));
+      IntegerPixelWalker walker(rays[i].start_x, rays[i].start_y,
+                                rays[i].angle);
+      for (const auto& [x, y] : pixels[i]) {
+        walker.next();
+        assert(walker.getX() == x && walker.getY() == y);
+      }
+    }
+  }
+}
+
+void RunTestAxisAligned() {
+  const std::vector<PixelRay> rays = {
+      {0, 0, 0.0f, 5}, {0, 0, float(M_PI_2), 5}, {0, 0, float(M_PI), 5},
+      {0, 0, float(M_PI_4), 5}};
+  std::vector<std::pair<int, int>> ends(rays.size());
+  WalkRays(rays.data(), rays.size(),
+           [&](const int32_t *ray_ids, const int32_t *xs, const int32_t *ys,
+               size_t count) {
+             for (size_t i = 0; i < count; ++i) {
+               ends[ray_ids[i]] = {xs[i], ys[i]};
+             }
+           });
+  assert(ends[0] == std::make_pair(5, 0));
+  assert(ends[1] == std::make_pair(0, 5));
+  assert(ends[2] == std::make_pair(-5, 0));
+  assert(ends[3] == std::make_pair(5, 5));
+}
+
+// Sums the values of a wrapped-around 1024x1024 grid at all pixels of all
+// rays, walked by scalar walkers or in packets. With |grid| empty sums the
+// coordinates instead, which measures the walks alone.
+template <typename Walker>
+int64_t SumScalar(const std::vector<PixelRay>& rays,
+                  const std::vector<uint8_t>& grid) {
+  int64_t sum = 0;
+  for (const PixelRay& ray : rays) {
+    Walker walker(ray.start_x, ray.start_y, ray.angle);
+    for (int i = 0; i < ray.length; ++i) {
+      walker.next();
+      sum += grid.empty()
+                 ? walker.getX() ^ walker.getY()
+                 : grid[(walker.getY() & 1023) * 1024 + (walker.getX() & 1023)];
+    }
+  }
+  return sum;
+}
+
+int64_t SumPackets(const std::vector<PixelRay>& rays,
+                   const std::vector<uint8_t>& grid) {
+  int64_t sum = 0;
+  WalkRays(rays.data(), rays.size(),
+           [&](const int32_t * /* ray_ids */, const int32_t *xs,
+               const int32_t *ys, size_t count) {
+             if (grid.empty()) {
+               for (size_t i = 0; i < count; ++i) {
+                 sum += xs[i] ^ ys[i];
+               }
+               return;
+             }
+             for (size_t i = 0; i < count; ++i) {
+               sum += grid[(ys[i] & 1023) * 1024 + (xs[i] & 1023)];
+             }
+           });
+  return sum;
+}
+
+template <typename Func>
+double MeasurePixelsPerSecond(const std::vector<PixelRay>& rays,
+                              const Func& func, int64_t *sum) {
+  size_t pixels_num = 0;
+  for (const PixelRay& ray : rays) {
+    pixels_num += ray.length;
+  }
+  auto start = std::chrono::high_resolution_clock::now();
+  *sum = func();
+  auto end = std::chrono::high_resolution_clock::now();
+  return pixels_num / std::chrono::duration<double>(end - start).count();
+}
+
+void RunBenchmark(const std::vector<PixelRay>& rays,
+                  const std::vector<uint8_t>& grid) {
+  int64_t float_sum;
+  int64_t integer_sum;
+  int64_t packet_sum;
+  const double float_speed = MeasurePixelsPerSecond(
+      rays, [&]() { return SumScalar<PixelWalker>(rays, grid); }, &float_sum);
+  const double integer_speed = MeasurePixelsPerSecond(
+      rays, [&]() { return SumScalar<IntegerPixelWalker>(rays, grid); },
+      &integer_sum);
+  const double packet_speed = MeasurePixelsPerSecond(
+      rays, [&]() { return SumPackets(rays, grid); }, &packet_sum);
+  assert(packet_sum == integer_sum);
+  std::cout << (grid.empty() ? "Walks only" : "Walks with grid lookups")
+            << ": PixelWalker " << float_speed / 1e6
+            << "M pixels/s, IntegerPixelWalker " << integer_speed / 1e6
+            << "M pixels/s, WalkRays with " << kPixelWalkerPacketLanes
+            << " lanes " << packet_speed / 1e6 << "M pixels/s (checksums "
+            << float_sum << ", " << packet_sum << ")" << std::endl;
+}
+
+int main() {
+  RunTestMatchesIntegerWalker();
+  RunTestAxisAligned();
+  std::cout << "All tests passed! :)" << std::endl;
+  std::mt19937 gen(42);
+  const std::vector<PixelRay> rays = GenerateRays(100000, 2000, gen);
+  std::vector<uint8_t> grid(1024 * 1024);
+  for (uint8_t& value : grid) {
+    value = gen();
+  }
+  RunBenchmark(rays, {});
+  RunBenchmark(rays, grid);
+  return 0;
+}
@@ -1,10 +1,15 @@
 #include "pixel_walker.h"
 
 #include <cassert>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <random>
+#include <vector>
 
+template <typename Walker>
 void RunTestStraightX() {
-  PixelWalker walker(0, 0, 0.0f);
+  Walker walker(0, 0, 0.0f);
   for (int i = 0; i < 100; ++i) {
     walker.next();
     assert(walker.getX() == i + 1);
@@ -12,8 +17,9 @@ void RunTestStraightX() {
   }
 }
 
+template <typename Walker>
 void RunTestStraightXInvert() {
-  PixelWalker walker(0, 0, M_PI);
+  Walker walker(0, 0, M_PI);
   for (int i = 0; i < 100; ++i) {
     walker.next();
     assert(walker.getX() == -i - 1);
@@ -21,8 +27,9 @@ void RunTestStraightXInvert() {
   }
 }
 
+template <typename Walker>
 void RunTestStraightY() {
-  PixelWalker walker(0, 0, M_PI_2);
+  Walker walker(0, 0, M_PI_2);
   for (int i = 0; i < 100; ++i) {
     walker.next();
     assert(walker.getX() == 0);
@@ -30,8 +37,9 @@ void RunTestStraightY() {
   }
 }
 
+template <typename Walker>
 void RunTestStraightYInvert() {
-  PixelWalker walker(0, 0, M_PI_2 * 3.0f);
+  Walker walker(0, 0, M_PI_2 * 3.0f);
   for (int i = 0; i < 100; ++i) {
     walker.next();
     assert(walker.getX() == 0);
@@ -39,8 +47,9 @@ void RunTestStraightYInvert() {
   }
 }
 
+template <typename Walker>
 void RunTestDegrees45() {
-  PixelWalker walker(0, 0, M_PI_4);
+  Walker walker(0, 0, M_PI_4);
   for (int i = 0; i < 100; ++i) {
     walker.next();
     assert(walker.getX() == i + 1);
@@ -48,8 +57,9 @@ void RunTestDegrees45() {
   }
 }
 
+template <typename Walker>
 void RunTestDegrees30() {
-  PixelWalker walker(0, 0, M_PI / 6.0f);
+  Walker walker(0, 0, M_PI / 6.0f);
   walker.next();
   assert(walker.getX() == 1);
   assert(walker.getY() == 0);
@@ -79,13 +89,241 @@ void RunTestDegrees30() {
   assert(walker.getY() == 5);
 }
 
+// Minor offset of the |k|-th pixel of a walk in direction (|major|, |minor|),
+// |major| > 0: the exact offset rounded down.
+int64_t ExactMinorOffset(int64_t k, int64_t major, int64_t minor) {
+  const __int128 offset = __int128(k) * minor;
+  return static_cast<int64_t>(offset >= 0 ? offset / major
+                                          : (offset - major + 1) / major);
+}
+
+void RunTestIntegerDirections() {
+  const std::vector<std::pair<int64_t, int64_t>> directions = {
+      {7, 3}, {7, -3}, {-7, 3}, {-7, -3}, {2, 9}, {-2, -9}, {5, 0}, {0, -5},
+      {1000003, 999999}, {1 << 24, 1}};
+  for (const auto& [dir_x, dir_y] : directions) {
+    IntegerPixelWalker walker(5, -2, dir_x, dir_y);
+    const bool x_major = std::llabs(dir_x) >= std::llabs(dir_y);
+    const int64_t major = x_major ? dir_x : dir_y;
+    const int64_t minor = x_major ? dir_y : dir_x;
+    for (int64_t k = 1; k <= 1000000; ++k) {
+      walker.next();
+      const int64_t major_offset = major > 0 ? k : -k;
+      const int64_t minor_offset = ExactMinorOffset(k, std::llabs(major),
+                                                    minor);
+      assert(walker.getX() - 5 == (x_major ? major_offset : minor_offset));
+      assert(walker.getY() + 2 == (x_major ? minor_offset : major_offset));
+    }
+  }
+}
+
+void RunTestIntegerTarget() {
+  IntegerPixelWalker walker(1, 1, 11 - 1, 4 - 1);
+  for (int i = 0; i < 10; ++i) {
+    walker.next();
+  }
+  assert(walker.getX() == 11 && walker.getY() == 4);
+}
+
+void RunTestIntegerAdvance() {
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<float> angle_distribution(0.0f, 2 * M_PI);
+  for (int ray = 0; ray < 100; ++ray) {
+    const float angle = angle_distribution(gen);
+    IntegerPixelWalker walker(-3, 7, angle);
+    IntegerPixelWalker jumping_walker(-3, 7, angle);
+    for (int64_t steps : {0, 1, 5, 100, 12345}) {
+      for (int64_t i = 0; i < steps; ++i) {
+        walker.next();
+      }
+      jumping_walker.advance(steps);
+      assert(walker.getX() == jumping_walker.getX());
+      assert(walker.getY() == jumping_walker.getY());
+      walker.next();
+      jumping_walker.next();
+      assert(walker.getX() == jumping_walker.getX());
+      assert(walker.getY() == jumping_walker.getY());
+    }
+  }
+}
+
+// Walks from different starts are shifted copies of each other, also with
+// negative coordinates.
+void RunTestIntegerStarts() {
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<float> angle_distribution(0.0f, 2 * M_PI);
+  std::uniform_int_distribution<int> start_distribution(-1000, 1000);
+  for (int ray = 0; ray < 100; ++ray) {
+    const float angle = angle_distribution(gen);
+    const int start_x = start_distribution(gen);
+    const int start_y = start_distribution(gen);
+    IntegerPixelWalker walker(0, 0, angle);
+    IntegerPixelWalker shifted_walker(start_x, start_y, angle);
+    for (int i = 0; i < 1000; ++i) {
+      walker.next();
+      shifted_walker.next();
+      assert(shifted_walker.getX() == walker.getX() + start_x);
+      assert(shifted_walker.getY() == walker.getY() + start_y);
+    }
+  }
+
+  // The exact coordinates are 4.5 and -4.5, which are rounded down. The
+  // float walker truncates the latter to -4.
+  IntegerPixelWalker down_walker(5, 5, 2, -1);
+  down_walker.next();
+  assert(down_walker.getX() == 6 && down_walker.getY() == 4);
+  IntegerPixelWalker up_walker(-5, -5, 2, 1);
+  up_walker.next();
+  assert(up_walker.getX() == -4 && up_walker.getY() == -5);
+  PixelWalker float_down_walker(5, 5, -0.4636f);
+  IntegerPixelWalker integer_down_walker(5, 5, -0.4636f);
+  float_down_walker.next();
+  integer_down_walker.next();
+  assert(float_down_walker.getX() == 6 && float_down_walker.getY() == 4);
+  assert(integer_down_walker.getX() == 6 && integer_down_walker.getY() == 4);
+}
+
+// Angles far outside of [-pi; pi] keep their direction, which PixelWalker
+// gets from float cos and sin directly.
+void RunTestIntegerLargeAngles() {
+  for (float angle : {1e8f, -3e7f, 16777216.0f, 1e30f, -7.5e12f}) {
+    int64_t dir_x;
+    int64_t dir_y;
+    IntegerPixelWalker::QuantizeAngle(angle, &dir_x, &dir_y);
+    assert(dir_x != 0 || dir_y != 0);
+    PixelWalker walker(500, 500, angle);
+    IntegerPixelWalker integer_walker(500, 500, angle);
+    for (int i = 0; i < 100; ++i) {
+      walker.next();
+      integer_walker.next();
+      assert(std::abs(walker.getX() - integer_walker.getX()) <= 1);
+      assert(std::abs(walker.getY() - integer_walker.getY()) <= 1);
+    }
+    assert(std::max(std::abs(integer_walker.getX() - 500),
+                    std::abs(integer_walker.getY() - 500)) == 100);
+  }
+}
+
+// PixelWalker and IntegerPixelWalker agree while coordinates stay
+// non-negative, except for pixels where the exact coordinate is next to an
+// integer and float rounding of PixelWalker takes the other side. Every step
+// of PixelWalker rounds coordinates below 1024 by up to 2^-14, so after 100
+// steps they are off by less than 1e-2.
+void RunTestIntegerMatchesFloat() {
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<float> angle_distribution(0.0f, 2 * M_PI);
+  std::uniform_int_distribution<int> start_distribution(100, 1000);
+  int mismatches_num = 0;
+  for (int ray = 0; ray < 1000; ++ray) {
+    const float angle = angle_distribution(gen);
+    const int start_x = start_distribution(gen);
+    const int start_y = start_distribution(gen);
+    const double dx = std::cos(double(angle));
+    const double dy = std::sin(double(angle));
+    const double norm = std::max(std::abs(dx), std::abs(dy));
+    PixelWalker walker(start_x, start_y, angle);
+    IntegerPixelWalker integer_walker(start_x, start_y, angle);
+    for (int i = 1; i <= 100; ++i) {
+      walker.next();
+      integer_walker.next();
+      if (walker.getX() == integer_walker.getX() &&
+          walker.getY() == integer_walker.getY()) {
+        continue;
+      }
+      ++mismatches_num;
+      const double x = start_x + i * dx / norm;
+      const double y = start_y + i * dy / norm;
+      assert(std::abs(walker.getX() - integer_walker.getX()) <= 1);
+      assert(std::abs(walker.getY() - integer_walker.getY()) <= 1);
+      assert(walker.getX() == integer_walker.getX() ||
+             std::abs(x - std::round(x)) < 1e-2);
+      assert(walker.getY() == integer_walker.getY() ||
+             std::abs(y - std::round(y)) < 1e-2);
+    }
+  }
+  std::cout << "PixelWalker and IntegerPixelWalker differ in "
+            << mismatches_num << " of 100000 pixels" << std::endl;
+}
+
+// Walks all rays and sums the values of a wrapped-around 1024x1024 grid at
+// visited pixels, so that no step can be optimized away.
+template <typename Walker>
+double MeasurePixelsPerSecond(const std::vector<float>& angles, int steps_num,
+                              const std::vector<uint8_t>& grid,
+                              int64_t *checksum) {
+  auto start = std::chrono::high_resolution_clock::now();
+  int64_t sum = 0;
+  for (float angle : angles) {
+    Walker walker(0, 0, angle);
+    for (int i = 0; i < steps_num; ++i) {
+      walker.next();
+      sum += grid[(walker.getY() & 1023) * 1024 + (walker.getX() & 1023)];
+    }
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  *checksum = sum;
+  return angles.size() * double(steps_num) /
+         std::chrono::duration<double>(end - start).count();
+}
+
+void RunBenchmark() {
+  constexpr int kRaysNum = 10000;
+  constexpr int kStepsNum = 10000;
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<float> angle_distribution(0.0f, 2 * M_PI);
+  std::vector<float> angles(kRaysNum);
+  for (float& angle : angles) {
+    angle = angle_distribution(gen);
+  }
+  std::vector<uint8_t> grid(1024 * 1024);
+  for (uint8_t& value : grid) {
+    value = gen();
+  }
+  int64_t checksum;
+  int64_t integer_checksum;
+  const double float_speed = MeasurePixelsPerSecond<PixelWalker>(
+      angles, kStepsNum, grid, &checksum);
+  const double integer_speed = MeasurePixelsPerSecond<IntegerPixelWalker>(
+      angles, kStepsNum, grid, &integer_checksum);
+  std::cout << "PixelWalker: " << float_speed / 1e6
+            << "M pixels/s, IntegerPixelWalker: " << integer_speed / 1e6
+            << "M pixels/s (checksums " << checksum << ", " << integer_checksum
+            << ")" << std::endl;
+
+  // Drift of the float walker on a long ray.
+  constexpr int kLongRayLength = 10000000;
+  PixelWalker walker(0, 0, M_PI / 6.0f);
+  IntegerPixelWalker integer_walker(0, 0, M_PI / 6.0f);
+  for (int i = 0; i < kLongRayLength; ++i) {
+    walker.next();
+    integer_walker.next();
+  }
+  std::cout << "After " << kLongRayLength << " steps at 30 degrees: "
+            << "PixelWalker at (" << walker.getX() << ", " << walker.getY()
+            << "), IntegerPixelWalker at (" << integer_walker.getX() << ", "
+            << integer_walker.getY() << ")" << std::endl;
+}
+
 int main() {
-  RunTestStraightX();
-  RunTestStraightY();
-  RunTestStraightXInvert();
-  RunTestStraightYInvert();
-  RunTestDegrees30();
-  RunTestDegrees45();
+  RunTestStraightX<PixelWalker>();
+  RunTestStraightY<PixelWalker>();
+  RunTestStraightXInvert<PixelWalker>();
+  RunTestStraightYInvert<PixelWalker>();
+  RunTestDegrees30<PixelWalker>();
+  RunTestDegrees45<PixelWalker>();
+  RunTestStraightX<IntegerPixelWalker>();
+  RunTestStraightY<IntegerPixelWalker>();
+  RunTestStraightXInvert<IntegerPixelWalker>();
+  RunTestStraightYInvert<IntegerPixelWalker>();
+  RunTestDegrees30<IntegerPixelWalker>();
+  RunTestDegrees45<IntegerPixelWalker>();
+  RunTestIntegerDirections();
+  RunTestIntegerTarget();
+  RunTestIntegerAdvance();
+  RunTestIntegerStarts();
+  RunTestIntegerLargeAngles();
+  RunTestIntegerMatchesFloat();
   std::cout << "All tests passed! :)" << std::endl;
+  RunBenchmark();
   return 0;
 }
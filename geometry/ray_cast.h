@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "../misc/blob_matrix2d.h"
+#include "../misc/thread_pool.h"
+#include "pixel_walker.h"
+
+// Casts rays over occupancy grids: cells with non-zero values are occupied,
+// x is the column and y is the row of a cell. Rays visit the pixels of
+// IntegerPixelWalker, starting with the start cell itself.
+//
+// The part of a ray inside the grid is found analytically, so rays starting
+// far outside the grid cost nothing until they enter it, and the cost of a
+// ray is proportional to the number of cells it traverses, not to the grid
+// size.
+
+struct RayCastHit {
+  bool hit = false;
+  // The first occupied cell, valid if |hit|.
+  int x = 0;
+  int y = 0;
+  // Distance from the start to the occupied cell along the ray, |max_dist|
+  // if nothing was hit.
+  float distance = 0.0f;
+};
+
+struct RayCastQuery {
+  int start_x;
+  int start_y;
+  float angle;
+  float max_dist;
+};
+
+namespace ray_cast_internal {
+
+// Rounds a / b down, b > 0.
+inline int64_t FloorDiv(__int128 a, int64_t b) {
+  return a >= 0 ? int64_t(a / b) : int64_t((a - b + 1) / b);
+}
+
+// Rounds a / b up, b > 0.
+inline int64_t CeilDiv(__int128 a, int64_t b) {
+  return a >= 0 ? int64_t((a + b - 1) / b) : int64_t(a / b);
+}
+
+// Steps range [*begin; *end] of a coordinate which after k steps is
+// floor(|start| + sign * k * minor_delta / major_delta), see
+// IntegerPixelWalker, and has to stay in [0; size). The range is empty if
+// *begin > *end.
+inline void ClipAxis(int64_t start, int sign, int64_t minor_delta,
+                     int64_t major_delta, int64_t size, int64_t *begin,
+                     int64_t *end) {
+  // Bounds of the offset, floor(k * minor_delta / major_delta) for positive
+  // |sign| and ceil(...) for negative.
+  const int64_t low = sign > 0 ? -start : start - size + 1;
+  const int64_t high = sign > 0 ? size - 1 - start : start;
+  if (minor_delta == 0) {
+    *begin = low <= 0 && 0 <= high ? 0 : 1;
+    *end = low <= 0 && 0 <= high ? INT64_MAX : 0;
+    return;
+  }
+  if (sign > 0) {
+    *begin = CeilDiv(__int128(low) * major_delta, minor_delta);
+    *end = CeilDiv(__int128(high + 1) * major_delta, minor_delta) - 1;
+  } else {
+    *begin = FloorDiv(__int128(low - 1) * major_delta, minor_delta) + 1;
+    *end = FloorDiv(__int128(high) * major_delta, minor_delta);
+  }
+}
+
+}  // namespace ray_cast_internal
+
+// Returns the first occupied cell of |grid| on the ray from (|start_x|,
+// |start_y|) in the direction of |angle| within |max_dist| cells. The start
+// may lie outside of the grid. Rays with negative or NaN |max_dist| hit
+// nothing.
+inline RayCastHit RayCast(const BlobMatrix2D<uint8_t>& grid, int start_x,
+                          int start_y, float angle, float max_dist) {
+  using ray_cast_internal::ClipAxis;
+  int64_t dir_x;
+  int64_t dir_y;
+  IntegerPixelWalker::QuantizeAngle(angle, &dir_x, &dir_y);
+  const bool x_major = std::llabs(dir_x) >= std::llabs(dir_y);
+  const int64_t major_delta = std::llabs(x_major ? dir_x : dir_y);
+  const int64_t minor_delta = std::llabs(x_major ? dir_y : dir_x);
+  // Every step moves by one along the major axis.
+  const double step_length =
+      std::hypot(double(major_delta), double(minor_delta)) / major_delta;
+
+  RayCastHit result;
+  result.distance = max_dist;
+  if (!(max_dist >= 0) || grid.rows() == 0 || grid.cols() == 0) {
+    return result;
+  }
+  int64_t begin = 0;
+  int64_t end = int64_t(std::min(max_dist / step_length, 1e18));
+  // The major axis is clipped as an axis whose offset grows by one per step.
+  int64_t axis_begin;
+  int64_t axis_end;
+  ClipAxis(start_x, dir_x < 0 ? -1 : 1, x_major ? 1 : minor_delta,
+           x_major ? 1 : major_delta, grid.cols(), &axis_begin, &axis_end);
+  begin = std::max(begin, axis_begin);
+  end = std::min(end, axis_end);
+  ClipAxis(start_y, dir_y < 0 ? -1 : 1, x_major ? minor_delta : 1,
+           x_major ? major_delta : 1, grid.rows(), &axis_begin, &axis_end);
+  begin = std::max(begin, axis_begin);
+  end = std::min(end, axis_end);
+  if (begin > end) {
+    return result;
+  }
+
+  IntegerPixelWalker walker(start_x, start_y, dir_x, dir_y);
+  walker.advance(begin);
+  for (int64_t step = begin; step <= end; ++step) {
+    if (grid(walker.getY(), walker.getX()) != 0) {
+      result.hit = true;
+      result.x = walker.getX();
+      result.y = walker.getY();
+      result.distance = step * step_length;
+      return result;
+    }
+    walker.next();
+  }
+  return result;
+}
+
+// Casts |queries_num| rays in parallel on |pool| and stores the results of
+// queries[i] to hits[i].
+inline void RayCast(const BlobMatrix2D<uint8_t>& grid,
+                    const RayCastQuery *queries, size_t queries_num,
+                    RayCastHit *hits, ThreadPool& pool) {
+  // Rays are cheap, so every task takes a batch of them.
+  constexpr size_t kGrainSize = 64;
+  ParallelFor(pool, 0, queries_num, kGrainSize,
+              [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                  const RayCastQuery& query = queries[i];
+                  hits[i] = RayCast(grid, query.start_x, query.start_y,
+                                    query.angle, query.max_dist);
+                }
+              });
+}
+
+// Sweep of a range sensor at (|x|, |y|): |rays_num| rays at angles
+// |first_angle| + i * |angle_step|, cast in parallel on |pool|.
+inline std::vector<RayCastHit> SensorSweep(const BlobMatrix2D<uint8_t>& grid,
+                                           int x, int y, float first_angle,
+                                           float angle_step, size_t rays_num,
+                                           float max_dist, ThreadPool& pool) {
+  std::vector<RayCastQuery> queries(rays_num);
+  for (size_t i = 0; i < rays_num; ++i) {
+    queries[i] = {x, y, first_angle + i * angle_step, max_dist};
+  }
+  std::vector<RayCastHit> hits(rays_num);
+  RayCast(grid, queries.data(), rays_num, hits.data(), pool);
+  return hits;
+}
@@ -0,0 +1,186 @@
+#include "ray_cast.h"
+
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Walks the whole ray within |max_dist| and tests the bounds on every step.
+RayCastHit BruteForceRayCast(const BlobMatrix2D<uint8_t>& grid, int start_x,
+                             int start_y, float angle, float max_dist) {
+  int64_t dir_x;
+  int64_t dir_y;
+  IntegerPixelWalker::QuantizeAngle(angle, &dir_x, &dir_y);
+  const int64_t major_delta = std::max(std::llabs(dir_x), std::llabs(dir_y));
+  const int64_t minor_delta = std::min(std::llabs(dir_x), std::llabs(dir_y));
+  const double step_length =
+      std::hypot(double(major_delta), double(minor_delta)) / major_delta;
+  const int64_t steps_num = max_dist / step_length;
+  IntegerPixelWalker walker(start_x, start_y, angle);
+  RayCastHit result;
+  result.distance = max_dist;
+  for (int64_t step = 0; step <= steps_num; ++step) {
+    const int x = walker.getX();
+    const int y = walker.getY();
+    if (x >= 0 && y >= 0 && size_t(x) < grid.cols() &&
+        size_t(y) < grid.rows() && grid(y, x) != 0) {
+      result.hit = true;
+      result.x = x;
+      result.y = y;
+      result.distance = step * step_length;
+      return result;
+    }
+    walker.next();
+  }
+  return result;
+}
+
+OwningBlobMatrix2D<uint8_t> GenerateGrid(size_t rows, size_t cols,
+                                         double density, std::mt19937& gen) {
+  OwningBlobMatrix2D<uint8_t> grid(rows, cols);
+  std::bernoulli_distribution occupied(density);
+  for (size_t i = 0; i < rows; ++i) {
+    for (size_t j = 0; j < cols; ++j) {
+      grid(i, j) = occupied(gen);
+    }
+  }
+  return grid;
+}
+
+bool operator==(const RayCastHit& a, const RayCastHit& b) {
+  return a.hit == b.hit && a.x == b.x && a.y == b.y && a.distance == b.distance;
+}
+
+void RunTestWall() {
+  OwningBlobMatrix2D<uint8_t> grid(100, 200);
+  for (size_t i = 0; i < grid.rows(); ++i) {
+    grid(i, 150) = 1;
+  }
+  RayCastHit hit = RayCast(grid, 10, 20, 0.0f, 1000.0f);
+  assert(hit.hit && hit.x == 150 && hit.y == 20 && hit.distance == 140.0f);
+  // Too short.
+  hit = RayCast(grid, 10, 20, 0.0f, 139.5f);
+  assert(!hit.hit && hit.distance == 139.5f);
+  // Away from the wall, and from far outside of the grid.
+  assert(!RayCast(grid, 10, 20, M_PI, 1000.0f).hit);
+  hit = RayCast(grid, -1000000000, 50, 0.0f, 2e9f);
+  assert(hit.hit && hit.x == 150 && hit.y == 50);
+  assert(!RayCast(grid, -1000000000, 150, 0.0f, 2e9f).hit);
+  // The start cell counts.
+  hit = RayCast(grid, 150, 0, M_PI_2, 10.0f);
+  assert(hit.hit && hit.x == 150 && hit.y == 0 && hit.distance == 0.0f);
+  // Angles far outside of [-pi; pi]: 10526013 is 1675267 full turns minus
+  // 2.8e-6, so the ray goes along the x axis slightly downwards.
+  hit = RayCast(grid, 10, 20, 10526013.0f, 1000.0f);
+  assert(hit.hit && hit.x == 150 && hit.y == 19);
+  // NaN distances hit nothing.
+  assert(!RayCast(grid, 10, 20, 0.0f, NAN).hit);
+  // Empty grids.
+  OwningBlobMatrix2D<uint8_t> empty;
+  assert(!RayCast(empty, 0, 0, 0.0f, 10.0f).hit);
+}
+
+void RunTestMatchesBruteForce() {
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<float> angle_distribution(0.0f, 2 * M_PI);
+  std::uniform_int_distribution<int> start_distribution(-200, 300);
+  std::uniform_real_distribution<float> dist_distribution(0.0f, 600.0f);
+  for (double density : {0.0, 0.001, 0.05}) {
+    const OwningBlobMatrix2D<uint8_t> grid = GenerateGrid(97, 131, density,
+                                                         gen);
+    for (int i = 0; i < 20000; ++i) {
+      const int x = start_distribution(gen);
+      const int y = start_distribution(gen);
+      // Axis-aligned and diagonal rays too.
+      const float angle = i % 10 == 0 ? (i / 10 % 8) * float(M_PI_4)
+                                      : angle_distribution(gen);
+      const float max_dist = dist_distribution(gen);
+      assert(RayCast(grid, x, y, angle, max_dist) ==
+             BruteForceRayCast(grid, x, y, angle, max_dist));
+    }
+  }
+}
+
+void RunTestParallel() {
+  std::mt19937 gen(42);
+  const OwningBlobMatrix2D<uint8_t> grid = GenerateGrid(500, 500, 0.01, gen);
+  ThreadPool pool(4);
+  const std::vector<RayCastHit> hits =
+      SensorSweep(grid, 250, 250, 0.0f, 2 * M_PI / 1000, 1000, 300.0f, pool);
+  assert(hits.size() == 1000);
+  for (size_t i = 0; i < hits.size(); ++i) {
+    assert(hits[i] ==
+           RayCast(grid, 250, 250, 0.0f + i * float(2 * M_PI / 1000), 300.0f));
+  }
+}
+
+template <typename Func>
+long long MeasureMs(const Func& func) {
+  auto start = std::chrono::high_resolution_clock::now();
+  func();
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      end - start).count();
+}
+
+// Sensor sweeps over a sparse map, serial and parallel, and rays from far
+// outside of the map, clipped and walked through.
+void RunBenchmark() {
+  constexpr size_t kSize = 4096;
+  constexpr size_t kRaysNum = 100000;
+  std::mt19937 gen(42);
+  const OwningBlobMatrix2D<uint8_t> grid = GenerateGrid(kSize, kSize, 0.0005,
+                                                       gen);
+  const float angle_step = 2 * M_PI / kRaysNum;
+  size_t hits_num = 0;
+  const long long serial_ms = MeasureMs([&]() {
+    for (size_t i = 0; i < kRaysNum; ++i) {
+      hits_num += RayCast(grid, kSize / 2, kSize / 2, i * angle_step,
+                          kSize).hit;
+    }
+  });
+  ThreadPool pool;
+  size_t parallel_hits_num = 0;
+  const long long parallel_ms = MeasureMs([&]() {
+    for (const RayCastHit& hit : SensorSweep(grid, kSize / 2, kSize / 2, 0.0f,
+                                             angle_step, kRaysNum, kSize,
+                                             pool)) {
+      parallel_hits_num += hit.hit;
+    }
+  });
+  assert(hits_num == parallel_hits_num);
+  std::cout << "Sweep of " << kRaysNum << " rays over " << kSize << "x"
+            << kSize << " map: serial " << serial_ms << "ms, "
+            << pool.GetThreadsNum() << " threads " << parallel_ms << "ms, "
+            << hits_num << " hits" << std::endl;
+
+  constexpr int kFarRaysNum = 1000;
+  constexpr int kFarStart = -1000000;
+  size_t clipped_hits_num = 0;
+  size_t brute_hits_num = 0;
+  const long long clipped_ms = MeasureMs([&]() {
+    for (int i = 0; i < kFarRaysNum; ++i) {
+      clipped_hits_num += RayCast(grid, kFarStart, i, 0.0f, 2e6f).hit;
+    }
+  });
+  const long long brute_ms = MeasureMs([&]() {
+    for (int i = 0; i < kFarRaysNum; ++i) {
+      brute_hits_num += BruteForceRayCast(grid, kFarStart, i, 0.0f, 2e6f).hit;
+    }
+  });
+  assert(clipped_hits_num == brute_hits_num);
+  std::cout << kFarRaysNum << " rays from " << -kFarStart
+            << " cells outside of the map: clipped " << clipped_ms
+            << "ms, walked through " << brute_ms << "ms" << std::endl;
+}
+
+int main() {
+  RunTestWall();
+  RunTestMatchesBruteForce();
+  RunTestParallel();
+  std::cout << "All tests passed! :)" << std::endl;
+  RunBenchmark();
+  return 0;
+}
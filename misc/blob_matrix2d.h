@@ -1,6 +1,12 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "../alloc/aligned_alloc.h"
 
 // This class provides interface for indexing matricies represented as
 // continuous in-memory blobs with specified number of rows, columns and
@@ -18,6 +24,7 @@ class BlobMatrix2D {
     }
   }
   BlobMatrix2D(const BlobMatrix2D&) = delete;
+  BlobMatrix2D& operator=(const BlobMatrix2D&) = delete;
 
   T& operator()(size_t i, size_t j) {
     assert(i < rows_);
@@ -38,9 +45,131 @@ class BlobMatrix2D {
   size_t cols() const {
     return cols_;
   }
+
+  T *Row(size_t i) {
+    assert(i < rows_);
+    return reinterpret_cast<T*>(data_ + i * bytes_per_row_);
+  }
+
+  const T *Row(size_t i) const {
+    assert(i < rows_);
+    return reinterpret_cast<const T*>(data_ + i * bytes_per_row_);
+  }
+
+  // Returns a view of the |rows| x |cols| submatrix starting at (|i|, |j|)
+  // which shares the data with this matrix.
+  BlobMatrix2D Block(size_t i, size_t j, size_t rows, size_t cols) const {
+    assert(i + rows <= rows_);
+    assert(j + cols <= cols_);
+    return BlobMatrix2D(data_ + i * bytes_per_row_ + j * sizeof(T), rows, cols,
+                        bytes_per_row_);
+  }
+
+  void *data() const {
+    return data_;
+  }
+
+  size_t bytes_per_row() const {
+    return bytes_per_row_;
+  }
+
+ protected:
+  // Only owners of the data may be moved: a moved view would be easy to
+  // confuse with a copy of the matrix.
+  BlobMatrix2D(BlobMatrix2D&&) = default;
+  BlobMatrix2D& operator=(BlobMatrix2D&&) = default;
+
  private:
   uint8_t *data_;
   size_t rows_;
   size_t cols_;
   size_t bytes_per_row_;
 };
+
+// Rows of OwningBlobMatrix2D start at multiples of this alignment, which is a
+// cache line and enough for aligned SIMD loads.
+constexpr size_t kBlobMatrixAlignment = 64;
+
+// Returns the size of rows of |cols| elements of |element_size| bytes padded
+// to kBlobMatrixAlignment. A typical L1 cache has 64 sets of 64-byte lines, so
+// with a stride which is a multiple of 512 bytes (4K in particular) elements
+// of a column fall into at most 8 sets and evict each other. Such rows get one
+// more cache line of padding.
+inline size_t PaddedBytesPerRow(size_t cols, size_t element_size) {
+  size_t bytes_per_row = (cols * element_size + kBlobMatrixAlignment - 1) /
+                         kBlobMatrixAlignment * kBlobMatrixAlignment;
+  if (bytes_per_row % 512 == 0) {
+    bytes_per_row += kBlobMatrixAlignment;
+  }
+  return bytes_per_row;
+}
+
+namespace blob_matrix2d_internal {
+
+// Storage of OwningBlobMatrix2D, which has to be initialized before the
+// BlobMatrix2D base pointing to it.
+struct AlignedStorage {
+  std::vector<uint8_t, AlignedAlloc<uint8_t, kBlobMatrixAlignment>> bytes;
+};
+
+}  // namespace blob_matrix2d_internal
+
+// BlobMatrix2D which owns zero-initialized storage with rows padded by
+// PaddedBytesPerRow. Can be passed wherever a BlobMatrix2D is expected, and
+// Block() hands out views of its parts without copying. Movable, but not
+// copyable.
+template <typename T>
+class OwningBlobMatrix2D : private blob_matrix2d_internal::AlignedStorage,
+                           public BlobMatrix2D<T> {
+ public:
+  static_assert(alignof(T) <= kBlobMatrixAlignment,
+                "Elements must fit the alignment of rows");
+
+  OwningBlobMatrix2D() : OwningBlobMatrix2D(0, 0) {}
+
+  OwningBlobMatrix2D(size_t rows, size_t cols)
+      : OwningBlobMatrix2D(rows, cols, PaddedBytesPerRow(cols, sizeof(T))) {}
+
+  OwningBlobMatrix2D(size_t rows, size_t cols, size_t bytes_per_row)
+      : AlignedStorage{MakeBytes(rows, cols, bytes_per_row, NumaPolicy())},
+        BlobMatrix2D<T>(bytes.data(), rows, cols, bytes_per_row) {}
+
+  // Places the storage on NUMA nodes according to |numa_policy|, see
+  // AlignedAlloc. Only matrices larger than kMaxPooledBlockSize are affected.
+  OwningBlobMatrix2D(size_t rows, size_t cols, const NumaPolicy& numa_policy)
+      : AlignedStorage{MakeBytes(rows, cols, PaddedBytesPerRow(cols, sizeof(T)),
+                                 numa_policy)},
+        BlobMatrix2D<T>(bytes.data(), rows, cols,
+                        PaddedBytesPerRow(cols, sizeof(T))) {}
+
+  OwningBlobMatrix2D(OwningBlobMatrix2D&& other)
+      : AlignedStorage(std::move(other)), BlobMatrix2D<T>(std::move(other)) {
+    other.Clear();
+  }
+
+  OwningBlobMatrix2D& operator=(OwningBlobMatrix2D&& other) {
+    if (this != &other) {
+      AlignedStorage::operator=(std::move(other));
+      BlobMatrix2D<T>::operator=(std::move(other));
+      other.Clear();
+    }
+    return *this;
+  }
+
+ private:
+  static std::vector<uint8_t, AlignedAlloc<uint8_t, kBlobMatrixAlignment>>
+  MakeBytes(size_t rows, size_t cols, size_t bytes_per_row,
+            const NumaPolicy& numa_policy) {
+    assert(bytes_per_row >= cols * sizeof(T));
+    assert(bytes_per_row % alignof(T) == 0);
+    return std::vector<uint8_t, AlignedAlloc<uint8_t, kBlobMatrixAlignment>>(
+        rows * bytes_per_row,
+        AlignedAlloc<uint8_t, kBlobMatrixAlignment>(numa_policy));
+  }
+
+  // Leaves an empty matrix after moving.
+  void Clear() {
+    bytes.clear();
+    BlobMatrix2D<T>::operator=(BlobMatrix2D<T>(nullptr, 0, 0));
+  }
+};
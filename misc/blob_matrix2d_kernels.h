@@ -0,0 +1,616 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+#include "../alloc/aligned_alloc.h"
+#include "blob_matrix2d.h"
+#include "thread_pool.h"
+
+// Dense linear algebra kernels on BlobMatrix2D views. Matrices are stored by
+// rows, so all inner loops run along rows obtained once per row by Row()
+// instead of indexing every element. Rows may be padded: every kernel honours
+// bytes_per_row() of each of its arguments.
+//
+// With AVX2 and FMA (-mavx2 -mfma) float and double matrices use explicitly
+// vectorized kernels, see SimdMatrixTraits. Other types and targets use
+// scalar loops which are left to the compiler.
+
+template <typename T>
+struct SimdMatrixTraits {
+  static constexpr bool kSupported = false;
+};
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+namespace blob_matrix2d_kernels_internal {
+
+struct Float64x4 {
+  using Value = double;
+  using Vector = __m256d;
+  static constexpr int kLanes = 4;
+
+  static Vector Load(const Value *p) {
+    return _mm256_loadu_pd(p);
+  }
+  static void Store(Value *p, Vector v) {
+    _mm256_storeu_pd(p, v);
+  }
+  static Vector Set1(Value value) {
+    return _mm256_set1_pd(value);
+  }
+  static Vector Zero() {
+    return _mm256_setzero_pd();
+  }
+  static Vector Add(Vector a, Vector b) {
+    return _mm256_add_pd(a, b);
+  }
+  static Vector Sub(Vector a, Vector b) {
+    return _mm256_sub_pd(a, b);
+  }
+  static Vector Mul(Vector a, Vector b) {
+    return _mm256_mul_pd(a, b);
+  }
+  // a * b + c.
+  static Vector MulAdd(Vector a, Vector b, Vector c) {
+    return _mm256_fmadd_pd(a, b, c);
+  }
+  static void Transpose(Vector *rows) {
+    const Vector t0 = _mm256_unpacklo_pd(rows[0], rows[1]);
+    const Vector t1 = _mm256_unpackhi_pd(rows[0], rows[1]);
+    const Vector t2 = _mm256_unpacklo_pd(rows[2], rows[3]);
+    const Vector t3 = _mm256_unpackhi_pd(rows[2], rows[3]);
+    rows[0] = _mm256_permute2f128_pd(t0, t2, 0x20);
+    rows[1] = _mm256_permute2f128_pd(t1, t3, 0x20);
+    rows[2] = _mm256_permute2f128_pd(t0, t2, 0x31);
+    rows[3] = _mm256_permute2f128_pd(t1, t3, 0x31);
+  }
+};
+
+struct Float32x8 {
+  using Value = float;
+  using Vector = __m256;
+  static constexpr int kLanes = 8;
+
+  static Vector Load(const Value *p) {
+    return _mm256_loadu_ps(p);
+  }
+  static void Store(Value *p, Vector v) {
+    _mm256_storeu_ps(p, v);
+  }
+  static Vector Set1(Value value) {
+    return _mm256_set1_ps(value);
+  }
+  static Vector Zero() {
+    return _mm256_setzero_ps();
+  }
+  static Vector Add(Vector a, Vector b) {
+    return _mm256_add_ps(a, b);
+  }
+  static Vector Sub(Vector a, Vector b) {
+    return _mm256_sub_ps(a, b);
+  }
+  static Vector Mul(Vector a, Vector b) {
+    return _mm256_mul_ps(a, b);
+  }
+  static Vector MulAdd(Vector a, Vector b, Vector c) {
+    return _mm256_fmadd_ps(a, b, c);
+  }
+  static void Transpose(Vector *rows) {
+    Vector t[8];
+    for (int i = 0; i < 8; i += 2) {
+      t[i] = _mm256_unpacklo_ps(rows[i], rows[i + 1]);
+      t[i + 1] = _mm256_unpackhi_ps(rows[i], rows[i + 1]);
+    }
+    Vector s[8];
+    for (int i = 0; i < 8; i += 4) {
+      s[i] = _mm256_shuffle_ps(t[i], t[i + 2], 0x44);
+      s[i + 1] = _mm256_shuffle_ps(t[i], t[i + 2], 0xEE);
+      s[i + 2] = _mm256_shuffle_ps(t[i + 1], t[i + 3], 0x44);
+      s[i + 3] = _mm256_shuffle_ps(t[i + 1], t[i + 3], 0xEE);
+    }
+    for (int i = 0; i < 4; ++i) {
+      rows[i] = _mm256_permute2f128_ps(s[i], s[i + 4], 0x20);
+      rows[i + 4] = _mm256_permute2f128_ps(s[i], s[i + 4], 0x31);
+    }
+  }
+};
+
+}  // namespace blob_matrix2d_kernels_internal
+
+template <>
+struct SimdMatrixTraits<double> : blob_matrix2d_kernels_internal::Float64x4 {
+  static constexpr bool kSupported = true;
+};
+
+template <>
+struct SimdMatrixTraits<float> : blob_matrix2d_kernels_internal::Float32x8 {
+  static constexpr bool kSupported = true;
+};
+
+#endif  // defined(__AVX2__) && defined(__FMA__)
+
+// Sizes of the tiles of the scalar matrix product. A tile of C is owned by a
+// single task, and the kGemmTileDepth x kGemmTileCols tile of B it is
+// multiplied by stays in L2 cache.
+constexpr size_t kGemmTileRows = 64;
+constexpr size_t kGemmTileCols = 256;
+constexpr size_t kGemmTileDepth = 128;
+
+// Blocking of the vectorized matrix product. A kGemmPanelDepth-deep slice of
+// B up to kGemmPanelCols wide is packed once and shared by all tasks; every
+// task packs kGemmPanelRows rows of A, which stay in L2 cache, and multiplies
+// them by the slivers of B, which stay in L1 cache.
+constexpr size_t kGemmPanelRows = 96;
+constexpr size_t kGemmPanelCols = 4096;
+constexpr size_t kGemmPanelDepth = 256;
+// Rows of the block of C kept in registers by the micro-kernel; it is two
+// vectors wide.
+constexpr size_t kGemmMicroRows = 6;
+
+// Triangular solves split the right-hand sides into independent column tiles
+// of this width.
+constexpr size_t kTrsmTileCols = 256;
+
+// Side of the square tiles of the transposition.
+constexpr size_t kTransposeTileSize = 32;
+
+namespace blob_matrix2d_kernels_internal {
+
+template <typename T>
+using PackedBuffer = std::vector<T, AlignedAlloc<T, 64>>;
+
+// c[0..cols) += alpha * b[0..cols).
+template <typename T>
+inline void Axpy(T alpha, const T *b, T *c, size_t cols) {
+  size_t j = 0;
+  if constexpr (SimdMatrixTraits<T>::kSupported) {
+    using Traits = SimdMatrixTraits<T>;
+    const auto alpha_vector = Traits::Set1(alpha);
+    for (; j + Traits::kLanes <= cols; j += Traits::kLanes) {
+      Traits::Store(c + j, Traits::MulAdd(alpha_vector, Traits::Load(b + j),
+                                          Traits::Load(c + j)));
+    }
+  }
+  for (; j < cols; ++j) {
+    c[j] += alpha * b[j];
+  }
+}
+
+// Single-threaded C += alpha * A * B on one tile of C.
+template <typename T>
+void GemmTile(T alpha, const BlobMatrix2D<T>& a, const BlobMatrix2D<T>& b,
+              BlobMatrix2D<T>& c, size_t rows_begin, size_t rows_end,
+              size_t cols_begin, size_t cols_end) {
+  const size_t cols = cols_end - cols_begin;
+  for (size_t depth_begin = 0; depth_begin < a.cols();
+       depth_begin += kGemmTileDepth) {
+    const size_t depth_end = std::min(depth_begin + kGemmTileDepth, a.cols());
+    for (size_t i = rows_begin; i < rows_end; ++i) {
+      const T *a_row = a.Row(i);
+      T *c_row = c.Row(i) + cols_begin;
+      size_t p = depth_begin;
+      // Two rows of B per pass halve the loads and stores of the row of C.
+      for (; p + 1 < depth_end; p += 2) {
+        const T alpha0 = alpha * a_row[p];
+        const T alpha1 = alpha * a_row[p + 1];
+        const T *b_row0 = b.Row(p) + cols_begin;
+        const T *b_row1 = b.Row(p + 1) + cols_begin;
+        for (size_t j = 0; j < cols; ++j) {
+          c_row[j] += alpha0 * b_row0[j] + alpha1 * b_row1[j];
+        }
+      }
+      if (p < depth_end) {
+        Axpy(alpha * a_row[p], b.Row(p) + cols_begin, c_row, cols);
+      }
+    }
+  }
+}
+
+template <typename T>
+void GemmTiled(T alpha, const BlobMatrix2D<T>& a, const BlobMatrix2D<T>& b,
+               BlobMatrix2D<T>& c, ThreadPool& pool) {
+  const size_t row_tiles_num = (c.rows() + kGemmTileRows - 1) / kGemmTileRows;
+  const size_t col_tiles_num = (c.cols() + kGemmTileCols - 1) / kGemmTileCols;
+  ParallelFor(pool, 0, row_tiles_num * col_tiles_num, 1,
+              [&](size_t tiles_begin, size_t tiles_end) {
+    for (size_t tile = tiles_begin; tile < tiles_end; ++tile) {
+      const size_t rows_begin = tile / col_tiles_num * kGemmTileRows;
+      const size_t cols_begin = tile % col_tiles_num * kGemmTileCols;
+      GemmTile(alpha, a, b, c, rows_begin,
+               std::min(rows_begin + kGemmTileRows, c.rows()), cols_begin,
+               std::min(cols_begin + kGemmTileCols, c.cols()));
+    }
+  });
+}
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+// Packs rows [|rows_begin|; |rows_begin| + |rows|) and columns
+// [|depth_begin|; |depth_begin| + |depth|) of A into slivers of
+// kGemmMicroRows rows stored column by column. Missing rows are zeroed.
+template <typename T>
+void PackA(const BlobMatrix2D<T>& a, size_t rows_begin, size_t rows,
+           size_t depth_begin, size_t depth, T *packed) {
+  for (size_t sliver = 0; sliver < rows; sliver += kGemmMicroRows) {
+    T *packed_sliver = packed + sliver * depth;
+    for (size_t r = 0; r < kGemmMicroRows; ++r) {
+      if (sliver + r < rows) {
+        const T *row = a.Row(rows_begin + sliver + r) + depth_begin;
+        for (size_t p = 0; p < depth; ++p) {
+          packed_sliver[p * kGemmMicroRows + r] = row[p];
+        }
+      } else {
+        for (size_t p = 0; p < depth; ++p) {
+          packed_sliver[p * kGemmMicroRows + r] = T(0);
+        }
+      }
+    }
+  }
+}
+
+// Packs slivers [|slivers_begin|; |slivers_end|) of |micro_cols| columns of
+// the |depth| x |cols| block of B at (|depth_begin|, |cols_begin|) row by row.
+// Missing columns are zeroed.
+template <typename T>
+void PackB(const BlobMatrix2D<T>& b, size_t depth_begin, size_t depth,
+           size_t cols_begin, size_t cols, size_t micro_cols,
+           size_t slivers_begin, size_t slivers_end, T *packed) {
+  for (size_t sliver = slivers_begin; sliver < slivers_end; ++sliver) {
+    const size_t sliver_begin = sliver * micro_cols;
+    const size_t sliver_cols = std::min(micro_cols, cols - sliver_begin);
+    T *packed_sliver = packed + sliver_begin * depth;
+    for (size_t p = 0; p < depth; ++p) {
+      const T *row = b.Row(depth_begin + p) + cols_begin + sliver_begin;
+      T *packed_row = packed_sliver + p * micro_cols;
+      std::copy(row, row + sliver_cols, packed_row);
+      std::fill(packed_row + sliver_cols, packed_row + micro_cols, T(0));
+    }
+  }
+}
+
+// C[0..rows) x [0..cols) += alpha * A * B for packed slivers of A and B, where
+// rows <= kGemmMicroRows and cols <= two vectors. The whole block of C is
+// accumulated in registers.
+template <typename T>
+void GemmMicroKernel(size_t depth, const T *packed_a, const T *packed_b,
+                     T alpha, T *c, size_t c_stride, size_t rows,
+                     size_t cols) {
+  using Traits = SimdMatrixTraits<T>;
+  using Vector = typename Traits::Vector;
+  constexpr size_t kLanes = Traits::kLanes;
+  Vector acc[kGemmMicroRows][2];
+  for (size_t r = 0; r < kGemmMicroRows; ++r) {
+    acc[r][0] = Traits::Zero();
+    acc[r][1] = Traits::Zero();
+  }
+  for (size_t p = 0; p < depth; ++p) {
+    const Vector b0 = Traits::Load(packed_b + p * 2 * kLanes);
+    const Vector b1 = Traits::Load(packed_b + p * 2 * kLanes + kLanes);
+    const T *a = packed_a + p * kGemmMicroRows;
+    // Unrolled, so that the accumulators are kept in registers.
+#pragma GCC unroll 6
+    for (size_t r = 0; r < kGemmMicroRows; ++r) {
+      const Vector a_vector = Traits::Set1(a[r]);
+      acc[r][0] = Traits::MulAdd(a_vector, b0, acc[r][0]);
+      acc[r][1] = Traits::MulAdd(a_vector, b1, acc[r][1]);
+    }
+  }
+  const Vector alpha_vector = Traits::Set1(alpha);
+  if (rows == kGemmMicroRows && cols == 2 * kLanes) {
+    for (size_t r = 0; r < kGemmMicroRows; ++r) {
+      T *c_row = c + r * c_stride;
+      Traits::Store(c_row, Traits::MulAdd(alpha_vector, acc[r][0],
+                                          Traits::Load(c_row)));
+      Traits::Store(c_row + kLanes,
+                    Traits::MulAdd(alpha_vector, acc[r][1],
+                                   Traits::Load(c_row + kLanes)));
+    }
+    return;
+  }
+  alignas(32) T block[kGemmMicroRows][2 * kLanes];
+  for (size_t r = 0; r < rows; ++r) {
+    Traits::Store(block[r], Traits::Mul(alpha_vector, acc[r][0]));
+    Traits::Store(block[r] + kLanes, Traits::Mul(alpha_vector, acc[r][1]));
+    T *c_row = c + r * c_stride;
+    for (size_t j = 0; j < cols; ++j) {
+      c_row[j] += block[r][j];
+    }
+  }
+}
+
+// Register-blocked matrix product over packed panels (K. Goto, R. van de
+// Geijn, "Anatomy of high-performance matrix multiplication").
+template <typename T>
+void GemmPacked(T alpha, const BlobMatrix2D<T>& a, const BlobMatrix2D<T>& b,
+                BlobMatrix2D<T>& c, ThreadPool& pool) {
+  constexpr size_t kMicroCols = 2 * SimdMatrixTraits<T>::kLanes;
+  static_assert(kGemmPanelRows % kGemmMicroRows == 0,
+                "Panels must consist of whole slivers");
+  // Element (i, j) of C is at c_data[i * c_stride + j].
+  assert(c.bytes_per_row() % sizeof(T) == 0);
+  const size_t c_stride = c.bytes_per_row() / sizeof(T);
+  PackedBuffer<T> packed_b;
+  for (size_t cols_begin = 0; cols_begin < c.cols();
+       cols_begin += kGemmPanelCols) {
+    const size_t cols = std::min(kGemmPanelCols, c.cols() - cols_begin);
+    const size_t slivers_num = (cols + kMicroCols - 1) / kMicroCols;
+    for (size_t depth_begin = 0; depth_begin < a.cols();
+         depth_begin += kGemmPanelDepth) {
+      const size_t depth = std::min(kGemmPanelDepth, a.cols() - depth_begin);
+      packed_b.resize(slivers_num * kMicroCols * depth);
+      ParallelFor(pool, 0, slivers_num, 16,
+                  [&](size_t slivers_begin, size_t slivers_end) {
+        PackB(b, depth_begin, depth, cols_begin, cols, kMicroCols,
+              slivers_begin, slivers_end, packed_b.data());
+      });
+      const size_t panels_num =
+          (c.rows() + kGemmPanelRows - 1) / kGemmPanelRows;
+      ParallelFor(pool, 0, panels_num, 1,
+                  [&](size_t panels_begin, size_t panels_end) {
+        thread_local PackedBuffer<T> packed_a;
+        packed_a.resize(kGemmPanelRows * depth);
+        for (size_t panel = panels_begin; panel < panels_end; ++panel) {
+          const size_t rows_begin = panel * kGemmPanelRows;
+          const size_t rows = std::min(kGemmPanelRows, c.rows() - rows_begin);
+          PackA(a, rows_begin, rows, depth_begin, depth, packed_a.data());
+          for (size_t sliver = 0; sliver < slivers_num; ++sliver) {
+            const size_t sliver_begin = sliver * kMicroCols;
+            const T *packed_b_sliver = packed_b.data() + sliver_begin * depth;
+            const size_t sliver_cols =
+                std::min(kMicroCols, cols - sliver_begin);
+            for (size_t r = 0; r < rows; r += kGemmMicroRows) {
+              GemmMicroKernel(depth, packed_a.data() + r * depth,
+                              packed_b_sliver, alpha,
+                              c.Row(rows_begin + r) + cols_begin +
+                                  sliver_begin,
+                              c_stride, std::min(kGemmMicroRows, rows - r),
+                              sliver_cols);
+            }
+          }
+        }
+      });
+    }
+  }
+}
+
+#endif  // defined(__AVX2__) && defined(__FMA__)
+
+// |c| = op(|a|, |b|) elementwise for rows of |cols| elements, where |Op| has
+// a scalar and a vector overload of Apply.
+template <typename T, typename Op>
+void ElementwiseRow(const T *a, const T *b, T *c, size_t cols, const Op& op) {
+  size_t j = 0;
+  if constexpr (SimdMatrixTraits<T>::kSupported) {
+    using Traits = SimdMatrixTraits<T>;
+    for (; j + Traits::kLanes <= cols; j += Traits::kLanes) {
+      Traits::Store(c + j, op.template Apply<Traits>(Traits::Load(a + j),
+                                                     Traits::Load(b + j)));
+    }
+  }
+  for (; j < cols; ++j) {
+    c[j] = op(a[j], b[j]);
+  }
+}
+
+template <typename T>
+bool IsContiguous(const BlobMatrix2D<T>& matrix) {
+  return matrix.bytes_per_row() == matrix.cols() * sizeof(T);
+}
+
+template <typename T, typename Op>
+void Elementwise(const BlobMatrix2D<T>& a, const BlobMatrix2D<T>& b,
+                 BlobMatrix2D<T>& c, const Op& op) {
+  assert(a.rows() == b.rows() && a.rows() == c.rows());
+  assert(a.cols() == b.cols() && a.cols() == c.cols());
+  if (c.rows() == 0) {
+    return;
+  }
+  // Unpadded matrices are processed as a single row with a single tail.
+  if (IsContiguous(a) && IsContiguous(b) && IsContiguous(c)) {
+    ElementwiseRow(a.Row(0), b.Row(0), c.Row(0), c.rows() * c.cols(), op);
+    return;
+  }
+  for (size_t i = 0; i < c.rows(); ++i) {
+    ElementwiseRow(a.Row(i), b.Row(i), c.Row(i), c.cols(), op);
+  }
+}
+
+struct AddOp {
+  template <typename T>
+  T operator()(T a, T b) const {
+    return a + b;
+  }
+  template <typename Traits>
+  typename Traits::Vector Apply(typename Traits::Vector a,
+                                typename Traits::Vector b) const {
+    return Traits::Add(a, b);
+  }
+};
+
+struct SubtractOp {
+  template <typename T>
+  T operator()(T a, T b) const {
+    return a - b;
+  }
+  template <typename Traits>
+  typename Traits::Vector Apply(typename Traits::Vector a,
+                                typename Traits::Vector b) const {
+    return Traits::Sub(a, b);
+  }
+};
+
+struct MultiplyOp {
+  template <typename T>
+  T operator()(T a, T b) const {
+    return a * b;
+  }
+  template <typename Traits>
+  typename Traits::Vector Apply(typename Traits::Vector a,
+                                typename Traits::Vector b) const {
+    return Traits::Mul(a, b);
+  }
+};
+
+// alpha * a + b.
+template <typename T>
+struct AddScaledOp {
+  T operator()(T a, T b) const {
+    return alpha * a + b;
+  }
+  template <typename Traits>
+  typename Traits::Vector Apply(typename Traits::Vector a,
+                                typename Traits::Vector b) const {
+    return Traits::MulAdd(Traits::Set1(alpha), a, b);
+  }
+
+  T alpha;
+};
+
+}  // namespace blob_matrix2d_kernels_internal
+
+// C += alpha * A * B. Rows of C are computed in parallel on |pool|.
+template <typename T>
+void Gemm(T alpha, const BlobMatrix2D<T>& a, const BlobMatrix2D<T>& b,
+          BlobMatrix2D<T>& c, ThreadPool& pool) {
+  assert(a.rows() == c.rows());
+  assert(a.cols() == b.rows());
+  assert(b.cols() == c.cols());
+#if defined(__AVX2__) && defined(__FMA__)
+  if constexpr (SimdMatrixTraits<T>::kSupported) {
+    blob_matrix2d_kernels_internal::GemmPacked(alpha, a, b, c, pool);
+    return;
+  }
+#endif
+  blob_matrix2d_kernels_internal::GemmTiled(alpha, a, b, c, pool);
+}
+
+// B = L^-1 * B, where L is the unit lower triangle of square |l|.
+template <typename T>
+void TrsmLowerUnit(const BlobMatrix2D<T>& l, BlobMatrix2D<T>& b,
+                   ThreadPool& pool) {
+  assert(l.rows() == l.cols());
+  assert(l.rows() == b.rows());
+  ParallelFor(pool, 0, b.cols(), kTrsmTileCols,
+              [&](size_t cols_begin, size_t cols_end) {
+    for (size_t i = 1; i < b.rows(); ++i) {
+      T *b_row = b.Row(i) + cols_begin;
+      const T *l_row = l.Row(i);
+      for (size_t p = 0; p < i; ++p) {
+        blob_matrix2d_kernels_internal::Axpy(
+            -l_row[p], b.Row(p) + cols_begin, b_row, cols_end - cols_begin);
+      }
+    }
+  });
+}
+
+// B = U^-1 * B, where U is the upper triangle of square |u|.
+template <typename T>
+void TrsmUpper(const BlobMatrix2D<T>& u, BlobMatrix2D<T>& b,
+               ThreadPool& pool) {
+  assert(u.rows() == u.cols());
+  assert(u.rows() == b.rows());
+  ParallelFor(pool, 0, b.cols(), kTrsmTileCols,
+              [&](size_t cols_begin, size_t cols_end) {
+    const size_t cols = cols_end - cols_begin;
+    for (size_t i = b.rows(); i-- > 0;) {
+      T *b_row = b.Row(i) + cols_begin;
+      const T *u_row = u.Row(i);
+      for (size_t p = i + 1; p < b.rows(); ++p) {
+        blob_matrix2d_kernels_internal::Axpy(-u_row[p], b.Row(p) + cols_begin,
+                                             b_row, cols);
+      }
+      const T inverse_diagonal = T(1) / u_row[i];
+      for (size_t j = 0; j < cols; ++j) {
+        b_row[j] *= inverse_diagonal;
+      }
+    }
+  });
+}
+
+// |dst| = |src|^T. Both matrices are traversed by square tiles, so that rows
+// of neither of them are evicted from cache before being used completely.
+// Within a tile float and double use in-register transposition of
+// vector-sized blocks.
+template <typename T>
+void Transpose(const BlobMatrix2D<T>& src, BlobMatrix2D<T>& dst) {
+  assert(src.rows() == dst.cols());
+  assert(src.cols() == dst.rows());
+  for (size_t rows_begin = 0; rows_begin < src.rows();
+       rows_begin += kTransposeTileSize) {
+    const size_t rows_end = std::min(rows_begin + kTransposeTileSize,
+                                     src.rows());
+    for (size_t cols_begin = 0; cols_begin < src.cols();
+         cols_begin += kTransposeTileSize) {
+      const size_t cols_end = std::min(cols_begin + kTransposeTileSize,
+                                       src.cols());
+      size_t i = rows_begin;
+      if constexpr (SimdMatrixTraits<T>::kSupported) {
+        using Traits = SimdMatrixTraits<T>;
+        constexpr size_t kLanes = Traits::kLanes;
+        for (; i + kLanes <= rows_end; i += kLanes) {
+          size_t j = cols_begin;
+          for (; j + kLanes <= cols_end; j += kLanes) {
+            typename Traits::Vector block[kLanes];
+            for (size_t r = 0; r < kLanes; ++r) {
+              block[r] = Traits::Load(src.Row(i + r) + j);
+            }
+            Traits::Transpose(block);
+            for (size_t r = 0; r < kLanes; ++r) {
+              Traits::Store(dst.Row(j + r) + i, block[r]);
+            }
+          }
+          for (; j < cols_end; ++j) {
+            T *dst_row = dst.Row(j);
+            for (size_t r = 0; r < kLanes; ++r) {
+              dst_row[i + r] = src.Row(i + r)[j];
+            }
+          }
+        }
+      }
+      for (; i < rows_end; ++i) {
+        const T *src_row = src.Row(i);
+        for (size_t j = cols_begin; j < cols_end; ++j) {
+          dst.Row(j)[i] = src_row[j];
+        }
+      }
+    }
+  }
+}
+
+// C = A + B.
+template <typename T>
+void Add(const BlobMatrix2D<T>& a, const BlobMatrix2D<T>& b,
+         BlobMatrix2D<T>& c) {
+  blob_matrix2d_kernels_internal::Elementwise(
+      a, b, c, blob_matrix2d_kernels_internal::AddOp());
+}
+
+// C = A - B.
+template <typename T>
+void Subtract(const BlobMatrix2D<T>& a, const BlobMatrix2D<T>& b,
+              BlobMatrix2D<T>& c) {
+  blob_matrix2d_kernels_internal::Elementwise(
+      a, b, c, blob_matrix2d_kernels_internal::SubtractOp());
+}
+
+// C = A .* B, the elementwise product.
+template <typename T>
+void MultiplyElementwise(const BlobMatrix2D<T>& a, const BlobMatrix2D<T>& b,
+                         BlobMatrix2D<T>& c) {
+  blob_matrix2d_kernels_internal::Elementwise(
+      a, b, c, blob_matrix2d_kernels_internal::MultiplyOp());
+}
+
+// B += alpha * A.
+template <typename T>
+void AddScaled(T alpha, const BlobMatrix2D<T>& a, BlobMatrix2D<T>& b) {
+  blob_matrix2d_kernels_internal::Elementwise(
+      a, b, b, blob_matrix2d_kernels_internal::AddScaledOp<T>{alpha});
+}
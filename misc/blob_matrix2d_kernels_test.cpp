@@ -0,0 +1,294 @@
+#include "blob_matrix2d_kernels.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+template <typename T = double>
+std::vector<T> GenerateMatrix(size_t rows, size_t cols, std::mt19937& gen) {
+  std::uniform_int_distribution<int> dist(-8, 8);
+  std::vector<T> data(rows * cols);
+  for (auto& value : data) {
+    value = T(dist(gen));
+    if constexpr (std::is_floating_point<T>::value) {
+      value /= 8;
+    }
+  }
+  return data;
+}
+
+template <typename T>
+void NaiveGemm(T alpha, const BlobMatrix2D<T>& a, const BlobMatrix2D<T>& b,
+               BlobMatrix2D<T>& c) {
+  for (size_t i = 0; i < c.rows(); ++i) {
+    for (size_t j = 0; j < c.cols(); ++j) {
+      T sum = 0;
+      for (size_t p = 0; p < a.cols(); ++p) {
+        sum += a(i, p) * b(p, j);
+      }
+      c(i, j) += alpha * sum;
+    }
+  }
+}
+
+// Elements are multiples of 1/8, so that products of small matrices are
+// computed exactly in any order.
+template <typename T>
+void TestGemmType(T alpha) {
+  std::mt19937 gen(42);
+  ThreadPool pool(4);
+  for (size_t n : {1, 3, 64, 65, 300}) {
+    for (size_t m : {1, 7, 257, 300}) {
+      // A is a block of a wider matrix and C has padded rows to test strides.
+      std::vector<T> a_data = GenerateMatrix<T>(n, m + 5, gen);
+      std::vector<T> b_data = GenerateMatrix<T>(m, n, gen);
+      std::vector<T> c_data = GenerateMatrix<T>(n, n + 3, gen);
+      std::vector<T> expected_data = c_data;
+      const BlobMatrix2D<T> a_full(a_data.data(), n, m + 5);
+      const BlobMatrix2D<T> a = a_full.Block(0, 3, n, m);
+      const BlobMatrix2D<T> b(b_data.data(), m, n);
+      BlobMatrix2D<T> c(c_data.data(), n, n, (n + 3) * sizeof(T));
+      BlobMatrix2D<T> expected(expected_data.data(), n, n,
+                               (n + 3) * sizeof(T));
+      Gemm(alpha, a, b, c, pool);
+      NaiveGemm(alpha, a, b, expected);
+      assert(c_data == expected_data);
+    }
+  }
+}
+
+void TestGemm() {
+  std::cout << "Testing matrix product..." << std::flush;
+  TestGemmType<double>(-0.5);
+  TestGemmType<float>(2.0f);
+  TestGemmType<int>(3);
+  std::cout << "ok!" << std::endl;
+}
+
+void TestTrsm() {
+  std::cout << "Testing triangular solves..." << std::flush;
+  std::mt19937 gen(7);
+  ThreadPool pool(4);
+  for (size_t n : {1, 2, 64, 100}) {
+    for (size_t m : {1, 300}) {
+      std::vector<double> t_data = GenerateMatrix(n, n, gen);
+      BlobMatrix2D<double> t(t_data.data(), n, n);
+      for (size_t i = 0; i < n; ++i) {
+        t(i, i) = n;
+      }
+      std::vector<double> x_data = GenerateMatrix(n, m, gen);
+      const BlobMatrix2D<double> x(x_data.data(), n, m);
+      for (bool lower : {false, true}) {
+        // B = T * X, then solving must give X back.
+        std::vector<double> b_data(n * m);
+        BlobMatrix2D<double> b(b_data.data(), n, m);
+        for (size_t i = 0; i < n; ++i) {
+          for (size_t j = 0; j < m; ++j) {
+            double sum = 0;
+            for (size_t p = 0; p < n; ++p) {
+              if (lower && p < i) {
+                sum += t(i, p) * x(p, j);
+              } else if (p == i) {
+                sum += (lower ? 1.0 : t(i, i)) * x(p, j);
+              } else if (!lower && p > i) {
+                sum += t(i, p) * x(p, j);
+              }
+            }
+            b(i, j) = sum;
+          }
+        }
+        if (lower) {
+          TrsmLowerUnit(t, b, pool);
+        } else {
+          TrsmUpper(t, b, pool);
+        }
+        for (size_t i = 0; i < n; ++i) {
+          for (size_t j = 0; j < m; ++j) {
+            assert(std::abs(b(i, j) - x(i, j)) < 1e-9);
+          }
+        }
+      }
+    }
+  }
+  std::cout << "ok!" << std::endl;
+}
+
+template <typename T>
+void TestTransposeType() {
+  std::mt19937 gen(3);
+  for (size_t rows : {1, 4, 8, 33, 100}) {
+    for (size_t cols : {1, 5, 8, 64, 71}) {
+      std::vector<T> src_data = GenerateMatrix<T>(rows, cols + 2, gen);
+      const BlobMatrix2D<T> src(src_data.data(), rows, cols,
+                                (cols + 2) * sizeof(T));
+      std::vector<T> dst_data(cols * (rows + 1), T(-1));
+      BlobMatrix2D<T> dst(dst_data.data(), cols, rows, (rows + 1) * sizeof(T));
+      Transpose(src, dst);
+      for (size_t i = 0; i < cols; ++i) {
+        for (size_t j = 0; j < rows; ++j) {
+          assert(dst(i, j) == src(j, i));
+        }
+        // Padding is not touched.
+        assert(dst_data[i * (rows + 1) + rows] == T(-1));
+      }
+    }
+  }
+}
+
+void TestTranspose() {
+  std::cout << "Testing transposition..." << std::flush;
+  TestTransposeType<double>();
+  TestTransposeType<float>();
+  TestTransposeType<int>();
+  std::cout << "ok!" << std::endl;
+}
+
+template <typename T>
+void TestElementwiseType() {
+  std::mt19937 gen(5);
+  for (size_t padding : {0, 3}) {
+    constexpr size_t kRows = 17;
+    constexpr size_t kCols = 23;
+    const size_t bytes_per_row = (kCols + padding) * sizeof(T);
+    std::vector<T> a_data = GenerateMatrix<T>(kRows, kCols + padding, gen);
+    std::vector<T> b_data = GenerateMatrix<T>(kRows, kCols + padding, gen);
+    std::vector<T> c_data(kRows * (kCols + padding), T(-1));
+    const BlobMatrix2D<T> a(a_data.data(), kRows, kCols, bytes_per_row);
+    const BlobMatrix2D<T> b(b_data.data(), kRows, kCols, bytes_per_row);
+    BlobMatrix2D<T> c(c_data.data(), kRows, kCols, bytes_per_row);
+    auto check = [&](auto op) {
+      for (size_t i = 0; i < kRows; ++i) {
+        for (size_t j = 0; j < kCols + padding; ++j) {
+          const size_t k = i * (kCols + padding) + j;
+          assert(j < kCols ? c_data[k] == op(a_data[k], b_data[k])
+                           : c_data[k] == T(-1));
+        }
+      }
+    };
+    Add(a, b, c);
+    check([](T x, T y) { return x + y; });
+    Subtract(a, b, c);
+    check([](T x, T y) { return x - y; });
+    MultiplyElementwise(a, b, c);
+    check([](T x, T y) { return x * y; });
+    Add(a, b, c);
+    AddScaled(T(2), a, c);
+    check([](T x, T y) { return x + y + T(2) * x; });
+  }
+}
+
+void TestElementwise() {
+  std::cout << "Testing elementwise operations..." << std::flush;
+  TestElementwiseType<double>();
+  TestElementwiseType<float>();
+  TestElementwiseType<int>();
+  std::cout << "ok!" << std::endl;
+}
+
+template <typename Func>
+long long MeasureMs(const Func& func) {
+  auto start = std::chrono::high_resolution_clock::now();
+  func();
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      end - start).count();
+}
+
+void RunGemmBenchmark() {
+  constexpr size_t kSize = 512;
+  std::mt19937 gen(42);
+  std::vector<double> a_data = GenerateMatrix(kSize, kSize, gen);
+  std::vector<double> b_data = GenerateMatrix(kSize, kSize, gen);
+  std::vector<double> c_data(kSize * kSize);
+  const BlobMatrix2D<double> a(a_data.data(), kSize, kSize);
+  const BlobMatrix2D<double> b(b_data.data(), kSize, kSize);
+  BlobMatrix2D<double> c(c_data.data(), kSize, kSize);
+  auto gflops = [](long long ms) {
+    return 2.0 * kSize * kSize * kSize / 1e6 / std::max<long long>(ms, 1);
+  };
+
+  ThreadPool pool(1);
+  const long long naive_ms = MeasureMs([&]() { NaiveGemm(1.0, a, b, c); });
+  const long long tiled_ms = MeasureMs([&]() {
+    blob_matrix2d_kernels_internal::GemmTiled(1.0, a, b, c, pool);
+  });
+  const long long gemm_ms = MeasureMs([&]() { Gemm(1.0, a, b, c, pool); });
+  std::cout << kSize << "x" << kSize << " matrix product on 1 thread: naive "
+            << naive_ms << "ms (" << gflops(naive_ms) << " GFLOP/s), tiled "
+            << tiled_ms << "ms (" << gflops(tiled_ms) << " GFLOP/s), Gemm "
+            << gemm_ms << "ms (" << gflops(gemm_ms) << " GFLOP/s)";
+  ThreadPool parallel_pool;
+  const long long parallel_ms = MeasureMs([&]() {
+    Gemm(1.0, a, b, c, parallel_pool);
+  });
+  std::cout << ", Gemm on " << parallel_pool.GetThreadsNum() << " threads "
+            << parallel_ms << "ms (" << gflops(parallel_ms) << " GFLOP/s)"
+            << std::endl;
+}
+
+void RunTransposeBenchmark() {
+  constexpr size_t kSize = 4096;
+  std::mt19937 gen(42);
+  std::vector<float> src_data = GenerateMatrix<float>(kSize, kSize, gen);
+  std::vector<float> dst_data(kSize * kSize);
+  const BlobMatrix2D<float> src(src_data.data(), kSize, kSize);
+  BlobMatrix2D<float> dst(dst_data.data(), kSize, kSize);
+  const long long naive_ms = MeasureMs([&]() {
+    for (size_t i = 0; i < kSize; ++i) {
+      for (size_t j = 0; j < kSize; ++j) {
+        dst(j, i) = src(i, j);
+      }
+    }
+  });
+  const long long tiled_ms = MeasureMs([&]() { Transpose(src, dst); });
+  std::cout << "Transposition of " << kSize << "x" << kSize
+            << " float matrix: naive " << naive_ms << "ms, tiled " << tiled_ms
+            << "ms" << std::endl;
+}
+
+void RunElementwiseBenchmark() {
+  constexpr size_t kRows = 2048;
+  constexpr size_t kCols = 2047;
+  // Rows are padded to 2048 elements.
+  constexpr size_t kBytesPerRow = 2048 * sizeof(float);
+  std::mt19937 gen(42);
+  std::vector<float> a_data = GenerateMatrix<float>(kRows, 2048, gen);
+  std::vector<float> b_data = GenerateMatrix<float>(kRows, 2048, gen);
+  const BlobMatrix2D<float> a(a_data.data(), kRows, kCols, kBytesPerRow);
+  BlobMatrix2D<float> b(b_data.data(), kRows, kCols, kBytesPerRow);
+  constexpr int kRepeats = 20;
+  const long long naive_ms = MeasureMs([&]() {
+    for (int repeat = 0; repeat < kRepeats; ++repeat) {
+      for (size_t i = 0; i < kRows; ++i) {
+        for (size_t j = 0; j < kCols; ++j) {
+          b(i, j) += 0.5f * a(i, j);
+        }
+      }
+    }
+  });
+  const long long kernel_ms = MeasureMs([&]() {
+    for (int repeat = 0; repeat < kRepeats; ++repeat) {
+      AddScaled(0.5f, a, b);
+    }
+  });
+  std::cout << kRepeats << " scaled additions of " << kRows << "x" << kCols
+            << " float matrices: naive " << naive_ms << "ms, AddScaled "
+            << kernel_ms << "ms" << std::endl;
+}
+
+int main() {
+  TestGemm();
+  TestTrsm();
+  TestTranspose();
+  TestElementwise();
+  std::cout << "All tests passed! :)" << std::endl;
+  RunGemmBenchmark();
+  RunTransposeBenchmark();
+  RunElementwiseBenchmark();
+  return 0;
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "blob_matrix2d.h"
+#include "thread_pool.h"
+
+// Parallel iteration over BlobMatrix2D. Work is split into contiguous bands of
+// rows, one per thread, whose boundaries start at cache line boundaries
+// whenever the layout of the matrix allows it, so that threads writing to
+// neighbouring bands never share a cache line.
+
+// Splits rows of |matrix| into at most |parts_num| nonempty bands and returns
+// their boundaries: band k is [result[k]; result[k + 1]).
+template <typename T>
+std::vector<size_t> PartitionRows(const BlobMatrix2D<T>& matrix,
+                                  size_t parts_num) {
+  const size_t rows = matrix.rows();
+  if (rows == 0) {
+    return {0};
+  }
+  // Every |step|-th row starts at the same offset within a cache line, and
+  // rows first_aligned, first_aligned + step, ... start at its beginning.
+  const size_t step =
+      kBlobMatrixAlignment /
+      std::gcd(matrix.bytes_per_row() % kBlobMatrixAlignment,
+               kBlobMatrixAlignment);
+  size_t first_aligned = 0;
+  while (first_aligned < std::min(step, rows) &&
+         reinterpret_cast<uintptr_t>(matrix.Row(first_aligned)) %
+                 kBlobMatrixAlignment != 0) {
+    ++first_aligned;
+  }
+  if (first_aligned == std::min(step, rows)) {
+    first_aligned = 0;
+  }
+  // Groups of |step| rows are the units of partitioning. The first group is
+  // shorter if the first row isn't aligned.
+  const size_t shift = (step - first_aligned) % step;
+  const size_t groups_num = (rows + shift + step - 1) / step;
+  parts_num = std::max<size_t>(std::min(parts_num, groups_num), 1);
+  std::vector<size_t> boundaries(parts_num + 1);
+  for (size_t k = 0; k <= parts_num; ++k) {
+    const size_t group = groups_num * k / parts_num;
+    boundaries[k] = std::min(std::max(group * step, shift) - shift, rows);
+  }
+  return boundaries;
+}
+
+namespace blob_matrix2d_parallel_internal {
+
+// Calls |func(part, rows_begin, rows_end)| for every band of PartitionRows in
+// parallel.
+template <typename T, typename Func>
+void ForEachBand(const BlobMatrix2D<T>& matrix, ThreadPool& pool,
+                 const Func& func) {
+  const std::vector<size_t> boundaries =
+      PartitionRows(matrix, pool.GetThreadsNum());
+  TaskGroup group(pool);
+  for (size_t part = 1; part + 1 < boundaries.size(); ++part) {
+    group.Run([&func, &boundaries, part]() {
+      func(part, boundaries[part], boundaries[part + 1]);
+    });
+  }
+  if (boundaries.size() > 1) {
+    func(0, boundaries[0], boundaries[1]);
+  }
+  group.Wait();
+}
+
+}  // namespace blob_matrix2d_parallel_internal
+
+// Calls |func(i, row)| for every row of |matrix|, where |row| points to its
+// first element.
+template <typename T, typename Func>
+void ForEachRow(BlobMatrix2D<T>& matrix, ThreadPool& pool, const Func& func) {
+  blob_matrix2d_parallel_internal::ForEachBand(
+      matrix, pool, [&](size_t, size_t rows_begin, size_t rows_end) {
+        for (size_t i = rows_begin; i < rows_end; ++i) {
+          func(i, matrix.Row(i));
+        }
+      });
+}
+
+template <typename T, typename Func>
+void ForEachRow(const BlobMatrix2D<T>& matrix, ThreadPool& pool,
+                const Func& func) {
+  blob_matrix2d_parallel_internal::ForEachBand(
+      matrix, pool, [&](size_t, size_t rows_begin, size_t rows_end) {
+        for (size_t i = rows_begin; i < rows_end; ++i) {
+          func(i, matrix.Row(i));
+        }
+      });
+}
+
+// Splits |matrix| into |tile_rows| x |tile_cols| tiles (smaller at the right
+// and bottom edges) and calls |func(tile, i, j)| for each of them, where
+// |tile| is a view of the submatrix starting at (|i|, |j|). Whole rows of tiles
+// are assigned to threads, so only tiles in different rows of tiles may be
+// processed concurrently.
+template <typename T, typename Func>
+void ForEachTile(BlobMatrix2D<T>& matrix, size_t tile_rows, size_t tile_cols,
+                 ThreadPool& pool, const Func& func) {
+  assert(tile_rows > 0 && tile_cols > 0);
+  const size_t tile_rows_num = (matrix.rows() + tile_rows - 1) / tile_rows;
+  ParallelFor(pool, 0, tile_rows_num, 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin * tile_rows; i < std::min(end * tile_rows,
+                                                    matrix.rows());
+         i += tile_rows) {
+      const size_t rows = std::min(tile_rows, matrix.rows() - i);
+      for (size_t j = 0; j < matrix.cols(); j += tile_cols) {
+        BlobMatrix2D<T> tile =
+            matrix.Block(i, j, rows, std::min(tile_cols, matrix.cols() - j));
+        func(tile, i, j);
+      }
+    }
+  });
+}
+
+// dst(i, j) = func(src(i, j)). |src| and |dst| must have the same shape and
+// may be the same matrix.
+template <typename T, typename U, typename Func>
+void Map(const BlobMatrix2D<T>& src, BlobMatrix2D<U>& dst, ThreadPool& pool,
+         const Func& func) {
+  assert(src.rows() == dst.rows() && src.cols() == dst.cols());
+  blob_matrix2d_parallel_internal::ForEachBand(
+      dst, pool, [&](size_t, size_t rows_begin, size_t rows_end) {
+        for (size_t i = rows_begin; i < rows_end; ++i) {
+          const T *src_row = src.Row(i);
+          U *dst_row = dst.Row(i);
+          for (size_t j = 0; j < dst.cols(); ++j) {
+            dst_row[j] = func(src_row[j]);
+          }
+        }
+      });
+}
+
+// dst(i, j) = func(a(i, j), b(i, j)).
+template <typename T, typename U, typename V, typename Func>
+void Map(const BlobMatrix2D<T>& a, const BlobMatrix2D<U>& b,
+         BlobMatrix2D<V>& dst, ThreadPool& pool, const Func& func) {
+  assert(a.rows() == dst.rows() && a.cols() == dst.cols());
+  assert(b.rows() == dst.rows() && b.cols() == dst.cols());
+  blob_matrix2d_parallel_internal::ForEachBand(
+      dst, pool, [&](size_t, size_t rows_begin, size_t rows_end) {
+        for (size_t i = rows_begin; i < rows_end; ++i) {
+          const T *a_row = a.Row(i);
+          const U *b_row = b.Row(i);
+          V *dst_row = dst.Row(i);
+          for (size_t j = 0; j < dst.cols(); ++j) {
+            dst_row[j] = func(a_row[j], b_row[j]);
+          }
+        }
+      });
+}
+
+// Folds elements of every band with |accumulate(result, element)| starting
+// from |init|, then folds the results of the bands in order with
+// |combine(result, band_result)|. |init| must be the identity of |combine|.
+// The order of the bands doesn't depend on timing, so floating point results
+// are reproducible for a fixed number of threads.
+template <typename T, typename R, typename Accumulate, typename Combine>
+R Reduce(const BlobMatrix2D<T>& matrix, ThreadPool& pool, R init,
+         const Accumulate& accumulate, const Combine& combine) {
+  std::vector<R> results(pool.GetThreadsNum(), init);
+  blob_matrix2d_parallel_internal::ForEachBand(
+      matrix, pool, [&](size_t part, size_t rows_begin, size_t rows_end) {
+        R result = init;
+        for (size_t i = rows_begin; i < rows_end; ++i) {
+          const T *row = matrix.Row(i);
+          for (size_t j = 0; j < matrix.cols(); ++j) {
+            result = accumulate(result, row[j]);
+          }
+        }
+        results[part] = result;
+      });
+  R result = init;
+  for (const R& band_result : results) {
+    result = combine(result, band_result);
+  }
+  return result;
+}
+
+// Reduce for operations like sum or max which fold elements and results in the
+// same way.
+template <typename T, typename R, typename Op>
+R Reduce(const BlobMatrix2D<T>& matrix, ThreadPool& pool, R init,
+         const Op& op) {
+  return Reduce(matrix, pool, init, op, op);
+}
@@ -0,0 +1,215 @@
+#include "blob_matrix2d_parallel.h"
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+void TestPartitionRows() {
+  std::cout << "Testing row partitioning..." << std::flush;
+  OwningBlobMatrix2D<float> storage(300, 64);
+  for (size_t offset : {0, 1, 3, 16}) {
+    for (size_t bytes_per_row : {4, 52, 64, 100, 256, 260}) {
+      for (size_t rows : {1, 5, 16, 17, 100, 255}) {
+        const BlobMatrix2D<float> matrix(storage.Row(0) + offset, rows,
+                                         bytes_per_row / sizeof(float),
+                                         bytes_per_row);
+        bool has_aligned_rows = false;
+        for (size_t i = 0; i < rows; ++i) {
+          has_aligned_rows |= reinterpret_cast<uintptr_t>(matrix.Row(i)) %
+                                  kBlobMatrixAlignment == 0;
+        }
+        for (size_t parts_num : {1, 2, 3, 8}) {
+          const std::vector<size_t> boundaries =
+              PartitionRows(matrix, parts_num);
+          assert(boundaries.size() >= 2 && boundaries.size() <= parts_num + 1);
+          assert(boundaries.front() == 0 && boundaries.back() == rows);
+          for (size_t k = 1; k < boundaries.size(); ++k) {
+            assert(boundaries[k - 1] < boundaries[k]);
+            if (k + 1 < boundaries.size() && has_aligned_rows) {
+              assert(reinterpret_cast<uintptr_t>(matrix.Row(boundaries[k])) %
+                         kBlobMatrixAlignment == 0);
+            }
+          }
+        }
+      }
+    }
+  }
+  // Padded rows are split evenly.
+  const std::vector<size_t> boundaries = PartitionRows(storage, 4);
+  assert((boundaries == std::vector<size_t>{0, 75, 150, 225, 300}));
+  std::cout << "ok!" << std::endl;
+}
+
+void TestForEachRow() {
+  std::cout << "Testing row iteration..." << std::flush;
+  for (size_t threads_num : {1, 3, 8}) {
+    ThreadPool pool(threads_num);
+    OwningBlobMatrix2D<int> matrix(101, 13);
+    std::vector<std::atomic<int>> visits(matrix.rows());
+    ForEachRow(matrix, pool, [&](size_t i, int *row) {
+      ++visits[i];
+      for (size_t j = 0; j < matrix.cols(); ++j) {
+        row[j] = i * matrix.cols() + j;
+      }
+    });
+    for (size_t i = 0; i < matrix.rows(); ++i) {
+      assert(visits[i] == 1);
+      for (size_t j = 0; j < matrix.cols(); ++j) {
+        assert(matrix(i, j) == int(i * matrix.cols() + j));
+      }
+    }
+
+    const BlobMatrix2D<int>& const_matrix = matrix;
+    std::atomic<long long> sum{0};
+    ForEachRow(const_matrix, pool, [&](size_t i, const int *row) {
+      assert(row == matrix.Row(i));
+      sum += row[0];
+    });
+    assert(sum == 13 * 100 * 101 / 2);
+  }
+  std::cout << "ok!" << std::endl;
+}
+
+void TestForEachTile() {
+  std::cout << "Testing tile iteration..." << std::flush;
+  ThreadPool pool(4);
+  for (size_t tile_rows : {1, 7, 32, 200}) {
+    for (size_t tile_cols : {1, 10, 64}) {
+      OwningBlobMatrix2D<int> matrix(100, 70);
+      ForEachTile(matrix, tile_rows, tile_cols, pool,
+                  [&](BlobMatrix2D<int>& tile, size_t i, size_t j) {
+                    assert(i % tile_rows == 0 && j % tile_cols == 0);
+                    assert(tile.rows() == std::min(tile_rows, 100 - i));
+                    assert(tile.cols() == std::min(tile_cols, 70 - j));
+                    assert(tile.Row(0) == matrix.Row(i) + j);
+                    for (size_t y = 0; y < tile.rows(); ++y) {
+                      for (size_t x = 0; x < tile.cols(); ++x) {
+                        tile(y, x) += (i + y) * 1000 + j + x + 1;
+                      }
+                    }
+                  });
+      for (size_t i = 0; i < matrix.rows(); ++i) {
+        for (size_t j = 0; j < matrix.cols(); ++j) {
+          assert(matrix(i, j) == int(i * 1000 + j + 1));
+        }
+      }
+    }
+  }
+  std::cout << "ok!" << std::endl;
+}
+
+void TestMapReduce() {
+  std::cout << "Testing map and reduce..." << std::flush;
+  ThreadPool pool(4);
+  OwningBlobMatrix2D<int> a(333, 17);
+  OwningBlobMatrix2D<int> b(333, 17);
+  ForEachRow(a, pool, [&](size_t i, int *row) {
+    for (size_t j = 0; j < a.cols(); ++j) {
+      row[j] = i + j;
+    }
+  });
+  OwningBlobMatrix2D<double> halves(333, 17);
+  Map(a, halves, pool, [](int x) { return x / 2.0; });
+  Map(a, b, pool, [](int x) { return 2 * x; });
+  Map(a, b, b, pool, [](int x, int y) { return y - x; });
+  // In place.
+  Map(a, a, pool, [](int x) { return -x; });
+  long long expected_sum = 0;
+  for (size_t i = 0; i < a.rows(); ++i) {
+    for (size_t j = 0; j < a.cols(); ++j) {
+      assert(a(i, j) == -int(i + j));
+      assert(b(i, j) == int(i + j));
+      assert(halves(i, j) == (i + j) / 2.0);
+      expected_sum += i + j;
+    }
+  }
+
+  auto plus = [](long long x, long long y) { return x + y; };
+  assert(Reduce(b, pool, 0LL, plus) == expected_sum);
+  assert(Reduce(b, pool, 0, [](int x, int y) { return std::max(x, y); }) ==
+         332 + 16);
+  // Counting elements needs different accumulation and combination.
+  const size_t evens = Reduce(
+      b, pool, size_t(0),
+      [](size_t count, int x) { return count + (x % 2 == 0); },
+      [](size_t x, size_t y) { return x + y; });
+  size_t expected_evens = 0;
+  for (size_t i = 0; i < b.rows(); ++i) {
+    for (size_t j = 0; j < b.cols(); ++j) {
+      expected_evens += (i + j) % 2 == 0;
+    }
+  }
+  assert(evens == expected_evens);
+
+  OwningBlobMatrix2D<float> empty;
+  assert(Reduce(empty, pool, 0.0f, std::plus<float>()) == 0.0f);
+  Map(empty, empty, pool, [](float x) { return x; });
+  std::cout << "ok!" << std::endl;
+}
+
+template <typename Func>
+long long MeasureMs(const Func& func) {
+  auto start = std::chrono::high_resolution_clock::now();
+  func();
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      end - start).count();
+}
+
+void RunScalingBenchmark() {
+  constexpr size_t kSize = 8192;
+  OwningBlobMatrix2D<float> src(kSize, kSize);
+  OwningBlobMatrix2D<float> dst(kSize, kSize);
+  const long long naive_ms = MeasureMs([&]() {
+    for (size_t i = 0; i < kSize; ++i) {
+      for (size_t j = 0; j < kSize; ++j) {
+        src(i, j) = float(i % 7 + j % 5) / 8;
+      }
+    }
+  });
+  std::cout << "Filling " << kSize << "x" << kSize << " float matrix: naive "
+            << naive_ms << "ms" << std::endl;
+  float sum = 0;
+  const unsigned threads_nums[] = {1, 2, 4, 8,
+                                   std::thread::hardware_concurrency()};
+  for (unsigned threads_num : threads_nums) {
+    ThreadPool pool(threads_num);
+    const long long map_ms = MeasureMs([&]() {
+      Map(src, dst, pool, [](float x) { return std::sqrt(x) * 2 + 1; });
+    });
+    float threads_sum;
+    const long long reduce_ms = MeasureMs([&]() {
+      threads_sum = Reduce(dst, pool, 0.0f, std::plus<float>());
+    });
+    const long long tile_ms = MeasureMs([&]() {
+      ForEachTile(dst, 256, 256, pool, [](BlobMatrix2D<float>& tile, size_t,
+                                          size_t) {
+        for (size_t i = 0; i < tile.rows(); ++i) {
+          float *row = tile.Row(i);
+          for (size_t j = 0; j < tile.cols(); ++j) {
+            row[j] *= 0.5f;
+          }
+        }
+      });
+    });
+    sum += threads_sum;
+    std::cout << threads_num << " threads: Map " << map_ms << "ms, Reduce "
+              << reduce_ms << "ms, ForEachTile " << tile_ms << "ms"
+              << std::endl;
+  }
+  assert(sum > 0);
+}
+
+int main() {
+  TestPartitionRows();
+  TestForEachRow();
+  TestForEachTile();
+  TestMapReduce();
+  std::cout << "All tests passed! :)" << std::endl;
+  RunScalingBenchmark();
+  return 0;
+}
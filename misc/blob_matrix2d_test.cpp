@@ -1,6 +1,10 @@
 #include "blob_matrix2d.h"
 
+#include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <utility>
+#include <vector>
 
 void TestCompactPacking() {
   constexpr int kWidth = 100;
@@ -63,10 +67,146 @@ void TestConst() {
   delete[] data;
 }
 
+void TestBlock() {
+  constexpr int kWidth = 100;
+  constexpr int kHeight = 200;
+  int *data = new int[kWidth * kHeight];
+  for (int i = 0; i < kHeight; ++i) {
+    for (int j = 0; j < kWidth; ++j) {
+      data[i * kWidth + j] = i * kWidth + j;
+    }
+  }
+
+  BlobMatrix2D<int> blob_matrix(data, kHeight, kWidth);
+  BlobMatrix2D<int> block = blob_matrix.Block(10, 20, 30, 40);
+  assert(block.rows() == 30);
+  assert(block.cols() == 40);
+  assert(block.bytes_per_row() == kWidth * sizeof(int));
+  assert(block.data() == &blob_matrix(10, 20));
+  for (int i = 0; i < 30; ++i) {
+    assert(block.Row(i) == &blob_matrix(10 + i, 20));
+    for (int j = 0; j < 40; ++j) {
+      assert(block(i, j) == (10 + i) * kWidth + 20 + j);
+    }
+  }
+  block(0, 0) = -1;
+  assert(blob_matrix(10, 20) == -1);
+
+  delete[] data;
+}
+
+void TestPaddedBytesPerRow() {
+  assert(PaddedBytesPerRow(1, 4) == 64);
+  assert(PaddedBytesPerRow(16, 4) == 64);
+  assert(PaddedBytesPerRow(17, 4) == 128);
+  assert(PaddedBytesPerRow(100, 8) == 832);
+  // Multiples of 512 bytes get an extra cache line.
+  assert(PaddedBytesPerRow(128, 4) == 576);
+  assert(PaddedBytesPerRow(1024, 4) == 4096 + 64);
+  assert(PaddedBytesPerRow(0, 4) == 64);
+}
+
+void TestOwning() {
+  constexpr int kWidth = 100;
+  constexpr int kHeight = 200;
+  OwningBlobMatrix2D<int> matrix(kHeight, kWidth);
+  assert(matrix.rows() == kHeight);
+  assert(matrix.cols() == kWidth);
+  assert(matrix.bytes_per_row() == PaddedBytesPerRow(kWidth, sizeof(int)));
+  assert(reinterpret_cast<uintptr_t>(matrix.data()) %
+             kBlobMatrixAlignment == 0);
+  for (int i = 0; i < kHeight; ++i) {
+    assert(reinterpret_cast<uintptr_t>(matrix.Row(i)) %
+               kBlobMatrixAlignment == 0);
+    for (int j = 0; j < kWidth; ++j) {
+      assert(matrix(i, j) == 0);
+      matrix(i, j) = i * kWidth + j;
+    }
+  }
+
+  // Blocks are views of the same storage.
+  BlobMatrix2D<int> block = matrix.Block(5, 7, 10, 20);
+  assert(block.bytes_per_row() == matrix.bytes_per_row());
+  assert(block(2, 3) == 7 * kWidth + 10);
+  block(2, 3) = -1;
+  assert(matrix(7, 10) == -1);
+
+  void *data = matrix.data();
+  OwningBlobMatrix2D<int> moved(std::move(matrix));
+  assert(moved.data() == data);
+  assert(moved.rows() == kHeight && moved.cols() == kWidth);
+  assert(moved(7, 10) == -1 && moved(kHeight - 1, kWidth - 1) ==
+                                   kHeight * kWidth - 1);
+  assert(matrix.rows() == 0 && matrix.cols() == 0);
+
+  OwningBlobMatrix2D<int> assigned(1, 1);
+  assigned = std::move(moved);
+  assert(assigned.data() == data);
+  assert(assigned(0, 1) == 1);
+  assert(moved.rows() == 0);
+
+  std::vector<OwningBlobMatrix2D<double>> matrices;
+  for (int i = 0; i < 10; ++i) {
+    matrices.emplace_back(i + 1, 3);
+    matrices.back()(i, 2) = i;
+  }
+  for (int i = 0; i < 10; ++i) {
+    assert(matrices[i].rows() == size_t(i + 1));
+    assert(matrices[i](i, 2) == i);
+  }
+
+  OwningBlobMatrix2D<float> interleaved(1000, 1000, NumaPolicy::Interleave());
+  assert(interleaved.bytes_per_row() == PaddedBytesPerRow(1000, sizeof(float)));
+  assert(interleaved(999, 999) == 0.0f);
+}
+
+// Sums a matrix column by column, which touches a new row on every access.
+template <typename T>
+long long MeasureColumnSumsMs(const BlobMatrix2D<T>& matrix, T *sum) {
+  auto start = std::chrono::high_resolution_clock::now();
+  T total = 0;
+  for (int repeat = 0; repeat < 10; ++repeat) {
+    for (size_t j = 0; j < matrix.cols(); ++j) {
+      for (size_t i = 0; i < matrix.rows(); ++i) {
+        total += matrix(i, j);
+      }
+    }
+  }
+  *sum = total;
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      end - start).count();
+}
+
+void RunPaddingBenchmark() {
+  constexpr size_t kSize = 1024;
+  std::vector<float> compact_data(kSize * kSize, 1.0f);
+  const BlobMatrix2D<float> compact(compact_data.data(), kSize, kSize);
+  OwningBlobMatrix2D<float> padded(kSize, kSize);
+  for (size_t i = 0; i < kSize; ++i) {
+    for (size_t j = 0; j < kSize; ++j) {
+      padded(i, j) = 1.0f;
+    }
+  }
+  float compact_sum;
+  float padded_sum;
+  const long long compact_ms = MeasureColumnSumsMs(compact, &compact_sum);
+  const long long padded_ms = MeasureColumnSumsMs<float>(padded, &padded_sum);
+  assert(compact_sum == padded_sum);
+  std::cout << "Column traversals of " << kSize << "x" << kSize
+            << " float matrix: " << compact.bytes_per_row() << " bytes per row "
+            << compact_ms << "ms, " << padded.bytes_per_row()
+            << " bytes per row " << padded_ms << "ms" << std::endl;
+}
+
 int main() {
   TestCompactPacking();
   TestRowPadding();
   TestConst();
+  TestBlock();
+  TestPaddedBytesPerRow();
+  TestOwning();
   std::cout << "All tests passed! :)" << std::endl;
+  RunPaddingBenchmark();
   return 0;
 }
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+// Unbounded multi-producer multi-consumer FIFO queue. Pipelines usually bound
+// it implicitly by circulating a fixed set of buffers through a queue of free
+// ones.
+template <typename T>
+class BlockingQueue {
+ public:
+  BlockingQueue() = default;
+  BlockingQueue(const BlockingQueue&) = delete;
+  BlockingQueue& operator=(const BlockingQueue&) = delete;
+
+  void Push(T value) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      values_.push_back(std::move(value));
+    }
+    cv_.notify_one();
+  }
+
+  // Blocks until a value is available. Returns false if the queue is closed
+  // and empty.
+  bool Pop(T& value) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return closed_ || !values_.empty(); });
+    if (values_.empty()) {
+      return false;
+    }
+    value = std::move(values_.front());
+    values_.pop_front();
+    return true;
+  }
+
+  // Wakes up all consumers once the remaining values are popped.
+  void Close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    cv_.notify_all();
+  }
+
+ private:
+  std::deque<T> values_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool closed_ = false;
+};
@@ -0,0 +1,66 @@
+#include "blocking_queue.h"
+
+#include <cassert>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+void TestFifo() {
+  std::cout << "Testing FIFO order..." << std::flush;
+  BlockingQueue<int> queue;
+  for (int i = 0; i < 10; ++i) {
+    queue.Push(i);
+  }
+  queue.Close();
+  int value;
+  for (int i = 0; i < 10; ++i) {
+    assert(queue.Pop(value) && value == i);
+  }
+  assert(!queue.Pop(value));
+  std::cout << "ok!" << std::endl;
+}
+
+void TestProducersConsumers() {
+  std::cout << "Testing producers and consumers..." << std::flush;
+  constexpr int kThreadsNum = 4;
+  constexpr int kValuesNum = 10000;
+  BlockingQueue<int> queue;
+  std::vector<long long> sums(kThreadsNum, 0);
+  std::vector<std::thread> consumers;
+  for (int i = 0; i < kThreadsNum; ++i) {
+    consumers.emplace_back([&queue, &sums, i]() {
+      int value;
+      while (queue.Pop(value)) {
+        sums[i] += value;
+      }
+    });
+  }
+  std::vector<std::thread> producers;
+  for (int i = 0; i < kThreadsNum; ++i) {
+    producers.emplace_back([&queue]() {
+      for (int j = 1; j <= kValuesNum; ++j) {
+        queue.Push(j);
+      }
+    });
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  queue.Close();
+  for (auto& consumer : consumers) {
+    consumer.join();
+  }
+  long long sum = 0;
+  for (long long cur_sum : sums) {
+    sum += cur_sum;
+  }
+  assert(sum == 1LL * kThreadsNum * kValuesNum * (kValuesNum + 1) / 2);
+  std::cout << "ok!" << std::endl;
+}
+
+int main() {
+  TestFifo();
+  TestProducersConsumers();
+  std::cout << "All tests passed! :)" << std::endl;
+  return 0;
+}
@@ -0,0 +1,331 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "blob_matrix2d.h"
+
+// BlobMatrix2D backed by a memory-mapped file. Opening a matrix only maps the
+// file: pages are read on first access and are shared through the page cache
+// by all processes which map the same file.
+//
+// Files either are raw (the layout is given by the caller, e.g. for images)
+// or start with a BlobMatrixFileHeader. Headers are stored in the native byte
+// order.
+
+enum class BlobMatrixDType : uint32_t {
+  kUInt8 = 1,
+  kInt8,
+  kUInt16,
+  kInt16,
+  kUInt32,
+  kInt32,
+  kUInt64,
+  kInt64,
+  kFloat32,
+  kFloat64,
+  // Any other trivially copyable element; only its size is checked.
+  kOpaque = 255,
+};
+
+template <typename T>
+constexpr BlobMatrixDType GetBlobMatrixDType() {
+  if constexpr (std::is_same<T, uint8_t>::value) {
+    return BlobMatrixDType::kUInt8;
+  } else if constexpr (std::is_same<T, int8_t>::value) {
+    return BlobMatrixDType::kInt8;
+  } else if constexpr (std::is_same<T, uint16_t>::value) {
+    return BlobMatrixDType::kUInt16;
+  } else if constexpr (std::is_same<T, int16_t>::value) {
+    return BlobMatrixDType::kInt16;
+  } else if constexpr (std::is_same<T, uint32_t>::value) {
+    return BlobMatrixDType::kUInt32;
+  } else if constexpr (std::is_same<T, int32_t>::value) {
+    return BlobMatrixDType::kInt32;
+  } else if constexpr (std::is_same<T, uint64_t>::value) {
+    return BlobMatrixDType::kUInt64;
+  } else if constexpr (std::is_same<T, int64_t>::value) {
+    return BlobMatrixDType::kInt64;
+  } else if constexpr (std::is_same<T, float>::value) {
+    return BlobMatrixDType::kFloat32;
+  } else if constexpr (std::is_same<T, double>::value) {
+    return BlobMatrixDType::kFloat64;
+  } else {
+    return BlobMatrixDType::kOpaque;
+  }
+}
+
+struct BlobMatrixFileHeader {
+  static constexpr char kMagic[8] = {'B', 'L', 'O', 'B', 'M', 'A', 'T', '1'};
+
+  char magic[8];
+  BlobMatrixDType dtype;
+  uint32_t element_size;
+  uint64_t rows;
+  uint64_t cols;
+  uint64_t bytes_per_row;
+  // Offset of the first row from the beginning of the file.
+  uint64_t data_offset;
+  uint8_t reserved[16];
+};
+
+static_assert(sizeof(BlobMatrixFileHeader) == 64, "Unexpected header size");
+
+// Rows of files created by MappedBlobMatrix2D start at the second page, so
+// that they are aligned just like rows of OwningBlobMatrix2D.
+constexpr uint64_t kBlobMatrixFileDataOffset = 4096;
+
+enum class MapMode {
+  // Changes are visible only to this mapping and are never written back.
+  kPrivate,
+  // Changes are written to the file and are visible to other processes.
+  kShared,
+};
+
+// Expected access pattern, passed to madvise.
+enum class AccessPattern {
+  kNormal,
+  // Aggressive read-ahead; pages behind are dropped early.
+  kSequential,
+  // No read-ahead: only the touched pages are read.
+  kRandom,
+  // Starts reading the pages in the background.
+  kWillNeed,
+};
+
+namespace mapped_blob_matrix2d_internal {
+
+inline std::runtime_error MapError(const std::string& message,
+                                   const std::string& path) {
+  return std::runtime_error(message + " '" + path + "': " + strerror(errno));
+}
+
+inline int ToAdvice(AccessPattern pattern) {
+  switch (pattern) {
+    case AccessPattern::kSequential:
+      return MADV_SEQUENTIAL;
+    case AccessPattern::kRandom:
+      return MADV_RANDOM;
+    case AccessPattern::kWillNeed:
+      return MADV_WILLNEED;
+    case AccessPattern::kNormal:
+      break;
+  }
+  return MADV_NORMAL;
+}
+
+}  // namespace mapped_blob_matrix2d_internal
+
+template <typename T>
+class MappedBlobMatrix2D : public BlobMatrix2D<T> {
+ public:
+  // Maps a file with a BlobMatrixFileHeader. Throws std::runtime_error if the
+  // file can't be mapped or its header doesn't match T.
+  static MappedBlobMatrix2D Open(const std::string& path,
+                                 MapMode mode = MapMode::kPrivate,
+                                 AccessPattern pattern = AccessPattern::kNormal) {
+    const int fd = OpenFile(path, mode);
+    BlobMatrixFileHeader header;
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+      close(fd);
+      throw std::runtime_error("Failed to read header of '" + path + "'");
+    }
+    if (memcmp(header.magic, BlobMatrixFileHeader::kMagic,
+               sizeof(header.magic)) != 0 ||
+        header.dtype != GetBlobMatrixDType<T>() ||
+        header.element_size != sizeof(T)) {
+      close(fd);
+      throw std::runtime_error("Header of '" + path +
+                               "' doesn't match the element type");
+    }
+    return Map(fd, path, mode, pattern, header.rows, header.cols,
+               header.bytes_per_row, header.data_offset);
+  }
+
+  // Maps a headerless file whose first row starts at |offset| bytes.
+  // |bytes_per_row| defaults to unpadded rows.
+  static MappedBlobMatrix2D OpenRaw(
+      const std::string& path, size_t rows, size_t cols,
+      size_t bytes_per_row = 0, uint64_t offset = 0,
+      MapMode mode = MapMode::kPrivate,
+      AccessPattern pattern = AccessPattern::kNormal) {
+    const int fd = OpenFile(path, mode);
+    return Map(fd, path, mode, pattern, rows, cols,
+               bytes_per_row == 0 ? cols * sizeof(T) : bytes_per_row, offset);
+  }
+
+  // Creates a zero-filled file with a header and rows padded by
+  // PaddedBytesPerRow, and maps it in kShared mode. The file is sparse until
+  // written.
+  static MappedBlobMatrix2D Create(const std::string& path, size_t rows,
+                                   size_t cols) {
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      throw mapped_blob_matrix2d_internal::MapError("Failed to create", path);
+    }
+    BlobMatrixFileHeader header = {};
+    memcpy(header.magic, BlobMatrixFileHeader::kMagic, sizeof(header.magic));
+    header.dtype = GetBlobMatrixDType<T>();
+    header.element_size = sizeof(T);
+    header.rows = rows;
+    header.cols = cols;
+    header.bytes_per_row = PaddedBytesPerRow(cols, sizeof(T));
+    header.data_offset = kBlobMatrixFileDataOffset;
+    if (pwrite(fd, &header, sizeof(header), 0) != sizeof(header) ||
+        ftruncate(fd, header.data_offset + rows * header.bytes_per_row) != 0) {
+      close(fd);
+      throw mapped_blob_matrix2d_internal::MapError("Failed to write", path);
+    }
+    return Map(fd, path, MapMode::kShared, AccessPattern::kNormal, rows, cols,
+               header.bytes_per_row, header.data_offset);
+  }
+
+  MappedBlobMatrix2D(MappedBlobMatrix2D&& other)
+      : BlobMatrix2D<T>(std::move(other)),
+        mapping_(std::exchange(other.mapping_, nullptr)),
+        mapping_size_(std::exchange(other.mapping_size_, 0)) {
+    other.Clear();
+  }
+
+  MappedBlobMatrix2D& operator=(MappedBlobMatrix2D&& other) {
+    if (this != &other) {
+      Unmap();
+      BlobMatrix2D<T>::operator=(std::move(other));
+      mapping_ = std::exchange(other.mapping_, nullptr);
+      mapping_size_ = std::exchange(other.mapping_size_, 0);
+      other.Clear();
+    }
+    return *this;
+  }
+
+  ~MappedBlobMatrix2D() {
+    Unmap();
+  }
+
+  // Advises the kernel about accesses to rows [|rows_begin|; |rows_end|).
+  void Advise(AccessPattern pattern, size_t rows_begin, size_t rows_end) {
+    if (rows_begin >= rows_end) {
+      return;
+    }
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    uint8_t *mapping = static_cast<uint8_t*>(mapping_);
+    const size_t begin = reinterpret_cast<uint8_t*>(this->Row(rows_begin)) -
+                         mapping;
+    const size_t end = reinterpret_cast<uint8_t*>(this->Row(rows_end - 1)) -
+                       mapping + this->cols() * sizeof(T);
+    const size_t aligned_begin = begin / page_size * page_size;
+    madvise(mapping + aligned_begin, end - aligned_begin,
+            mapped_blob_matrix2d_internal::ToAdvice(pattern));
+  }
+
+  void Advise(AccessPattern pattern) {
+    Advise(pattern, 0, this->rows());
+  }
+
+  // Writes changes of a kShared mapping to the file.
+  void Flush() {
+    if (mapping_ != nullptr && msync(mapping_, mapping_size_, MS_SYNC) != 0) {
+      throw std::runtime_error(std::string("Failed to sync: ") +
+                               strerror(errno));
+    }
+  }
+
+ private:
+  MappedBlobMatrix2D(void *mapping, size_t mapping_size, uint64_t data_offset,
+                     size_t rows, size_t cols, size_t bytes_per_row)
+      : BlobMatrix2D<T>(static_cast<uint8_t*>(mapping) + data_offset, rows,
+                        cols, bytes_per_row),
+        mapping_(mapping), mapping_size_(mapping_size) {}
+
+  static int OpenFile(const std::string& path, MapMode mode) {
+    const int fd = open(path.c_str(),
+                        mode == MapMode::kShared ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+      throw mapped_blob_matrix2d_internal::MapError("Failed to open", path);
+    }
+    return fd;
+  }
+
+  // Whether the layout fits a file of |file_size| bytes. Sizes may come from
+  // a corrupt header, so all products are checked for overflow by dividing
+  // instead of multiplying.
+  static bool FitsFile(uint64_t rows, uint64_t cols, uint64_t bytes_per_row,
+                       uint64_t data_offset, uint64_t file_size) {
+    if (data_offset > file_size || data_offset % alignof(T) != 0 ||
+        bytes_per_row % alignof(T) != 0 || cols > bytes_per_row / sizeof(T) ||
+        rows > SIZE_MAX || cols > SIZE_MAX || bytes_per_row > SIZE_MAX) {
+      return false;
+    }
+    if (rows == 0) {
+      return true;
+    }
+    // The last row takes only cols * sizeof(T) bytes.
+    const uint64_t available = file_size - data_offset;
+    const uint64_t last_row_size = cols * sizeof(T);
+    if (last_row_size > available) {
+      return false;
+    }
+    return rows == 1 ||
+           bytes_per_row <= (available - last_row_size) / (rows - 1);
+  }
+
+  // Maps the whole file |fd| and closes it.
+  static MappedBlobMatrix2D Map(int fd, const std::string& path, MapMode mode,
+                                AccessPattern pattern, size_t rows,
+                                size_t cols, size_t bytes_per_row,
+                                uint64_t data_offset) {
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+      close(fd);
+      throw mapped_blob_matrix2d_internal::MapError("Failed to stat", path);
+    }
+    const size_t file_size = file_stat.st_size;
+    if (!FitsFile(rows, cols, bytes_per_row, data_offset, file_size)) {
+      close(fd);
+      throw std::runtime_error("Layout of the matrix doesn't fit '" + path +
+                               "'");
+    }
+    void *mapping = nullptr;
+    if (file_size > 0) {
+      mapping = mmap(nullptr, file_size, PROT_READ | PROT_WRITE,
+                     mode == MapMode::kShared ? MAP_SHARED : MAP_PRIVATE, fd,
+                     0);
+      if (mapping == MAP_FAILED) {
+        close(fd);
+        throw mapped_blob_matrix2d_internal::MapError("Failed to map", path);
+      }
+      madvise(mapping, file_size,
+              mapped_blob_matrix2d_internal::ToAdvice(pattern));
+    }
+    close(fd);
+    return MappedBlobMatrix2D(mapping, file_size, data_offset, rows, cols,
+                              bytes_per_row);
+  }
+
+  void Unmap() {
+    if (mapping_ != nullptr) {
+      munmap(mapping_, mapping_size_);
+      mapping_ = nullptr;
+      mapping_size_ = 0;
+    }
+  }
+
+  // Leaves an empty matrix after moving.
+  void Clear() {
+    BlobMatrix2D<T>::operator=(BlobMatrix2D<T>(nullptr, 0, 0));
+  }
+
+  void *mapping_;
+  size_t mapping_size_;
+};
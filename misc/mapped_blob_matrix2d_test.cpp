@@ -0,0 +1,232 @@
+#include "mapped_blob_matrix2d.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+const std::string kPath = "/tmp/mapped_blob_matrix2d_test.bin";
+
+template <typename Func>
+bool Throws(const Func& func) {
+  try {
+    func();
+  } catch (const std::runtime_error&) {
+    return true;
+  }
+  return false;
+}
+
+void TestCreateAndOpen() {
+  std::cout << "Testing created files..." << std::flush;
+  constexpr size_t kRows = 37;
+  constexpr size_t kCols = 100;
+  {
+    MappedBlobMatrix2D<double> matrix =
+        MappedBlobMatrix2D<double>::Create(kPath, kRows, kCols);
+    assert(matrix.rows() == kRows && matrix.cols() == kCols);
+    assert(matrix.bytes_per_row() == PaddedBytesPerRow(kCols, sizeof(double)));
+    for (size_t i = 0; i < kRows; ++i) {
+      assert(reinterpret_cast<uintptr_t>(matrix.Row(i)) %
+                 kBlobMatrixAlignment == 0);
+      for (size_t j = 0; j < kCols; ++j) {
+        assert(matrix(i, j) == 0);
+        matrix(i, j) = i * kCols + j;
+      }
+    }
+    matrix.Flush();
+  }
+
+  MappedBlobMatrix2D<double> matrix = MappedBlobMatrix2D<double>::Open(
+      kPath, MapMode::kPrivate, AccessPattern::kSequential);
+  assert(matrix.rows() == kRows && matrix.cols() == kCols);
+  for (size_t i = 0; i < kRows; ++i) {
+    for (size_t j = 0; j < kCols; ++j) {
+      assert(matrix(i, j) == i * kCols + j);
+    }
+  }
+  matrix.Advise(AccessPattern::kRandom, 3, 10);
+  matrix.Advise(AccessPattern::kWillNeed);
+
+  // Private changes don't reach the file, shared ones do.
+  matrix(1, 2) = -1;
+  {
+    MappedBlobMatrix2D<double> shared =
+        MappedBlobMatrix2D<double>::Open(kPath, MapMode::kShared);
+    assert(shared(1, 2) == kCols + 2);
+    shared(3, 4) = -2;
+  }
+  MappedBlobMatrix2D<double> reopened = MappedBlobMatrix2D<double>::Open(kPath);
+  assert(reopened(1, 2) == kCols + 2);
+  assert(reopened(3, 4) == -2);
+
+  MappedBlobMatrix2D<double> moved(std::move(reopened));
+  assert(reopened.rows() == 0 && reopened.cols() == 0);
+  assert(moved(3, 4) == -2);
+  matrix = std::move(moved);
+  assert(matrix(3, 4) == -2 && matrix(1, 2) == kCols + 2);
+  std::cout << "ok!" << std::endl;
+}
+
+void TestOpenRaw() {
+  std::cout << "Testing raw files..." << std::flush;
+  // 16-byte preamble followed by 5 rows of 7 bytes padded to 8.
+  constexpr size_t kOffset = 16;
+  constexpr size_t kRows = 5;
+  constexpr size_t kCols = 7;
+  std::vector<uint8_t> bytes(kOffset + kRows * 8, 0xff);
+  for (size_t i = 0; i < kRows; ++i) {
+    for (size_t j = 0; j < kCols; ++j) {
+      bytes[kOffset + i * 8 + j] = i * 10 + j;
+    }
+  }
+  {
+    std::ofstream out(kPath, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  }
+  MappedBlobMatrix2D<uint8_t> image = MappedBlobMatrix2D<uint8_t>::OpenRaw(
+      kPath, kRows, kCols, 8, kOffset);
+  for (size_t i = 0; i < kRows; ++i) {
+    for (size_t j = 0; j < kCols; ++j) {
+      assert(image(i, j) == i * 10 + j);
+    }
+  }
+
+  // The whole file as unpadded rows.
+  MappedBlobMatrix2D<uint8_t> flat = MappedBlobMatrix2D<uint8_t>::OpenRaw(
+      kPath, 1, bytes.size());
+  assert(flat(0, kOffset + 8 + 3) == 13);
+
+  assert(Throws([]() {
+    MappedBlobMatrix2D<uint8_t>::OpenRaw(kPath, kRows + 1, kCols, 8, kOffset);
+  }));
+  assert(Throws([]() {
+    MappedBlobMatrix2D<uint8_t>::OpenRaw(kPath, kRows, kCols, 6, kOffset);
+  }));
+  // Not a file with a header.
+  assert(Throws([]() { MappedBlobMatrix2D<uint8_t>::Open(kPath); }));
+  std::cout << "ok!" << std::endl;
+}
+
+void TestErrors() {
+  std::cout << "Testing errors..." << std::flush;
+  assert(Throws([]() {
+    MappedBlobMatrix2D<float>::Open("/tmp/no/such/matrix.bin");
+  }));
+  MappedBlobMatrix2D<float>::Create(kPath, 10, 10);
+  assert(Throws([]() { MappedBlobMatrix2D<double>::Open(kPath); }));
+  assert(Throws([]() { MappedBlobMatrix2D<int32_t>::Open(kPath); }));
+  MappedBlobMatrix2D<float>::Open(kPath);
+
+  // Truncated data.
+  assert(truncate(kPath.c_str(), kBlobMatrixFileDataOffset + 100) == 0);
+  assert(Throws([]() { MappedBlobMatrix2D<float>::Open(kPath); }));
+  // Corrupt headers whose sizes overflow when multiplied, or point past the
+  // end of the file.
+  auto open_with_header = [](uint64_t rows, uint64_t cols,
+                             uint64_t bytes_per_row, uint64_t data_offset) {
+    MappedBlobMatrix2D<float>::Create(kPath, 1, 1);
+    assert(truncate(kPath.c_str(), 128) == 0);
+    std::fstream file(kPath, std::ios::in | std::ios::out | std::ios::binary);
+    BlobMatrixFileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    header.rows = rows;
+    header.cols = cols;
+    header.bytes_per_row = bytes_per_row;
+    header.data_offset = data_offset;
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+    MappedBlobMatrix2D<float>::Open(kPath);
+  };
+  assert(Throws([&]() {
+    open_with_header((uint64_t(1) << 32) + 1, 1, uint64_t(1) << 32, 64);
+  }));
+  assert(Throws([&]() {
+    open_with_header(2, uint64_t(1) << 62, uint64_t(1) << 62, 64);
+  }));
+  assert(Throws([&]() {
+    open_with_header(1, 1, 4, uint64_t(-4));
+  }));
+  assert(Throws([&]() { open_with_header(1, 1, 4, 256); }));
+  open_with_header(16, 1, 4, 64);
+  assert(Throws([&]() { open_with_header(17, 1, 4, 64); }));
+
+  // Truncated header.
+  assert(truncate(kPath.c_str(), 10) == 0);
+  assert(Throws([]() { MappedBlobMatrix2D<float>::Open(kPath); }));
+
+  MappedBlobMatrix2D<float> empty = MappedBlobMatrix2D<float>::Create(kPath, 0,
+                                                                      0);
+  assert(empty.rows() == 0);
+  empty.Advise(AccessPattern::kSequential);
+  std::cout << "ok!" << std::endl;
+}
+
+// Opening a mapping doesn't depend on the size of the file, while reading it
+// into memory does. Sums of a few scattered rows only page in these rows.
+void RunOpenBenchmark() {
+  constexpr size_t kRows = 16384;
+  constexpr size_t kCols = 4096;
+  {
+    MappedBlobMatrix2D<float> matrix =
+        MappedBlobMatrix2D<float>::Create(kPath, kRows, kCols);
+    for (size_t i = 0; i < kRows; ++i) {
+      for (size_t j = 0; j < kCols; ++j) {
+        matrix(i, j) = 1.0f;
+      }
+    }
+  }
+  const double size_mb = kRows * PaddedBytesPerRow(kCols, sizeof(float)) /
+                         1048576.0;
+
+  auto start = std::chrono::high_resolution_clock::now();
+  MappedBlobMatrix2D<float> mapped = MappedBlobMatrix2D<float>::Open(
+      kPath, MapMode::kPrivate, AccessPattern::kRandom);
+  float mapped_sum = 0;
+  for (size_t i = 0; i < kRows; i += 1024) {
+    for (size_t j = 0; j < kCols; ++j) {
+      mapped_sum += mapped(i, j);
+    }
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  const long long mapped_us =
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+          .count();
+
+  start = std::chrono::high_resolution_clock::now();
+  std::vector<char> bytes(kBlobMatrixFileDataOffset +
+                          kRows * mapped.bytes_per_row());
+  FILE *file = fopen(kPath.c_str(), "rb");
+  assert(fread(bytes.data(), 1, bytes.size(), file) == bytes.size());
+  fclose(file);
+  const BlobMatrix2D<float> loaded(bytes.data() + kBlobMatrixFileDataOffset,
+                                   kRows, kCols, mapped.bytes_per_row());
+  float loaded_sum = 0;
+  for (size_t i = 0; i < kRows; i += 1024) {
+    for (size_t j = 0; j < kCols; ++j) {
+      loaded_sum += loaded(i, j);
+    }
+  }
+  end = std::chrono::high_resolution_clock::now();
+  const long long loaded_us =
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+          .count();
+  assert(mapped_sum == loaded_sum);
+  std::cout << "Sampling 16 rows of " << size_mb << "MB matrix: mapped "
+            << mapped_us << "us, read into memory " << loaded_us << "us"
+            << std::endl;
+  remove(kPath.c_str());
+}
+
+int main() {
+  TestCreateAndOpen();
+  TestOpenRaw();
+  TestErrors();
+  std::cout << "All tests passed! :)" << std::endl;
+  RunOpenBenchmark();
+  return 0;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads executing tasks from a shared queue.
+// Threads which wait for a group of tasks (see TaskGroup) execute pending tasks
+// themselves, so tasks may safely spawn and wait for nested tasks.
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t threads_num = std::thread::hardware_concurrency())
+      : threads_num_(std::max<size_t>(threads_num, 1)) {
+    // The calling thread participates in the computation while waiting, so we
+    // spawn one thread less than requested.
+    for (size_t i = 1; i < threads_num_; ++i) {
+      workers_.emplace_back([this]() { WorkerLoop(); });
+    }
+  }
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopped_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  void Submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+  }
+
+  // Executes one pending task on the calling thread. Returns false if the
+  // queue was empty.
+  bool RunPendingTask() {
+    std::function<void()> task;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (tasks_.empty()) {
+        return false;
+      }
+      task = std::move(tasks_.back());
+      tasks_.pop_back();
+    }
+    task();
+    return true;
+  }
+
+  size_t GetThreadsNum() const {
+    return threads_num_;
+  }
+
+ private:
+  void WorkerLoop() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return stopped_ || !tasks_.empty(); });
+        if (tasks_.empty()) {
+          return;
+        }
+        // Oldest tasks are usually the largest ones, so workers take them
+        // from the front while waiting threads pick the freshest ones.
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+  size_t threads_num_;
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopped_ = false;
+};
+
+// Set of tasks which can be waited for as a whole.
+class TaskGroup {
+ public:
+  explicit TaskGroup(ThreadPool& pool) : pool_(pool) {}
+  TaskGroup(const TaskGroup&) = delete;
+  ~TaskGroup() {
+    Wait();
+  }
+
+  void Run(std::function<void()> task) {
+    pending_tasks_.fetch_add(1, std::memory_order_relaxed);
+    pool_.Submit([this, task = std::move(task)]() {
+      task();
+      pending_tasks_.fetch_sub(1, std::memory_order_release);
+    });
+  }
+
+  void Wait() {
+    while (pending_tasks_.load(std::memory_order_acquire) != 0) {
+      if (!pool_.RunPendingTask()) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+ private:
+  ThreadPool& pool_;
+  std::atomic<size_t> pending_tasks_{0};
+};
+
+// Splits [begin; end) into contiguous ranges of at least |grain_size| elements
+// and calls |func(range_begin, range_end)| for each of them in parallel.
+template <typename Func>
+void ParallelFor(ThreadPool& pool, size_t begin, size_t end, size_t grain_size,
+                 const Func& func) {
+  if (begin >= end) {
+    return;
+  }
+  grain_size = std::max<size_t>(grain_size, 1);
+  const size_t ranges_num = std::max<size_t>(
+      std::min((end - begin) / grain_size, pool.GetThreadsNum()), 1);
+  const size_t range_size = (end - begin + ranges_num - 1) / ranges_num;
+  TaskGroup group(pool);
+  for (size_t range_begin = begin + range_size; range_begin < end;
+       range_begin += range_size) {
+    const size_t range_end = std::min(range_begin + range_size, end);
+    group.Run([&func, range_begin, range_end]() {
+      func(range_begin, range_end);
+    });
+  }
+  func(begin, std::min(begin + range_size, end));
+  group.Wait();
+}
@@ -0,0 +1,69 @@
+#include "thread_pool.h"
+
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+void TestTaskGroup() {
+  std::cout << "Testing task group..." << std::flush;
+  ThreadPool pool(4);
+  std::atomic<int> counter{0};
+  {
+    TaskGroup group(pool);
+    for (int i = 0; i < 1000; ++i) {
+      group.Run([&counter]() { ++counter; });
+    }
+    group.Wait();
+    assert(counter == 1000);
+  }
+  std::cout << "ok!" << std::endl;
+}
+
+// Recursive tasks must not deadlock even if there are less threads than
+// simultaneously waiting tasks.
+int ParallelFibonacci(ThreadPool& pool, int n) {
+  if (n < 2) {
+    return n;
+  }
+  int a = 0;
+  TaskGroup group(pool);
+  group.Run([&pool, &a, n]() { a = ParallelFibonacci(pool, n - 1); });
+  int b = ParallelFibonacci(pool, n - 2);
+  group.Wait();
+  return a + b;
+}
+
+void TestNestedTasks() {
+  std::cout << "Testing nested tasks..." << std::flush;
+  for (size_t threads_num : {1, 2, 8}) {
+    ThreadPool pool(threads_num);
+    assert(ParallelFibonacci(pool, 20) == 6765);
+  }
+  std::cout << "ok!" << std::endl;
+}
+
+void TestParallelFor() {
+  std::cout << "Testing parallel for..." << std::flush;
+  ThreadPool pool(3);
+  for (size_t n : {0, 1, 7, 1000, 12345}) {
+    std::vector<int> data(n, 0);
+    ParallelFor(pool, 0, n, 10, [&data](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        ++data[i];
+      }
+    });
+    assert(std::accumulate(data.begin(), data.end(), size_t(0)) == n);
+    assert(static_cast<size_t>(std::count(data.begin(), data.end(), 1)) == n);
+  }
+  std::cout << "ok!" << std::endl;
+}
+
+int main() {
+  TestTaskGroup();
+  TestNestedTasks();
+  TestParallelFor();
+  std::cout << "All tests passed! :)" << std::endl;
+  return 0;
+}
@@ -1,21 +1,422 @@
-#include <fstream>
-#include <iostream>
-#include <random>
+// Generates arrays for the external sorts.
+//
+// Every element is computed from its index by a counter-based random number
+// generator, so blocks of the array are generated by different threads
+// independently and the result depends only on the seed.
+//
+// Without arguments asks for the array size and writes uniformly distributed
+// ints to 'array.txt'.
+
+#include <cctype>
 #include <chrono>
 #include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../../misc/thread_pool.h"
+#include "chunk-io.h"
+#include "records.h"
+
+enum class Distribution {
+  kUniform,
+  kZipf,
+  kSorted,
+  kNearlySorted,
+  kFewUnique,
+};
+
+enum class KeyType {
+  kInt32,
+  kInt64,
+  kRecord,
+};
+
+struct Options {
+  uint64_t size = 0;
+  KeyType key_type = KeyType::kInt32;
+  FileFormat format = FileFormat::kText;
+  Distribution distribution = Distribution::kUniform;
+  uint64_t seed = std::chrono::system_clock::now().time_since_epoch().count();
+  size_t threads_num = std::thread::hardware_concurrency();
+  // Number of distinct values for zipf and few-unique distributions.
+  uint64_t values_num = 0;
+  double zipf_exponent = 1.0;
+  // Fraction of random elements in a nearly sorted array.
+  double unsorted_fraction = 0.01;
+};
+
+constexpr uint64_t kDefaultZipfValuesNum = 1000 * 1000;
+constexpr uint64_t kDefaultFewUniqueValuesNum = 16;
+// Elements are generated and written in blocks of this size, one block per
+// thread at a time.
+constexpr size_t kBlockSize = 1 << 20;
+
+inline uint64_t SplitMix64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// Stream of random numbers of one element, determined by the seed and the
+// element index only.
+class CounterRng {
+ public:
+  CounterRng(uint64_t seed, uint64_t index)
+      : state_(SplitMix64(seed ^ SplitMix64(index))) {}
+
+  uint64_t Next() {
+    state_ += 0x9e3779b97f4a7c15ULL;
+    return SplitMix64(state_);
+  }
+
+  // Uniformly distributed in [0; 1).
+  double NextDouble() {
+    return (Next() >> 11) * 0x1.0p-53;
+  }
+
+ private:
+  uint64_t state_;
+};
+
+// Zipf distribution over [1; values_num] with P(k) ~ k^-exponent sampled by
+// rejection-inversion (W. Hormann, G. Derflinger, "Rejection-inversion to
+// generate variates from monotone discrete distributions"). Takes O(1)
+// expected time per sample and no tables.
+class ZipfSampler {
+ public:
+  ZipfSampler(uint64_t values_num, double exponent)
+      : values_num_(values_num), exponent_(exponent) {
+    h_integral_x1_ = HIntegral(1.5) - 1.0;
+    h_integral_values_num_ = HIntegral(values_num_ + 0.5);
+    s_ = 2.0 - HIntegralInverse(HIntegral(2.5) - H(2.0));
+  }
+
+  uint64_t Sample(CounterRng& rng) const {
+    while (true) {
+      const double u = h_integral_values_num_ +
+          rng.NextDouble() * (h_integral_x1_ - h_integral_values_num_);
+      const double x = HIntegralInverse(u);
+      const double k = std::min<double>(
+          std::max(std::floor(x + 0.5), 1.0), values_num_);
+      if (k - x <= s_ || u >= HIntegral(k + 0.5) - H(k)) {
+        return static_cast<uint64_t>(k);
+      }
+    }
+  }
+
+ private:
+  double H(double x) const {
+    return std::exp(-exponent_ * std::log(x));
+  }
+
+  // Integral of H from 1 to x up to a constant.
+  double HIntegral(double x) const {
+    const double log_x = std::log(x);
+    return ExpM1DivX((1.0 - exponent_) * log_x) * log_x;
+  }
+
+  double HIntegralInverse(double x) const {
+    const double t = std::max(x * (1.0 - exponent_), -1.0);
+    return std::exp(Log1pDivX(t) * x);
+  }
+
+  // log(1 + x) / x, accurate near 0.
+  static double Log1pDivX(double x) {
+    if (std::abs(x) > 1e-8) {
+      return std::log1p(x) / x;
+    }
+    return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+  }
+
+  // (exp(x) - 1) / x, accurate near 0.
+  static double ExpM1DivX(double x) {
+    if (std::abs(x) > 1e-8) {
+      return std::expm1(x) / x;
+    }
+    return 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+  }
+
+  uint64_t values_num_;
+  double exponent_;
+  double h_integral_x1_;
+  double h_integral_values_num_;
+  double s_;
+};
+
+// Computes the key of the element with the given index.
+template <typename Key>
+class KeyGenerator {
+ public:
+  explicit KeyGenerator(const Options& options)
+      : options_(options),
+        zipf_(options.values_num, options.zipf_exponent) {}
 
-int main() {
-  size_t n;
-  int cnum;
-  std::cout << "Please enter array size: ";
-  std::cin >> n;
-  std::default_random_engine generator(
-      std::chrono::system_clock::now().time_since_epoch().count());
-  std::uniform_int_distribution<int> distribution(INT_MIN, INT_MAX);
-  std::ofstream out("array.txt");
-  out << n << std::endl;
-  for (int i = 0; i < n; ++i) {
-    out << distribution(generator) << " ";
-  }
-  out << std::endl;
+  Key operator()(uint64_t index) const {
+    CounterRng rng(options_.seed, index);
+    switch (options_.distribution) {
+      case Distribution::kUniform:
+        return static_cast<Key>(rng.Next());
+      case Distribution::kZipf:
+        return static_cast<Key>(zipf_.Sample(rng));
+      case Distribution::kSorted:
+        return SortedKey(index);
+      case Distribution::kNearlySorted:
+        if (rng.NextDouble() < options_.unsorted_fraction) {
+          return static_cast<Key>(rng.Next());
+        }
+        return SortedKey(index);
+      case Distribution::kFewUnique:
+        return static_cast<Key>(SplitMix64(
+            options_.seed + rng.Next() % options_.values_num));
+    }
+    return Key();
+  }
+
+ private:
+  // Non-decreasing keys spread over the whole range of Key.
+  Key SortedKey(uint64_t index) const {
+    const double range = std::pow(2.0, std::numeric_limits<Key>::digits + 1);
+    const double key = std::numeric_limits<Key>::min() +
+                       double(index) / options_.size * range;
+    if (key >= double(std::numeric_limits<Key>::max())) {
+      return std::numeric_limits<Key>::max();
+    }
+    return static_cast<Key>(key);
+  }
+
+  const Options& options_;
+  ZipfSampler zipf_;
+};
+
+template <typename T>
+T MakeElement(typename RecordTraits<T>::Key key, uint64_t) {
+  return key;
+}
+
+// Payload of a record starts with its index in the array, which is handy for
+// checking stability.
+template <>
+Record MakeElement<Record>(int64_t key, uint64_t index) {
+  Record record;
+  record.key = key;
+  memset(record.payload, 0, sizeof(record.payload));
+  memcpy(record.payload, &index, sizeof(index));
+  return record;
+}
+
+// Every thread has a buffer for a block of kBlockSize elements, e.g. 64MB
+// for records, so the number of threads is limited to keep memory use sane.
+constexpr size_t kMaxThreadsNum = 64;
+
+// Parses decimal |value| into |result| if it is at most |max_value|.
+// std::stoull accepts a leading '-' and wraps negative values around, so
+// only digits are allowed.
+bool ParseUnsigned(const std::string& value, uint64_t max_value,
+                   uint64_t *result) {
+  if (value.empty() || !isdigit(static_cast<unsigned char>(value[0]))) {
+    return false;
+  }
+  size_t end_pos = 0;
+  const unsigned long long res = std::stoull(value, &end_pos);
+  if (end_pos != value.size() || res > max_value) {
+    return false;
+  }
+  *result = res;
+  return true;
+}
+
+// Parses |value| into |result| if it is a number in [|min_value|;
+// |max_value|].
+bool ParseDouble(const std::string& value, double min_value, double max_value,
+                 double *result) {
+  size_t end_pos = 0;
+  const double res = std::stod(value, &end_pos);
+  if (end_pos != value.size() || !(res >= min_value && res <= max_value)) {
+    return false;
+  }
+  *result = res;
+  return true;
+}
+
+bool ParseOptions(int argc, char **argv, Options *options) {
+  // Numbers are parsed by std::stoull and std::stod, which throw on invalid
+  // or out of range values.
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      const size_t eq_pos = arg.find('=');
+      const std::string name = arg.substr(0, eq_pos);
+      const std::string value =
+          eq_pos == std::string::npos ? "" : arg.substr(eq_pos + 1);
+      if (name == "--size") {
+        if (!ParseUnsigned(value, UINT64_MAX, &options->size)) {
+          return false;
+        }
+      } else if (name == "--type") {
+        if (value == "int32") {
+          options->key_type = KeyType::kInt32;
+        } else if (value == "int64") {
+          options->key_type = KeyType::kInt64;
+        } else if (value == "record") {
+          options->key_type = KeyType::kRecord;
+        } else {
+          return false;
+        }
+      } else if (name == "--format") {
+        if (!ParseFileFormat(value, &options->format)) {
+          return false;
+        }
+      } else if (name == "--distribution") {
+        if (value == "uniform") {
+          options->distribution = Distribution::kUniform;
+        } else if (value == "zipf") {
+          options->distribution = Distribution::kZipf;
+        } else if (value == "sorted") {
+          options->distribution = Distribution::kSorted;
+        } else if (value == "nearly-sorted") {
+          options->distribution = Distribution::kNearlySorted;
+        } else if (value == "few-unique") {
+          options->distribution = Distribution::kFewUnique;
+        } else {
+          return false;
+        }
+      } else if (name == "--seed") {
+        if (!ParseUnsigned(value, UINT64_MAX, &options->seed)) {
+          return false;
+        }
+      } else if (name == "--threads") {
+        uint64_t threads_num;
+        if (!ParseUnsigned(value, kMaxThreadsNum, &threads_num)) {
+          return false;
+        }
+        options->threads_num = threads_num;
+      } else if (name == "--values") {
+        if (!ParseUnsigned(value, UINT64_MAX, &options->values_num)) {
+          return false;
+        }
+      } else if (name == "--zipf-exponent") {
+        if (!ParseDouble(value, 0.0, HUGE_VAL, &options->zipf_exponent)) {
+          return false;
+        }
+      } else if (name == "--unsorted-fraction") {
+        if (!ParseDouble(value, 0.0, 1.0, &options->unsorted_fraction)) {
+          return false;
+        }
+      } else {
+        return false;
+      }
+    }
+  } catch (const std::invalid_argument&) {
+    return false;
+  } catch (const std::out_of_range&) {
+    return false;
+  }
+  if (options->values_num == 0) {
+    options->values_num = options->distribution == Distribution::kZipf ?
+        kDefaultZipfValuesNum : kDefaultFewUniqueValuesNum;
+  }
+  return options->zipf_exponent > 0;
+}
+
+std::string GetOutputPath(const Options& options) {
+  return options.format == FileFormat::kText ? "array.txt" : "array.bin";
+}
+
+template <typename T>
+void GenerateArray(const Options& options) {
+  using Key = typename RecordTraits<T>::Key;
+  CheckFormat(options.format, HasTextFormat<T>());
+  auto start = std::chrono::high_resolution_clock::now();
+  const KeyGenerator<Key> generator(options);
+  ThreadPool pool(options.threads_num);
+  const bool text = options.format == FileFormat::kText;
+  const size_t block_bytes =
+      kBlockSize * (text ? kMaxTextSize : sizeof(T));
+  std::vector<std::vector<char>> blocks(pool.GetThreadsNum(),
+                                        std::vector<char>(block_bytes));
+  std::vector<size_t> block_sizes(blocks.size());
+
+  BufferedWriter out(GetOutputPath(options));
+  if (text) {
+    out.WriteText(options.size, '\n');
+  } else {
+    out.Write(&options.size, sizeof(options.size));
+  }
+  for (uint64_t batch_begin = 0; batch_begin < options.size;
+       batch_begin += blocks.size() * kBlockSize) {
+    ParallelFor(pool, 0, blocks.size(), 1,
+                [&](size_t blocks_begin, size_t blocks_end) {
+      for (size_t i = blocks_begin; i < blocks_end; ++i) {
+        const uint64_t begin = std::min(batch_begin + i * kBlockSize,
+                                        options.size);
+        const uint64_t end = std::min(begin + kBlockSize, options.size);
+        char *block_begin = blocks[i].data();
+        char *block_end = block_begin;
+        for (uint64_t index = begin; index < end; ++index) {
+          const T value = MakeElement<T>(generator(index), index);
+          if constexpr (HasTextFormat<T>()) {
+            if (text) {
+              block_end = FormatText(value, '\n', block_end);
+              continue;
+            }
+          }
+          memcpy(block_end, &value, sizeof(T));
+          block_end += sizeof(T);
+        }
+        block_sizes[i] = block_end - block_begin;
+      }
+    });
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      out.Write(blocks[i].data(), block_sizes[i]);
+    }
+  }
+  out.Flush();
+  auto end = std::chrono::high_resolution_clock::now();
+  const long long elapsed_ms = std::max<long long>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          end - start).count(), 1);
+  std::cout << "Generated " << options.size << " elements with seed "
+            << options.seed << " in " << elapsed_ms << "ms ("
+            << double(options.size) * sizeof(T) / 1e6 / elapsed_ms
+            << " GB/s)." << std::endl;
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    std::cerr << "Usage: " << argv[0] << " [--size=N]"
+              << " [--type=int32|int64|record] [--format=text|binary]"
+              << " [--distribution=uniform|zipf|sorted|nearly-sorted|"
+              << "few-unique] [--seed=S] [--threads=N] [--values=K]"
+              << " [--zipf-exponent=S] [--unsorted-fraction=F]" << std::endl;
+    return -1;
+  }
+  if (argc == 1) {
+    std::cout << "Please enter array size: ";
+    std::cin >> options.size;
+  }
+  try {
+    switch (options.key_type) {
+      case KeyType::kInt32:
+        GenerateArray<int32_t>(options);
+        break;
+      case KeyType::kInt64:
+        GenerateArray<int64_t>(options);
+        break;
+      case KeyType::kRecord:
+        GenerateArray<Record>(options);
+        break;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return -1;
+  }
+  return 0;
 }
@@ -0,0 +1,145 @@
+#include "chunk-io.h"
+
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Parses all integers of |text|, returns false if the parser throws.
+template <typename T>
+bool Parse(const std::string& text, std::vector<T> *values) {
+  TextIntParser parser(text.data(), text.data() + text.size());
+  values->clear();
+  try {
+    T value;
+    while (parser.Next(value)) {
+      values->push_back(value);
+    }
+  } catch (const std::runtime_error&) {
+    return false;
+  }
+  return true;
+}
+
+void TestTextIntParser() {
+  std::cout << "Testing text parser..." << std::flush;
+  std::vector<int32_t> values;
+  assert(Parse("3\n-1 0\t42\r\n", &values));
+  assert((values == std::vector<int32_t>{3, -1, 0, 42}));
+  assert(Parse("  \n", &values) && values.empty());
+  assert(Parse("-2147483648 2147483647", &values));
+  assert((values == std::vector<int32_t>{std::numeric_limits<int32_t>::min(),
+                                         std::numeric_limits<int32_t>::max()}));
+
+  // Anything but digits fails instead of being read as zero.
+  for (const char *text : {"+1", "1,2", "abc", "-", "12a", "1 - 2", "1.5"}) {
+    assert(!Parse(text, &values));
+  }
+  // So do values out of range.
+  for (const char *text : {"2147483648", "-2147483649",
+                           "99999999999999999999999"}) {
+    assert(!Parse(text, &values));
+  }
+
+  std::vector<int64_t> values64;
+  assert(Parse("-9223372036854775808 9223372036854775807", &values64));
+  assert(values64[0] == std::numeric_limits<int64_t>::min());
+  assert(values64[1] == std::numeric_limits<int64_t>::max());
+  assert(!Parse("9223372036854775808", &values64));
+
+  std::vector<uint64_t> sizes;
+  assert(Parse("18446744073709551615 -0", &sizes));
+  assert(sizes[0] == std::numeric_limits<uint64_t>::max() && sizes[1] == 0);
+  assert(!Parse("18446744073709551616", &sizes));
+  assert(!Parse("-1", &sizes));
+  std::cout << "ok!" << std::endl;
+}
+
+// Everything written by FormatText() is parsed back.
+void TestTextRoundTrip() {
+  std::cout << "Testing text round trip..." << std::flush;
+  const std::vector<int64_t> expected = {
+      0, 1, -1, 10, -10, 1234567890123, std::numeric_limits<int64_t>::min(),
+      std::numeric_limits<int64_t>::max()};
+  std::string text;
+  for (int64_t value : expected) {
+    char buffer[kMaxTextSize];
+    char *end = FormatText(value, '\n', buffer);
+    assert(size_t(end - buffer) == TextSize(value));
+    text.append(buffer, end);
+  }
+  std::vector<int64_t> values;
+  assert(Parse(text, &values) && values == expected);
+  std::cout << "ok!" << std::endl;
+}
+
+// A partial element at the end of a binary file is an error, not the end of
+// the array.
+void TestTruncatedBinaryFile() {
+  std::cout << "Testing truncated binary file..." << std::flush;
+  const std::string path = "chunk-io-test.bin";
+  const std::vector<int64_t> expected = {1, 2, 3, 4, 5};
+  {
+    ArrayWriter<int64_t> out(path, FileFormat::kBinary, expected.size());
+    out.Write(expected.data(), expected.size());
+    out.Flush();
+  }
+  {
+    ArrayReader<int64_t> in(path, FileFormat::kBinary);
+    std::vector<int64_t> values(expected.size() + 1);
+    assert(in.Read(values.data(), values.size()) == expected.size());
+  }
+  assert(truncate(path.c_str(), sizeof(uint64_t) + 4 * sizeof(int64_t) + 3)
+         == 0);
+  for (size_t buffer_size : {size_t(16), kIoBufferSize}) {
+    ArrayReader<int64_t> in(path, FileFormat::kBinary, buffer_size);
+    std::vector<int64_t> values(expected.size());
+    bool failed = false;
+    try {
+      in.Read(values.data(), values.size());
+    } catch (const std::runtime_error&) {
+      failed = true;
+    }
+    assert(failed);
+  }
+  remove(path.c_str());
+  std::cout << "ok!" << std::endl;
+}
+
+// Write errors are reported by Flush(), and the destructor doesn't throw.
+void TestWriteError() {
+  std::cout << "Testing write errors..." << std::flush;
+  if (access("/dev/full", W_OK) != 0) {
+    std::cout << "skipped, no /dev/full" << std::endl;
+    return;
+  }
+  bool failed = false;
+  try {
+    ArrayWriter<int32_t> out("/dev/full", FileFormat::kText, 1);
+    out.Write(1);
+    out.Flush();
+  } catch (const std::runtime_error&) {
+    failed = true;
+  }
+  assert(failed);
+  {
+    ArrayWriter<int32_t> out("/dev/full", FileFormat::kText, 1);
+    out.Write(1);
+  }
+  std::cout << "ok!" << std::endl;
+}
+
+int main() {
+  TestTextIntParser();
+  TestTextRoundTrip();
+  TestTruncatedBinaryFile();
+  TestWriteError();
+  std::cout << "All tests passed! :)" << std::endl;
+  return 0;
+}
@@ -0,0 +1,483 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "../../alloc/aligned_alloc.h"
+
+// Arrays are stored either as text (elements count on the first line followed
+// by whitespace separated elements) or in binary format (64-bit elements count
+// followed by raw elements).
+enum class FileFormat {
+  kText,
+  kBinary,
+};
+
+inline bool ParseFileFormat(const std::string& value, FileFormat *format) {
+  if (value == "text") {
+    *format = FileFormat::kText;
+  } else if (value == "binary") {
+    *format = FileFormat::kBinary;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+constexpr size_t kIoBufferSize = 4 << 20;
+constexpr size_t kIoBufferAlignment = 64;
+
+using IoBuffer = std::vector<char, AlignedAlloc<char, kIoBufferAlignment>>;
+
+inline std::runtime_error IoError(const std::string& message,
+                                  const std::string& path) {
+  return std::runtime_error(message + " '" + path + "': " + strerror(errno));
+}
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw IoError("Failed to open", path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+      close(fd);
+      throw IoError("Failed to stat", path);
+    }
+    size_ = file_stat.st_size;
+    if (size_ > 0) {
+      void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        close(fd);
+        throw IoError("Failed to map", path);
+      }
+      data_ = static_cast<const char*>(data);
+      madvise(data, size_, MADV_SEQUENTIAL);
+    }
+    close(fd);
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() {
+    if (data_ != nullptr) {
+      munmap(const_cast<char*>(data_), size_);
+    }
+  }
+
+  const char *data() const {
+    return data_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// Parses whitespace separated decimal integers without locale and stream
+// overhead. Throws std::runtime_error on anything else, e.g. a '+' or a letter,
+// and on values which don't fit into the requested type.
+class TextIntParser {
+ public:
+  TextIntParser(const char *begin, const char *end) : cur_(begin), end_(end) {}
+
+  // Returns false at the end of the input.
+  template <typename T>
+  bool Next(T& value) {
+    static_assert(std::is_integral<T>::value, "Only integers can be parsed");
+    while (cur_ != end_ && IsSeparator(*cur_)) {
+      ++cur_;
+    }
+    if (cur_ == end_) {
+      return false;
+    }
+    const bool negative = *cur_ == '-';
+    if (negative) {
+      ++cur_;
+    }
+    // Largest absolute value of the sign.
+    using Unsigned = typename std::make_unsigned<T>::type;
+    const uint64_t limit =
+        negative ? (std::is_signed<T>::value
+                        ? uint64_t(Unsigned(std::numeric_limits<T>::max())) + 1
+                        : 0)
+                 : uint64_t(std::numeric_limits<T>::max());
+    const char *digits_begin = cur_;
+    uint64_t res = 0;
+    while (cur_ != end_ && static_cast<unsigned>(*cur_ - '0') < 10) {
+      const unsigned digit = *cur_ - '0';
+      if (digit > limit || res > (limit - digit) / 10) {
+        throw std::runtime_error("Integer out of range in text input");
+      }
+      res = res * 10 + digit;
+      ++cur_;
+    }
+    if (cur_ == digits_begin || (cur_ != end_ && !IsSeparator(*cur_))) {
+      throw std::runtime_error("Invalid integer in text input");
+    }
+    value = static_cast<T>(negative ? 0 - res : res);
+    return true;
+  }
+
+ private:
+  static bool IsSeparator(char c) {
+    return static_cast<unsigned char>(c) <= ' ';
+  }
+
+  const char *cur_;
+  const char *end_;
+};
+
+// Length of the decimal representation of |value| followed by a separator, as
+// written by BufferedWriter::WriteText().
+template <typename T>
+size_t TextSize(T value) {
+  static_assert(std::is_integral<T>::value, "Only integers can be written");
+  using Unsigned = typename std::make_unsigned<T>::type;
+  Unsigned abs_value = value < 0 ? 0 - static_cast<Unsigned>(value) :
+                                   static_cast<Unsigned>(value);
+  size_t res = value < 0 ? 3 : 2;
+  while (abs_value >= 10) {
+    abs_value /= 10;
+    ++res;
+  }
+  return res;
+}
+
+// Upper bound of TextSize() for all integer types.
+constexpr size_t kMaxTextSize = 24;
+
+// Writes decimal representation of |value| followed by |separator| to |out|.
+// Returns the end of the written text.
+template <typename T>
+char *FormatText(T value, char separator, char *out) {
+  static_assert(std::is_integral<T>::value, "Only integers can be written");
+  char digits[kMaxTextSize];
+  char *digits_begin = digits + kMaxTextSize;
+  *(--digits_begin) = separator;
+  using Unsigned = typename std::make_unsigned<T>::type;
+  Unsigned abs_value = value < 0 ? 0 - static_cast<Unsigned>(value) :
+                                   static_cast<Unsigned>(value);
+  do {
+    *(--digits_begin) = '0' + abs_value % 10;
+    abs_value /= 10;
+  } while (abs_value != 0);
+  if (value < 0) {
+    *(--digits_begin) = '-';
+  }
+  const size_t length = digits + kMaxTextSize - digits_begin;
+  memcpy(out, digits_begin, length);
+  return out + length;
+}
+
+// Writes data to a file through a large aligned buffer. Buffered data is
+// written by Flush(), which reports write errors.
+class BufferedWriter {
+ public:
+  explicit BufferedWriter(const std::string& path,
+                          size_t buffer_size = kIoBufferSize)
+      : path_(path), buffer_(buffer_size) {
+    fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+      throw IoError("Failed to create", path);
+    }
+  }
+  // Writes to an existing file starting at byte |offset| without truncating
+  // it, so that several processes can fill disjoint parts of one file.
+  BufferedWriter(const std::string& path, uint64_t offset,
+                 size_t buffer_size)
+      : path_(path), buffer_(buffer_size), offset_(offset) {
+    fd_ = open(path.c_str(), O_WRONLY);
+    if (fd_ < 0) {
+      throw IoError("Failed to open", path);
+    }
+  }
+  BufferedWriter(const BufferedWriter&) = delete;
+  BufferedWriter& operator=(const BufferedWriter&) = delete;
+  // Writes the rest of the buffer, ignoring errors: callers which need to know
+  // that all data was written call Flush() first.
+  ~BufferedWriter() {
+    try {
+      Flush();
+    } catch (const std::runtime_error&) {
+    }
+    close(fd_);
+  }
+
+  void Write(const void *data, size_t size) {
+    if (size_ + size > buffer_.size()) {
+      Flush();
+      if (size >= buffer_.size()) {
+        WriteAll(static_cast<const char*>(data), size);
+        return;
+      }
+    }
+    memcpy(buffer_.data() + size_, data, size);
+    size_ += size;
+  }
+
+  // Writes decimal representation of |value| followed by |separator|.
+  template <typename T>
+  void WriteText(T value, char separator) {
+    if (size_ + kMaxTextSize > buffer_.size()) {
+      Flush();
+    }
+    size_ = FormatText(value, separator, buffer_.data() + size_) -
+            buffer_.data();
+  }
+
+  void Flush() {
+    WriteAll(buffer_.data(), size_);
+    size_ = 0;
+  }
+
+ private:
+  void WriteAll(const char *data, size_t size) {
+    while (size > 0) {
+      ssize_t written = pwrite(fd_, data, size, offset_);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw IoError("Failed to write", path_);
+      }
+      data += written;
+      size -= written;
+      offset_ += written;
+    }
+  }
+
+  std::string path_;
+  int fd_;
+  IoBuffer buffer_;
+  size_t size_ = 0;
+  uint64_t offset_ = 0;
+};
+
+// Reads data from a file through a large aligned buffer.
+class BufferedReader {
+ public:
+  explicit BufferedReader(const std::string& path,
+                          size_t buffer_size = kIoBufferSize)
+      : path_(path), buffer_(buffer_size) {
+    fd_ = open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+      throw IoError("Failed to open", path);
+    }
+    posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+  BufferedReader(const BufferedReader&) = delete;
+  BufferedReader& operator=(const BufferedReader&) = delete;
+  ~BufferedReader() {
+    close(fd_);
+  }
+
+  // Returns the number of bytes read, which is less than |size| only at the
+  // end of file.
+  size_t Read(void *data, size_t size) {
+    char *out = static_cast<char*>(data);
+    size_t res = 0;
+    while (res < size) {
+      if (begin_ == end_) {
+        // Large reads bypass the buffer.
+        if (size - res >= buffer_.size()) {
+          const size_t cur_size = ReadAll(out + res, size - res);
+          res += cur_size;
+          if (cur_size == 0) {
+            break;
+          }
+          continue;
+        }
+        if (!Fill()) {
+          break;
+        }
+      }
+      const size_t cur_size = std::min(size - res, end_ - begin_);
+      memcpy(out + res, buffer_.data() + begin_, cur_size);
+      begin_ += cur_size;
+      res += cur_size;
+    }
+    return res;
+  }
+
+ private:
+  bool Fill() {
+    begin_ = 0;
+    end_ = ReadAll(buffer_.data(), buffer_.size());
+    return end_ > 0;
+  }
+
+  // Single read() call retried on interrupts. Returns 0 at the end of file.
+  size_t ReadAll(char *data, size_t size) {
+    while (true) {
+      ssize_t res = read(fd_, data, size);
+      if (res < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw IoError("Failed to read", path_);
+      }
+      return res;
+    }
+  }
+
+  std::string path_;
+  int fd_;
+  IoBuffer buffer_;
+  size_t begin_ = 0;
+  size_t end_ = 0;
+};
+
+// Only integers can be stored in text format, other types (e.g. records) are
+// supported in binary format only.
+template <typename T>
+constexpr bool HasTextFormat() {
+  return std::is_integral<T>::value;
+}
+
+inline void CheckFormat(FileFormat format, bool has_text_format) {
+  if (format == FileFormat::kText && !has_text_format) {
+    throw std::runtime_error("Only integers can be stored as text");
+  }
+}
+
+// Sequential writer of an array of |size| elements.
+template <typename T>
+class ArrayWriter {
+ public:
+  ArrayWriter(const std::string& path, FileFormat format, uint64_t size,
+              size_t buffer_size = kIoBufferSize)
+      : format_(format), writer_(path, buffer_size) {
+    CheckFormat(format_, HasTextFormat<T>());
+    if (format_ == FileFormat::kBinary) {
+      writer_.Write(&size, sizeof(size));
+    } else {
+      writer_.WriteText(size, '\n');
+    }
+  }
+
+  void Write(const T& value) {
+    Write(&value, 1);
+  }
+
+  void Write(const T *values, size_t size) {
+    if constexpr (HasTextFormat<T>()) {
+      if (format_ == FileFormat::kText) {
+        for (size_t i = 0; i < size; ++i) {
+          writer_.WriteText(values[i], '\n');
+        }
+        return;
+      }
+    }
+    writer_.Write(values, size * sizeof(T));
+  }
+
+  // Writes buffered elements, see BufferedWriter::Flush().
+  void Flush() {
+    writer_.Flush();
+  }
+
+ private:
+  FileFormat format_;
+  BufferedWriter writer_;
+};
+
+// Sequential reader of an array written by ArrayWriter. Text files are
+// memory mapped and parsed in place, binary ones are read in blocks.
+template <typename T>
+class ArrayReader {
+ public:
+  ArrayReader(const std::string& path, FileFormat format,
+              size_t buffer_size = kIoBufferSize)
+      : path_(path), format_(format) {
+    CheckFormat(format_, HasTextFormat<T>());
+    if (format_ == FileFormat::kBinary) {
+      reader_ = std::make_unique<BufferedReader>(path, buffer_size);
+      values_.resize(std::max<size_t>(buffer_size / sizeof(T), 1));
+      if (reader_->Read(&size_, sizeof(size_)) != sizeof(size_)) {
+        throw std::runtime_error("Truncated array file '" + path + "'");
+      }
+    } else {
+      file_ = std::make_unique<MappedFile>(path);
+      parser_ = std::make_unique<TextIntParser>(
+          file_->data(), file_->data() + file_->size());
+      if (!parser_->Next(size_)) {
+        throw std::runtime_error("Empty array file '" + path + "'");
+      }
+    }
+  }
+
+  // Number of elements in the array.
+  uint64_t size() const {
+    return size_;
+  }
+
+  bool Next(T& value) {
+    return Read(&value, 1) == 1;
+  }
+
+  // Reads up to |size| next elements to |values|. Returns the number of
+  // elements read, which is 0 at the end of the array.
+  size_t Read(T *values, size_t size) {
+    size_t res = 0;
+    if constexpr (HasTextFormat<T>()) {
+      if (format_ == FileFormat::kText) {
+        while (res < size && parser_->Next(values[res])) {
+          ++res;
+        }
+        return res;
+      }
+    }
+    if (pos_ == values_end_ && size < values_.size()) {
+      values_end_ = ReadElements(values_.data(), values_.size());
+      pos_ = 0;
+    }
+    res = std::min(size, values_end_ - pos_);
+    std::copy(values_.begin() + pos_, values_.begin() + pos_ + res, values);
+    pos_ += res;
+    if (res < size) {
+      res += ReadElements(values + res, size - res);
+    }
+    return res;
+  }
+
+ private:
+  // Reads up to |size| elements from the binary file. A partial element at
+  // the end of the file means that it is truncated.
+  size_t ReadElements(T *values, size_t size) {
+    const size_t bytes = reader_->Read(values, size * sizeof(T));
+    if (bytes % sizeof(T) != 0) {
+      throw std::runtime_error("Truncated array file '" + path_ + "'");
+    }
+    return bytes / sizeof(T);
+  }
+
+  std::string path_;
+  FileFormat format_;
+  uint64_t size_ = 0;
+  std::unique_ptr<MappedFile> file_;
+  std::unique_ptr<TextIntParser> parser_;
+  std::unique_ptr<BufferedReader> reader_;
+  std::vector<T> values_;
+  size_t pos_ = 0;
+  size_t values_end_ = 0;
+};
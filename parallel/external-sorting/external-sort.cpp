@@ -6,9 +6,20 @@
 #include <time.h>
 #include <stdbool.h>
 #include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
-#include <set>
+
+#include "../../misc/blocking_queue.h"
+#include "chunk-io.h"
+#include "loser-tree.h"
+#include "records.h"
 
 class Timer {
 public:
@@ -19,11 +30,12 @@ public:
     start_ = std::chrono::high_resolution_clock::now();
   }
   void stop() {
+    std::cout << "Elapsed time: " << elapsed_ms() << "ms" << std::endl;
+  }
+  long long elapsed_ms() const {
     auto end = std::chrono::high_resolution_clock::now();
-    std::cout << "Elapsed time: "
-              << std::chrono::duration_cast<std::chrono::milliseconds>(
-                     end - start_).count()
-              << "ms" << std::endl;
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        end - start_).count();
   }
 private:
   std::chrono::high_resolution_clock::time_point start_;
@@ -33,108 +45,592 @@ bool IsMasterProcess(int rank) {
   return rank == 0;
 }
 
-constexpr int kChunkSize = 10 * 1000 * 1000;
+// Size of the chunks sorted by workers.
+constexpr size_t kChunkBytes = 40 * 1000 * 1000;
+// Read-ahead buffer of every sorted chunk during merging.
+constexpr size_t kMergeReadBufferBytes = 1 << 20;
+constexpr size_t kMergeOutputBatchBytes = 1 << 18;
+constexpr size_t kChunkReaderBufferSize = 1 << 12;
+// Every sorted chunk contributes this many regularly spaced samples to the
+// choice of key ranges for the distributed merge.
+constexpr int kSamplesPerChunk = 1024;
+
+enum class MergeMode {
+  // Rank 0 merges all the chunks.
+  kMaster,
+  // Every rank merges its own key range of all the chunks.
+  kDistributed,
+};
+
+enum class KeyType {
+  kInt32,
+  kInt64,
+  kRecord,
+};
+
+struct Options {
+  // Format of the input and the output arrays.
+  FileFormat format = FileFormat::kText;
+  // Format of the intermediate sorted chunks.
+  FileFormat chunks_format = FileFormat::kBinary;
+  MergeMode merge_mode = MergeMode::kDistributed;
+  KeyType key_type = KeyType::kInt32;
+  // Keep elements with equal keys in their input order.
+  bool stable = false;
+  bool descending = false;
+};
+
+bool ParseOptions(int argc, char **argv, Options *options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t eq_pos = arg.find('=');
+    const std::string name = arg.substr(0, eq_pos);
+    const std::string value =
+        eq_pos == std::string::npos ? "" : arg.substr(eq_pos + 1);
+    if (name == "--format") {
+      if (!ParseFileFormat(value, &options->format)) {
+        return false;
+      }
+    } else if (name == "--chunks-format") {
+      if (!ParseFileFormat(value, &options->chunks_format)) {
+        return false;
+      }
+    } else if (name == "--merge") {
+      if (value == "master") {
+        options->merge_mode = MergeMode::kMaster;
+      } else if (value == "distributed") {
+        options->merge_mode = MergeMode::kDistributed;
+      } else {
+        return false;
+      }
+    } else if (name == "--type") {
+      if (value == "int32") {
+        options->key_type = KeyType::kInt32;
+      } else if (value == "int64") {
+        options->key_type = KeyType::kInt64;
+      } else if (value == "record") {
+        options->key_type = KeyType::kRecord;
+      } else {
+        return false;
+      }
+    } else if (name == "--order") {
+      if (value == "ascending") {
+        options->descending = false;
+      } else if (value == "descending") {
+        options->descending = true;
+      } else {
+        return false;
+      }
+    } else if (name == "--stable") {
+      options->stable = true;
+    } else {
+      return false;
+    }
+  }
+  // Key ranges of the chunks are found by binary search, which is possible
+  // only in binary files.
+  return options->merge_mode == MergeMode::kMaster ||
+         options->chunks_format == FileFormat::kBinary;
+}
+
+std::string GetInputPath(const Options& options) {
+  return options.format == FileFormat::kText ? "array.txt" : "array.bin";
+}
+
+std::string GetOutputPath(const Options& options) {
+  return options.format == FileFormat::kText ? "sorted-array.txt" :
+                                               "sorted-array.bin";
+}
+
+std::string GetChunkPath(int chunk_id) {
+  return "data/chunk-" + std::to_string(chunk_id);
+}
+
+// MPI datatype of the elements of type T.
+template <typename T>
+struct MpiDatatype;
+
+template <>
+struct MpiDatatype<int32_t> {
+  static MPI_Datatype Get() {
+    return MPI_INT32_T;
+  }
+};
+
+template <>
+struct MpiDatatype<int64_t> {
+  static MPI_Datatype Get() {
+    return MPI_INT64_T;
+  }
+};
+
+// Records are described by a struct type resized to the record size, so that
+// arrays of records with padding are transferred correctly.
+template <typename Key, size_t kPayloadSize>
+struct MpiDatatype<KeyedRecord<Key, kPayloadSize>> {
+  static MPI_Datatype Get() {
+    static MPI_Datatype datatype = Create();
+    return datatype;
+  }
+
+ private:
+  static MPI_Datatype Create() {
+    using Record = KeyedRecord<Key, kPayloadSize>;
+    int block_lengths[2] = {1, static_cast<int>(kPayloadSize)};
+    MPI_Aint displacements[2] = {offsetof(Record, key),
+                                 offsetof(Record, payload)};
+    MPI_Datatype types[2] = {MpiDatatype<Key>::Get(), MPI_BYTE};
+    MPI_Datatype struct_type;
+    MPI_Type_create_struct(2, block_lengths, displacements, types,
+                           &struct_type);
+    MPI_Datatype datatype;
+    MPI_Type_create_resized(struct_type, 0, sizeof(Record), &datatype);
+    MPI_Type_commit(&datatype);
+    MPI_Type_free(&struct_type);
+    return datatype;
+  }
+};
+
+// Chunks are assigned to workers round-robin, so every process knows which
+// chunks it receives once the array size is broadcast.
+template <typename T>
+constexpr int64_t GetChunkCapacity() {
+  return kChunkBytes / sizeof(T);
+}
+
+template <typename T>
+int GetChunksNum(int64_t n) {
+  return (n + GetChunkCapacity<T>() - 1) / GetChunkCapacity<T>();
+}
+
+template <typename T>
+int GetChunkSize(int chunk_id, int64_t n) {
+  return std::min(n - chunk_id * GetChunkCapacity<T>(), GetChunkCapacity<T>());
+}
+
+int GetChunkOwner(int chunk_id, int processes_num) {
+  return 1 + chunk_id % (processes_num - 1);
+}
+
+// Sorted chunk passed between the stages of a worker.
+template <typename T>
+struct Chunk {
+  std::vector<T> data;
+  // Target of the gather after sorting large records by their keys.
+  std::vector<T> buffer;
+  // Either data or buffer after sorting.
+  const T *sorted = nullptr;
+  int size = 0;
+  int id = 0;
+};
+
+// Reads the input array and sends it to the workers chunk by chunk. The array
+// size is broadcast as soon as it is known. Parsing of the next chunk overlaps
+// with sending of the previous one.
+template <typename T>
+void DistributeChunks(const Options& options, int processes_num, int64_t *n) {
+  Timer timer;
+  CheckFormat(options.format, HasTextFormat<T>());
+  MappedFile input(GetInputPath(options));
+  const T *binary_data = nullptr;
+  TextIntParser parser(input.data(), input.data() + input.size());
+  if (options.format == FileFormat::kBinary) {
+    uint64_t size = 0;
+    if (input.size() >= sizeof(size)) {
+      memcpy(&size, input.data(), sizeof(size));
+    }
+    if (input.size() < sizeof(size) + size * sizeof(T)) {
+      throw std::runtime_error("Truncated input file");
+    }
+    *n = size;
+    // Binary input is sent directly from the mapped file.
+    binary_data = reinterpret_cast<const T*>(input.data() + sizeof(size));
+  } else if (!parser.Next(*n)) {
+    throw std::runtime_error("Empty input file");
+  }
+  MPI_Bcast(n, 1, MPI_INT64_T, 0, MPI_COMM_WORLD);
+
+  std::vector<T> buffers[2];
+  MPI_Request requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+  long long parse_ms = 0;
+  long long send_wait_ms = 0;
+  const int chunks_num = GetChunksNum<T>(*n);
+  for (int chunk_id = 0; chunk_id < chunks_num; ++chunk_id) {
+    const int cur_size = GetChunkSize<T>(chunk_id, *n);
+    const int buffer_id = chunk_id % 2;
+    Timer stage_timer;
+    MPI_Wait(&requests[buffer_id], MPI_STATUS_IGNORE);
+    send_wait_ms += stage_timer.elapsed_ms();
+    const T *chunk = binary_data + chunk_id * GetChunkCapacity<T>();
+    if constexpr (HasTextFormat<T>()) {
+      if (options.format == FileFormat::kText) {
+        stage_timer.start();
+        std::vector<T>& buffer = buffers[buffer_id];
+        buffer.resize(cur_size);
+        for (int j = 0; j < cur_size; ++j) {
+          if (!parser.Next(buffer[j])) {
+            throw std::runtime_error("Truncated input file");
+          }
+        }
+        chunk = buffer.data();
+        parse_ms += stage_timer.elapsed_ms();
+      }
+    }
+    MPI_Isend(chunk, cur_size, MpiDatatype<T>::Get(),
+              GetChunkOwner(chunk_id, processes_num), chunk_id,
+              MPI_COMM_WORLD, &requests[buffer_id]);
+  }
+  Timer stage_timer;
+  MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+  send_wait_ms += stage_timer.elapsed_ms();
+  std::cout << "Process #0 distributed " << chunks_num << " chunks: parsing "
+            << parse_ms << "ms, waiting for sends " << send_wait_ms
+            << "ms, total " << timer.elapsed_ms() << "ms." << std::endl;
+}
+
+template <typename T, typename Compare>
+void MergeChunks(const Options& options, int chunks_num, int64_t n) {
+  std::cout << "Merging " << chunks_num << " chunks." << std::endl;
+  std::vector<std::unique_ptr<ArrayReader<T>>> sorted_inputs;
+  std::vector<ArrayReader<T>*> runs;
+  for (int i = 0; i < chunks_num; ++i) {
+    // Read-ahead is done by MergeRuns, so readers only need a small buffer
+    // for the header.
+    sorted_inputs.push_back(std::make_unique<ArrayReader<T>>(
+        GetChunkPath(i), options.chunks_format, kChunkReaderBufferSize));
+    runs.push_back(sorted_inputs.back().get());
+  }
+  ArrayWriter<T> out(GetOutputPath(options), options.format, n);
+  MergeRuns<T>(runs, kMergeReadBufferBytes / sizeof(T),
+               kMergeOutputBatchBytes / sizeof(T),
+               [&out](const T *values, size_t size) {
+                 out.Write(values, size);
+               }, Compare(), KeyOf());
+  out.Flush();
+}
+
+// Sorts chunks received from the master and returns samples of their keys.
+// The main thread receives chunks into two buffers while a sort thread and a
+// writer thread process the previous ones; it is the only thread calling MPI.
+template <typename T, typename Compare>
+std::vector<typename RecordTraits<T>::Key> SortChunks(
+    const Options& options, int rank, int processes_num, int64_t n) {
+  using Key = typename RecordTraits<T>::Key;
+  // Two chunks being received, one being sorted and one being written.
+  constexpr int kBuffersNum = 4;
+  constexpr int kReceivesNum = 2;
+  Timer timer;
+  std::vector<Chunk<T>> chunks(kBuffersNum);
+  BlockingQueue<Chunk<T>*> free_chunks;
+  BlockingQueue<Chunk<T>*> received_chunks;
+  BlockingQueue<Chunk<T>*> sorted_chunks;
+  for (auto& chunk : chunks) {
+    chunk.data.resize(GetChunkCapacity<T>());
+    if (sizeof(T) > kMaxRecordSizeForDirectSort) {
+      chunk.buffer.resize(GetChunkCapacity<T>());
+    }
+    free_chunks.Push(&chunk);
+  }
+
+  std::vector<Key> samples;
+  long long sort_ms = 0;
+  std::thread sort_thread([&]() {
+    Chunk<T> *chunk = nullptr;
+    while (received_chunks.Pop(chunk)) {
+      Timer stage_timer;
+      chunk->sorted = SortRecords(chunk->data.data(), chunk->buffer.data(),
+                                  chunk->size, options.stable, Compare());
+      for (int i = 0; i < kSamplesPerChunk; ++i) {
+        samples.push_back(RecordTraits<T>::GetKey(
+            chunk->sorted[int64_t(i) * chunk->size / kSamplesPerChunk]));
+      }
+      sort_ms += stage_timer.elapsed_ms();
+      sorted_chunks.Push(chunk);
+    }
+    sorted_chunks.Close();
+  });
+  long long write_ms = 0;
+  std::thread write_thread([&]() {
+    Chunk<T> *chunk = nullptr;
+    while (sorted_chunks.Pop(chunk)) {
+      Timer stage_timer;
+      ArrayWriter<T> out(GetChunkPath(chunk->id), options.chunks_format,
+                         chunk->size);
+      out.Write(chunk->sorted, chunk->size);
+      out.Flush();
+      write_ms += stage_timer.elapsed_ms();
+      free_chunks.Push(chunk);
+    }
+  });
+
+  std::vector<int> chunk_ids;
+  for (int chunk_id = 0; chunk_id < GetChunksNum<T>(n); ++chunk_id) {
+    if (GetChunkOwner(chunk_id, processes_num) == rank) {
+      chunk_ids.push_back(chunk_id);
+    }
+  }
+  long long receive_wait_ms = 0;
+  std::deque<std::pair<Chunk<T>*, MPI_Request>> receives;
+  size_t next_chunk = 0;
+  while (next_chunk < chunk_ids.size() || !receives.empty()) {
+    Timer stage_timer;
+    while (next_chunk < chunk_ids.size() &&
+           receives.size() < kReceivesNum) {
+      Chunk<T> *chunk = nullptr;
+      free_chunks.Pop(chunk);
+      chunk->id = chunk_ids[next_chunk++];
+      chunk->size = GetChunkSize<T>(chunk->id, n);
+      MPI_Request request;
+      MPI_Irecv(chunk->data.data(), chunk->size, MpiDatatype<T>::Get(), 0,
+                chunk->id, MPI_COMM_WORLD, &request);
+      receives.emplace_back(chunk, request);
+    }
+    MPI_Wait(&receives.front().second, MPI_STATUS_IGNORE);
+    receive_wait_ms += stage_timer.elapsed_ms();
+    received_chunks.Push(receives.front().first);
+    receives.pop_front();
+  }
+  received_chunks.Close();
+  sort_thread.join();
+  write_thread.join();
+  std::cout << "Process #" << rank << " sorted " << chunk_ids.size()
+            << " chunks: waiting for data " << receive_wait_ms
+            << "ms, sorting " << sort_ms << "ms, writing " << write_ms
+            << "ms, total " << timer.elapsed_ms() << "ms." << std::endl;
+  return samples;
+}
+
+// Gathers samples of all the processes on the master and chooses
+// |processes_num - 1| splitters dividing the keys into ranges of roughly equal
+// size.
+template <typename Key, typename Compare>
+std::vector<Key> ChooseSplitters(const std::vector<Key>& samples, int rank,
+                                 int processes_num) {
+  int samples_num = samples.size();
+  std::vector<int> samples_nums(processes_num);
+  MPI_Gather(&samples_num, 1, MPI_INT, samples_nums.data(), 1, MPI_INT, 0,
+             MPI_COMM_WORLD);
+  std::vector<int> displacements(processes_num, 0);
+  std::vector<Key> all_samples;
+  if (IsMasterProcess(rank)) {
+    for (int i = 1; i < processes_num; ++i) {
+      displacements[i] = displacements[i - 1] + samples_nums[i - 1];
+    }
+    all_samples.resize(displacements.back() + samples_nums.back());
+  }
+  MPI_Gatherv(samples.data(), samples_num, MpiDatatype<Key>::Get(),
+              all_samples.data(), samples_nums.data(), displacements.data(),
+              MpiDatatype<Key>::Get(), 0, MPI_COMM_WORLD);
+  std::vector<Key> splitters(processes_num - 1, Key());
+  if (IsMasterProcess(rank) && !all_samples.empty()) {
+    std::sort(all_samples.begin(), all_samples.end(), Compare());
+    for (int i = 1; i < processes_num; ++i) {
+      splitters[i - 1] =
+          all_samples[int64_t(i) * all_samples.size() / processes_num];
+    }
+  }
+  MPI_Bcast(splitters.data(), processes_num - 1, MpiDatatype<Key>::Get(), 0,
+            MPI_COMM_WORLD);
+  return splitters;
+}
+
+// Merges keys in [splitters[rank - 1]; splitters[rank]) of all the chunks and
+// writes them to their place in the output file. Ranges of consecutive ranks
+// follow each other, so the output is the concatenation of the ranges. All
+// elements with equal keys belong to one range, so stability is preserved.
+template <typename T, typename Compare>
+void MergeKeyRange(
+    const Options& options, int rank, int processes_num, int chunks_num,
+    int64_t n, const std::vector<typename RecordTraits<T>::Key>& splitters) {
+  using Key = typename RecordTraits<T>::Key;
+  Timer timer;
+  const Compare less;
+  const auto key_less = [&less](const T& value, const Key& key) {
+    return less(RecordTraits<T>::GetKey(value), key);
+  };
+  std::vector<std::unique_ptr<MappedFile>> chunks;
+  std::vector<RangeRun<T>> ranges;
+  int64_t range_size = 0;
+  int64_t range_text_size = 0;
+  for (int i = 0; i < chunks_num; ++i) {
+    chunks.push_back(std::make_unique<MappedFile>(GetChunkPath(i)));
+    uint64_t size = 0;
+    memcpy(&size, chunks.back()->data(), sizeof(size));
+    const T *begin =
+        reinterpret_cast<const T*>(chunks.back()->data() + sizeof(size));
+    const T *end = begin + size;
+    const T *range_begin = rank == 0 ? begin :
+        std::lower_bound(begin, end, splitters[rank - 1], key_less);
+    const T *range_end = rank == processes_num - 1 ? end :
+        std::lower_bound(range_begin, end, splitters[rank], key_less);
+    ranges.emplace_back(range_begin, range_end);
+    range_size += range_end - range_begin;
+    if constexpr (HasTextFormat<T>()) {
+      if (options.format == FileFormat::kText) {
+        for (const T *it = range_begin; it != range_end; ++it) {
+          range_text_size += TextSize(*it);
+        }
+      }
+    }
+  }
+
+  // Position of the range in the output file.
+  const bool text = options.format == FileFormat::kText;
+  const uint64_t header_size = text ? TextSize(n) : sizeof(uint64_t);
+  int64_t range_bytes = text ? range_text_size : range_size * sizeof(T);
+  int64_t range_offset = 0;
+  int64_t total_bytes = 0;
+  MPI_Exscan(&range_bytes, &range_offset, 1, MPI_INT64_T, MPI_SUM,
+             MPI_COMM_WORLD);
+  MPI_Allreduce(&range_bytes, &total_bytes, 1, MPI_INT64_T, MPI_SUM,
+                MPI_COMM_WORLD);
+  if (IsMasterProcess(rank)) {
+    // MPI_Exscan leaves the result on rank 0 undefined.
+    range_offset = 0;
+    {
+      ArrayWriter<T> out(GetOutputPath(options), options.format, n);
+      out.Flush();
+    }
+    if (truncate(GetOutputPath(options).c_str(),
+                 header_size + total_bytes) != 0) {
+      throw IoError("Failed to resize", GetOutputPath(options));
+    }
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  std::vector<RangeRun<T>*> runs;
+  for (auto& range : ranges) {
+    runs.push_back(&range);
+  }
+  BufferedWriter out(GetOutputPath(options), header_size + range_offset,
+                     kIoBufferSize);
+  MergeRuns<T>(runs, kMergeReadBufferBytes / sizeof(T),
+               kMergeOutputBatchBytes / sizeof(T),
+               [&out, text](const T *values, size_t size) {
+                 if constexpr (HasTextFormat<T>()) {
+                   if (text) {
+                     for (size_t i = 0; i < size; ++i) {
+                       out.WriteText(values[i], '\n');
+                     }
+                     return;
+                   }
+                 }
+                 out.Write(values, size * sizeof(T));
+               }, Compare(), KeyOf());
+  out.Flush();
+  std::cout << "Process #" << rank << " merged " << range_size
+            << " elements: total " << timer.elapsed_ms() << "ms." << std::endl;
+}
+
+template <typename T, typename Compare>
+void ExternalSort(const Options& options, int rank, int processes_num) {
+  using Key = typename RecordTraits<T>::Key;
+  Timer timer;
+  int64_t n = 0;
+  std::vector<Key> samples;
+  if (IsMasterProcess(rank)) {
+    printf("Sorting with %d processes...\n", (int)processes_num);
+    DistributeChunks<T>(options, processes_num, &n);
+  } else {
+    MPI_Bcast(&n, 1, MPI_INT64_T, 0, MPI_COMM_WORLD);
+    samples = SortChunks<T, Compare>(options, rank, processes_num, n);
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  const int chunks_num = GetChunksNum<T>(n);
+  if (options.merge_mode == MergeMode::kMaster) {
+    if (IsMasterProcess(rank)) {
+      MergeChunks<T, Compare>(options, chunks_num, n);
+    }
+  } else {
+    if (IsMasterProcess(rank)) {
+      std::cout << "Merging " << chunks_num << " chunks by "
+                << processes_num << " processes." << std::endl;
+    }
+    const std::vector<Key> splitters =
+        ChooseSplitters<Key, Compare>(samples, rank, processes_num);
+    MergeKeyRange<T, Compare>(options, rank, processes_num, chunks_num, n,
+                              splitters);
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+  if (IsMasterProcess(rank)) {
+    const long long elapsed_ms = std::max<long long>(timer.elapsed_ms(), 1);
+    std::cout << "Sorted " << n << " elements of " << sizeof(T)
+              << " bytes in " << elapsed_ms << "ms ("
+              << double(n) * sizeof(T) / 1e9 * 1000 / elapsed_ms << " GB/s)."
+              << std::endl;
+  }
+}
+
+template <typename T>
+void ExternalSort(const Options& options, int rank, int processes_num) {
+  using Key = typename RecordTraits<T>::Key;
+  if (options.descending) {
+    ExternalSort<T, std::greater<Key>>(options, rank, processes_num);
+  } else {
+    ExternalSort<T, std::less<Key>>(options, rank, processes_num);
+  }
+}
 
 int main(int argc, char ** argv) {
   int rank;
   int processes_num = 4;
-  Timer timer;
 
-  MPI_Init(&argc, &argv);
+  // Workers run sort and writer threads, but only the main thread calls MPI.
+  int thread_support;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
   MPI_Comm_size(MPI_COMM_WORLD, &processes_num);
 
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    if (IsMasterProcess(rank)) {
+      std::cerr << "Usage: " << argv[0]
+                << " [--format=text|binary] [--chunks-format=text|binary]"
+                << " [--merge=master|distributed]"
+                << " [--type=int32|int64|record]"
+                << " [--order=ascending|descending] [--stable]" << std::endl
+                << "Distributed merge requires binary chunks." << std::endl
+                << "Records are supported in binary format only."
+                << std::endl;
+    }
+    MPI_Finalize();
+    return -1;
+  }
+
+  if (thread_support < MPI_THREAD_FUNNELED) {
+    MPI_Finalize();
+    std::cerr << "MPI library does not support threads" << std::endl;
+    return -1;
+  }
+
   if (processes_num == 1) {
     MPI_Finalize();
     std::cerr << "Please use at least 2 processes" << std::endl;
     return -1;
   }
 
-  MPI_Barrier(MPI_COMM_WORLD);
-
-	if (IsMasterProcess(rank)) {
-		printf("Sorting with %d processes...\n", (int)processes_num);
-    std::vector<int> a(kChunkSize);
-    int n;
-    std::ifstream in("array.txt");
-    in >> n;
-    int cur_process_id = 1;
-    int cur_chunk_id = 0;
-    int params[2];
-    for (int i = 0; i < n; i += kChunkSize) {
-      int cur_size = std::min(n - i, kChunkSize);
-      params[0] = cur_size;
-      params[1] = cur_chunk_id;
-      for (int j = 0; j < cur_size; ++j) {
-        in >> a[j + 2];
-      }
-      MPI_Send(params, 2, MPI_INT, cur_process_id, 0, MPI_COMM_WORLD);
-      MPI_Send(&a[0], cur_size, MPI_INT, cur_process_id, 0, MPI_COMM_WORLD);
-      ++cur_chunk_id;
-      ++cur_process_id;
-      if (cur_process_id >= processes_num) {
-        cur_process_id = 1;
-      }
-    }
-    params[0] = -1;
-    for (int pid = 1; pid < processes_num; ++pid) {
-      MPI_Send(params, 2, MPI_INT, pid, 0, MPI_COMM_WORLD);
-    }
-    MPI_Barrier(MPI_COMM_WORLD);
-    MPI_Barrier(MPI_COMM_WORLD);
-    int chunks_num = cur_chunk_id;
-    std::cout << "Merging " << chunks_num << " chunks." << std::endl;
-    std::vector<std::ifstream> sorted_inputs;
-    std::vector<int> sorted_inputs_size;
-    std::ofstream out("sorted-array.txt");
-    out << n << std::endl;
-    std::set<std::pair<int, int>> min_elements;
-    for (int i = 0; i < chunks_num; ++i) {
-      sorted_inputs.push_back(std::ifstream("data/chunk-" + std::to_string(i)));
-      int tmp;
-      sorted_inputs[sorted_inputs.size() - 1] >> tmp;
-      sorted_inputs_size.push_back(tmp);
-      sorted_inputs[sorted_inputs.size() - 1] >> tmp;
-      min_elements.insert(std::make_pair(tmp, i));
-    }
-    for (int i = 0; i < n; ++i) {
-      auto min = *min_elements.begin();
-      min_elements.erase(min_elements.begin());
-      out << min.first << "\n";
-      --sorted_inputs_size[min.second];
-      if (sorted_inputs_size[min.second] > 0) {
-        sorted_inputs[min.second] >> min.first;
-        min_elements.insert(min);
-      }
-    }
+  if (options.key_type == KeyType::kRecord &&
+      (options.format == FileFormat::kText ||
+       options.chunks_format == FileFormat::kText)) {
     if (IsMasterProcess(rank)) {
-      timer.stop();
+      std::cerr << "Records are supported in binary format only" << std::endl;
     }
-  } else {
-    MPI_Status status;
-    int params[2];
-    std::vector<int> data(kChunkSize);
-    Timer timer;
-    timer.start();
-    MPI_Recv(params, 2, MPI_INT, 0, 0, MPI_COMM_WORLD, &status);
-    while (params[0] != -1) {
-      int cur_size = params[0];
-      MPI_Recv(&data[0], cur_size, MPI_INT, 0, 0, MPI_COMM_WORLD, &status);
-      std::sort(data.begin(), data.begin() + cur_size);
-      std::ofstream out("data/chunk-" + std::to_string(params[1]));
-      std::cout << "Process #" << rank << " sorted " << cur_size
-                << " elements.";
-      out << cur_size << std::endl;
-      for (int i = 0; i < cur_size; ++i) {
-        out << data[i] << " ";
-      }
-      out << std::endl;
-      timer.stop();
-      timer.start();
-      MPI_Recv(params, 2, MPI_INT, 0, 0, MPI_COMM_WORLD, &status);
-    }
-    MPI_Barrier(MPI_COMM_WORLD);
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Finalize();
+    return -1;
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  switch (options.key_type) {
+    case KeyType::kInt32:
+      ExternalSort<int32_t>(options, rank, processes_num);
+      break;
+    case KeyType::kInt64:
+      ExternalSort<int64_t>(options, rank, processes_num);
+      break;
+    case KeyType::kRecord:
+      ExternalSort<Record>(options, rank, processes_num);
+      break;
   }
 
   MPI_Finalize();
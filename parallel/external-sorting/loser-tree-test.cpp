@@ -0,0 +1,278 @@
+#include "loser-tree.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+// Sorted run held in memory.
+template <typename T>
+class VectorRun {
+ public:
+  explicit VectorRun(std::vector<T> data) : data_(std::move(data)) {}
+
+  size_t Read(T *values, size_t size) {
+    size = std::min(size, data_.size() - pos_);
+    std::copy(data_.begin() + pos_, data_.begin() + pos_ + size, values);
+    pos_ += size;
+    return size;
+  }
+
+  void Rewind() {
+    pos_ = 0;
+  }
+
+  const std::vector<T>& data() const {
+    return data_;
+  }
+
+ private:
+  std::vector<T> data_;
+  size_t pos_ = 0;
+};
+
+std::vector<VectorRun<int>> GenerateRuns(std::mt19937& gen, size_t runs_num,
+                                         size_t max_run_size, int max_value) {
+  std::uniform_int_distribution<size_t> size_dist(0, max_run_size);
+  std::uniform_int_distribution<int> value_dist(0, max_value);
+  std::vector<VectorRun<int>> runs;
+  for (size_t i = 0; i < runs_num; ++i) {
+    std::vector<int> data(size_dist(gen));
+    for (auto& x : data) {
+      x = value_dist(gen);
+    }
+    std::sort(data.begin(), data.end());
+    runs.emplace_back(std::move(data));
+  }
+  return runs;
+}
+
+template <typename T>
+std::vector<VectorRun<T>*> GetPointers(std::vector<VectorRun<T>>& runs) {
+  std::vector<VectorRun<T>*> res;
+  for (auto& run : runs) {
+    run.Rewind();
+    res.push_back(&run);
+  }
+  return res;
+}
+
+void TestMergeRuns() {
+  std::cout << "Testing k-way merge..." << std::flush;
+  std::mt19937 gen(42);
+  for (size_t runs_num : {0, 1, 2, 3, 5, 16, 17, 100}) {
+    for (size_t read_buffer_size : {1, 3, 64}) {
+      auto runs = GenerateRuns(gen, runs_num, 200, 1000);
+      std::vector<int> expected;
+      for (const auto& run : runs) {
+        expected.insert(expected.end(), run.data().begin(), run.data().end());
+      }
+      std::sort(expected.begin(), expected.end());
+      std::vector<int> res;
+      MergeRuns<int>(GetPointers(runs), read_buffer_size, 7,
+                     [&res](const int *values, size_t size) {
+                       assert(size <= 7);
+                       res.insert(res.end(), values, values + size);
+                     });
+      assert(res == expected);
+    }
+  }
+  std::cout << "ok!" << std::endl;
+}
+
+void TestStability() {
+  std::cout << "Testing stability..." << std::flush;
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int> key_dist(0, 5);
+  using Item = std::pair<int, int>;
+  std::vector<VectorRun<Item>> runs;
+  std::vector<Item> expected;
+  for (int run = 0; run < 13; ++run) {
+    std::vector<Item> data;
+    for (int i = 0; i < 50; ++i) {
+      data.emplace_back(key_dist(gen), run);
+    }
+    std::sort(data.begin(), data.end());
+    expected.insert(expected.end(), data.begin(), data.end());
+    runs.emplace_back(std::move(data));
+  }
+  auto by_key = [](const Item& a, const Item& b) { return a.first < b.first; };
+  std::stable_sort(expected.begin(), expected.end(), by_key);
+  std::vector<Item> res;
+  MergeRuns<Item>(GetPointers(runs), 4, 16,
+                  [&res](const Item *values, size_t size) {
+                    res.insert(res.end(), values, values + size);
+                  }, by_key);
+  assert(res == expected);
+
+  // Integer keys are packed with the run index, ties still go to the first
+  // run.
+  res.clear();
+  MergeRuns<Item>(GetPointers(runs), 4, 16,
+                  [&res](const Item *values, size_t size) {
+                    res.insert(res.end(), values, values + size);
+                  }, std::less<int>(), [](const Item& item) {
+                    return item.first;
+                  });
+  assert(res == expected);
+  std::cout << "ok!" << std::endl;
+}
+
+// Merges runs of random values of type T in the order of Compare.
+template <typename T, typename Compare>
+void TestKeyType() {
+  std::mt19937_64 gen(3);
+  std::vector<VectorRun<T>> runs;
+  std::vector<T> expected;
+  for (int run = 0; run < 9; ++run) {
+    std::vector<T> data(100);
+    for (auto& x : data) {
+      // Many duplicates and the extreme values.
+      x = gen() % 4 == 0 ? std::numeric_limits<T>::min()
+          : gen() % 4 == 0 ? std::numeric_limits<T>::max()
+                           : T(gen());
+    }
+    std::sort(data.begin(), data.end(), Compare());
+    expected.insert(expected.end(), data.begin(), data.end());
+    runs.emplace_back(std::move(data));
+  }
+  std::sort(expected.begin(), expected.end(), Compare());
+  std::vector<T> res;
+  MergeRuns<T>(GetPointers(runs), 5, 8,
+               [&res](const T *values, size_t size) {
+                 res.insert(res.end(), values, values + size);
+               }, Compare());
+  assert(res == expected);
+}
+
+void TestKeyTypes() {
+  std::cout << "Testing key types..." << std::flush;
+  TestKeyType<int8_t, std::less<int8_t>>();
+  TestKeyType<int32_t, std::less<int32_t>>();
+  TestKeyType<int32_t, std::greater<int32_t>>();
+  TestKeyType<uint32_t, std::less<uint32_t>>();
+  TestKeyType<int64_t, std::less<int64_t>>();
+  TestKeyType<int64_t, std::greater<int64_t>>();
+  TestKeyType<uint64_t, std::greater<uint64_t>>();
+  TestKeyType<double, std::less<double>>();
+  std::cout << "ok!" << std::endl;
+}
+
+void TestLoserTree() {
+  std::cout << "Testing loser tree..." << std::flush;
+  LoserTree<int> tree(5);
+  tree.Set(0, 3);
+  tree.Set(2, 1);
+  tree.Set(4, 1);
+  tree.Build();
+  assert(!tree.Empty() && tree.Top() == 2 && tree.TopKey() == 1);
+  tree.PopTop();
+  assert(tree.Top() == 4 && tree.TopKey() == 1);
+  tree.ReplaceTop(5);
+  assert(tree.Top() == 0 && tree.TopKey() == 3);
+  tree.PopTop();
+  assert(tree.Top() == 4 && tree.TopKey() == 5);
+  tree.PopTop();
+  assert(tree.Empty());
+  std::cout << "ok!" << std::endl;
+}
+
+template <typename Func>
+long long MeasureMs(const Func& func) {
+  auto start = std::chrono::high_resolution_clock::now();
+  func();
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      end - start).count();
+}
+
+void RunMergeBenchmark() {
+  constexpr size_t kElementsNum = 1 << 24;
+  constexpr size_t kReadBufferSize = 1 << 12;
+  constexpr size_t kOutputBatchSize = 1 << 12;
+  std::mt19937 gen(1);
+  std::cout << "Merging " << kElementsNum << " ints (loser tree / std::set / "
+            << "std::priority_queue):" << std::endl;
+  for (size_t runs_num = 2; runs_num <= 1024; runs_num *= 2) {
+    auto runs = GenerateRuns(gen, runs_num, 2 * kElementsNum / runs_num,
+                             1 << 30);
+    size_t total_size = 0;
+    for (const auto& run : runs) {
+      total_size += run.data().size();
+    }
+    std::vector<int> res(total_size);
+    size_t res_size = 0;
+    auto append = [&res, &res_size](const int *values, size_t size) {
+      std::copy(values, values + size, res.begin() + res_size);
+      res_size += size;
+    };
+
+    auto pointers = GetPointers(runs);
+    const long long loser_tree_time = MeasureMs([&]() {
+      MergeRuns<int>(pointers, kReadBufferSize, kOutputBatchSize, append);
+    });
+    assert(res_size == total_size && std::is_sorted(res.begin(), res.end()));
+
+    res_size = 0;
+    const long long set_time = MeasureMs([&]() {
+      std::vector<size_t> pos(runs_num, 0);
+      std::set<std::pair<int, size_t>> heads;
+      for (size_t i = 0; i < runs_num; ++i) {
+        if (!runs[i].data().empty()) {
+          heads.emplace(runs[i].data()[0], i);
+        }
+      }
+      while (!heads.empty()) {
+        auto head = *heads.begin();
+        heads.erase(heads.begin());
+        res[res_size++] = head.first;
+        const auto& data = runs[head.second].data();
+        if (++pos[head.second] < data.size()) {
+          heads.emplace(data[pos[head.second]], head.second);
+        }
+      }
+    });
+    assert(res_size == total_size && std::is_sorted(res.begin(), res.end()));
+
+    res_size = 0;
+    const long long heap_time = MeasureMs([&]() {
+      std::vector<size_t> pos(runs_num, 0);
+      using Head = std::pair<int, size_t>;
+      std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+      for (size_t i = 0; i < runs_num; ++i) {
+        if (!runs[i].data().empty()) {
+          heads.emplace(runs[i].data()[0], i);
+        }
+      }
+      while (!heads.empty()) {
+        auto head = heads.top();
+        heads.pop();
+        res[res_size++] = head.first;
+        const auto& data = runs[head.second].data();
+        if (++pos[head.second] < data.size()) {
+          heads.emplace(data[pos[head.second]], head.second);
+        }
+      }
+    });
+    assert(res_size == total_size && std::is_sorted(res.begin(), res.end()));
+
+    std::cout << "k = " << runs_num << ": " << loser_tree_time << "ms / "
+              << set_time << "ms / " << heap_time << "ms" << std::endl;
+  }
+}
+
+int main() {
+  TestLoserTree();
+  TestMergeRuns();
+  TestStability();
+  TestKeyTypes();
+  std::cout << "All tests passed! :)" << std::endl;
+  RunMergeBenchmark();
+  return 0;
+}
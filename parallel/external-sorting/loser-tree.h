@@ -0,0 +1,292 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace loser_tree_internal {
+
+// Entries of the tree: a key and the index of its source, ordered by the key
+// and then by the source, so that merging is stable. Sources which are
+// exhausted hold entries which are greater than all others.
+template <typename Key, typename Compare, typename Enable = void>
+struct Entries {
+  static constexpr uint32_t kExhaustedBit = uint32_t(1) << 31;
+  static constexpr size_t kMaxSourcesNum = kExhaustedBit;
+
+  struct Entry {
+    Key key;
+    uint32_t source;
+  };
+
+  static Entry Make(const Key& key, uint32_t source) {
+    return {key, source};
+  }
+
+  static Entry Exhausted(uint32_t source) {
+    return {Key(), source | kExhaustedBit};
+  }
+
+  static bool IsExhausted(const Entry& entry) {
+    return entry.source & kExhaustedBit;
+  }
+
+  static uint32_t GetSource(const Entry& entry) {
+    return entry.source & ~kExhaustedBit;
+  }
+
+  static const Key& GetKey(const Entry& entry) {
+    return entry.key;
+  }
+
+  static bool Less(const Entry& a, const Entry& b, const Compare& less) {
+    if ((a.source | b.source) & kExhaustedBit) {
+      return a.source < b.source;
+    }
+    if (less(a.key, b.key)) {
+      return true;
+    }
+    return a.source < b.source && !less(b.key, a.key);
+  }
+};
+
+template <typename Key, typename Compare>
+constexpr bool IsPackable() {
+  return std::is_integral<Key>::value && !std::is_same<Key, bool>::value &&
+         sizeof(Key) <= 8 &&
+         (std::is_same<Compare, std::less<Key>>::value ||
+          std::is_same<Compare, std::greater<Key>>::value);
+}
+
+// Integer keys ordered by std::less or std::greater are packed together with
+// the source into a single unsigned integer, so that every match is one
+// comparison without branches. All ones is the entry of exhausted sources.
+template <typename Key, typename Compare>
+struct Entries<Key, Compare,
+               typename std::enable_if<IsPackable<Key, Compare>()>::type> {
+  static constexpr size_t kMaxSourcesNum = UINT32_MAX;
+
+  using Unsigned = typename std::make_unsigned<Key>::type;
+  using Entry = typename std::conditional<sizeof(Key) <= 4, uint64_t,
+                                          unsigned __int128>::type;
+
+  // Maps keys to unsigned values in the same order.
+  static constexpr Unsigned kFlip =
+      (std::is_signed<Key>::value ? Unsigned(1) << (8 * sizeof(Key) - 1)
+                                  : Unsigned(0)) ^
+      (std::is_same<Compare, std::greater<Key>>::value ? Unsigned(~Unsigned(0))
+                                                       : Unsigned(0));
+
+  static Entry Make(Key key, uint32_t source) {
+    return Entry(Unsigned(Unsigned(key) ^ kFlip)) << 32 | source;
+  }
+
+  static Entry Exhausted(uint32_t) {
+    return ~Entry(0);
+  }
+
+  static bool IsExhausted(Entry entry) {
+    return entry == ~Entry(0);
+  }
+
+  static uint32_t GetSource(Entry entry) {
+    return uint32_t(entry);
+  }
+
+  static Key GetKey(Entry entry) {
+    return Key(Unsigned(Unsigned(entry >> 32) ^ kFlip));
+  }
+
+  static bool Less(Entry a, Entry b, const Compare&) {
+    return a < b;
+  }
+};
+
+// Key of elements which are their own keys.
+struct IdentityKey {
+  template <typename T>
+  const T& operator()(const T& value) const {
+    return value;
+  }
+};
+
+}  // namespace loser_tree_internal
+
+// Tournament tree of losers over k sources. Every internal node keeps the
+// entry which lost the match played at that node, node 0 keeps the overall
+// winner. Replacing the winner's key replays only the matches on the path from
+// its leaf to the root: log2(k) comparisons and no allocations. Entries keep
+// the keys themselves, so the path touches nothing but the tree.
+//
+// Ties are resolved in favour of the source with the smaller index, so merging
+// runs in their original order is stable.
+template <typename Key, typename Compare = std::less<Key>>
+class LoserTree {
+  using Entries = loser_tree_internal::Entries<Key, Compare>;
+  using Entry = typename Entries::Entry;
+
+ public:
+  explicit LoserTree(size_t sources_num, Compare less = Compare())
+      : sources_num_(sources_num), less_(less) {
+    assert(sources_num_ < Entries::kMaxSourcesNum);
+    leaves_num_ = 1;
+    while (leaves_num_ < sources_num_) {
+      leaves_num_ *= 2;
+    }
+    leaves_.resize(leaves_num_);
+    for (size_t i = 0; i < leaves_num_; ++i) {
+      leaves_[i] = Entries::Exhausted(i);
+    }
+    tree_.resize(leaves_num_);
+  }
+
+  // Sets the first key of |source|. Sources which were not set are considered
+  // empty. Must be followed by Build().
+  void Set(size_t source, const Key& key) {
+    leaves_[source] = Entries::Make(key, source);
+  }
+
+  void Build() {
+    std::vector<Entry> winners(2 * leaves_num_);
+    std::copy(leaves_.begin(), leaves_.end(), winners.begin() + leaves_num_);
+    for (size_t node = leaves_num_ - 1; node > 0; --node) {
+      Entry a = winners[2 * node];
+      Entry b = winners[2 * node + 1];
+      if (!Entries::Less(a, b, less_)) {
+        std::swap(a, b);
+      }
+      winners[node] = a;
+      tree_[node] = b;
+    }
+    tree_[0] = winners[1];
+  }
+
+  bool Empty() const {
+    return Entries::IsExhausted(tree_[0]);
+  }
+
+  // Index of the source holding the smallest key.
+  size_t Top() const {
+    return Entries::GetSource(tree_[0]);
+  }
+
+  Key TopKey() const {
+    return Entries::GetKey(tree_[0]);
+  }
+
+  // Replaces the smallest key with the next key of the same source.
+  void ReplaceTop(const Key& key) {
+    const size_t source = Top();
+    Replay(source, Entries::Make(key, source));
+  }
+
+  // Marks the source holding the smallest key as exhausted.
+  void PopTop() {
+    const size_t source = Top();
+    Replay(source, Entries::Exhausted(source));
+  }
+
+  size_t GetSourcesNum() const {
+    return sources_num_;
+  }
+
+ private:
+  void Replay(size_t source, Entry winner) {
+    for (size_t node = (leaves_num_ + source) / 2; node > 0; node /= 2) {
+      const Entry loser = tree_[node];
+      const bool loser_wins = Entries::Less(loser, winner, less_);
+      tree_[node] = loser_wins ? winner : loser;
+      winner = loser_wins ? loser : winner;
+    }
+    tree_[0] = winner;
+  }
+
+  size_t sources_num_;
+  size_t leaves_num_;
+  Compare less_;
+  // First entries of the sources until Build().
+  std::vector<Entry> leaves_;
+  // Entry which lost at every internal node, the winner at 0.
+  std::vector<Entry> tree_;
+};
+
+// Merges sorted |runs| into a single sorted sequence. Every run is read ahead
+// into its own buffer of |read_buffer_size| elements by run->Read(T*, size_t),
+// which returns the number of elements read and 0 at the end of the run. The
+// result is passed to output(const T*, size_t) in batches of
+// |output_batch_size| elements.
+//
+// Elements are ordered by |less| on their keys get_key(element), and the tree
+// keeps only the keys, so merging large records doesn't copy them around.
+template <typename T, typename Run, typename Output,
+          typename Compare = std::less<T>,
+          typename GetKey = loser_tree_internal::IdentityKey>
+void MergeRuns(const std::vector<Run*>& runs, size_t read_buffer_size,
+               size_t output_batch_size, Output output,
+               Compare less = Compare(), GetKey get_key = GetKey()) {
+  using Key = typename std::decay<decltype(get_key(std::declval<T>()))>::type;
+  read_buffer_size = std::max<size_t>(read_buffer_size, 1);
+  output_batch_size = std::max<size_t>(output_batch_size, 1);
+  const size_t runs_num = runs.size();
+  std::vector<T> buffers(runs_num * read_buffer_size);
+  // Position of the next element of every run in its buffer, the current one
+  // precedes it.
+  std::vector<size_t> pos(runs_num, 0);
+  std::vector<size_t> sizes(runs_num, 0);
+  LoserTree<Key, Compare> tree(runs_num, less);
+  for (size_t i = 0; i < runs_num; ++i) {
+    sizes[i] = runs[i]->Read(&buffers[i * read_buffer_size], read_buffer_size);
+    if (sizes[i] > 0) {
+      tree.Set(i, get_key(buffers[i * read_buffer_size]));
+      pos[i] = 1;
+    }
+  }
+  tree.Build();
+
+  std::vector<T> batch(output_batch_size);
+  size_t batch_size = 0;
+  while (!tree.Empty()) {
+    const size_t run = tree.Top();
+    T *buffer = &buffers[run * read_buffer_size];
+    batch[batch_size++] = buffer[pos[run] - 1];
+    if (batch_size == output_batch_size) {
+      output(batch.data(), batch_size);
+      batch_size = 0;
+    }
+    if (pos[run] == sizes[run]) {
+      sizes[run] = runs[run]->Read(buffer, read_buffer_size);
+      pos[run] = 0;
+      if (sizes[run] == 0) {
+        tree.PopTop();
+        continue;
+      }
+    }
+    tree.ReplaceTop(get_key(buffer[pos[run]++]));
+  }
+  if (batch_size > 0) {
+    output(batch.data(), batch_size);
+  }
+}
+
+// Sorted run stored in memory, e.g. a part of a memory mapped file.
+template <typename T>
+class RangeRun {
+ public:
+  RangeRun(const T *begin, const T *end) : begin_(begin), end_(end) {}
+
+  size_t Read(T *values, size_t size) {
+    size = std::min<size_t>(size, end_ - begin_);
+    std::copy(begin_, begin_ + size, values);
+    begin_ += size;
+    return size;
+  }
+
+ private:
+  const T *begin_;
+  const T *end_;
+};
@@ -0,0 +1,121 @@
+#include "records.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+std::vector<Record> GenerateRecords(size_t n, int max_key) {
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> key_dist(0, max_key);
+  std::vector<Record> records(n);
+  for (size_t i = 0; i < n; ++i) {
+    records[i].key = key_dist(gen);
+    memcpy(records[i].payload, &i, sizeof(i));
+  }
+  return records;
+}
+
+size_t GetIndex(const Record& record) {
+  size_t index;
+  memcpy(&index, record.payload, sizeof(index));
+  return index;
+}
+
+template <typename Compare>
+void CheckStableSortedRecords(const Record *records, size_t n) {
+  Compare less;
+  for (size_t i = 1; i < n; ++i) {
+    assert(!less(records[i].key, records[i - 1].key));
+    if (records[i].key == records[i - 1].key) {
+      assert(GetIndex(records[i - 1]) < GetIndex(records[i]));
+    }
+  }
+}
+
+void TestSortRecords() {
+  std::cout << "Testing sorting of records..." << std::flush;
+  for (size_t n : {0, 1, 2, 1000}) {
+    for (bool stable : {false, true}) {
+      std::vector<Record> records = GenerateRecords(n, 10);
+      std::vector<Record> buffer(n);
+      const Record *sorted = SortRecords(records.data(), buffer.data(), n,
+                                         stable, std::less<int64_t>());
+      std::vector<size_t> indices;
+      for (size_t i = 0; i < n; ++i) {
+        assert(i == 0 || sorted[i - 1].key <= sorted[i].key);
+        indices.push_back(GetIndex(sorted[i]));
+      }
+      std::sort(indices.begin(), indices.end());
+      for (size_t i = 0; i < n; ++i) {
+        assert(indices[i] == i);
+      }
+      if (stable) {
+        CheckStableSortedRecords<std::less<int64_t>>(sorted, n);
+      }
+    }
+  }
+  std::vector<Record> records = GenerateRecords(1000, 10);
+  std::vector<Record> buffer(records.size());
+  const Record *sorted = SortRecords(records.data(), buffer.data(),
+                                     records.size(), true,
+                                     std::greater<int64_t>());
+  CheckStableSortedRecords<std::greater<int64_t>>(sorted, records.size());
+  std::cout << "ok!" << std::endl;
+}
+
+void TestSortIntegers() {
+  std::cout << "Testing sorting of integers..." << std::flush;
+  std::mt19937 gen(7);
+  std::vector<int> values(1000);
+  for (auto& value : values) {
+    value = gen() % 100;
+  }
+  std::vector<int> expected = values;
+  std::sort(expected.begin(), expected.end(), std::greater<int>());
+  const int *sorted = SortRecords(values.data(), static_cast<int*>(nullptr),
+                                  values.size(), false, std::greater<int>());
+  assert(sorted == values.data());
+  assert(values == expected);
+  std::cout << "ok!" << std::endl;
+}
+
+void RunSortRecordsBenchmark() {
+  constexpr size_t kRecordsNum = 1 << 21;
+  for (bool stable : {false, true}) {
+    std::vector<Record> records = GenerateRecords(kRecordsNum, 1 << 30);
+    std::vector<Record> copy = records;
+    std::vector<Record> buffer(kRecordsNum);
+    auto start = std::chrono::high_resolution_clock::now();
+    if (stable) {
+      std::stable_sort(copy.begin(), copy.end());
+    } else {
+      std::sort(copy.begin(), copy.end());
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << (stable ? "Stable" : "Unstable") << " sort of "
+              << kRecordsNum << " records of " << sizeof(Record)
+              << " bytes: moving records "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     end - start).count() << "ms, ";
+    start = std::chrono::high_resolution_clock::now();
+    SortRecords(records.data(), buffer.data(), kRecordsNum, stable,
+                std::less<int64_t>());
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "sorting keys "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     end - start).count() << "ms" << std::endl;
+  }
+}
+
+int main() {
+  TestSortRecords();
+  TestSortIntegers();
+  std::cout << "All tests passed! :)" << std::endl;
+  RunSortRecordsBenchmark();
+  return 0;
+}
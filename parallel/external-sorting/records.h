@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Fixed-width record which is sorted by the |key| prefix and carries an opaque
+// |payload|.
+template <typename Key, size_t kPayloadSize>
+struct KeyedRecord {
+  using KeyType = Key;
+  static constexpr size_t kPayloadBytes = kPayloadSize;
+
+  Key key;
+  char payload[kPayloadSize];
+
+  bool operator<(const KeyedRecord& other) const {
+    return key < other.key;
+  }
+};
+
+// 64-byte record with a 64-bit key.
+using Record = KeyedRecord<int64_t, 56>;
+
+// Describes how to extract the sort key of an element. Integers are their own
+// keys.
+template <typename T>
+struct RecordTraits {
+  static_assert(std::is_integral<T>::value, "Unsupported record type");
+  using Key = T;
+
+  static const Key& GetKey(const T& value) {
+    return value;
+  }
+};
+
+template <typename K, size_t kPayloadSize>
+struct RecordTraits<KeyedRecord<K, kPayloadSize>> {
+  using Key = K;
+
+  static const Key& GetKey(const KeyedRecord<K, kPayloadSize>& record) {
+    return record.key;
+  }
+};
+
+// Returns the key of an element.
+struct KeyOf {
+  template <typename T>
+  const typename RecordTraits<T>::Key& operator()(const T& value) const {
+    return RecordTraits<T>::GetKey(value);
+  }
+};
+
+// Compares elements by their keys.
+template <typename T, typename Compare>
+struct KeyLess {
+  explicit KeyLess(Compare less = Compare()) : less(less) {}
+
+  bool operator()(const T& a, const T& b) const {
+    return less(RecordTraits<T>::GetKey(a), RecordTraits<T>::GetKey(b));
+  }
+
+  Compare less;
+};
+
+// Records larger than this are sorted by (key, index) pairs and then gathered,
+// so that every record is moved only once.
+constexpr size_t kMaxRecordSizeForDirectSort = 16;
+
+// Sorts |size| elements at |records| by their keys. Either |records| or
+// |buffer| (of the same size) receives the result; the returned pointer tells
+// which. If |stable| is set, elements with equal keys keep their order.
+// |size| must fit into 32 bits.
+template <typename T, typename Compare>
+T *SortRecords(T *records, T *buffer, size_t size, bool stable,
+               Compare less) {
+  if constexpr (sizeof(T) <= kMaxRecordSizeForDirectSort) {
+    const KeyLess<T, Compare> record_less(less);
+    if (stable) {
+      std::stable_sort(records, records + size, record_less);
+    } else {
+      std::sort(records, records + size, record_less);
+    }
+    return records;
+  }
+
+  using Key = typename RecordTraits<T>::Key;
+  std::vector<std::pair<Key, uint32_t>> keys(size);
+  for (size_t i = 0; i < size; ++i) {
+    keys[i] = std::make_pair(RecordTraits<T>::GetKey(records[i]),
+                             static_cast<uint32_t>(i));
+  }
+  if (stable) {
+    // Index breaks ties, so the order is fully determined.
+    std::sort(keys.begin(), keys.end(),
+              [&less](const std::pair<Key, uint32_t>& a,
+                      const std::pair<Key, uint32_t>& b) {
+                if (less(a.first, b.first)) {
+                  return true;
+                }
+                return !less(b.first, a.first) && a.second < b.second;
+              });
+  } else {
+    std::sort(keys.begin(), keys.end(),
+              [&less](const std::pair<Key, uint32_t>& a,
+                      const std::pair<Key, uint32_t>& b) {
+                return less(a.first, b.first);
+              });
+  }
+  for (size_t i = 0; i < size; ++i) {
+    buffer[i] = records[keys[i].second];
+  }
+  return buffer;
+}
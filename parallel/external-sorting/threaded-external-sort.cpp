@@ -0,0 +1,303 @@
+// Single-node external merge sort which uses threads instead of MPI processes.
+//
+// The input is split into runs which fit into the memory budget together with
+// the buffer of the parallel merge sort. Sorted runs are spilled to 'data/'
+// and merged by a loser tree. If there are more runs than the fan-in, they are
+// merged in several passes; independent merges of one pass run in parallel.
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../../misc/thread_pool.h"
+#include "../../sort/mergesort.h"
+#include "chunk-io.h"
+#include "loser-tree.h"
+#include "records.h"
+
+enum class KeyType {
+  kInt32,
+  kInt64,
+  kRecord,
+};
+
+struct Options {
+  KeyType key_type = KeyType::kInt32;
+  FileFormat format = FileFormat::kText;
+  size_t memory_bytes = size_t(1) << 30;
+  size_t threads_num = std::thread::hardware_concurrency();
+  size_t fan_in = 64;
+};
+
+// Readers of the runs need only a small buffer: read-ahead is done by
+// MergeRuns.
+constexpr size_t kRunReaderBufferSize = 1 << 12;
+constexpr size_t kMergeOutputBatchSize = 1 << 16;
+constexpr size_t kMinMergeReadBufferSize = 1 << 10;
+
+class Timer {
+ public:
+  Timer() : start_(std::chrono::high_resolution_clock::now()) {}
+
+  long long elapsed_ms() const {
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        end - start_).count();
+  }
+
+ private:
+  std::chrono::high_resolution_clock::time_point start_;
+};
+
+// Limits of the options: every thread and every merged run need buffers, and
+// runs need file descriptors as well.
+constexpr size_t kMaxThreadsNum = 1 << 10;
+constexpr size_t kMaxFanIn = 1 << 16;
+
+// Parses decimal |value| into |result| if it is at most |max_value|.
+// std::stoull accepts a leading '-' and wraps negative values around, so
+// only digits are allowed.
+bool ParseSize(const std::string& value, size_t max_value, size_t *result) {
+  if (value.empty() || !isdigit(static_cast<unsigned char>(value[0]))) {
+    return false;
+  }
+  size_t end_pos = 0;
+  const unsigned long long res = std::stoull(value, &end_pos);
+  if (end_pos != value.size() || res > max_value) {
+    return false;
+  }
+  *result = res;
+  return true;
+}
+
+bool ParseOptions(int argc, char **argv, Options *options) {
+  // std::stoull throws on invalid or out of range numbers.
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      const size_t eq_pos = arg.find('=');
+      const std::string name = arg.substr(0, eq_pos);
+      const std::string value =
+          eq_pos == std::string::npos ? "" : arg.substr(eq_pos + 1);
+      if (name == "--type") {
+        if (value == "int32") {
+          options->key_type = KeyType::kInt32;
+        } else if (value == "int64") {
+          options->key_type = KeyType::kInt64;
+        } else if (value == "record") {
+          options->key_type = KeyType::kRecord;
+        } else {
+          return false;
+        }
+      } else if (name == "--format") {
+        if (!ParseFileFormat(value, &options->format)) {
+          return false;
+        }
+      } else if (name == "--memory") {
+        size_t memory_mb;
+        if (!ParseSize(value, SIZE_MAX >> 20, &memory_mb)) {
+          return false;
+        }
+        options->memory_bytes = memory_mb << 20;
+      } else if (name == "--threads") {
+        if (!ParseSize(value, kMaxThreadsNum, &options->threads_num)) {
+          return false;
+        }
+      } else if (name == "--fan-in") {
+        if (!ParseSize(value, kMaxFanIn, &options->fan_in)) {
+          return false;
+        }
+      } else {
+        return false;
+      }
+    }
+  } catch (const std::invalid_argument&) {
+    return false;
+  } catch (const std::out_of_range&) {
+    return false;
+  }
+  return options->memory_bytes > 0 && options->fan_in >= 2;
+}
+
+std::string GetInputPath(const Options& options) {
+  return options.format == FileFormat::kText ? "array.txt" : "array.bin";
+}
+
+std::string GetOutputPath(const Options& options) {
+  return options.format == FileFormat::kText ? "sorted-array.txt" :
+                                               "sorted-array.bin";
+}
+
+std::string GetRunPath(int pass, size_t run_id) {
+  return "data/run-" + std::to_string(pass) + "-" + std::to_string(run_id);
+}
+
+// Splits the input into sorted runs of at most |memory_bytes| / 2 bytes.
+// Returns paths of the runs. Throws if the number of elements in the input
+// differs from its header.
+template <typename T>
+std::vector<std::string> GenerateRuns(const Options& options, ThreadPool& pool,
+                                      uint64_t *n) {
+  Timer timer;
+  ArrayReader<T> in(GetInputPath(options), options.format);
+  *n = in.size();
+  // At least one element is read even for an empty array, so that extra
+  // elements are noticed.
+  const size_t run_capacity = std::max<uint64_t>(
+      std::min<uint64_t>(options.memory_bytes / (2 * sizeof(T)), *n), 1);
+  std::vector<T> run(run_capacity);
+  std::vector<T> buffer(run_capacity);
+  std::vector<std::string> runs;
+  long long read_ms = 0;
+  long long sort_ms = 0;
+  long long write_ms = 0;
+  uint64_t read_num = 0;
+  while (true) {
+    Timer stage_timer;
+    const size_t size = in.Read(run.data(), run.size());
+    read_ms += stage_timer.elapsed_ms();
+    if (size == 0) {
+      break;
+    }
+    read_num += size;
+    stage_timer = Timer();
+    ParallelMergeSort(run.begin(), run.begin() + size, buffer.begin(), pool);
+    sort_ms += stage_timer.elapsed_ms();
+    stage_timer = Timer();
+    runs.push_back(GetRunPath(0, runs.size()));
+    ArrayWriter<T> out(runs.back(), FileFormat::kBinary, size);
+    out.Write(run.data(), size);
+    out.Flush();
+    write_ms += stage_timer.elapsed_ms();
+  }
+  if (read_num != *n) {
+    throw std::runtime_error("Input file has " + std::to_string(read_num) +
+                             " elements instead of " + std::to_string(*n));
+  }
+  std::cout << "Generated " << runs.size() << " runs: reading " << read_ms
+            << "ms, sorting " << sort_ms << "ms, writing " << write_ms
+            << "ms, total " << timer.elapsed_ms() << "ms." << std::endl;
+  return runs;
+}
+
+// Merges binary run files |inputs| into |output| and removes them.
+template <typename T>
+void MergeRunFiles(const std::vector<std::string>& inputs,
+                   const std::string& output, FileFormat format,
+                   size_t read_buffer_size) {
+  std::vector<std::unique_ptr<ArrayReader<T>>> readers;
+  std::vector<ArrayReader<T>*> runs;
+  uint64_t size = 0;
+  uint64_t max_run_size = 0;
+  for (const auto& input : inputs) {
+    readers.push_back(std::make_unique<ArrayReader<T>>(
+        input, FileFormat::kBinary, kRunReaderBufferSize));
+    runs.push_back(readers.back().get());
+    size += readers.back()->size();
+    max_run_size = std::max(max_run_size, readers.back()->size());
+  }
+  // Buffers larger than the runs would never be filled.
+  read_buffer_size = std::min<uint64_t>(read_buffer_size, max_run_size);
+  ArrayWriter<T> out(output, format, size);
+  MergeRuns<T>(runs, read_buffer_size, kMergeOutputBatchSize,
+               [&out](const T *values, size_t values_num) {
+                 out.Write(values, values_num);
+               }, std::less<typename RecordTraits<T>::Key>(), KeyOf());
+  out.Flush();
+  for (const auto& input : inputs) {
+    remove(input.c_str());
+  }
+}
+
+template <typename T>
+void ExternalSort(const Options& options) {
+  Timer timer;
+  ThreadPool pool(options.threads_num);
+  uint64_t n = 0;
+  std::vector<std::string> runs = GenerateRuns<T>(options, pool, &n);
+
+  int pass = 0;
+  while (runs.size() > options.fan_in) {
+    Timer pass_timer;
+    ++pass;
+    const size_t groups_num =
+        (runs.size() + options.fan_in - 1) / options.fan_in;
+    // Every merge gets an equal share of the memory for its read buffers.
+    const size_t parallel_merges_num =
+        std::min(groups_num, pool.GetThreadsNum());
+    const size_t read_buffer_size = std::max(
+        options.memory_bytes / sizeof(T) /
+            (parallel_merges_num * (options.fan_in + 1)),
+        kMinMergeReadBufferSize);
+    std::vector<std::string> next_runs(groups_num);
+    ParallelFor(pool, 0, groups_num, 1,
+                [&](size_t groups_begin, size_t groups_end) {
+      for (size_t i = groups_begin; i < groups_end; ++i) {
+        const size_t runs_begin = i * options.fan_in;
+        const size_t runs_end =
+            std::min(runs_begin + options.fan_in, runs.size());
+        std::vector<std::string> inputs(runs.begin() + runs_begin,
+                                        runs.begin() + runs_end);
+        next_runs[i] = GetRunPath(pass, i);
+        MergeRunFiles<T>(inputs, next_runs[i], FileFormat::kBinary,
+                         read_buffer_size);
+      }
+    });
+    std::cout << "Pass " << pass << ": merged " << runs.size()
+              << " runs into " << groups_num << " in "
+              << pass_timer.elapsed_ms() << "ms." << std::endl;
+    runs = std::move(next_runs);
+  }
+
+  Timer merge_timer;
+  const size_t read_buffer_size = std::max(
+      options.memory_bytes / sizeof(T) / (runs.size() + 1),
+      kMinMergeReadBufferSize);
+  MergeRunFiles<T>(runs, GetOutputPath(options), options.format,
+                   read_buffer_size);
+  std::cout << "Final merge of " << runs.size() << " runs: "
+            << merge_timer.elapsed_ms() << "ms." << std::endl;
+
+  const long long elapsed_ms = timer.elapsed_ms();
+  std::cout << "Sorted " << n << " elements of " << sizeof(T) << " bytes in "
+            << elapsed_ms << "ms ("
+            << double(n) * sizeof(T) / (1 << 20) * 1000 /
+                   std::max<long long>(elapsed_ms, 1)
+            << " MB/s)." << std::endl;
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--type=int32|int64|record] [--format=text|binary]"
+              << " [--memory=MB] [--threads=N] [--fan-in=K]" << std::endl
+              << "Records are supported in binary format only." << std::endl;
+    return -1;
+  }
+  try {
+    switch (options.key_type) {
+      case KeyType::kInt32:
+        ExternalSort<int32_t>(options);
+        break;
+      case KeyType::kInt64:
+        ExternalSort<int64_t>(options);
+        break;
+      case KeyType::kRecord:
+        ExternalSort<Record>(options);
+        break;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,715 @@
+// Distributed in-place Gauss-Jordan inversion with partial pivoting on a 2D
+// block-cyclic distribution.
+//
+// Processes form a grid of |rows| x |cols|, and the block (I, J) of the matrix
+// is stored by the process (I % rows, J % cols), as in ScaLAPACK. At step k
+// the process column owning the block column k factorizes it as a panel. The
+// panel is broadcast along the process rows and the pivot block row k along
+// the process columns, after which every process updates its part of the
+// matrix by a single local matrix product. With look-ahead the owners of the
+// next panel update and factorize it first and broadcast it while updating
+// the rest of their blocks, so that the factorization is hidden behind the
+// updates of the other processes.
+//
+// Reads 'matrix.txt' and writes 'inversed-matrix.txt' like inversion.py.
+
+#include <mpi.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../../misc/blob_matrix2d.h"
+#include "../../misc/blob_matrix2d_kernels.h"
+#include "../../misc/thread_pool.h"
+#include "matrix-io.h"
+
+class Timer {
+ public:
+  Timer() : start_(std::chrono::high_resolution_clock::now()) {}
+
+  long long elapsed_ms() const {
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        end - start_).count();
+  }
+
+  long long elapsed_us() const {
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        end - start_).count();
+  }
+
+ private:
+  std::chrono::high_resolution_clock::time_point start_;
+};
+
+struct Options {
+  // Process grid; chosen as square as possible if not set.
+  int grid_rows = 0;
+  int grid_cols = 0;
+  size_t block_size = 64;
+  size_t threads_num = 1;
+  bool look_ahead = true;
+};
+
+// Local trailing updates are split into chunks of this many columns, between
+// which pending broadcasts are progressed.
+constexpr size_t kUpdateChunkCols = 512;
+
+constexpr int kRowSwapTag = 1;
+constexpr int kColSwapTag = 2;
+constexpr int kScatterTag = 3;
+constexpr int kGatherTag = 4;
+
+// Block-cyclic distribution of |n| indices in blocks of |block_size| among
+// |procs_num| processes, viewed from the process |proc|.
+class CyclicDistribution {
+ public:
+  CyclicDistribution(size_t n, size_t block_size, int procs_num, int proc)
+      : block_size_(block_size), procs_num_(procs_num), proc_(proc) {
+    const size_t blocks_num = (n + block_size - 1) / block_size;
+    local_size_ = 0;
+    for (size_t block = proc; block < blocks_num; block += procs_num) {
+      local_size_ += std::min(block_size, n - block * block_size);
+    }
+  }
+
+  int Owner(size_t global) const {
+    return global / block_size_ % procs_num_;
+  }
+
+  // Local index of the |global| index which is owned by Owner(global).
+  size_t ToLocal(size_t global) const {
+    return global / block_size_ / procs_num_ * block_size_ +
+           global % block_size_;
+  }
+
+  size_t ToGlobal(size_t local) const {
+    return (local / block_size_ * procs_num_ + proc_) * block_size_ +
+           local % block_size_;
+  }
+
+  // Number of local indices whose global indices are less than |global|.
+  size_t LocalBegin(size_t global) const {
+    const size_t block = global / block_size_;
+    const size_t full_blocks = block / procs_num_;
+    size_t begin = full_blocks * block_size_;
+    const int owner = block % procs_num_;
+    if (owner > proc_) {
+      begin += block_size_;
+    } else if (owner == proc_) {
+      begin += global % block_size_;
+    }
+    return std::min(begin, local_size_);
+  }
+
+  size_t local_size() const {
+    return local_size_;
+  }
+
+ private:
+  size_t block_size_;
+  int procs_num_;
+  int proc_;
+  size_t local_size_;
+};
+
+class BlockCyclicInverter {
+ public:
+  BlockCyclicInverter(size_t n, const Options& options, int grid_row,
+                      int grid_col, MPI_Comm row_comm, MPI_Comm col_comm)
+      : n_(n), block_size_(options.block_size), look_ahead_(options.look_ahead),
+        grid_row_(grid_row), grid_col_(grid_col), row_comm_(row_comm),
+        col_comm_(col_comm),
+        rows_(n, options.block_size, options.grid_rows, grid_row),
+        cols_(n, options.block_size, options.grid_cols, grid_col),
+        data_(rows_.local_size() * cols_.local_size()),
+        local_(data_.data(), rows_.local_size(), cols_.local_size()),
+        pool_(options.threads_num), pivots_(n) {}
+
+  BlobMatrix2D<double>& local() {
+    return local_;
+  }
+
+  // Replaces the local part of the matrix by the local part of its inverse.
+  // Returns false on all processes if the matrix is singular.
+  bool Invert() {
+    const size_t steps_num = (n_ + block_size_ - 1) / block_size_;
+    Panel panel;
+    StartPanel(0, &panel);
+    for (size_t step = 0; step < steps_num; ++step) {
+      Timer wait_timer;
+      MPI_Waitall(2, panel.requests, MPI_STATUSES_IGNORE);
+      wait_us_ += wait_timer.elapsed_us();
+      if (panel.pivots.back() != 0) {
+        return false;
+      }
+      const size_t begin = step * block_size_;
+      const size_t size = panel.pivots.size() - 1;
+      std::copy(panel.pivots.begin(), panel.pivots.end() - 1,
+                pivots_.begin() + begin);
+      Timer swap_timer;
+      ApplyRowSwaps(begin, size);
+      swap_us_ += swap_timer.elapsed_us();
+
+      std::vector<double> pivot_rows = BroadcastPivotRows(begin, size);
+      // Rows of the pivot block must become A11^-1 * R instead of
+      // R + A11^-1 * R, so the identity is subtracted from their multipliers.
+      if (rows_.Owner(begin) == grid_row_) {
+        const size_t local_begin = rows_.ToLocal(begin);
+        for (size_t i = 0; i < size; ++i) {
+          panel.values[(local_begin + i) * size + i] -= 1.0;
+        }
+      }
+      const BlobMatrix2D<double> multipliers(panel.values.data(),
+                                             rows_.local_size(), size);
+      const BlobMatrix2D<double> pivot_block(pivot_rows.data(), size,
+                                             cols_.local_size());
+
+      Panel next_panel;
+      const size_t next_begin = begin + size;
+      size_t skip_begin = 0;
+      size_t skip_end = 0;
+      if (step + 1 < steps_num && look_ahead_ &&
+          cols_.Owner(next_begin) == grid_col_) {
+        skip_begin = cols_.ToLocal(next_begin);
+        skip_end = skip_begin + std::min(block_size_, n_ - next_begin);
+        Timer update_timer;
+        Update(multipliers, pivot_block, skip_begin, skip_end);
+        update_us_ += update_timer.elapsed_us();
+        StartPanel(step + 1, &next_panel);
+      }
+      Timer update_timer;
+      Update(multipliers, pivot_block, 0, skip_begin, &next_panel);
+      Update(multipliers, pivot_block, skip_end, cols_.local_size(),
+             &next_panel);
+      update_us_ += update_timer.elapsed_us();
+      if (step + 1 < steps_num && skip_begin == skip_end) {
+        StartPanel(step + 1, &next_panel);
+      }
+      panel = std::move(next_panel);
+    }
+    Timer swap_timer;
+    ApplyColumnSwaps();
+    swap_us_ += swap_timer.elapsed_us();
+    return true;
+  }
+
+  long long panel_ms() const {
+    return panel_us_ / 1000;
+  }
+
+  long long update_ms() const {
+    return update_us_ / 1000;
+  }
+
+  long long swap_ms() const {
+    return swap_us_ / 1000;
+  }
+
+  long long wait_ms() const {
+    return wait_us_ / 1000;
+  }
+
+ private:
+  // Factorized panel: local rows of the multipliers for the trailing update
+  // and the pivots followed by the singularity flag.
+  struct Panel {
+    Panel() {
+      requests[0] = requests[1] = MPI_REQUEST_NULL;
+    }
+
+    Panel(Panel&& other) {
+      *this = std::move(other);
+    }
+
+    Panel& operator=(Panel&& other) {
+      values = std::move(other.values);
+      pivots = std::move(other.pivots);
+      // Non-blocking broadcasts keep the pointers to the buffers, which
+      // remain valid after moving the vectors.
+      requests[0] = other.requests[0];
+      requests[1] = other.requests[1];
+      other.requests[0] = other.requests[1] = MPI_REQUEST_NULL;
+      return *this;
+    }
+
+    std::vector<double> values;
+    std::vector<int> pivots;
+    MPI_Request requests[2];
+  };
+
+  // Factorizes the panel of the |step| if this process owns it and starts
+  // its broadcast along the process row.
+  void StartPanel(size_t step, Panel *panel) {
+    const size_t begin = step * block_size_;
+    const size_t size = std::min(block_size_, n_ - begin);
+    const int owner = cols_.Owner(begin);
+    panel->values.resize(rows_.local_size() * size);
+    panel->pivots.assign(size + 1, 0);
+    if (owner == grid_col_) {
+      Timer timer;
+      const size_t local_begin = cols_.ToLocal(begin);
+      if (!FactorizePanel(begin, local_begin, size, &panel->pivots)) {
+        panel->pivots.back() = 1;
+      }
+      for (size_t i = 0; i < rows_.local_size(); ++i) {
+        std::copy(local_.Row(i) + local_begin,
+                  local_.Row(i) + local_begin + size,
+                  panel->values.data() + i * size);
+      }
+      panel_us_ += timer.elapsed_us();
+    }
+    MPI_Ibcast(panel->pivots.data(), panel->pivots.size(), MPI_INT, owner,
+               row_comm_, &panel->requests[0]);
+    MPI_Ibcast(panel->values.data(), panel->values.size(), MPI_DOUBLE, owner,
+               row_comm_, &panel->requests[1]);
+  }
+
+  // Unblocked Gauss-Jordan elimination restricted to the |size| columns of
+  // the panel starting at the global column |begin|. Turns the panel
+  // [A01; A11; A21] into [-A01 * A11^-1; A11^-1; -A21 * A11^-1] with rows
+  // swapped within the panel only. Called by the whole process column.
+  bool FactorizePanel(size_t begin, size_t local_begin, size_t size,
+                      std::vector<int> *pivots) {
+    std::vector<double> pivot_row(size);
+    for (size_t jj = 0; jj < size; ++jj) {
+      const size_t j = begin + jj;
+      const size_t col = local_begin + jj;
+      struct {
+        double value;
+        int row;
+      } candidate = {-1.0, 0}, pivot;
+      for (size_t i = rows_.LocalBegin(j); i < rows_.local_size(); ++i) {
+        const double value = std::abs(local_(i, col));
+        if (value > candidate.value) {
+          candidate.value = value;
+          candidate.row = rows_.ToGlobal(i);
+        }
+      }
+      MPI_Allreduce(&candidate, &pivot, 1, MPI_DOUBLE_INT, MPI_MAXLOC,
+                    col_comm_);
+      if (pivot.value == 0.0) {
+        return false;
+      }
+      (*pivots)[jj] = pivot.row;
+      SwapRows(j, pivot.row, {{local_begin, local_begin + size}});
+
+      const int pivot_owner = rows_.Owner(j);
+      if (pivot_owner == grid_row_) {
+        const double *row = local_.Row(rows_.ToLocal(j)) + local_begin;
+        std::copy(row, row + size, pivot_row.begin());
+      }
+      MPI_Bcast(pivot_row.data(), size, MPI_DOUBLE, pivot_owner, col_comm_);
+      const double inverse_pivot = 1.0 / pivot_row[jj];
+      for (double& value : pivot_row) {
+        value *= inverse_pivot;
+      }
+      pivot_row[jj] = inverse_pivot;
+      for (size_t i = 0; i < rows_.local_size(); ++i) {
+        double *row = local_.Row(i) + local_begin;
+        if (rows_.ToGlobal(i) == j) {
+          std::copy(pivot_row.begin(), pivot_row.end(), row);
+          continue;
+        }
+        const double multiplier = row[jj];
+        row[jj] = 0.0;
+        for (size_t c = 0; c < size; ++c) {
+          row[c] -= multiplier * pivot_row[c];
+        }
+      }
+    }
+    return true;
+  }
+
+  // Swaps the parts of global rows |a| and |b| in local column |ranges|
+  // between the process rows.
+  void SwapRows(size_t a, size_t b,
+                const std::vector<std::pair<size_t, size_t>>& ranges) {
+    if (a == b) {
+      return;
+    }
+    const int a_owner = rows_.Owner(a);
+    const int b_owner = rows_.Owner(b);
+    if (a_owner == b_owner) {
+      if (a_owner == grid_row_) {
+        double *a_row = local_.Row(rows_.ToLocal(a));
+        double *b_row = local_.Row(rows_.ToLocal(b));
+        for (const auto& range : ranges) {
+          std::swap_ranges(a_row + range.first, a_row + range.second,
+                           b_row + range.first);
+        }
+      }
+      return;
+    }
+    int peer;
+    size_t row;
+    if (a_owner == grid_row_) {
+      peer = b_owner;
+      row = a;
+    } else if (b_owner == grid_row_) {
+      peer = a_owner;
+      row = b;
+    } else {
+      return;
+    }
+    double *local_row = local_.Row(rows_.ToLocal(row));
+    swap_buffer_.clear();
+    for (const auto& range : ranges) {
+      swap_buffer_.insert(swap_buffer_.end(), local_row + range.first,
+                          local_row + range.second);
+    }
+    MPI_Sendrecv_replace(swap_buffer_.data(), swap_buffer_.size(), MPI_DOUBLE,
+                         peer, kRowSwapTag, peer, kRowSwapTag, col_comm_,
+                         MPI_STATUS_IGNORE);
+    const double *value = swap_buffer_.data();
+    for (const auto& range : ranges) {
+      std::copy(value, value + range.second - range.first,
+                local_row + range.first);
+      value += range.second - range.first;
+    }
+  }
+
+  // Applies the row swaps of the panel to the columns outside of it.
+  void ApplyRowSwaps(size_t begin, size_t size) {
+    std::vector<std::pair<size_t, size_t>> ranges;
+    if (cols_.Owner(begin) == grid_col_) {
+      const size_t local_begin = cols_.ToLocal(begin);
+      ranges = {{0, local_begin}, {local_begin + size, cols_.local_size()}};
+    } else {
+      ranges = {{0, cols_.local_size()}};
+    }
+    for (size_t j = begin; j < begin + size; ++j) {
+      SwapRows(j, pivots_[j], ranges);
+    }
+  }
+
+  // Broadcasts the local columns of the pivot block row along the process
+  // column. Columns of the panel are zeroed, so that the update keeps them.
+  std::vector<double> BroadcastPivotRows(size_t begin, size_t size) {
+    std::vector<double> pivot_rows(size * cols_.local_size());
+    const int owner = rows_.Owner(begin);
+    if (owner == grid_row_) {
+      const size_t local_begin = rows_.ToLocal(begin);
+      for (size_t i = 0; i < size; ++i) {
+        std::copy(local_.Row(local_begin + i),
+                  local_.Row(local_begin + i) + cols_.local_size(),
+                  pivot_rows.data() + i * cols_.local_size());
+      }
+      if (cols_.Owner(begin) == grid_col_) {
+        const size_t panel_begin = cols_.ToLocal(begin);
+        for (size_t i = 0; i < size; ++i) {
+          double *row = pivot_rows.data() + i * cols_.local_size();
+          std::fill(row + panel_begin, row + panel_begin + size, 0.0);
+        }
+      }
+    }
+    Timer timer;
+    MPI_Bcast(pivot_rows.data(), pivot_rows.size(), MPI_DOUBLE, owner,
+              col_comm_);
+    wait_us_ += timer.elapsed_us();
+    return pivot_rows;
+  }
+
+  // Local columns [|begin|; |end|) += multipliers * pivot_block. Progresses
+  // the broadcast of |pending| between chunks.
+  void Update(const BlobMatrix2D<double>& multipliers,
+              const BlobMatrix2D<double>& pivot_block, size_t begin,
+              size_t end, Panel *pending = nullptr) {
+    for (size_t chunk_begin = begin; chunk_begin < end;
+         chunk_begin += kUpdateChunkCols) {
+      const size_t chunk_size = std::min(kUpdateChunkCols, end - chunk_begin);
+      const BlobMatrix2D<double> b = pivot_block.Block(
+          0, chunk_begin, pivot_block.rows(), chunk_size);
+      BlobMatrix2D<double> c = local_.Block(0, chunk_begin, local_.rows(),
+                                            chunk_size);
+      Gemm(1.0, multipliers, b, c, pool_);
+      if (pending != nullptr) {
+        int done;
+        MPI_Testall(2, pending->requests, &done, MPI_STATUSES_IGNORE);
+      }
+    }
+  }
+
+  // In-place Gauss-Jordan elimination yields the inverse with columns
+  // permuted by the row swaps, which are undone in reverse order.
+  void ApplyColumnSwaps() {
+    std::vector<double> column(rows_.local_size());
+    for (size_t j = n_; j-- > 0;) {
+      const size_t p = pivots_[j];
+      if (p == j) {
+        continue;
+      }
+      const int j_owner = cols_.Owner(j);
+      const int p_owner = cols_.Owner(p);
+      if (j_owner == p_owner) {
+        if (j_owner == grid_col_) {
+          const size_t local_j = cols_.ToLocal(j);
+          const size_t local_p = cols_.ToLocal(p);
+          for (size_t i = 0; i < rows_.local_size(); ++i) {
+            std::swap(local_(i, local_j), local_(i, local_p));
+          }
+        }
+        continue;
+      }
+      int peer;
+      size_t col;
+      if (j_owner == grid_col_) {
+        peer = p_owner;
+        col = cols_.ToLocal(j);
+      } else if (p_owner == grid_col_) {
+        peer = j_owner;
+        col = cols_.ToLocal(p);
+      } else {
+        continue;
+      }
+      for (size_t i = 0; i < rows_.local_size(); ++i) {
+        column[i] = local_(i, col);
+      }
+      MPI_Sendrecv_replace(column.data(), column.size(), MPI_DOUBLE, peer,
+                           kColSwapTag, peer, kColSwapTag, row_comm_,
+                           MPI_STATUS_IGNORE);
+      for (size_t i = 0; i < rows_.local_size(); ++i) {
+        local_(i, col) = column[i];
+      }
+    }
+  }
+
+  size_t n_;
+  size_t block_size_;
+  bool look_ahead_;
+  int grid_row_;
+  int grid_col_;
+  MPI_Comm row_comm_;
+  MPI_Comm col_comm_;
+  CyclicDistribution rows_;
+  CyclicDistribution cols_;
+  std::vector<double> data_;
+  BlobMatrix2D<double> local_;
+  ThreadPool pool_;
+  // Global row swapped with row j at step j.
+  std::vector<size_t> pivots_;
+  std::vector<double> swap_buffer_;
+  long long panel_us_ = 0;
+  long long update_us_ = 0;
+  long long swap_us_ = 0;
+  long long wait_us_ = 0;
+};
+
+bool ParseOptions(int argc, char **argv, Options *options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t eq_pos = arg.find('=');
+    const std::string name = arg.substr(0, eq_pos);
+    const std::string value =
+        eq_pos == std::string::npos ? "" : arg.substr(eq_pos + 1);
+    if (name == "--grid") {
+      const size_t x_pos = value.find('x');
+      if (x_pos == std::string::npos) {
+        return false;
+      }
+      options->grid_rows = std::stoi(value.substr(0, x_pos));
+      options->grid_cols = std::stoi(value.substr(x_pos + 1));
+    } else if (name == "--block") {
+      options->block_size = std::stoull(value);
+    } else if (name == "--threads") {
+      options->threads_num = std::stoull(value);
+    } else if (name == "--look-ahead") {
+      if (value != "0" && value != "1") {
+        return false;
+      }
+      options->look_ahead = value == "1";
+    } else {
+      return false;
+    }
+  }
+  return options->block_size > 0;
+}
+
+// Most square grid with rows <= cols.
+void ChooseGrid(int procs_num, Options *options) {
+  int rows = 1;
+  for (int i = 1; i * i <= procs_num; ++i) {
+    if (procs_num % i == 0) {
+      rows = i;
+    }
+  }
+  options->grid_rows = rows;
+  options->grid_cols = procs_num / rows;
+}
+
+// Sends every process its local part of |matrix| from rank 0.
+void ScatterMatrix(const std::vector<double>& matrix, size_t n,
+                   const Options& options, BlockCyclicInverter *inverter) {
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  BlobMatrix2D<double>& local = inverter->local();
+  if (rank != 0) {
+    MPI_Recv(local.data(), local.rows() * local.cols(), MPI_DOUBLE, 0,
+             kScatterTag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    return;
+  }
+  const BlobMatrix2D<double> global(const_cast<double*>(matrix.data()), n, n);
+  std::vector<double> buffer;
+  for (int dest = 0; dest < options.grid_rows * options.grid_cols; ++dest) {
+    const CyclicDistribution rows(n, options.block_size, options.grid_rows,
+                                  dest / options.grid_cols);
+    const CyclicDistribution cols(n, options.block_size, options.grid_cols,
+                                  dest % options.grid_cols);
+    buffer.resize(rows.local_size() * cols.local_size());
+    for (size_t i = 0; i < rows.local_size(); ++i) {
+      for (size_t j = 0; j < cols.local_size(); ++j) {
+        buffer[i * cols.local_size() + j] =
+            global(rows.ToGlobal(i), cols.ToGlobal(j));
+      }
+    }
+    if (dest == 0) {
+      std::copy(buffer.begin(), buffer.end(),
+                static_cast<double*>(local.data()));
+    } else {
+      MPI_Send(buffer.data(), buffer.size(), MPI_DOUBLE, dest, kScatterTag,
+               MPI_COMM_WORLD);
+    }
+  }
+}
+
+// Collects the local parts into |matrix| on rank 0.
+void GatherMatrix(BlockCyclicInverter& inverter, size_t n,
+                  const Options& options, std::vector<double> *matrix) {
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  BlobMatrix2D<double>& local = inverter.local();
+  if (rank != 0) {
+    MPI_Send(local.data(), local.rows() * local.cols(), MPI_DOUBLE, 0,
+             kGatherTag, MPI_COMM_WORLD);
+    return;
+  }
+  matrix->resize(n * n);
+  BlobMatrix2D<double> global(matrix->data(), n, n);
+  std::vector<double> buffer;
+  for (int source = 0; source < options.grid_rows * options.grid_cols;
+       ++source) {
+    const CyclicDistribution rows(n, options.block_size, options.grid_rows,
+                                  source / options.grid_cols);
+    const CyclicDistribution cols(n, options.block_size, options.grid_cols,
+                                  source % options.grid_cols);
+    buffer.resize(rows.local_size() * cols.local_size());
+    if (source == 0) {
+      const double *data = static_cast<const double*>(local.data());
+      std::copy(data, data + buffer.size(), buffer.begin());
+    } else {
+      MPI_Recv(buffer.data(), buffer.size(), MPI_DOUBLE, source, kGatherTag,
+               MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+    for (size_t i = 0; i < rows.local_size(); ++i) {
+      for (size_t j = 0; j < cols.local_size(); ++j) {
+        global(rows.ToGlobal(i), cols.ToGlobal(j)) =
+            buffer[i * cols.local_size() + j];
+      }
+    }
+  }
+}
+
+int Run(const Options& options, int rank) {
+  unsigned long long n = 0;
+  std::vector<double> matrix;
+  if (rank == 0) {
+    size_t size;
+    if (!ReadMatrix("matrix.txt", &size, &matrix)) {
+      std::cerr << "Failed to read 'matrix.txt'" << std::endl;
+    } else {
+      n = size;
+    }
+  }
+  MPI_Bcast(&n, 1, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+  if (n == 0) {
+    return -1;
+  }
+
+  const int grid_row = rank / options.grid_cols;
+  const int grid_col = rank % options.grid_cols;
+  MPI_Comm row_comm;
+  MPI_Comm col_comm;
+  MPI_Comm_split(MPI_COMM_WORLD, grid_row, grid_col, &row_comm);
+  MPI_Comm_split(MPI_COMM_WORLD, grid_col, grid_row, &col_comm);
+  BlockCyclicInverter inverter(n, options, grid_row, grid_col, row_comm,
+                               col_comm);
+  ScatterMatrix(matrix, n, options, &inverter);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  Timer timer;
+  const bool inverted = inverter.Invert();
+  const long long elapsed_ms = timer.elapsed_ms();
+  long long max_wait_ms;
+  const long long wait_ms = inverter.wait_ms();
+  MPI_Reduce(&wait_ms, &max_wait_ms, 1, MPI_LONG_LONG, MPI_MAX, 0,
+             MPI_COMM_WORLD);
+
+  int result = 0;
+  if (!inverted) {
+    if (rank == 0) {
+      std::cerr << "Matrix is singular" << std::endl;
+    }
+    result = -1;
+  } else {
+    GatherMatrix(inverter, n, options, &matrix);
+    if (rank == 0) {
+      // In-place Gauss-Jordan inversion takes 2 n^3 flops.
+      std::cout << "Inverted " << n << "x" << n << " matrix on "
+                << options.grid_rows << "x" << options.grid_cols
+                << " grid in " << elapsed_ms << "ms ("
+                << 2.0 * n * n * n / 1e6 / std::max<long long>(elapsed_ms, 1)
+                << " GFLOP/s): panels " << inverter.panel_ms()
+                << "ms, updates " << inverter.update_ms() << "ms, swaps "
+                << inverter.swap_ms() << "ms, max waiting " << max_wait_ms
+                << "ms." << std::endl;
+      const BlobMatrix2D<double> inverse(matrix.data(), n, n);
+      if (!WriteMatrix("inversed-matrix.txt", inverse)) {
+        std::cerr << "Failed to write 'inversed-matrix.txt'" << std::endl;
+        result = -1;
+      }
+    }
+  }
+  MPI_Comm_free(&row_comm);
+  MPI_Comm_free(&col_comm);
+  return result;
+}
+
+int main(int argc, char **argv) {
+  int thread_support;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
+  int rank;
+  int procs_num;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &procs_num);
+
+  Options options;
+  if (!ParseOptions(argc, argv, &options) ||
+      options.grid_rows * options.grid_cols > procs_num) {
+    if (rank == 0) {
+      std::cerr << "Usage: " << argv[0] << " [--grid=ROWSxCOLS] [--block=N]"
+                << " [--threads=N] [--look-ahead=0|1]" << std::endl;
+    }
+    MPI_Finalize();
+    return -1;
+  }
+  if (options.grid_rows == 0) {
+    ChooseGrid(procs_num, &options);
+  }
+  if (options.grid_rows * options.grid_cols != procs_num) {
+    if (rank == 0) {
+      std::cerr << "Grid must have " << procs_num << " processes" << std::endl;
+    }
+    MPI_Finalize();
+    return -1;
+  }
+
+  const int result = Run(options, rank);
+  MPI_Finalize();
+  return result;
+}
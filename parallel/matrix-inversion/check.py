@@ -1,3 +1,18 @@
+#!/usr/bin/python3
+# Checks that 'inversed-matrix.txt' is the inverse of 'matrix.txt'.
 import numpy as np
-a = np.identity(100)
-print(a)
+import sys
+
+a = np.loadtxt('matrix.txt', skiprows=1, ndmin=2)
+x = np.loadtxt('inversed-matrix.txt', skiprows=1, ndmin=2)
+if a.shape != x.shape:
+    print('Matrix sizes do not match: {} and {}'.format(a.shape, x.shape))
+    sys.exit(1)
+error = np.max(np.abs(a @ x - np.identity(a.shape[0])))
+# Errors of a backward stable inversion grow with the condition number.
+tolerance = 1e-12 * a.shape[0] * np.linalg.cond(a)
+print('max |A * X - I| = {}, tolerance {}'.format(error, tolerance))
+if error > tolerance:
+    print('Wrong inverse')
+    sys.exit(1)
+print('OK')
@@ -0,0 +1,87 @@
+// Inverts the matrix from 'matrix.txt' using blocked LU factorization with
+// partial pivoting on a thread pool and writes the result to
+// 'inversed-matrix.txt'.
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../misc/blob_matrix2d.h"
+#include "../../misc/thread_pool.h"
+#include "lu-inversion.h"
+#include "matrix-io.h"
+
+class Timer {
+ public:
+  Timer() : start_(std::chrono::high_resolution_clock::now()) {}
+
+  long long elapsed_ms() const {
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        end - start_).count();
+  }
+
+ private:
+  std::chrono::high_resolution_clock::time_point start_;
+};
+
+bool ParseOptions(int argc, char **argv, size_t *threads_num) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t eq_pos = arg.find('=');
+    const std::string name = arg.substr(0, eq_pos);
+    const std::string value =
+        eq_pos == std::string::npos ? "" : arg.substr(eq_pos + 1);
+    if (name == "--threads") {
+      *threads_num = std::stoull(value);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  size_t threads_num = std::thread::hardware_concurrency();
+  if (!ParseOptions(argc, argv, &threads_num)) {
+    std::cerr << "Usage: " << argv[0] << " [--threads=N]" << std::endl;
+    return -1;
+  }
+
+  Timer read_timer;
+  size_t n;
+  std::vector<double> data;
+  if (!ReadMatrix("matrix.txt", &n, &data)) {
+    std::cerr << "Failed to read 'matrix.txt'" << std::endl;
+    return -1;
+  }
+  std::cout << "Read " << n << "x" << n << " matrix in "
+            << read_timer.elapsed_ms() << "ms." << std::endl;
+
+  Timer inversion_timer;
+  ThreadPool pool(threads_num);
+  BlobMatrix2D<double> a(data.data(), n, n);
+  OwningBlobMatrix2D<double> inverse(n, n);
+  if (!Invert(a, inverse, pool)) {
+    std::cerr << "Matrix is singular" << std::endl;
+    return -1;
+  }
+  const long long inversion_ms = inversion_timer.elapsed_ms();
+  // LU factorization takes 2/3 n^3 flops, each of the triangular solves n^3.
+  std::cout << "Inverted in " << inversion_ms << "ms ("
+            << 8.0 / 3.0 * n * n * n / 1e6 /
+                   std::max<long long>(inversion_ms, 1)
+            << " GFLOP/s) on " << pool.GetThreadsNum() << " threads."
+            << std::endl;
+
+  Timer write_timer;
+  if (!WriteMatrix("inversed-matrix.txt", inverse)) {
+    std::cerr << "Failed to write 'inversed-matrix.txt'" << std::endl;
+    return -1;
+  }
+  std::cout << "Written in " << write_timer.elapsed_ms() << "ms." << std::endl;
+  return 0;
+}
@@ -0,0 +1,186 @@
+#include "lu-inversion.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+std::vector<double> GenerateMatrix(size_t n, std::mt19937& gen) {
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  std::vector<double> data(n * n);
+  for (auto& value : data) {
+    value = dist(gen);
+  }
+  return data;
+}
+
+// Max-norm of A * X - I.
+double InversionError(const BlobMatrix2D<double>& a,
+                      const BlobMatrix2D<double>& x) {
+  const size_t n = a.rows();
+  double error = 0;
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      double sum = i == j ? -1.0 : 0.0;
+      for (size_t p = 0; p < n; ++p) {
+        sum += a(i, p) * x(p, j);
+      }
+      error = std::max(error, std::abs(sum));
+    }
+  }
+  return error;
+}
+
+void TestLuDecompose() {
+  std::cout << "Testing LU decomposition..." << std::flush;
+  std::mt19937 gen(42);
+  ThreadPool pool(4);
+  for (size_t n : {1, 2, 63, 64, 65, 200}) {
+    std::vector<double> data = GenerateMatrix(n, gen);
+    std::vector<double> lu_data = data;
+    const BlobMatrix2D<double> a(data.data(), n, n);
+    BlobMatrix2D<double> lu(lu_data.data(), n, n);
+    std::vector<size_t> pivots;
+    assert(LuDecompose(lu, &pivots, pool));
+
+    std::vector<size_t> permutation(n);
+    for (size_t i = 0; i < n; ++i) {
+      permutation[i] = i;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      assert(pivots[i] >= i && pivots[i] < n);
+      std::swap(permutation[i], permutation[pivots[i]]);
+    }
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        // Partial pivoting keeps multipliers bounded by one.
+        if (j < i) {
+          assert(std::abs(lu(i, j)) <= 1.0);
+        }
+        double sum = 0;
+        for (size_t p = 0; p <= std::min(i, j); ++p) {
+          sum += (p == i ? 1.0 : lu(i, p)) * lu(p, j);
+        }
+        assert(std::abs(sum - a(permutation[i], j)) < 1e-9);
+      }
+    }
+  }
+  std::cout << "ok!" << std::endl;
+}
+
+void TestInvert() {
+  std::cout << "Testing inversion..." << std::flush;
+  std::mt19937 gen(7);
+  ThreadPool pool(4);
+  for (size_t n : {1, 3, 64, 100, 300}) {
+    std::vector<double> data = GenerateMatrix(n, gen);
+    std::vector<double> lu_data = data;
+    std::vector<double> inverse_data(n * n);
+    const BlobMatrix2D<double> a(data.data(), n, n);
+    BlobMatrix2D<double> lu(lu_data.data(), n, n);
+    BlobMatrix2D<double> inverse(inverse_data.data(), n, n);
+    assert(Invert(lu, inverse, pool));
+    assert(InversionError(a, inverse) < 1e-8);
+  }
+
+  // Zero on the diagonal requires pivoting.
+  double data[] = {0, 1, 2,
+                   1, 0, 3,
+                   4, -3, 8};
+  double lu_data[9];
+  std::copy(data, data + 9, lu_data);
+  double inverse_data[9];
+  const BlobMatrix2D<double> a(data, 3, 3);
+  BlobMatrix2D<double> lu(lu_data, 3, 3);
+  BlobMatrix2D<double> inverse(inverse_data, 3, 3);
+  assert(Invert(lu, inverse, pool));
+  assert(InversionError(a, inverse) < 1e-12);
+  std::cout << "ok!" << std::endl;
+}
+
+void TestSingular() {
+  std::cout << "Testing singular matrices..." << std::flush;
+  ThreadPool pool(2);
+  constexpr size_t kSize = 100;
+  std::vector<double> data(kSize * kSize);
+  BlobMatrix2D<double> a(data.data(), kSize, kSize);
+  for (size_t i = 0; i < kSize; ++i) {
+    for (size_t j = 0; j < kSize; ++j) {
+      a(i, j) = (i % 2 == 0) ? j : 2.0 * j;
+    }
+  }
+  std::vector<double> inverse_data(kSize * kSize);
+  BlobMatrix2D<double> inverse(inverse_data.data(), kSize, kSize);
+  assert(!Invert(a, inverse, pool));
+  std::cout << "ok!" << std::endl;
+}
+
+// Row-by-row Gauss-Jordan elimination without blocking, as in inversion.py.
+void GaussJordanInvert(BlobMatrix2D<double>& a,
+                       BlobMatrix2D<double>& inverse) {
+  const size_t n = a.rows();
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      inverse(i, j) = i == j ? 1.0 : 0.0;
+    }
+  }
+  for (size_t k = 0; k < n; ++k) {
+    const double inverse_pivot = 1.0 / a(k, k);
+    for (size_t j = 0; j < n; ++j) {
+      a(k, j) *= inverse_pivot;
+      inverse(k, j) *= inverse_pivot;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      if (i == k) {
+        continue;
+      }
+      const double multiplier = a(i, k);
+      for (size_t j = 0; j < n; ++j) {
+        a(i, j) -= multiplier * a(k, j);
+        inverse(i, j) -= multiplier * inverse(k, j);
+      }
+    }
+  }
+}
+
+void RunInversionBenchmark() {
+  constexpr size_t kSize = 1024;
+  std::mt19937 gen(42);
+  const std::vector<double> data = GenerateMatrix(kSize, gen);
+  std::vector<double> a_data = data;
+  std::vector<double> inverse_data(kSize * kSize);
+  BlobMatrix2D<double> a(a_data.data(), kSize, kSize);
+  BlobMatrix2D<double> inverse(inverse_data.data(), kSize, kSize);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  GaussJordanInvert(a, inverse);
+  auto end = std::chrono::high_resolution_clock::now();
+  std::cout << "Inversion of " << kSize << "x" << kSize
+            << " matrix: Gauss-Jordan "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(
+                   end - start).count() << "ms";
+  const size_t threads_nums[] = {1, std::thread::hardware_concurrency()};
+  for (size_t threads_num : threads_nums) {
+    ThreadPool pool(threads_num);
+    a_data = data;
+    start = std::chrono::high_resolution_clock::now();
+    Invert(a, inverse, pool);
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << ", blocked LU on " << pool.GetThreadsNum() << " threads "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     end - start).count() << "ms";
+  }
+  std::cout << std::endl;
+}
+
+int main() {
+  TestLuDecompose();
+  TestInvert();
+  TestSingular();
+  std::cout << "All tests passed! :)" << std::endl;
+  RunInversionBenchmark();
+  return 0;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "../../misc/blob_matrix2d.h"
+#include "../../misc/blob_matrix2d_kernels.h"
+#include "../../misc/thread_pool.h"
+
+// Width of the panels of the blocked LU factorization and of the block rows of
+// the triangular solves.
+constexpr size_t kLuBlockSize = 64;
+
+namespace lu_inversion_internal {
+
+template <typename T>
+void SwapRows(BlobMatrix2D<T>& a, size_t i, size_t j) {
+  if (i != j) {
+    std::swap_ranges(a.Row(i), a.Row(i) + a.cols(), a.Row(j));
+  }
+}
+
+// Factorizes the panel of columns [|begin|; |end|) below row |begin| with
+// partial pivoting. Rows are swapped as a whole, so the columns on both sides
+// of the panel are permuted as well.
+template <typename T>
+bool FactorizePanel(BlobMatrix2D<T>& a, size_t begin, size_t end,
+                    std::vector<size_t>* pivots) {
+  const size_t n = a.rows();
+  for (size_t j = begin; j < end; ++j) {
+    size_t pivot = j;
+    for (size_t i = j + 1; i < n; ++i) {
+      if (std::abs(a(i, j)) > std::abs(a(pivot, j))) {
+        pivot = i;
+      }
+    }
+    if (a(pivot, j) == T(0)) {
+      return false;
+    }
+    (*pivots)[j] = pivot;
+    SwapRows(a, j, pivot);
+    const T inverse_pivot = T(1) / a(j, j);
+    const T *pivot_row = a.Row(j);
+    for (size_t i = j + 1; i < n; ++i) {
+      T *row = a.Row(i);
+      row[j] *= inverse_pivot;
+      const T multiplier = row[j];
+      for (size_t k = j + 1; k < end; ++k) {
+        row[k] -= multiplier * pivot_row[k];
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace lu_inversion_internal
+
+// Factorizes square |a| in place as P * A = L * U, where L is unit lower
+// triangular and U is upper triangular. Row i was swapped with row
+// (*pivots)[i] at step i. The trailing submatrix is updated by a blocked
+// right-looking algorithm, so almost all the work is done by Gemm on |pool|.
+// Returns false if |a| is singular.
+template <typename T>
+bool LuDecompose(BlobMatrix2D<T>& a, std::vector<size_t>* pivots,
+                 ThreadPool& pool) {
+  assert(a.rows() == a.cols());
+  const size_t n = a.rows();
+  pivots->resize(n);
+  for (size_t k = 0; k < n; k += kLuBlockSize) {
+    const size_t block_size = std::min(kLuBlockSize, n - k);
+    const size_t rest = n - k - block_size;
+    if (!lu_inversion_internal::FactorizePanel(a, k, k + block_size,
+                                               pivots)) {
+      return false;
+    }
+    if (rest == 0) {
+      break;
+    }
+    // A12 = L11^-1 * A12, A22 -= A21 * A12.
+    const BlobMatrix2D<T> l11 = a.Block(k, k, block_size, block_size);
+    BlobMatrix2D<T> a12 = a.Block(k, k + block_size, block_size, rest);
+    TrsmLowerUnit(l11, a12, pool);
+    const BlobMatrix2D<T> a21 = a.Block(k + block_size, k, rest, block_size);
+    BlobMatrix2D<T> a22 = a.Block(k + block_size, k + block_size, rest, rest);
+    Gemm(T(-1), a21, a12, a22, pool);
+  }
+  return true;
+}
+
+// Computes A^-1 = U^-1 * L^-1 * P into |inverse| by two blocked triangular
+// solves with the permuted identity matrix. |a| is overwritten by its LU
+// factorization. Returns false if |a| is singular.
+template <typename T>
+bool Invert(BlobMatrix2D<T>& a, BlobMatrix2D<T>& inverse, ThreadPool& pool) {
+  assert(inverse.rows() == a.rows());
+  assert(inverse.cols() == a.cols());
+  const size_t n = a.rows();
+  std::vector<size_t> pivots;
+  if (!LuDecompose(a, &pivots, pool)) {
+    return false;
+  }
+
+  // Row i of P is the unit row of permutation[i].
+  std::vector<size_t> permutation(n);
+  std::iota(permutation.begin(), permutation.end(), 0);
+  for (size_t i = 0; i < n; ++i) {
+    std::swap(permutation[i], permutation[pivots[i]]);
+  }
+  for (size_t i = 0; i < n; ++i) {
+    std::fill(inverse.Row(i), inverse.Row(i) + n, T(0));
+    inverse(i, permutation[i]) = T(1);
+  }
+
+  for (size_t k = 0; k < n; k += kLuBlockSize) {
+    const size_t block_size = std::min(kLuBlockSize, n - k);
+    const size_t rest = n - k - block_size;
+    const BlobMatrix2D<T> l = a.Block(k, k, block_size, block_size);
+    BlobMatrix2D<T> x = inverse.Block(k, 0, block_size, n);
+    TrsmLowerUnit(l, x, pool);
+    if (rest > 0) {
+      const BlobMatrix2D<T> l_below = a.Block(k + block_size, k, rest,
+                                              block_size);
+      BlobMatrix2D<T> x_below = inverse.Block(k + block_size, 0, rest, n);
+      Gemm(T(-1), l_below, x, x_below, pool);
+    }
+  }
+
+  for (size_t end = n; end > 0;) {
+    const size_t block_size = std::min(kLuBlockSize, end);
+    const size_t k = end - block_size;
+    const BlobMatrix2D<T> u = a.Block(k, k, block_size, block_size);
+    BlobMatrix2D<T> x = inverse.Block(k, 0, block_size, n);
+    TrsmUpper(u, x, pool);
+    if (k > 0) {
+      const BlobMatrix2D<T> u_above = a.Block(0, k, k, block_size);
+      BlobMatrix2D<T> x_above = inverse.Block(0, 0, k, n);
+      Gemm(T(-1), u_above, x, x_above, pool);
+    }
+    end = k;
+  }
+  return true;
+}
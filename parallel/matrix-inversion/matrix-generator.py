@@ -1,11 +1,20 @@
 #!/usr/bin/python3
+# Writes a matrix to 'matrix.txt'. By default it has 10 on the diagonal and 1
+# elsewhere; with 'random' elements are random integers from [-100; 100], so
+# the inversion has to pivot.
+import random
+import sys
+
 print('Please enter matrix size: ')
 n = int(input())
+randomized = len(sys.argv) > 1 and sys.argv[1] == 'random'
 with open('matrix.txt', 'w') as f:
     f.write('{}\n'.format(n))
     for i in range(0, n):
         for j in range(0, n):
-            if i == j:
+            if randomized:
+                f.write('{} '.format(random.randint(-100, 100)))
+            elif i == j:
                 f.write('{} '.format(10))
             else:
                 f.write('{} '.format(1))
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../../misc/blob_matrix2d.h"
+
+// Matrices are stored as text: the size n followed by n rows of n elements.
+
+inline bool ReadMatrix(const std::string& path, size_t *n,
+                       std::vector<double> *data) {
+  std::ifstream in(path);
+  if (!in) {
+    return false;
+  }
+  const std::string text((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+  const char *pos = text.c_str();
+  char *end;
+  *n = strtoull(pos, &end, 10);
+  if (end == pos) {
+    return false;
+  }
+  data->resize(*n * *n);
+  for (double& value : *data) {
+    pos = end;
+    value = strtod(pos, &end);
+    if (end == pos) {
+      return false;
+    }
+  }
+  return true;
+}
+
+inline bool WriteMatrix(const std::string& path,
+                        const BlobMatrix2D<double>& matrix) {
+  FILE *out = fopen(path.c_str(), "w");
+  if (out == nullptr) {
+    return false;
+  }
+  fprintf(out, "%zu\n", matrix.rows());
+  for (size_t i = 0; i < matrix.rows(); ++i) {
+    for (size_t j = 0; j < matrix.cols(); ++j) {
+      fprintf(out, "%.17g ", matrix(i, j));
+    }
+    fputc('\n', out);
+  }
+  return fclose(out) == 0;
+}
@@ -1,25 +1,30 @@
 #include <iostream>
 #include <memory>
+#include <random>
 #include <functional>
 #include <set>
 #include <cassert>
+#include <chrono>
 #include <sstream>
+#include <type_traits>
 #include <vector>
 
+#include "../../alloc/arena.h"
+
 template <typename T>
 class TreeNode {
  public:
   enum Color {RED, BLACK};
   TreeNode(const T& value) : value_(value) {}
-  TreeNode(const T& value, std::shared_ptr<TreeNode> parent)
+  TreeNode(const T& value, TreeNode *parent)
       : value_(value), parent_(parent) {}
-  void SetLeft(std::shared_ptr<TreeNode> left) {
+  void SetLeft(TreeNode *left) {
     left_ = left;
   }
-  void SetRight(std::shared_ptr<TreeNode> right) {
+  void SetRight(TreeNode *right) {
     right_ = right;
   }
-  void SetParent(std::shared_ptr<TreeNode> parent) {
+  void SetParent(TreeNode *parent) {
     parent_ = parent;
   }
   void SetColor(Color color) {
@@ -34,14 +39,14 @@ class TreeNode {
   const T& GetValue() const {
     return value_;
   }
-  std::shared_ptr<TreeNode> GetLeft() const {
+  TreeNode *GetLeft() const {
     return left_;
   }
-  std::shared_ptr<TreeNode> GetRight() const {
+  TreeNode *GetRight() const {
     return right_;
   }
-  std::shared_ptr<TreeNode> GetParent() const {
-    return parent_.lock();
+  TreeNode *GetParent() const {
+    return parent_;
   }
   Color GetColor() const {
     return color_;
@@ -49,14 +54,14 @@ class TreeNode {
   int CheckRBTreeProperty() const;
   std::string Preorder() const;
 
-  static bool IsBlack(std::shared_ptr<TreeNode> node) {
+  static bool IsBlack(TreeNode *node) {
     if (node) {
       return node->GetColor() == BLACK;
     } else {
       return true;
     }
   }
-  static bool IsRed(std::shared_ptr<TreeNode> node) {
+  static bool IsRed(TreeNode *node) {
     if (node) {
       return node->GetColor() == RED;
     } else {
@@ -66,15 +71,21 @@ class TreeNode {
  private:
   Color color_;
   T value_;
-  std::shared_ptr<TreeNode> left_, right_;
-  // Parent pointer should be weak in order to prevent cyclic references.
-  std::weak_ptr<TreeNode> parent_;
+  TreeNode *left_ = nullptr;
+  TreeNode *right_ = nullptr;
+  TreeNode *parent_ = nullptr;
 };
 
-template <typename T, typename Comp = std::less<T>>
+// The tree owns its nodes, which are allocated by |Alloc|. With an
+// ArenaAllocator from alloc/arena.h and trivially destructible values Clear()
+// and the destructor don't visit the nodes: the arena releases them all at
+// once.
+template <typename T, typename Comp = std::less<T>,
+          typename Alloc = std::allocator<T>>
 class RedBlackTree {
  public:
-  using NodePtr = std::shared_ptr<TreeNode<T>> ;
+  using NodePtr = TreeNode<T>*;
+  explicit RedBlackTree(const Alloc& alloc = Alloc()) : alloc_(alloc) {}
   void Insert(const T& value);
   void Erase(const T& value);
   NodePtr Find(const T& value) const;
@@ -87,7 +98,17 @@ class RedBlackTree {
     }
   }
 
+  RedBlackTree(const RedBlackTree&) = delete;
+  RedBlackTree& operator=(const RedBlackTree&) = delete;
+  ~RedBlackTree() {
+    Clear();
+  }
+
   void Clear() {
+    if (!ReleasesInBulk<Alloc>::value ||
+        !std::is_trivially_destructible<TreeNode<T>>::value) {
+      DeleteSubtree(root_);
+    }
     root_ = nullptr;
   }
 
@@ -163,8 +184,39 @@ class RedBlackTree {
   // red.
   void EraseCase6(NodePtr node);
 
+  using NodeAlloc = typename std::allocator_traits<Alloc>::template
+      rebind_alloc<TreeNode<T>>;
+  using NodeTraits = std::allocator_traits<NodeAlloc>;
+
+  NodePtr NewNode(const T& value) {
+    NodePtr node = NodeTraits::allocate(alloc_, 1);
+    NodeTraits::construct(alloc_, node, value);
+    return node;
+  }
+  void DeleteNode(NodePtr node) {
+    NodeTraits::destroy(alloc_, node);
+    NodeTraits::deallocate(alloc_, node, 1);
+  }
+  // Rotates left children up until there are none, so that deep trees don't
+  // need a stack.
+  void DeleteSubtree(NodePtr node) {
+    while (node) {
+      NodePtr left = node->GetLeft();
+      if (left) {
+        node->SetLeft(left->GetRight());
+        left->SetRight(node);
+        node = left;
+      } else {
+        NodePtr right = node->GetRight();
+        DeleteNode(node);
+        node = right;
+      }
+    }
+  }
+
   Comp comp;
-  NodePtr root_;
+  NodeAlloc alloc_;
+  NodePtr root_ = nullptr;
 };
 
 template <typename T>
@@ -172,12 +224,12 @@ int TreeNode<T>::CheckRBTreeProperty() const {
   if (color_ == BLACK) {
     int l = 1;
     if (left_) {
-      assert(this == left_->GetParent().get());
+      assert(this == left_->GetParent());
       l = left_->CheckRBTreeProperty();
     }
     int r = 1;
     if (right_) {
-      assert(this == right_->GetParent().get());
+      assert(this == right_->GetParent());
       r = right_->CheckRBTreeProperty();
     }
     assert(l == r);
@@ -185,13 +237,13 @@ int TreeNode<T>::CheckRBTreeProperty() const {
   } else {
     int l = 1;
     if (left_) {
-      assert(this == left_->GetParent().get());
+      assert(this == left_->GetParent());
       assert(left_->color_ == BLACK);
       l = left_->CheckRBTreeProperty();
     }
     int r = 1;
     if (right_) {
-      assert(this == right_->GetParent().get());
+      assert(this == right_->GetParent());
       assert(right_->color_ == BLACK);
       r = right_->CheckRBTreeProperty();
     }
@@ -216,9 +268,9 @@ std::string TreeNode<T>::Preorder() const {
   return res.str();
 }
 
-template <typename T, typename Comp>
-void RedBlackTree<T, Comp>::Insert(const T& value) {
-  NodePtr cur_node = root_, parent;
+template <typename T, typename Comp, typename Alloc>
+void RedBlackTree<T, Comp, Alloc>::Insert(const T& value) {
+  NodePtr cur_node = root_, parent = nullptr;
   while (cur_node) {
     parent = cur_node;
     if (comp(value, cur_node->GetValue())) {
@@ -230,7 +282,7 @@ void RedBlackTree<T, Comp>::Insert(const T& value) {
     }
   }
 
-  cur_node.reset(new TreeNode<T>(value));
+  cur_node = NewNode(value);
   cur_node->SetColor(TreeNode<T>::RED);
   cur_node->SetParent(parent);
   if (!parent) {
@@ -244,8 +296,8 @@ void RedBlackTree<T, Comp>::Insert(const T& value) {
   InsertCase1(cur_node);
 }
 
-template <typename T, typename Comp>
-void RedBlackTree<T, Comp>::Erase(const T& value) {
+template <typename T, typename Comp, typename Alloc>
+void RedBlackTree<T, Comp, Alloc>::Erase(const T& value) {
   auto node = Find(value);
   if (!node) return;
   if (node->GetLeft() && node->GetRight()) {
@@ -295,13 +347,13 @@ void RedBlackTree<T, Comp>::Erase(const T& value) {
   } else {
     root_ = nullptr;
   }
+  DeleteNode(node);
 }
 
-template <typename T, typename Comp>
-std::shared_ptr<TreeNode<T>> RedBlackTree<T, Comp>::Find(const T& value) const {
-  NodePtr cur_node = root_, parent;
+template <typename T, typename Comp, typename Alloc>
+TreeNode<T> *RedBlackTree<T, Comp, Alloc>::Find(const T& value) const {
+  NodePtr cur_node = root_;
   while (cur_node && !Equiv(cur_node->GetValue(), value)) {
-    parent = cur_node;
     if (comp(value, cur_node->GetValue())) {
       cur_node = cur_node->GetLeft();
     } else {
@@ -315,11 +367,11 @@ std::shared_ptr<TreeNode<T>> RedBlackTree<T, Comp>::Find(const T& value) const {
   }
 }
 
-template <typename T, typename Comp>
-std::shared_ptr<TreeNode<T>> RedBlackTree<T, Comp>::GetLowerBound(
+template <typename T, typename Comp, typename Alloc>
+TreeNode<T> *RedBlackTree<T, Comp, Alloc>::GetLowerBound(
     const T& value) const {
   NodePtr cur_node = root_;
-  NodePtr best_node;
+  NodePtr best_node = nullptr;
   while (cur_node) {
     if (comp(cur_node->GetValue(), value)) {
       best_node = cur_node;
@@ -331,8 +383,8 @@ std::shared_ptr<TreeNode<T>> RedBlackTree<T, Comp>::GetLowerBound(
   return best_node;
 }
 
-template <typename T, typename Comp>
-void RedBlackTree<T, Comp>::LeftRotate(NodePtr nodex) {
+template <typename T, typename Comp, typename Alloc>
+void RedBlackTree<T, Comp, Alloc>::LeftRotate(NodePtr nodex) {
   auto nodey = nodex->GetRight();
   assert(nodey);
   auto parent = nodex->GetParent();
@@ -355,8 +407,8 @@ void RedBlackTree<T, Comp>::LeftRotate(NodePtr nodex) {
   nodex->SetParent(nodey);
 }
 
-template <typename T, typename Comp>
-void RedBlackTree<T, Comp>::RightRotate(NodePtr nodey) {
+template <typename T, typename Comp, typename Alloc>
+void RedBlackTree<T, Comp, Alloc>::RightRotate(NodePtr nodey) {
   auto nodex = nodey->GetLeft();
   assert(nodex);
   auto parent = nodey->GetParent();
@@ -379,8 +431,8 @@ void RedBlackTree<T, Comp>::RightRotate(NodePtr nodey) {
   nodey->SetParent(nodex);
 }
 
-template <typename T, typename Comp>
-void RedBlackTree<T, Comp>::InsertCase1(NodePtr node) {
+template <typename T, typename Comp, typename Alloc>
+void RedBlackTree<T, Comp, Alloc>::InsertCase1(NodePtr node) {
   if (!node->GetParent()) {
     node->SetColor(TreeNode<T>::BLACK);
   } else {
@@ -388,15 +440,15 @@ void RedBlackTree<T, Comp>::InsertCase1(NodePtr node) {
   }
 }
 
-template <typename T, typename Comp>
-void RedBlackTree<T, Comp>::InsertCase2(NodePtr node) {
+template <typename T, typename Comp, typename Alloc>
+void RedBlackTree<T, Comp, Alloc>::InsertCase2(NodePtr node) {
   if (node->GetParent()->GetColor() != TreeNode<T>::BLACK) {
     InsertCase3(node);
   }
 }
 
-template <typename T, typename Comp>
-void RedBlackTree<T, Comp>::InsertCase3(NodePtr node) {
+template <typename T, typename Comp, typename Alloc>
+void RedBlackTree<T, Comp, Alloc>::InsertCase3(NodePtr node) {
   auto uncle = GetUncle(node);
   if (TreeNode<T>::IsRed(uncle)) {
     node->GetParent()->SetColor(TreeNode<T>::BLACK);
@@ -409,8 +461,8 @@ void RedBlackTree<T, Comp>::InsertCase3(NodePtr node) {
   }
 }
 
-template <typename T, typename Comp>
-void RedBlackTree<T, Comp>::InsertCase4(NodePtr node) {
+template <typename T, typename Comp, typename Alloc>
+void RedBlackTree<T, Comp, Alloc>::InsertCase4(NodePtr node) {
   auto parent = node->GetParent();
   // parent is red => grandparent always exists
   auto grandparent = parent->GetParent();
@@ -424,8 +476,8 @@ void RedBlackTree<T, Comp>::InsertCase4(NodePtr node) {
   InsertCase5(node);
 }
 
-template <typename T, typename Comp>
-void RedBlackTree<T, Comp>::InsertCase5(NodePtr node) {
+template <typename T, typename Comp, typename Alloc>
+void RedBlackTree<T, Comp, Alloc>::InsertCase5(NodePtr node) {
   auto parent = node->GetParent();
   // parent is red => grandparent always exists
   auto grandparent = parent->GetParent();
@@ -439,15 +491,15 @@ void RedBlackTree<T, Comp>::InsertCase5(NodePtr node) {
   }
 }
 
-template <typename T, typename Comp>
-void RedBlackTree<T, Comp>::EraseCase1(NodePtr node) {
+template <typename T, typename Comp, typename Alloc>
+void RedBlackTree<T, Comp, Alloc>::EraseCase1(NodePtr node) {
   if (node->GetParent()) {
     EraseCase2(node);
   }
 }
 
-template <typename T, typename Comp>
-void RedBlackTree<T, Comp>::EraseCase2(NodePtr node) {
+template <typename T, typename Comp, typename Alloc>
+void RedBlackTree<T, Comp, Alloc>::EraseCase2(NodePtr node) {
   auto parent = node->GetParent();
   auto sibling = GetSibling(node);
   assert(parent);
@@ -467,8 +519,8 @@ void RedBlackTree<T, Comp>::EraseCase2(NodePtr node) {
   }
 }
 
-template <typename T, typename Comp>
-void RedBlackTree<T, Comp>::EraseCase3(NodePtr node) {
+template <typename T, typename Comp, typename Alloc>
+void RedBlackTree<T, Comp, Alloc>::EraseCase3(NodePtr node) {
   auto parent = node->GetParent();
   auto sibling = GetSibling(node);
   assert(parent);
@@ -483,8 +535,8 @@ void RedBlackTree<T, Comp>::EraseCase3(NodePtr node) {
   }
 }
 
-template <typename T, typename Comp>
-void RedBlackTree<T, Comp>::EraseCase4(NodePtr node) {
+template <typename T, typename Comp, typename Alloc>
+void RedBlackTree<T, Comp, Alloc>::EraseCase4(NodePtr node) {
   auto parent = node->GetParent();
   auto sibling = GetSibling(node);
   assert(parent);
@@ -499,8 +551,8 @@ void RedBlackTree<T, Comp>::EraseCase4(NodePtr node) {
   }
 }
 
-template <typename T, typename Comp>
-void RedBlackTree<T, Comp>::EraseCase5(NodePtr node) {
+template <typename T, typename Comp, typename Alloc>
+void RedBlackTree<T, Comp, Alloc>::EraseCase5(NodePtr node) {
   auto parent = node->GetParent();
   auto sibling = GetSibling(node);
   assert(parent);
@@ -522,8 +574,8 @@ void RedBlackTree<T, Comp>::EraseCase5(NodePtr node) {
   EraseCase6(node);
 }
 
-template <typename T, typename Comp>
-void RedBlackTree<T, Comp>::EraseCase6(NodePtr node) {
+template <typename T, typename Comp, typename Alloc>
+void RedBlackTree<T, Comp, Alloc>::EraseCase6(NodePtr node) {
   auto sibling = GetSibling(node);
   auto parent = node->GetParent();
   assert(parent);
@@ -594,9 +646,60 @@ void RunTests() {
     }
   }
 
+  // Nodes may live in an arena.
+  MonotonicArena arena;
+  ArenaAllocator<int> alloc(&arena);
+  RedBlackTree<int, std::less<int>, ArenaAllocator<int>> arena_tree(alloc);
+  for (auto e : elements) {
+    arena_tree.Insert(e);
+  }
+  arena_tree.CheckRBTreeProperty();
+  for (auto e : s) {
+    assert(arena_tree.Find(e));
+  }
+  assert(arena.allocated_bytes() > 0);
+
   std::cout << "All tests passed!" << std::endl;
 }
 
+// Build and teardown times of a tree with the default allocator and with an
+// arena, which releases all nodes at once.
+template <typename MakeTree>
+long long MeasureTreeMs(const std::vector<int>& elements,
+                        const MakeTree& make_tree) {
+  auto start = std::chrono::high_resolution_clock::now();
+  {
+    auto tree = make_tree();
+    for (int e : elements) {
+      tree->Insert(e);
+    }
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      end - start).count();
+}
+
+void RunArenaBenchmark() {
+  constexpr int kSize = 1000000;
+  std::mt19937 gen(42);
+  std::vector<int> elements(kSize);
+  for (int& e : elements) {
+    e = gen();
+  }
+  const long long tree_ms = MeasureTreeMs(elements, []() {
+    return std::make_unique<RedBlackTree<int>>();
+  });
+  MonotonicArena arena;
+  const long long arena_tree_ms = MeasureTreeMs(elements, [&]() {
+    return std::make_unique<
+        RedBlackTree<int, std::less<int>, ArenaAllocator<int>>>(
+        ArenaAllocator<int>(&arena));
+  });
+  std::cout << "RedBlackTree of " << kSize << " elements: std::allocator "
+            << tree_ms << "ms, MonotonicArena " << arena_tree_ms << "ms"
+            << std::endl;
+}
+
 class RoomsRange {
  public:
   RoomsRange() : start_(0), length_(0) {}
@@ -631,6 +734,7 @@ class RoomsRange {
 
 int main() {
   // RunTests();
+  // RunArenaBenchmark();
   RedBlackTree<RoomsRange> rb_tree;
   int queries_num;
   std::cin >> queries_num;
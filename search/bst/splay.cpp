@@ -1,24 +1,29 @@
 #include <iostream>
 #include <memory>
+#include <random>
 #include <functional>
 #include <set>
 #include <cassert>
+#include <chrono>
 #include <sstream>
+#include <type_traits>
 #include <vector>
 
+#include "../../alloc/arena.h"
+
 template <typename T>
 class SplayTreeNode {
  public:
   SplayTreeNode(const T& value) : value_(value) {}
-  SplayTreeNode(const T& value, std::shared_ptr<SplayTreeNode> parent)
+  SplayTreeNode(const T& value, SplayTreeNode *parent)
       : value_(value), parent_(parent) {}
-  void SetLeft(std::shared_ptr<SplayTreeNode> left) {
+  void SetLeft(SplayTreeNode *left) {
     left_ = left;
   }
-  void SetRight(std::shared_ptr<SplayTreeNode> right) {
+  void SetRight(SplayTreeNode *right) {
     right_ = right;
   }
-  void SetParent(std::shared_ptr<SplayTreeNode> parent) {
+  void SetParent(SplayTreeNode *parent) {
     parent_ = parent;
   }
   void SwapValues(SplayTreeNode& other_node) {
@@ -30,26 +35,26 @@ class SplayTreeNode {
   const T& GetValue() const {
     return value_;
   }
-  std::shared_ptr<SplayTreeNode> GetLeft() const {
+  SplayTreeNode *GetLeft() const {
     return left_;
   }
-  std::shared_ptr<SplayTreeNode> GetRight() const {
+  SplayTreeNode *GetRight() const {
     return right_;
   }
-  std::shared_ptr<SplayTreeNode> GetParent() const {
-    return parent_.lock();
+  SplayTreeNode *GetParent() const {
+    return parent_;
   }
   std::string Preorder() const {
     std::stringstream res;
     res << value_ << " ";
     res << "(";
     if (left_) {
-      assert(this == left_->GetParent().get());
+      assert(this == left_->GetParent());
       res << left_->Preorder();
     }
     res << ") (";
     if (right_) {
-      assert(this == right_->GetParent().get());
+      assert(this == right_->GetParent());
       res << right_->Preorder();
     }
     res << ")";
@@ -57,21 +62,37 @@ class SplayTreeNode {
   }
  private:
   T value_;
-  std::shared_ptr<SplayTreeNode> left_, right_;
-  // Parent pointer should be weak in order to prevent cyclic references.
-  std::weak_ptr<SplayTreeNode> parent_;
+  SplayTreeNode *left_ = nullptr;
+  SplayTreeNode *right_ = nullptr;
+  SplayTreeNode *parent_ = nullptr;
 };
 
-template <typename T, typename Comp = std::less<T>>
+// The tree owns its nodes, which are allocated by |Alloc|. With an
+// ArenaAllocator from alloc/arena.h and trivially destructible values Clear()
+// and the destructor don't visit the nodes: the arena releases them all at
+// once.
+template <typename T, typename Comp = std::less<T>,
+          typename Alloc = std::allocator<T>>
 class SplayTree {
  public:
-  using NodePtr = std::shared_ptr<SplayTreeNode<T>> ;
+  using NodePtr = SplayTreeNode<T>*;
+  explicit SplayTree(const Alloc& alloc = Alloc()) : alloc_(alloc) {}
   void Insert(const T& value);
   void Erase(const T& value);
   NodePtr Find(const T& value);
   NodePtr GetLowerBound(const T& value);
 
+  SplayTree(const SplayTree&) = delete;
+  SplayTree& operator=(const SplayTree&) = delete;
+  ~SplayTree() {
+    Clear();
+  }
+
   void Clear() {
+    if (!ReleasesInBulk<Alloc>::value ||
+        !std::is_trivially_destructible<SplayTreeNode<T>>::value) {
+      DeleteSubtree(root_);
+    }
     root_ = nullptr;
   }
 
@@ -90,13 +111,44 @@ class SplayTree {
   void Zig(NodePtr& node);
   void Zag(NodePtr& node);
 
+  using NodeAlloc = typename std::allocator_traits<Alloc>::template
+      rebind_alloc<SplayTreeNode<T>>;
+  using NodeTraits = std::allocator_traits<NodeAlloc>;
+
+  NodePtr NewNode(const T& value) {
+    NodePtr node = NodeTraits::allocate(alloc_, 1);
+    NodeTraits::construct(alloc_, node, value);
+    return node;
+  }
+  void DeleteNode(NodePtr node) {
+    NodeTraits::destroy(alloc_, node);
+    NodeTraits::deallocate(alloc_, node, 1);
+  }
+  // Rotates left children up until there are none, so that deep trees don't
+  // need a stack.
+  void DeleteSubtree(NodePtr node) {
+    while (node) {
+      NodePtr left = node->GetLeft();
+      if (left) {
+        node->SetLeft(left->GetRight());
+        left->SetRight(node);
+        node = left;
+      } else {
+        NodePtr right = node->GetRight();
+        DeleteNode(node);
+        node = right;
+      }
+    }
+  }
+
   Comp comp;
-  NodePtr root_;
+  NodeAlloc alloc_;
+  NodePtr root_ = nullptr;
 };
 
-template <typename T, typename Comp>
-void SplayTree<T, Comp>::Insert(const T& value) {
-  NodePtr cur_node = root_, parent;
+template <typename T, typename Comp, typename Alloc>
+void SplayTree<T, Comp, Alloc>::Insert(const T& value) {
+  NodePtr cur_node = root_, parent = nullptr;
   while (cur_node) {
     parent = cur_node;
     if (comp(value, cur_node->GetValue())) {
@@ -108,7 +160,7 @@ void SplayTree<T, Comp>::Insert(const T& value) {
     }
   }
 
-  cur_node.reset(new SplayTreeNode<T>(value));
+  cur_node = NewNode(value);
   cur_node->SetParent(parent);
   if (!parent) {
     root_ = cur_node;
@@ -121,8 +173,8 @@ void SplayTree<T, Comp>::Insert(const T& value) {
   Splay(cur_node);
 }
 
-template <typename T, typename Comp>
-void SplayTree<T, Comp>::Erase(const T& value) {
+template <typename T, typename Comp, typename Alloc>
+void SplayTree<T, Comp, Alloc>::Erase(const T& value) {
   auto node = Find(value);
   if (!node) return;
   if (node->GetLeft() && node->GetRight()) {
@@ -164,13 +216,13 @@ void SplayTree<T, Comp>::Erase(const T& value) {
   } else {
     root_ = nullptr;
   }
+  DeleteNode(node);
 }
 
-template <typename T, typename Comp>
-std::shared_ptr<SplayTreeNode<T>> SplayTree<T, Comp>::Find(const T& value) {
-  NodePtr cur_node = root_, parent;
+template <typename T, typename Comp, typename Alloc>
+SplayTreeNode<T> *SplayTree<T, Comp, Alloc>::Find(const T& value) {
+  NodePtr cur_node = root_;
   while (cur_node && !Equiv(cur_node->GetValue(), value)) {
-    parent = cur_node;
     if (comp(value, cur_node->GetValue())) {
       cur_node = cur_node->GetLeft();
     } else {
@@ -187,11 +239,11 @@ std::shared_ptr<SplayTreeNode<T>> SplayTree<T, Comp>::Find(const T& value) {
   }
 }
 
-template <typename T, typename Comp>
-std::shared_ptr<SplayTreeNode<T>> SplayTree<T, Comp>::GetLowerBound(
+template <typename T, typename Comp, typename Alloc>
+SplayTreeNode<T> *SplayTree<T, Comp, Alloc>::GetLowerBound(
     const T& value) {
   NodePtr cur_node = root_;
-  NodePtr best_node;
+  NodePtr best_node = nullptr;
   while (cur_node) {
     if (comp(cur_node->GetValue(), value)) {
       best_node = cur_node;
@@ -203,8 +255,8 @@ std::shared_ptr<SplayTreeNode<T>> SplayTree<T, Comp>::GetLowerBound(
   return best_node;
 }
 
-template <typename T, typename Comp>
-void SplayTree<T, Comp>::Splay(NodePtr node) {
+template <typename T, typename Comp, typename Alloc>
+void SplayTree<T, Comp, Alloc>::Splay(NodePtr node) {
   while (node->GetParent()) {
     auto parent = node->GetParent();
     auto grandparent = parent->GetParent();
@@ -242,8 +294,8 @@ void SplayTree<T, Comp>::Splay(NodePtr node) {
   }
 }
 
-template <typename T, typename Comp>
-void SplayTree<T, Comp>::ZigZig(
+template <typename T, typename Comp, typename Alloc>
+void SplayTree<T, Comp, Alloc>::ZigZig(
     SplayTree::NodePtr& node, SplayTree::NodePtr& parent,
     SplayTree::NodePtr& grandparent) {
   if (parent->GetRight()) {
@@ -264,8 +316,8 @@ void SplayTree<T, Comp>::ZigZig(
   }
 }
 
-template <typename T, typename Comp>
-void SplayTree<T, Comp>::ZigZag(
+template <typename T, typename Comp, typename Alloc>
+void SplayTree<T, Comp, Alloc>::ZigZag(
     SplayTree::NodePtr& node, SplayTree::NodePtr& parent,
     SplayTree::NodePtr& grandparent) {
   if (node->GetRight()) {
@@ -286,8 +338,8 @@ void SplayTree<T, Comp>::ZigZag(
   }
 }
 
-template <typename T, typename Comp>
-void SplayTree<T, Comp>::ZagZig(
+template <typename T, typename Comp, typename Alloc>
+void SplayTree<T, Comp, Alloc>::ZagZig(
     SplayTree::NodePtr& node, SplayTree::NodePtr& parent,
     SplayTree::NodePtr& grandparent) {
   if (node->GetLeft()) {
@@ -308,8 +360,8 @@ void SplayTree<T, Comp>::ZagZig(
   }
 }
 
-template <typename T, typename Comp>
-void SplayTree<T, Comp>::ZagZag(
+template <typename T, typename Comp, typename Alloc>
+void SplayTree<T, Comp, Alloc>::ZagZag(
     SplayTree::NodePtr& node, SplayTree::NodePtr& parent,
     SplayTree::NodePtr& grandparent) {
   if (parent->GetLeft()) {
@@ -330,8 +382,8 @@ void SplayTree<T, Comp>::ZagZag(
   }
 }
 
-template <typename T, typename Comp>
-void SplayTree<T, Comp>::Zig(SplayTree::NodePtr& node) {
+template <typename T, typename Comp, typename Alloc>
+void SplayTree<T, Comp, Alloc>::Zig(SplayTree::NodePtr& node) {
   assert(root_ == node->GetParent());
   if (node->GetRight()) {
     node->GetRight()->SetParent(root_);
@@ -343,8 +395,8 @@ void SplayTree<T, Comp>::Zig(SplayTree::NodePtr& node) {
   root_ = node;
 }
 
-template <typename T, typename Comp>
-void SplayTree<T, Comp>::Zag(SplayTree::NodePtr& node) {
+template <typename T, typename Comp, typename Alloc>
+void SplayTree<T, Comp, Alloc>::Zag(SplayTree::NodePtr& node) {
   assert(root_ == node->GetParent());
   if (node->GetLeft()) {
     node->GetLeft()->SetParent(root_);
@@ -430,9 +482,59 @@ void RunTests() {
   splay_tree.Insert(5);
   splay_tree.Find(100);
 
+  // Nodes may live in an arena.
+  MonotonicArena arena;
+  ArenaAllocator<int> alloc(&arena);
+  SplayTree<int, std::less<int>, ArenaAllocator<int>> arena_tree(alloc);
+  for (auto e : elements) {
+    arena_tree.Insert(e);
+  }
+  for (auto e : s) {
+    assert(arena_tree.Find(e));
+  }
+  assert(arena.allocated_bytes() > 0);
+
   std::cout << "All tests passed!" << std::endl;
 }
 
+// Build and teardown times of a tree with the default allocator and with an
+// arena, which releases all nodes at once.
+template <typename MakeTree>
+long long MeasureTreeMs(const std::vector<int>& elements,
+                        const MakeTree& make_tree) {
+  auto start = std::chrono::high_resolution_clock::now();
+  {
+    auto tree = make_tree();
+    for (int e : elements) {
+      tree->Insert(e);
+    }
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      end - start).count();
+}
+
+void RunArenaBenchmark() {
+  constexpr int kSize = 1000000;
+  std::mt19937 gen(42);
+  std::vector<int> elements(kSize);
+  for (int& e : elements) {
+    e = gen();
+  }
+  const long long tree_ms = MeasureTreeMs(elements, []() {
+    return std::make_unique<SplayTree<int>>();
+  });
+  MonotonicArena arena;
+  const long long arena_tree_ms = MeasureTreeMs(elements, [&]() {
+    return std::make_unique<
+        SplayTree<int, std::less<int>, ArenaAllocator<int>>>(
+        ArenaAllocator<int>(&arena));
+  });
+  std::cout << "SplayTree of " << kSize << " elements: std::allocator "
+            << tree_ms << "ms, MonotonicArena " << arena_tree_ms << "ms"
+            << std::endl;
+}
+
 class RoomsRange {
  public:
   RoomsRange() : start_(0), length_(0) {}
@@ -467,6 +569,7 @@ class RoomsRange {
 
 int main() {
   // RunTests();
+  // RunArenaBenchmark();
   SplayTree<RoomsRange> splay_tree;
   int queries_num;
   std::cin >> queries_num;
@@ -5,21 +5,23 @@
 #include <vector>
 #include <memory>
 #include <sstream>
+#include <type_traits>
+
+#include "../alloc/arena.h"
 
 template <typename T>
 class CartesianTreeNode {
  public:
   CartesianTreeNode(const T& value, int id) : value_(value), id_(id) {}
-  CartesianTreeNode(const T& value, int id,
-                    std::shared_ptr<CartesianTreeNode> parent)
+  CartesianTreeNode(const T& value, int id, CartesianTreeNode *parent)
       : value_(value), id_(id), parent_(parent) {}
-  void SetLeft(std::shared_ptr<CartesianTreeNode> left) {
+  void SetLeft(CartesianTreeNode *left) {
     left_ = left;
   }
-  void SetRight(std::shared_ptr<CartesianTreeNode> right) {
+  void SetRight(CartesianTreeNode *right) {
     right_ = right;
   }
-  void SetParent(std::shared_ptr<CartesianTreeNode> parent) {
+  void SetParent(CartesianTreeNode *parent) {
     parent_ = parent;
   }
   void SwapValues(CartesianTreeNode& other_node) {
@@ -37,23 +39,23 @@ class CartesianTreeNode {
   int GetId() const {
     return id_;
   }
-  std::shared_ptr<CartesianTreeNode> GetLeft() const {
+  CartesianTreeNode *GetLeft() const {
     return left_;
   }
-  std::shared_ptr<CartesianTreeNode> GetRight() const {
+  CartesianTreeNode *GetRight() const {
     return right_;
   }
-  std::shared_ptr<CartesianTreeNode> GetParent() const {
-    return parent_.lock();
+  CartesianTreeNode *GetParent() const {
+    return parent_;
   }
   void CheckHeapProperty(int min_val) const {
     assert(value_ >= min_val);
     if (left_) {
-      assert(this == left_->GetParent().get());
+      assert(this == left_->GetParent());
       left_->CheckHeapProperty(value_);
     }
     if (right_) {
-      assert(this == right_->GetParent().get());
+      assert(this == right_->GetParent());
       right_->CheckHeapProperty(value_);
     }
   }
@@ -69,29 +71,30 @@ class CartesianTreeNode {
  private:
   T value_;
   int id_;
-  std::shared_ptr<CartesianTreeNode> left_, right_;
-  // Parent pointer should be weak in order to prevent cyclic references.
-  std::weak_ptr<CartesianTreeNode> parent_;
+  CartesianTreeNode *left_ = nullptr;
+  CartesianTreeNode *right_ = nullptr;
+  CartesianTreeNode *parent_ = nullptr;
 };
 
-template <typename T>
+// The tree owns its nodes, which are allocated by |Alloc|. With an
+// ArenaAllocator from alloc/arena.h and trivially destructible values the
+// destructor doesn't visit the nodes: the arena releases them all at once.
+template <typename T, typename Alloc = std::allocator<T>>
 class CartesianTree {
  public:
-  using NodePtr = std::shared_ptr<CartesianTreeNode<T>>;
-  static CartesianTree Init(const std::vector<T>& data) {
+  using NodePtr = CartesianTreeNode<T>*;
+  static CartesianTree Init(const std::vector<T>& data,
+                            const Alloc& alloc = Alloc()) {
     assert(!data.empty());
-    CartesianTree res;
+    CartesianTree res(alloc);
     res.nodes_num_ = data.size();
-    NodePtr cur_node = NodePtr(new CartesianTreeNode<T>(data[0], 0));
+    NodePtr cur_node = res.NewNode(data[0], 0);
     res.root_ = cur_node;
-    // We have to always store owning pointer to the tree root in order to
-    // prevent it from destructing (cur_node stores only weak pointer to it's
-    // parent).
     for (size_t i = 1; i < data.size(); ++i) {
       while (cur_node->GetParent() && cur_node->GetValue() > data[i]) {
         cur_node = cur_node->GetParent();
       }
-      NodePtr new_node(new CartesianTreeNode<T>(data[i], i));
+      NodePtr new_node = res.NewNode(data[i], i);
       if (cur_node->GetValue() <= data[i]) {
         if (cur_node->GetRight()) {
           new_node->SetLeft(cur_node->GetRight());
@@ -111,6 +114,19 @@ class CartesianTree {
     }
     return res;
   }
+  CartesianTree(CartesianTree&& other)
+      : alloc_(other.alloc_), root_(other.root_),
+        nodes_num_(other.nodes_num_) {
+    other.root_ = nullptr;
+  }
+  CartesianTree(const CartesianTree&) = delete;
+  CartesianTree& operator=(const CartesianTree&) = delete;
+  ~CartesianTree() {
+    if (!ReleasesInBulk<Alloc>::value ||
+        !std::is_trivially_destructible<CartesianTreeNode<T>>::value) {
+      DeleteSubtree(root_);
+    }
+  }
   NodePtr GetRoot() const {
     return root_;
   }
@@ -123,9 +139,37 @@ class CartesianTree {
     return nodes_num_;
   }
  private:
-  CartesianTree() {}
-  NodePtr root_;
-  int nodes_num_;
+  using NodeAlloc = typename std::allocator_traits<Alloc>::template
+      rebind_alloc<CartesianTreeNode<T>>;
+  using NodeTraits = std::allocator_traits<NodeAlloc>;
+
+  explicit CartesianTree(const Alloc& alloc) : alloc_(alloc) {}
+  NodePtr NewNode(const T& value, int id) {
+    NodePtr node = NodeTraits::allocate(alloc_, 1);
+    NodeTraits::construct(alloc_, node, value, id);
+    return node;
+  }
+  // Rotates left children up until there are none, so that deep trees don't
+  // need a stack.
+  void DeleteSubtree(NodePtr node) {
+    while (node) {
+      NodePtr left = node->GetLeft();
+      if (left) {
+        node->SetLeft(left->GetRight());
+        left->SetRight(node);
+        node = left;
+      } else {
+        NodePtr right = node->GetRight();
+        NodeTraits::destroy(alloc_, node);
+        NodeTraits::deallocate(alloc_, node, 1);
+        node = right;
+      }
+    }
+  }
+
+  NodeAlloc alloc_;
+  NodePtr root_ = nullptr;
+  int nodes_num_ = 0;
 };
 
 #endif  // CARTESIAN_TREE_HPP
@@ -16,14 +16,24 @@ void Print(RandomAccessIterator begin, RandomAccessIterator end) {
   std::cout << std::endl;
 }
 
+// Elements are shifted instead of being swapped, so every inserted element
+// costs one move per position instead of three.
 template <typename RandomAccessIterator>
 void InsertionSort(RandomAccessIterator begin, RandomAccessIterator end) {
+  if (begin == end) {
+    return;
+  }
   for (RandomAccessIterator it = begin + 1; it != end; ++it) {
+    if (!(*it < *(it - 1))) {
+      continue;
+    }
+    auto value = std::move(*it);
     RandomAccessIterator cur = it;
-    while (cur != begin && *cur < *(cur - 1)) {
-      std::swap(*cur, *(cur - 1));
+    do {
+      *cur = std::move(*(cur - 1));
       --cur;
-    }
+    } while (cur != begin && value < *(cur - 1));
+    *cur = std::move(value);
   }
 }
 
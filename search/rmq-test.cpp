@@ -5,6 +5,7 @@
 
 #include "sparse-table.hpp"
 #include "lca-rmq.hpp"
+#include "../alloc/tracking_new_delete.h"
 
 template <typename T>
 std::vector<T> FindMins(const std::vector<T>& data, int l, int r) {
@@ -50,11 +51,23 @@ void RunSpeedTests() {
   const auto time_now = []() {
     return std::chrono::high_resolution_clock::now();
   };
+  // Heap usage since the last reset, not counting blocks allocated before it.
+  size_t live_bytes_before = 0;
+  const auto reset_heap_stats = [&live_bytes_before]() {
+    HeapStats().Reset();
+    live_bytes_before = HeapStats().GetSnapshot().live_bytes;
+  };
+  const auto print_heap_usage = [&live_bytes_before](const char *name) {
+    const AllocationStats::Snapshot snapshot = HeapStats().GetSnapshot();
+    std::cout << name << " init memory: " << snapshot.allocations_num << " allocations, peak " << (snapshot.peak_bytes - live_bytes_before) / 1024 << " KiB." << std::endl;
+  };
+  reset_heap_stats();
   auto start1 = time_now();
   RmqLca<int> rmq;
   rmq.Init(data);
   auto end1 = time_now();
   std::cout << "Fast-RMQ init time: " << std::chrono::duration_cast<std::chrono::milliseconds>(end1 - start1).count() << " ms." << std::endl;
+  print_heap_usage("Fast-RMQ");
   auto start = time_now();
   double total_time = 0;
   for (int i = 0; i < kTestsNum; ++i) {
@@ -67,11 +80,13 @@ void RunSpeedTests() {
   total_time += std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
   std::cout << "Fast-RMQ average query time: " << total_time / kTestsNum * 1000 << " us." << std::endl;
 
+  reset_heap_stats();
   auto start2 = time_now();
   SparseTable<int> st;
   st.Init(data);
   auto end2 = time_now();
   std::cout << "SparseTable Init time: " << std::chrono::duration_cast<std::chrono::milliseconds>(end2 - start2).count() << " ms." << std::endl;
+  print_heap_usage("SparseTable");
   auto start3 = time_now();
   total_time = 0.0;
   for (int i = 0; i < kTestsNum; ++i) {
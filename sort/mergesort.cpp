@@ -4,105 +4,46 @@
 #include <random>
 #include <chrono>
 #include <climits>
+#include <cmath>
 #include <algorithm>
 #include <cassert>
 #include <type_traits>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
 
-constexpr int kMaxArraySizeForInsertionSort = 10;
+#include "mergesort.h"
 
-template <typename RandomAccessIterator>
-void InsertionSort(RandomAccessIterator begin, RandomAccessIterator end) {
-  for (RandomAccessIterator it = begin + 1; it != end; ++it) {
-    RandomAccessIterator cur = it;
-    while (cur != begin && *cur < *(cur - 1)) {
-      std::swap(*cur, *(cur - 1));
-      --cur;
-    }
+// Counts heap allocations made by the program, so tests can check that
+// in-place algorithms do not allocate. All replaced forms allocate with
+// malloc, so that every pointer freed by operator delete comes from it, e.g.
+// temporary buffers of std::stable_sort use the nothrow form. None of them are
+// inlined, otherwise GCC sees e.g. free() of pointers returned by operator new
+// and warns about mismatched allocation functions.
+std::atomic<size_t> allocations_num{0};
+
+__attribute__((noinline)) void *operator new(size_t size) {
+  ++allocations_num;
+  if (void *ptr = malloc(size)) {
+    return ptr;
   }
+  throw std::bad_alloc();
 }
 
-// Merges two sorted arrays [begin1; end1) and [begin2; end2). The result is
-// stored in |buffer_begin|. Content of |buffer_begin| is moved to input arrays.
-template <typename RandomAccessIterator>
-void Merge(RandomAccessIterator begin1, RandomAccessIterator end1,
-           RandomAccessIterator begin2, RandomAccessIterator end2,
-           RandomAccessIterator buffer_begin) {
-  while (begin1 != end1 && begin2 != end2) {
-    if (*begin1 < *begin2) {
-      std::swap(*buffer_begin, *begin1);
-      ++begin1;
-    } else {
-      std::swap(*buffer_begin, *begin2);
-      ++begin2;
-    }
-    ++buffer_begin;
-  }
-  while (begin1 != end1) {
-    std::swap(*(buffer_begin++), *(begin1++));
-  }
-  while (begin2 != end2) {
-    std::swap(*(buffer_begin++), *(begin2++));
-  }
+__attribute__((noinline)) void *operator new(
+    size_t size, const std::nothrow_t&) noexcept {
+  ++allocations_num;
+  return malloc(size);
 }
 
-// Swaps [begin; end) and [out; out + (end - begin)) buffers content.
-template <typename RandomAccessIterator>
-void Swap(RandomAccessIterator begin, RandomAccessIterator end,
-          RandomAccessIterator out) {
-  while (begin != end) {
-    std::swap(*begin, *out);
-    ++begin;
-    ++out;
-  }
+__attribute__((noinline)) void operator delete(void *ptr) noexcept {
+  free(ptr);
 }
 
-// Sorts an array using external buffer for merging.
-// Elements are swapped instead of being overwritten, so the original buffer's
-// content is preserved.
-template <typename RandomAccessIterator>
-void MergeSort(RandomAccessIterator begin, RandomAccessIterator end,
-               RandomAccessIterator buffer_begin) {
-  size_t cur_size = kMaxArraySizeForInsertionSort;
-  for (auto it = begin; it < end; it += cur_size) {
-    InsertionSort(it, it + cur_size);
-  }
-  while (cur_size < end - begin) {
-    for (auto it = begin; it + cur_size < end; it += 2 * cur_size) {
-      auto begin1 = it;
-      auto end1 = it + cur_size;
-      auto begin2 = end1;
-      auto end2 = (begin2 + cur_size < end)?begin2 + cur_size:end;
-      Merge(begin1, end1, begin2, end2, buffer_begin + (it - begin));
-      Swap(buffer_begin + (it - begin), buffer_begin + (end2 - begin), it);
-    }
-    cur_size *= 2;
-  }
-}
-
-// Sorts an array using O(1) extra memory.
-template <typename RandomAccessIterator>
-void MergeSort(RandomAccessIterator begin, RandomAccessIterator end) {
-  if (begin >= end) {
-    return;
-  }
-  RandomAccessIterator sorted_begin = (end - begin + 1) / 2 + begin;
-  MergeSort(sorted_begin, end, begin);
-  while (sorted_begin != begin) {
-    if (sorted_begin - begin <= kMaxArraySizeForInsertionSort) {
-      InsertionSort(begin, sorted_begin);
-      std::vector<typename std::remove_reference<decltype(*begin)>::type>
-          buffer(begin, sorted_begin);
-      Merge(buffer.begin(), buffer.end(), sorted_begin, end, begin);
-      sorted_begin = begin;
-    } else {
-      size_t pending_sort_size = (sorted_begin - begin) / 2;
-      RandomAccessIterator pending_sort_end = begin + pending_sort_size;
-      MergeSort(begin, pending_sort_end, pending_sort_end);
-      Merge(begin, pending_sort_end, sorted_begin, end,
-            sorted_begin - pending_sort_size);
-      sorted_begin = sorted_begin - pending_sort_size;
-    }
-  }
+__attribute__((noinline)) void operator delete(
+    void *ptr, size_t /* not used */) noexcept {
+  free(ptr);
 }
 
 std::vector<int> GenerateRandomArray(const int n) {
@@ -146,22 +87,52 @@ void TestExternalMergeSort() {
             << "ms" << std::endl;
 }
 
+// NaNs are unordered, but sorting must keep every value.
+void TestExternalMergeSortNaN() {
+  constexpr int n = 100 * 1000;
+  const std::vector<int> keys = GenerateRandomArray(n);
+  std::vector<float> a(keys.begin(), keys.end());
+  for (int i = 0; i < n; i += 997) {
+    a[i] = NAN;
+  }
+  const auto is_nan = [](float value) { return value != value; };
+  // Sorted non-NaN values of |values|.
+  const auto get_numbers = [&](const std::vector<float>& values) {
+    std::vector<float> numbers;
+    std::remove_copy_if(values.begin(), values.end(),
+                        std::back_inserter(numbers), is_nan);
+    std::sort(numbers.begin(), numbers.end());
+    return numbers;
+  };
+  const std::vector<float> numbers_reference = get_numbers(a);
+  std::vector<float> buffer(n);
+  MergeSort(a.begin(), a.end(), buffer.begin());
+  assert(std::count_if(a.begin(), a.end(), is_nan) == (n + 996) / 997);
+  assert(get_numbers(a) == numbers_reference);
+}
+
 void TestInPlaceMergeSort() {
   constexpr int n = 1000 * 1000;
   std::vector<int> a = GenerateRandomArray(n);
   std::vector<int> a_reference(a);
+  std::vector<int> a_buffered(a);
   std::vector<int> buffer(n);
 
   const auto time_now = []() {
     return std::chrono::high_resolution_clock::now();
   };
 
+  const size_t allocations_num_before = allocations_num;
   auto start1 = time_now();
   MergeSort(a.begin(), a.end());
   auto end1 = time_now();
+  assert(allocations_num == allocations_num_before);
   auto start2 = time_now();
   std::sort(a_reference.begin(), a_reference.end());
   auto end2 = time_now();
+  auto start3 = time_now();
+  MergeSort(a_buffered.begin(), a_buffered.end(), buffer.begin());
+  auto end3 = time_now();
   for (int i = 0; i < n; ++i) {
     assert(a[i] == a_reference[i]);
   }
@@ -169,8 +140,334 @@ void TestInPlaceMergeSort() {
   std::cout << "In-place MergeSort: "
             << std::chrono::duration_cast<std::chrono::milliseconds>(
                    end1 - start1).count()
+            << "ms, " << allocations_num - allocations_num_before
+            << " allocations" << std::endl;
+  std::cout << "External MergeSort: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(
+                   end3 - start3).count()
+            << "ms" << std::endl;
+  std::cout << "std::sort: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(
+                   end2 - start2).count()
             << "ms" << std::endl;
+}
+
+void TestInPlaceMergeSortStability() {
+  struct Element {
+    std::string key;
+    int order;
+    bool operator<(const Element& other) const {
+      return key < other.key;
+    }
+  };
+  for (int n : {0, 1, 2, 10, 11, 1000, 12345, 100 * 1000}) {
+    std::vector<int> keys = GenerateRandomArray(n);
+    std::vector<Element> elements(n);
+    for (int i = 0; i < n; ++i) {
+      elements[i].key = std::to_string(keys[i] & 1023);
+      elements[i].order = i;
+    }
+    const size_t allocations_num_before = allocations_num;
+    MergeSort(elements.begin(), elements.end());
+    assert(allocations_num == allocations_num_before);
+    for (int i = 1; i < n; ++i) {
+      assert(!(elements[i] < elements[i - 1]));
+      if (elements[i - 1].key == elements[i].key) {
+        assert(elements[i - 1].order < elements[i].order);
+      }
+    }
+  }
+}
+
+// Counts live objects, so the test can check that every element constructed
+// in the cache of the in-place MergeSort is destroyed.
+struct CountedElement {
+  static int live_num;
+
+  explicit CountedElement(int key) : key(key) {
+    ++live_num;
+  }
+  CountedElement(const CountedElement& other) : key(other.key) {
+    ++live_num;
+  }
+  CountedElement& operator=(const CountedElement& other) = default;
+  ~CountedElement() {
+    --live_num;
+  }
+
+  bool operator<(const CountedElement& other) const {
+    return key < other.key;
+  }
+
+  int key;
+};
+
+int CountedElement::live_num = 0;
+
+void TestInPlaceMergeSortConstruction() {
+  for (int n : {0, 1, 10, 1000, 100 * 1000}) {
+    std::vector<int> keys = GenerateRandomArray(n);
+    std::vector<CountedElement> elements;
+    elements.reserve(n);
+    for (int key : keys) {
+      elements.emplace_back(key);
+    }
+    MergeSort(elements.begin(), elements.end());
+    assert(CountedElement::live_num == n);
+    std::sort(keys.begin(), keys.end());
+    for (int i = 0; i < n; ++i) {
+      assert(elements[i].key == keys[i]);
+    }
+  }
+}
+
+void TestMoveMergeSort() {
+  // Sizes with odd and even numbers of merging levels.
+  for (int n : {0, 1, 2, 100, 257, 600, 12345}) {
+    std::vector<int> a = GenerateRandomArray(n);
+    std::vector<int> a_reference(a);
+    std::vector<int> buffer(n);
+    MoveMergeSort(a.begin(), a.end(), buffer.begin());
+    std::sort(a_reference.begin(), a_reference.end());
+    assert(a == a_reference);
+  }
+
+  // Equal keys must keep their original order.
+  struct Element {
+    int key;
+    int order;
+    bool operator<(const Element& other) const {
+      return key < other.key;
+    }
+  };
+  for (int n : {100, 1000, 10000}) {
+    std::vector<Element> elements(n);
+    for (int i = 0; i < n; ++i) {
+      elements[i].key = i * 7919 % 97;
+      elements[i].order = i;
+    }
+    std::vector<Element> buffer(n);
+    MoveMergeSort(elements.begin(), elements.end(), buffer.begin());
+    for (int i = 1; i < n; ++i) {
+      assert(elements[i - 1].key <= elements[i].key);
+      if (elements[i - 1].key == elements[i].key) {
+        assert(elements[i - 1].order < elements[i].order);
+      }
+    }
+  }
+}
+
+void TestParallelMergeSort() {
+  for (int n : {0, 1, 2, 100, 12345, 100 * 1000}) {
+    std::vector<int> a = GenerateRandomArray(n);
+    std::vector<int> a_reference(a);
+    std::vector<int> buffer(n);
+    ThreadPool pool(4);
+    ParallelMergeSort(a.begin(), a.end(), buffer.begin(), pool);
+    std::sort(a_reference.begin(), a_reference.end());
+    assert(a == a_reference);
+  }
+
+  // Equal keys must keep their original order.
+  struct Element {
+    int key;
+    int order;
+    bool operator<(const Element& other) const {
+      return key < other.key;
+    }
+  };
+  std::vector<Element> elements(200 * 1000);
+  for (size_t i = 0; i < elements.size(); ++i) {
+    elements[i].key = i * 7919 % 97;
+    elements[i].order = i;
+  }
+  std::vector<Element> buffer(elements.size());
+  ThreadPool pool(3);
+  ParallelMergeSort(elements.begin(), elements.end(), buffer.begin(), pool);
+  for (size_t i = 1; i < elements.size(); ++i) {
+    assert(elements[i - 1].key <= elements[i].key);
+    if (elements[i - 1].key == elements[i].key) {
+      assert(elements[i - 1].order < elements[i].order);
+    }
+  }
+}
+
+void RunParallelMergeSortBenchmark() {
+  constexpr int n = 10 * 1000 * 1000;
+  const std::vector<int> a = GenerateRandomArray(n);
+  std::vector<int> buffer(n);
+
+  const auto time_now = []() {
+    return std::chrono::high_resolution_clock::now();
+  };
+
+  const size_t max_threads_num =
+      std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  for (size_t threads_num = 1;; threads_num = std::min(threads_num * 2,
+                                                       max_threads_num)) {
+    ThreadPool pool(threads_num);
+    std::vector<int> data(a);
+    auto start = time_now();
+    ParallelMergeSort(data.begin(), data.end(), buffer.begin(), pool);
+    auto end = time_now();
+    assert(std::is_sorted(data.begin(), data.end()));
+    std::cout << "ParallelMergeSort, " << threads_num << " threads: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     end - start).count()
+              << "ms" << std::endl;
+    if (threads_num == max_threads_num) {
+      break;
+    }
+  }
+  std::vector<int> data(a);
+  auto start = time_now();
+  std::sort(data.begin(), data.end());
+  auto end = time_now();
   std::cout << "std::sort: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(
+                   end - start).count()
+            << "ms" << std::endl;
+}
+
+enum class Distribution {
+  kSorted,
+  kReversed,
+  kSawtooth,
+  kFewUnique,
+  kRandom,
+};
+
+const char *GetDistributionName(Distribution distribution) {
+  switch (distribution) {
+    case Distribution::kSorted: return "sorted";
+    case Distribution::kReversed: return "reversed";
+    case Distribution::kSawtooth: return "sawtooth";
+    case Distribution::kFewUnique: return "few unique";
+    case Distribution::kRandom: return "random";
+  }
+  return "";
+}
+
+std::vector<int> GenerateArray(const int n, Distribution distribution) {
+  std::vector<int> a = GenerateRandomArray(n);
+  switch (distribution) {
+    case Distribution::kSorted:
+      std::sort(a.begin(), a.end());
+      break;
+    case Distribution::kReversed:
+      std::sort(a.begin(), a.end(), std::greater<int>());
+      break;
+    case Distribution::kSawtooth:
+      for (int i = 0; i < n; ++i) {
+        a[i] = i % 1000;
+      }
+      break;
+    case Distribution::kFewUnique:
+      for (int i = 0; i < n; ++i) {
+        a[i] = a[i] & 7;
+      }
+      break;
+    case Distribution::kRandom:
+      break;
+  }
+  return a;
+}
+
+void TestNaturalMergeSort() {
+  const std::vector<Distribution> distributions = {
+      Distribution::kSorted, Distribution::kReversed, Distribution::kSawtooth,
+      Distribution::kFewUnique, Distribution::kRandom};
+  struct Element {
+    int key;
+    int order;
+    bool operator<(const Element& other) const {
+      return key < other.key;
+    }
+  };
+  for (int n : {0, 1, 2, 3, 63, 64, 65, 1000, 12345, 300 * 1000}) {
+    for (Distribution distribution : distributions) {
+      std::vector<int> keys = GenerateArray(n, distribution);
+      std::vector<Element> elements(n);
+      for (int i = 0; i < n; ++i) {
+        elements[i].key = keys[i] % 100;
+        elements[i].order = i;
+      }
+      NaturalMergeSort(elements.begin(), elements.end());
+      for (int i = 1; i < n; ++i) {
+        assert(elements[i - 1].key <= elements[i].key);
+        if (elements[i - 1].key == elements[i].key) {
+          assert(elements[i - 1].order < elements[i].order);
+        }
+      }
+
+      std::vector<int> reference(keys);
+      NaturalMergeSort(keys.begin(), keys.end());
+      std::sort(reference.begin(), reference.end());
+      assert(keys == reference);
+    }
+  }
+}
+
+void RunNaturalMergeSortBenchmark() {
+  constexpr int n = 1000 * 1000;
+  const auto time_now = []() {
+    return std::chrono::high_resolution_clock::now();
+  };
+  const auto to_ms = [](auto duration) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+        .count();
+  };
+  for (Distribution distribution :
+       {Distribution::kSorted, Distribution::kReversed,
+        Distribution::kSawtooth, Distribution::kFewUnique,
+        Distribution::kRandom}) {
+    const std::vector<int> a = GenerateArray(n, distribution);
+    std::vector<int> a1(a), a2(a), a3(a);
+    std::vector<int> buffer(n);
+
+    auto start1 = time_now();
+    NaturalMergeSort(a1.begin(), a1.end());
+    auto end1 = time_now();
+    auto start2 = time_now();
+    MergeSort(a2.begin(), a2.end(), buffer.begin());
+    auto end2 = time_now();
+    auto start3 = time_now();
+    std::stable_sort(a3.begin(), a3.end());
+    auto end3 = time_now();
+    assert(a1 == a3);
+    assert(a2 == a3);
+
+    std::cout << GetDistributionName(distribution)
+              << ": NaturalMergeSort " << to_ms(end1 - start1) << "ms"
+              << ", External MergeSort " << to_ms(end2 - start2) << "ms"
+              << ", std::stable_sort " << to_ms(end3 - start3) << "ms"
+              << std::endl;
+  }
+}
+
+template <typename T>
+void RunVectorizedMergeSortBenchmark(const char *type_name) {
+  constexpr int n = 1000 * 1000;
+  const std::vector<int> keys = GenerateRandomArray(n);
+  std::vector<T> a(keys.begin(), keys.end());
+  std::vector<T> a_reference(a);
+  std::vector<T> buffer(n);
+
+  const auto time_now = []() {
+    return std::chrono::high_resolution_clock::now();
+  };
+  auto start1 = time_now();
+  MergeSort(a.begin(), a.end(), buffer.begin());
+  auto end1 = time_now();
+  auto start2 = time_now();
+  std::sort(a_reference.begin(), a_reference.end());
+  auto end2 = time_now();
+  assert(a == a_reference);
+
+  std::cout << type_name << ": External MergeSort "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(
+                   end1 - start1).count()
+            << "ms, std::sort "
             << std::chrono::duration_cast<std::chrono::milliseconds>(
                    end2 - start2).count()
             << "ms" << std::endl;
@@ -180,8 +477,17 @@ int main() {
   TestExternalMergeSort();
   // External MergeSort: 102ms
   // std::sort: 84ms
+  TestExternalMergeSortNaN();
   TestInPlaceMergeSort();
-  // In-place MergeSort: 110ms
-  // std::sort: 84ms
+  TestInPlaceMergeSortStability();
+  TestInPlaceMergeSortConstruction();
+  TestMoveMergeSort();
+  TestParallelMergeSort();
+  RunParallelMergeSortBenchmark();
+  TestNaturalMergeSort();
+  RunNaturalMergeSortBenchmark();
+  RunVectorizedMergeSortBenchmark<int32_t>("int32");
+  RunVectorizedMergeSortBenchmark<float>("float");
+  RunVectorizedMergeSortBenchmark<int64_t>("int64");
   return 0;
 }
@@ -0,0 +1,699 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../misc/thread_pool.h"
+#include "sorting_network.h"
+
+constexpr int kMaxArraySizeForInsertionSort = 10;
+
+// Elements are shifted instead of being swapped, so every inserted element
+// costs one move per position instead of three.
+template <typename RandomAccessIterator>
+void InsertionSort(RandomAccessIterator begin, RandomAccessIterator end) {
+  if (begin == end) {
+    return;
+  }
+  for (RandomAccessIterator it = begin + 1; it != end; ++it) {
+    if (!(*it < *(it - 1))) {
+      continue;
+    }
+    auto value = std::move(*it);
+    RandomAccessIterator cur = it;
+    do {
+      *cur = std::move(*(cur - 1));
+      --cur;
+    } while (cur != begin && value < *(cur - 1));
+    *cur = std::move(value);
+  }
+}
+
+// Merges two sorted arrays [begin1; end1) and [begin2; end2). The result is
+// stored in |buffer_begin|. Content of |buffer_begin| is moved to input arrays.
+// Equal elements from the first array go first.
+template <typename RandomAccessIterator>
+void Merge(RandomAccessIterator begin1, RandomAccessIterator end1,
+           RandomAccessIterator begin2, RandomAccessIterator end2,
+           RandomAccessIterator buffer_begin) {
+  while (begin1 != end1 && begin2 != end2) {
+    if (!(*begin2 < *begin1)) {
+      std::swap(*buffer_begin, *begin1);
+      ++begin1;
+    } else {
+      std::swap(*buffer_begin, *begin2);
+      ++begin2;
+    }
+    ++buffer_begin;
+  }
+  while (begin1 != end1) {
+    std::swap(*(buffer_begin++), *(begin1++));
+  }
+  while (begin2 != end2) {
+    std::swap(*(buffer_begin++), *(begin2++));
+  }
+}
+
+// Swaps [begin; end) and [out; out + (end - begin)) buffers content.
+template <typename RandomAccessIterator>
+void Swap(RandomAccessIterator begin, RandomAccessIterator end,
+          RandomAccessIterator out) {
+  while (begin != end) {
+    std::swap(*begin, *out);
+    ++begin;
+    ++out;
+  }
+}
+
+// Number of elements sorted without touching the external buffer when the
+// keys can be sorted by vectorized sorting networks.
+constexpr size_t kVectorizedSortBlockSize = 256;
+
+// Tells whether [begin; end) can be sorted with SIMD kernels: keys must be
+// supported by SimdSortTraits and stored contiguously.
+template <typename RandomAccessIterator>
+constexpr bool CanSortVectorized() {
+  using T = typename std::iterator_traits<RandomAccessIterator>::value_type;
+  return SimdSortTraits<T>::kSupported &&
+         (std::is_pointer<RandomAccessIterator>::value ||
+          std::is_same<RandomAccessIterator,
+                       typename std::vector<T>::iterator>::value);
+}
+
+// Sorts up to kVectorizedSortBlockSize keys. Blocks of
+// kSortingNetworkBlockSize keys are sorted by sorting networks and then
+// merged by vectorized merging, ping-ponging with a buffer on the stack.
+// Blocks with NaNs take the same steps with insertion sort and scalar
+// merging, since the networks would lose values.
+template <typename T>
+void SortVectorizedBlock(T *data, size_t size) {
+  const bool vectorized = !HasNaN(data, size);
+  const size_t networks_end =
+      vectorized ? size - size % kSortingNetworkBlockSize : 0;
+  for (size_t i = 0; i < networks_end; i += kSortingNetworkBlockSize) {
+    SortNetworkBlock(data + i);
+  }
+  for (size_t i = networks_end; i < size; i += kSortingNetworkBlockSize) {
+    InsertionSort(data + i, data + std::min(i + kSortingNetworkBlockSize,
+                                            size));
+  }
+  T buffer[kVectorizedSortBlockSize];
+  T *src = data;
+  T *dst = buffer;
+  for (size_t run_size = kSortingNetworkBlockSize; run_size < size;
+       run_size *= 2) {
+    for (size_t i = 0; i < size; i += 2 * run_size) {
+      const size_t end1 = std::min(i + run_size, size);
+      const size_t end2 = std::min(i + 2 * run_size, size);
+      if (vectorized) {
+        MergeSortedArrays(src + i, src + end1, src + end1, src + end2,
+                          dst + i);
+      } else {
+        std::merge(src + i, src + end1, src + end1, src + end2, dst + i);
+      }
+    }
+    std::swap(src, dst);
+  }
+  if (src != data) {
+    std::copy(src, src + size, data);
+  }
+}
+
+// Sorts consecutive blocks of [begin; end) independently and returns their
+// size. Blocks of SIMD-friendly keys are sorted by SortVectorizedBlock, other
+// types use insertion sort.
+template <typename RandomAccessIterator>
+size_t SortSmallBlocks(RandomAccessIterator begin, RandomAccessIterator end) {
+  const size_t size = end - begin;
+  if constexpr (CanSortVectorized<RandomAccessIterator>()) {
+    for (size_t i = 0; i < size; i += kVectorizedSortBlockSize) {
+      SortVectorizedBlock(&*(begin + i),
+                          std::min(kVectorizedSortBlockSize, size - i));
+    }
+    return kVectorizedSortBlockSize;
+  } else {
+    for (size_t i = 0; i < size; i += kMaxArraySizeForInsertionSort) {
+      InsertionSort(begin + i, begin + std::min(
+          i + kMaxArraySizeForInsertionSort, size));
+    }
+    return kMaxArraySizeForInsertionSort;
+  }
+}
+
+// Sorts an array using external buffer for merging.
+// Elements are swapped instead of being overwritten, so the original buffer's
+// content is preserved. MoveMergeSort is faster when it doesn't need to be.
+// Blocks of int32_t, float and int64_t keys are sorted by SIMD sorting
+// networks and merging (see sorting_network.h) before the first merge level.
+template <typename RandomAccessIterator>
+void MergeSort(RandomAccessIterator begin, RandomAccessIterator end,
+               RandomAccessIterator buffer_begin) {
+  const size_t size = end - begin;
+  for (size_t cur_size = SortSmallBlocks(begin, end); cur_size < size;
+       cur_size *= 2) {
+    for (size_t i = 0; i + cur_size < size; i += 2 * cur_size) {
+      auto begin1 = begin + i;
+      auto end1 = begin1 + cur_size;
+      auto begin2 = end1;
+      auto end2 = begin + std::min(i + 2 * cur_size, size);
+      Merge(begin1, end1, begin2, end2, buffer_begin + i);
+      Swap(buffer_begin + i, buffer_begin + (end2 - begin), begin1);
+    }
+  }
+}
+
+// Minimal number of elements sorted by a single task before parallel merging
+// starts. Blocks of this size fit into L2 cache.
+constexpr size_t kParallelMergeSortBlockSize = 1 << 13;
+// Minimal number of output elements produced by a single merging task.
+constexpr size_t kMinParallelMergeSize = 1 << 15;
+
+// Returns how many elements of [begin1; begin1 + size1) are among the first
+// |k| elements of the stable merge of [begin1; begin1 + size1) and
+// [begin2; begin2 + size2) (the co-rank of |k|). Equal elements from the first
+// range go first.
+template <typename RandomAccessIterator>
+size_t MergeCoRank(size_t k, RandomAccessIterator begin1, size_t size1,
+                   RandomAccessIterator begin2, size_t size2) {
+  size_t lo = k > size2 ? k - size2 : 0;
+  size_t hi = std::min(k, size1);
+  while (lo < hi) {
+    const size_t i = lo + (hi - lo) / 2;
+    const size_t j = k - i;
+    if (!(*(begin2 + (j - 1)) < *(begin1 + i))) {
+      lo = i + 1;
+    } else {
+      hi = i;
+    }
+  }
+  return lo;
+}
+
+// Stable merge of [begin1; end1) and [begin2; end2) moving elements to |out|.
+template <typename InputIterator, typename OutputIterator>
+OutputIterator MoveMerge(InputIterator begin1, InputIterator end1,
+                         InputIterator begin2, InputIterator end2,
+                         OutputIterator out) {
+  while (begin1 != end1 && begin2 != end2) {
+    if (*begin2 < *begin1) {
+      *out = std::move(*begin2);
+      ++begin2;
+    } else {
+      *out = std::move(*begin1);
+      ++begin1;
+    }
+    ++out;
+  }
+  out = std::move(begin1, end1, out);
+  return std::move(begin2, end2, out);
+}
+
+// Merges adjacent pairs of sorted runs of length |run_size| from |src| into
+// |dst|, producing only the output elements [out_begin; out_end). Merge path
+// co-ranking locates the corresponding input elements, so any output range can
+// be produced independently of the others.
+template <typename RandomAccessIterator>
+void MergeRunsRange(RandomAccessIterator src, RandomAccessIterator dst,
+                    size_t size, size_t run_size, size_t out_begin,
+                    size_t out_end) {
+  size_t pair_begin = out_begin - out_begin % (2 * run_size);
+  while (pair_begin < out_end) {
+    const size_t size1 = std::min(run_size, size - pair_begin);
+    const size_t size2 = std::min(run_size, size - pair_begin - size1);
+    const size_t pair_end = pair_begin + size1 + size2;
+    RandomAccessIterator begin1 = src + pair_begin;
+    RandomAccessIterator begin2 = begin1 + size1;
+    const size_t k_begin = std::max(out_begin, pair_begin) - pair_begin;
+    const size_t k_end = std::min(out_end, pair_end) - pair_begin;
+    const size_t i_begin = MergeCoRank(k_begin, begin1, size1, begin2, size2);
+    const size_t i_end = MergeCoRank(k_end, begin1, size1, begin2, size2);
+    MoveMerge(begin1 + i_begin, begin1 + i_end,
+              begin2 + (k_begin - i_begin), begin2 + (k_end - i_end),
+              dst + (pair_begin + k_begin));
+    pair_begin = pair_end;
+  }
+}
+
+// Sorts an array using external buffer of the same size like MergeSort, but
+// merging levels move elements between the array and the buffer instead of
+// swapping them back, which halves memory traffic. Content of the buffer is
+// not preserved.
+template <typename RandomAccessIterator>
+void MoveMergeSort(RandomAccessIterator begin, RandomAccessIterator end,
+                   RandomAccessIterator buffer_begin) {
+  const size_t size = end - begin;
+  RandomAccessIterator src = begin;
+  RandomAccessIterator dst = buffer_begin;
+  bool sorted_in_buffer = false;
+  for (size_t run_size = SortSmallBlocks(begin, end); run_size < size;
+       run_size *= 2) {
+    MergeRunsRange(src, dst, size, run_size, 0, size);
+    std::swap(src, dst);
+    sorted_in_buffer = !sorted_in_buffer;
+  }
+  if (sorted_in_buffer) {
+    std::move(src, src + size, begin);
+  }
+}
+
+// Sorts an array using external buffer of the same size and threads of
+// |pool|. Unlike the sequential version, elements are moved between the array
+// and the buffer, so content of the buffer is not preserved.
+//
+// Blocks of kParallelMergeSortBlockSize elements are sorted independently by
+// MoveMergeSort, then bottom-up merging ping-pongs between the array and the buffer. Every
+// merging level is split into equal output ranges, so all threads stay busy
+// even when only two runs are left.
+template <typename RandomAccessIterator>
+void ParallelMergeSort(RandomAccessIterator begin, RandomAccessIterator end,
+                       RandomAccessIterator buffer_begin, ThreadPool& pool) {
+  const size_t size = end - begin;
+  if (size < 2) {
+    return;
+  }
+  ParallelFor(pool, 0, (size + kParallelMergeSortBlockSize - 1) /
+                           kParallelMergeSortBlockSize, 1,
+              [&](size_t blocks_begin, size_t blocks_end) {
+    for (size_t i = blocks_begin; i < blocks_end; ++i) {
+      const size_t block_begin = i * kParallelMergeSortBlockSize;
+      const size_t block_end =
+          std::min(block_begin + kParallelMergeSortBlockSize, size);
+      MoveMergeSort(begin + block_begin, begin + block_end,
+                    buffer_begin + block_begin);
+    }
+  });
+
+  RandomAccessIterator src = begin;
+  RandomAccessIterator dst = buffer_begin;
+  bool sorted_in_buffer = false;
+  for (size_t run_size = kParallelMergeSortBlockSize; run_size < size;
+       run_size *= 2) {
+    ParallelFor(pool, 0, size, kMinParallelMergeSize,
+                [&](size_t out_begin, size_t out_end) {
+      MergeRunsRange(src, dst, size, run_size, out_begin, out_end);
+    });
+    std::swap(src, dst);
+    sorted_in_buffer = !sorted_in_buffer;
+  }
+  if (sorted_in_buffer) {
+    ParallelFor(pool, 0, size, kMinParallelMergeSize,
+                [&](size_t range_begin, size_t range_end) {
+      std::move(src + range_begin, src + range_end, begin + range_begin);
+    });
+  }
+}
+
+// Number of consecutive wins of one run after which natural merge sort
+// switches to galloping. The threshold adapts to the data during merging.
+constexpr size_t kMinGallop = 7;
+
+// Returns the first element in [begin; end) which is greater than |key|.
+// Exponential search from |begin| makes it O(log d), where d is the distance
+// to the result.
+template <typename RandomAccessIterator, typename T>
+RandomAccessIterator GallopUpperBound(RandomAccessIterator begin,
+                                      RandomAccessIterator end, const T& key) {
+  const size_t size = end - begin;
+  size_t bound = 1;
+  while (bound < size && !(key < *(begin + bound))) {
+    bound *= 2;
+  }
+  return std::upper_bound(begin + bound / 2, begin + std::min(bound, size),
+                          key);
+}
+
+// Returns the first element in [begin; end) which is not less than |key|.
+template <typename RandomAccessIterator, typename T>
+RandomAccessIterator GallopLowerBound(RandomAccessIterator begin,
+                                      RandomAccessIterator end, const T& key) {
+  const size_t size = end - begin;
+  size_t bound = 1;
+  while (bound < size && *(begin + bound) < key) {
+    bound *= 2;
+  }
+  return std::lower_bound(begin + bound / 2, begin + std::min(bound, size),
+                          key);
+}
+
+// Same as GallopUpperBound, but the exponential search starts from |end|.
+template <typename RandomAccessIterator, typename T>
+RandomAccessIterator GallopUpperBoundFromRight(RandomAccessIterator begin,
+                                               RandomAccessIterator end,
+                                               const T& key) {
+  const size_t size = end - begin;
+  size_t bound = 1;
+  while (bound <= size && key < *(end - bound)) {
+    bound *= 2;
+  }
+  return std::upper_bound(bound > size ? begin : end - bound,
+                          end - bound / 2, key);
+}
+
+// Same as GallopLowerBound, but the exponential search starts from |end|.
+template <typename RandomAccessIterator, typename T>
+RandomAccessIterator GallopLowerBoundFromRight(RandomAccessIterator begin,
+                                               RandomAccessIterator end,
+                                               const T& key) {
+  const size_t size = end - begin;
+  size_t bound = 1;
+  while (bound <= size && !(*(end - bound) < key)) {
+    bound *= 2;
+  }
+  return std::lower_bound(bound > size ? begin : end - bound,
+                          end - bound / 2, key);
+}
+
+// Stable insertion sort of [begin; end) given that [begin; sorted_end) is
+// already sorted.
+template <typename RandomAccessIterator>
+void BinaryInsertionSort(RandomAccessIterator begin,
+                         RandomAccessIterator sorted_end,
+                         RandomAccessIterator end) {
+  for (RandomAccessIterator it = sorted_end; it < end; ++it) {
+    RandomAccessIterator pos = std::upper_bound(begin, it, *it);
+    if (pos != it) {
+      auto value = std::move(*it);
+      std::move_backward(pos, it, it + 1);
+      *pos = std::move(value);
+    }
+  }
+}
+
+// Returns end of the run starting at |begin|. Strictly descending runs are
+// reversed, which keeps the sort stable.
+template <typename RandomAccessIterator>
+RandomAccessIterator FindRunAndMakeAscending(RandomAccessIterator begin,
+                                             RandomAccessIterator end) {
+  RandomAccessIterator run_end = begin + 1;
+  if (run_end == end) {
+    return run_end;
+  }
+  if (*run_end < *begin) {
+    while (run_end != end && *run_end < *(run_end - 1)) {
+      ++run_end;
+    }
+    std::reverse(begin, run_end);
+  } else {
+    while (run_end != end && !(*run_end < *(run_end - 1))) {
+      ++run_end;
+    }
+  }
+  return run_end;
+}
+
+// Runs shorter than the returned value are extended by binary insertion sort,
+// so that the number of runs is a power of two or slightly less.
+inline size_t ComputeMinRunSize(size_t size) {
+  size_t low_bits = 0;
+  while (size >= 64) {
+    low_bits |= size & 1;
+    size >>= 1;
+  }
+  return size + low_bits;
+}
+
+// Merges [begin1; begin1 + size1) and [begin2; begin2 + size2) stored one
+// after another. The first run must already be moved to |buffer|, it's merged
+// from the left.
+template <typename RandomAccessIterator, typename BufferIterator>
+void MergeLow(RandomAccessIterator begin1, size_t size1,
+              RandomAccessIterator begin2, size_t size2,
+              BufferIterator buffer, size_t& min_gallop) {
+  BufferIterator cur1 = buffer;
+  BufferIterator end1 = buffer + size1;
+  RandomAccessIterator cur2 = begin2;
+  RandomAccessIterator end2 = begin2 + size2;
+  RandomAccessIterator out = begin1;
+  while (cur1 != end1 && cur2 != end2) {
+    size_t count1 = 0;
+    size_t count2 = 0;
+    while (cur1 != end1 && cur2 != end2 && count1 < min_gallop &&
+           count2 < min_gallop) {
+      if (*cur2 < *cur1) {
+        *(out++) = std::move(*(cur2++));
+        ++count2;
+        count1 = 0;
+      } else {
+        *(out++) = std::move(*(cur1++));
+        ++count1;
+        count2 = 0;
+      }
+    }
+    // One of the runs keeps winning: copy whole blocks found by galloping.
+    while (cur1 != end1 && cur2 != end2) {
+      BufferIterator next1 = GallopUpperBound(cur1, end1, *cur2);
+      count1 = next1 - cur1;
+      out = std::move(cur1, next1, out);
+      cur1 = next1;
+      if (cur1 == end1) {
+        break;
+      }
+      RandomAccessIterator next2 = GallopLowerBound(cur2, end2, *cur1);
+      count2 = next2 - cur2;
+      out = std::move(cur2, next2, out);
+      cur2 = next2;
+      if (count1 < kMinGallop && count2 < kMinGallop) {
+        ++min_gallop;
+        break;
+      }
+      if (min_gallop > 1) {
+        --min_gallop;
+      }
+    }
+  }
+  // Remaining elements of the second run are already in place.
+  std::move(cur1, end1, out);
+}
+
+// Same as MergeLow, but the second run must already be moved to |buffer|, it's
+// merged from the right.
+template <typename RandomAccessIterator, typename BufferIterator>
+void MergeHigh(RandomAccessIterator begin1, size_t size1,
+               RandomAccessIterator begin2, size_t size2,
+               BufferIterator buffer, size_t& min_gallop) {
+  RandomAccessIterator cur1 = begin1 + size1;
+  BufferIterator cur2 = buffer + size2;
+  RandomAccessIterator out = begin2 + size2;
+  while (cur1 != begin1 && cur2 != buffer) {
+    size_t count1 = 0;
+    size_t count2 = 0;
+    while (cur1 != begin1 && cur2 != buffer && count1 < min_gallop &&
+           count2 < min_gallop) {
+      if (*(cur2 - 1) < *(cur1 - 1)) {
+        *(--out) = std::move(*(--cur1));
+        ++count1;
+        count2 = 0;
+      } else {
+        *(--out) = std::move(*(--cur2));
+        ++count2;
+        count1 = 0;
+      }
+    }
+    while (cur1 != begin1 && cur2 != buffer) {
+      RandomAccessIterator next1 =
+          GallopUpperBoundFromRight(begin1, cur1, *(cur2 - 1));
+      count1 = cur1 - next1;
+      out = std::move_backward(next1, cur1, out);
+      cur1 = next1;
+      if (cur1 == begin1) {
+        break;
+      }
+      BufferIterator next2 =
+          GallopLowerBoundFromRight(buffer, cur2, *(cur1 - 1));
+      count2 = cur2 - next2;
+      out = std::move_backward(next2, cur2, out);
+      cur2 = next2;
+      if (count1 < kMinGallop && count2 < kMinGallop) {
+        ++min_gallop;
+        break;
+      }
+      if (min_gallop > 1) {
+        --min_gallop;
+      }
+    }
+  }
+  // Remaining elements of the first run are already in place.
+  std::move_backward(buffer, cur2, out);
+}
+
+// Merges adjacent sorted runs [begin; middle) and [middle; end). The buffer
+// holds only the shorter part of the runs which is actually out of place.
+template <typename RandomAccessIterator, typename T>
+void MergeAdjacentRuns(RandomAccessIterator begin, RandomAccessIterator middle,
+                       RandomAccessIterator end, std::vector<T>& buffer,
+                       size_t& min_gallop) {
+  // Elements of the first run not greater than the first element of the
+  // second run are already in place, and so are elements of the second run
+  // not less than the last element of the first run.
+  begin = GallopUpperBound(begin, middle, *middle);
+  if (begin == middle) {
+    return;
+  }
+  end = GallopLowerBoundFromRight(middle, end, *(middle - 1));
+  const size_t size1 = middle - begin;
+  const size_t size2 = end - middle;
+  if (buffer.size() < std::min(size1, size2)) {
+    buffer.resize(std::min(size1, size2));
+  }
+  if (size1 <= size2) {
+    std::move(begin, middle, buffer.begin());
+    MergeLow(begin, size1, middle, size2, buffer.begin(), min_gallop);
+  } else {
+    std::move(middle, end, buffer.begin());
+    MergeHigh(begin, size1, middle, size2, buffer.begin(), min_gallop);
+  }
+}
+
+// Stable adaptive natural merge sort (TimSort). Existing ascending and
+// strictly descending runs are detected and merged, so nearly sorted input is
+// sorted in close to linear time. Extra memory is bounded by half of the
+// array.
+template <typename RandomAccessIterator>
+void NaturalMergeSort(RandomAccessIterator begin, RandomAccessIterator end) {
+  using ValueType = typename std::iterator_traits<RandomAccessIterator>::
+      value_type;
+  const size_t size = end - begin;
+  if (size < 2) {
+    return;
+  }
+  const size_t min_run_size = ComputeMinRunSize(size);
+  std::vector<ValueType> buffer;
+  size_t min_gallop = kMinGallop;
+  // Pending runs as [begin offset; size). Run sizes on the stack decrease at
+  // least as fast as Fibonacci numbers, so it stays O(log(n)) deep.
+  std::vector<std::pair<size_t, size_t>> runs;
+  const auto merge_at = [&](size_t i) {
+    RandomAccessIterator run_begin = begin + runs[i].first;
+    RandomAccessIterator run_middle = run_begin + runs[i].second;
+    MergeAdjacentRuns(run_begin, run_middle, run_middle + runs[i + 1].second,
+                      buffer, min_gallop);
+    runs[i].second += runs[i + 1].second;
+    runs.erase(runs.begin() + i + 1);
+  };
+
+  RandomAccessIterator run_begin = begin;
+  while (run_begin != end) {
+    RandomAccessIterator run_end = FindRunAndMakeAscending(run_begin, end);
+    if (static_cast<size_t>(run_end - run_begin) < min_run_size) {
+      RandomAccessIterator forced_end =
+          (static_cast<size_t>(end - run_begin) > min_run_size) ?
+              run_begin + min_run_size : end;
+      BinaryInsertionSort(run_begin, run_end, forced_end);
+      run_end = forced_end;
+    }
+    runs.emplace_back(run_begin - begin, run_end - run_begin);
+    run_begin = run_end;
+
+    // Restores invariants |Z| > |Y| + |X| and |Y| > |X| for the three top
+    // runs (checked four deep to keep them valid for the whole stack).
+    while (runs.size() > 1) {
+      size_t n = runs.size() - 2;
+      if ((n > 0 &&
+           runs[n - 1].second <= runs[n].second + runs[n + 1].second) ||
+          (n > 1 &&
+           runs[n - 2].second <= runs[n - 1].second + runs[n].second)) {
+        if (runs[n - 1].second < runs[n + 1].second) {
+          --n;
+        }
+      } else if (runs[n].second > runs[n + 1].second) {
+        break;
+      }
+      merge_at(n);
+    }
+  }
+  while (runs.size() > 1) {
+    size_t n = runs.size() - 2;
+    if (n > 0 && runs[n - 1].second < runs[n + 1].second) {
+      --n;
+    }
+    merge_at(n);
+  }
+}
+
+// Size in bytes of the on-stack cache used by the in-place MergeSort.
+constexpr size_t kInPlaceMergeCacheBytes = 16 * 1024;
+
+// Stable merge of adjacent sorted runs [begin; middle) and [middle; end)
+// without heap allocations. Runs are split with binary search and a rotation
+// (as in std::inplace_merge without buffer) until the shorter one fits into
+// |cache| of |cache_size| elements, and then merged through it. |cache| is
+// uninitialized storage: elements are constructed in it for a merge and
+// destroyed afterwards.
+template <typename RandomAccessIterator, typename T>
+void MergeInPlace(RandomAccessIterator begin, RandomAccessIterator middle,
+                  RandomAccessIterator end, T *cache, size_t cache_size) {
+  size_t min_gallop = kMinGallop;
+  while (begin != middle && middle != end) {
+    begin = GallopUpperBound(begin, middle, *middle);
+    if (begin == middle) {
+      return;
+    }
+    end = GallopLowerBoundFromRight(middle, end, *(middle - 1));
+    const size_t size1 = middle - begin;
+    const size_t size2 = end - middle;
+    if (size1 <= cache_size && size1 <= size2) {
+      std::uninitialized_move(begin, middle, cache);
+      MergeLow(begin, size1, middle, size2, cache, min_gallop);
+      std::destroy(cache, cache + size1);
+      return;
+    }
+    if (size2 <= cache_size) {
+      std::uninitialized_move(middle, end, cache);
+      MergeHigh(begin, size1, middle, size2, cache, min_gallop);
+      std::destroy(cache, cache + size2);
+      return;
+    }
+    RandomAccessIterator cut1, cut2;
+    if (size1 > size2) {
+      cut1 = begin + size1 / 2;
+      cut2 = std::lower_bound(middle, end, *cut1);
+    } else {
+      cut2 = middle + size2 / 2;
+      cut1 = std::upper_bound(begin, middle, *cut2);
+    }
+    RandomAccessIterator new_middle = std::rotate(cut1, middle, cut2);
+    // Recursion goes into the smaller part, so its depth is O(log(n)).
+    if ((new_middle - begin) < (end - new_middle)) {
+      MergeInPlace(begin, cut1, new_middle, cache, cache_size);
+      begin = new_middle;
+      middle = cut2;
+    } else {
+      MergeInPlace(new_middle, cut2, end, cache, cache_size);
+      end = new_middle;
+      middle = cut1;
+    }
+  }
+}
+
+// Stable sort using O(1) extra memory: a fixed-size cache on the stack and no
+// heap allocations. Blocks sorted by SortSmallBlocks are merged bottom-up by
+// MergeInPlace.
+template <typename RandomAccessIterator>
+void MergeSort(RandomAccessIterator begin, RandomAccessIterator end) {
+  using ValueType = typename std::iterator_traits<RandomAccessIterator>::
+      value_type;
+  constexpr size_t kCacheSize =
+      std::max<size_t>(kInPlaceMergeCacheBytes / sizeof(ValueType), 16);
+  const size_t size = end - begin;
+  if (size < 2) {
+    return;
+  }
+  // Elements are constructed in the cache only while they are merged, so
+  // their types need no default constructor.
+  alignas(ValueType) unsigned char cache_storage[kCacheSize *
+                                                 sizeof(ValueType)];
+  ValueType *cache = reinterpret_cast<ValueType*>(cache_storage);
+  for (size_t cur_size = SortSmallBlocks(begin, end); cur_size < size;
+       cur_size *= 2) {
+    for (size_t i = 0; i + cur_size < size; i += 2 * cur_size) {
+      MergeInPlace(begin + i, begin + (i + cur_size),
+                   begin + std::min(i + 2 * cur_size, size), cache,
+                   kCacheSize);
+    }
+  }
+}
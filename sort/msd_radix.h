@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "../misc/thread_pool.h"
+
+// In-place MSD radix sort (American flag sort) for variable-length keys such
+// as std::string or std::vector<uint8_t>. Keys are compared lexicographically
+// byte by byte, so a common prefix is scanned only once per radix level
+// instead of on every comparison.
+//
+// If |lcp| is not null it receives the longest common prefix array of the
+// sorted sequence: lcp[0] = 0, lcp[i] = LCP(key[i - 1], key[i]).
+
+// Buckets smaller than this are sorted by multikey quicksort.
+constexpr size_t kMaxBucketSizeForMultikeyQuickSort = 64;
+// Ranges smaller than this are sorted by insertion sort.
+constexpr size_t kMaxBucketSizeForStringInsertionSort = 8;
+// Buckets larger than this are sorted in parallel.
+constexpr size_t kMinBucketSizeForParallelSort = 1 << 14;
+
+namespace msd_radix_internal {
+
+// 0 denotes end of key, so shorter keys go before their extensions.
+constexpr size_t kAlphabetSize = 257;
+
+template <typename Key>
+inline size_t CharAt(const Key& key, size_t depth) {
+  return depth < key.size() ? static_cast<uint8_t>(key[depth]) + 1 : 0;
+}
+
+// Returns length of the common prefix of |a| and |b| given that their first
+// |depth| characters are equal.
+template <typename Key>
+size_t CommonPrefix(const Key& a, const Key& b, size_t depth) {
+  const size_t max_depth = std::min(a.size(), b.size());
+  while (depth < max_depth &&
+         static_cast<uint8_t>(a[depth]) == static_cast<uint8_t>(b[depth])) {
+    ++depth;
+  }
+  return depth;
+}
+
+template <typename Key>
+bool Less(const Key& a, const Key& b, size_t depth) {
+  depth = CommonPrefix(a, b, depth);
+  return CharAt(a, depth) < CharAt(b, depth);
+}
+
+// Sorts keys sharing first |depth| characters. lcp[0] is never written: it is
+// owned by the caller which knows the preceding range.
+template <typename RandomAccessIterator>
+void InsertionSort(RandomAccessIterator begin, RandomAccessIterator end,
+                   size_t depth, size_t *lcp) {
+  if (end - begin < 2) {
+    return;
+  }
+  for (RandomAccessIterator it = begin + 1; it < end; ++it) {
+    RandomAccessIterator cur = it;
+    while (cur != begin && Less(*cur, *(cur - 1), depth)) {
+      std::swap(*cur, *(cur - 1));
+      --cur;
+    }
+  }
+  if (lcp != nullptr) {
+    for (RandomAccessIterator it = begin + 1; it < end; ++it) {
+      lcp[it - begin] = CommonPrefix(*(it - 1), *it, depth);
+    }
+  }
+}
+
+// Bentley-Sedgewick multikey quicksort.
+template <typename RandomAccessIterator>
+void MultikeyQuickSort(RandomAccessIterator begin, RandomAccessIterator end,
+                       size_t depth, size_t *lcp) {
+  while (static_cast<size_t>(end - begin) >
+         kMaxBucketSizeForStringInsertionSort) {
+    const size_t n = end - begin;
+    size_t a = CharAt(*begin, depth);
+    size_t b = CharAt(*(begin + n / 2), depth);
+    size_t c = CharAt(*(end - 1), depth);
+    const size_t pivot = std::max(std::min(a, b), std::min(std::max(a, b), c));
+    // [begin..lt) < pivot, [lt..i) == pivot, (gt..end) > pivot.
+    RandomAccessIterator lt = begin, i = begin, gt = end - 1;
+    while (i <= gt) {
+      const size_t cur = CharAt(*i, depth);
+      if (cur < pivot) {
+        std::swap(*i, *lt);
+        ++lt;
+        ++i;
+      } else if (cur > pivot) {
+        std::swap(*i, *gt);
+        --gt;
+      } else {
+        ++i;
+      }
+    }
+    ++gt;
+    if (lcp != nullptr) {
+      if (lt != begin) {
+        lcp[lt - begin] = depth;
+      }
+      if (gt != end) {
+        lcp[gt - begin] = depth;
+      }
+    }
+    MultikeyQuickSort(begin, lt, depth, lcp);
+    MultikeyQuickSort(gt, end, depth, lcp == nullptr ? nullptr :
+                                          lcp + (gt - begin));
+    if (pivot == 0) {
+      // All keys in the middle part have ended and are equal.
+      if (lcp != nullptr) {
+        std::fill(lcp + (lt - begin) + 1, lcp + (gt - begin), depth);
+      }
+      return;
+    }
+    if (lcp != nullptr) {
+      lcp += lt - begin;
+    }
+    begin = lt;
+    end = gt;
+    ++depth;
+  }
+  InsertionSort(begin, end, depth, lcp);
+}
+
+template <typename RandomAccessIterator>
+void AmericanFlagSort(RandomAccessIterator begin, RandomAccessIterator end,
+                      size_t depth, size_t *lcp, TaskGroup *group) {
+  std::array<size_t, kAlphabetSize> counts;
+  std::array<size_t, kAlphabetSize + 1> bucket_begin;
+  std::array<size_t, kAlphabetSize> next;
+  while (static_cast<size_t>(end - begin) >
+         kMaxBucketSizeForMultikeyQuickSort) {
+    const size_t n = end - begin;
+    counts.fill(0);
+    for (RandomAccessIterator it = begin; it != end; ++it) {
+      ++counts[CharAt(*it, depth)];
+    }
+    bucket_begin[0] = 0;
+    for (size_t c = 0; c < kAlphabetSize; ++c) {
+      bucket_begin[c + 1] = bucket_begin[c] + counts[c];
+    }
+    // All keys share one more character: skip the whole common prefix of the
+    // range in one pass instead of counting it character by character.
+    const size_t first_char = CharAt(*begin, depth);
+    if (counts[first_char] == n) {
+      if (first_char == 0) {
+        if (lcp != nullptr) {
+          std::fill(lcp + 1, lcp + n, depth);
+        }
+        return;
+      }
+      size_t common_prefix = begin->size();
+      for (RandomAccessIterator it = begin + 1;
+           it != end && common_prefix > depth + 1; ++it) {
+        const size_t max_depth = std::min(common_prefix, it->size());
+        size_t cur_depth = depth + 1;
+        while (cur_depth < max_depth &&
+               (*begin)[cur_depth] == (*it)[cur_depth]) {
+          ++cur_depth;
+        }
+        common_prefix = cur_depth;
+      }
+      depth = common_prefix;
+      continue;
+    }
+
+    // Permutes keys into their buckets following the permutation cycles.
+    std::copy(bucket_begin.begin(), bucket_begin.end() - 1, next.begin());
+    for (size_t c = 0; c < kAlphabetSize; ++c) {
+      while (next[c] < bucket_begin[c + 1]) {
+        size_t cur_char = CharAt(*(begin + next[c]), depth);
+        while (cur_char != c) {
+          std::swap(*(begin + next[c]), *(begin + next[cur_char]++));
+          cur_char = CharAt(*(begin + next[c]), depth);
+        }
+        ++next[c];
+      }
+    }
+
+    if (lcp != nullptr) {
+      for (size_t c = 0; c < kAlphabetSize; ++c) {
+        if (bucket_begin[c] != 0 && counts[c] != 0) {
+          lcp[bucket_begin[c]] = depth;
+        }
+      }
+      if (counts[0] > 1) {
+        std::fill(lcp + 1, lcp + counts[0], depth);
+      }
+    }
+    for (size_t c = 1; c < kAlphabetSize; ++c) {
+      const size_t bucket_size = counts[c];
+      if (bucket_size <= 1) {
+        continue;
+      }
+      RandomAccessIterator bucket = begin + bucket_begin[c];
+      size_t *bucket_lcp = lcp == nullptr ? nullptr : lcp + bucket_begin[c];
+      if (group != nullptr && bucket_size >= kMinBucketSizeForParallelSort) {
+        group->Run([bucket, bucket_size, depth, bucket_lcp, group]() {
+          AmericanFlagSort(bucket, bucket + bucket_size, depth + 1,
+                           bucket_lcp, group);
+        });
+      } else {
+        AmericanFlagSort(bucket, bucket + bucket_size, depth + 1, bucket_lcp,
+                         group);
+      }
+    }
+    return;
+  }
+  MultikeyQuickSort(begin, end, depth, lcp);
+}
+
+}  // namespace msd_radix_internal
+
+template <typename RandomAccessIterator>
+void MsdRadixSort(RandomAccessIterator begin, RandomAccessIterator end,
+                  size_t *lcp = nullptr) {
+  if (begin == end) {
+    return;
+  }
+  if (lcp != nullptr) {
+    lcp[0] = 0;
+  }
+  msd_radix_internal::AmericanFlagSort(begin, end, 0, lcp, nullptr);
+}
+
+// Same as above, but buckets larger than kMinBucketSizeForParallelSort are
+// sorted by tasks of |pool|.
+template <typename RandomAccessIterator>
+void ParallelMsdRadixSort(RandomAccessIterator begin, RandomAccessIterator end,
+                          ThreadPool& pool, size_t *lcp = nullptr) {
+  if (begin == end) {
+    return;
+  }
+  if (lcp != nullptr) {
+    lcp[0] = 0;
+  }
+  TaskGroup group(pool);
+  msd_radix_internal::AmericanFlagSort(begin, end, 0, lcp, &group);
+  group.Wait();
+}
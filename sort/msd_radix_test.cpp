@@ -0,0 +1,133 @@
+#include "msd_radix.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+std::vector<std::string> GenerateRandomStrings(int n, int max_length,
+                                               int alphabet_size,
+                                               const std::string& prefix) {
+  std::default_random_engine generator(n);
+  std::uniform_int_distribution<int> length_distribution(0, max_length);
+  std::uniform_int_distribution<int> char_distribution(0, alphabet_size - 1);
+  std::vector<std::string> res(n, prefix);
+  for (auto& s : res) {
+    int length = length_distribution(generator);
+    for (int i = 0; i < length; ++i) {
+      s.push_back('a' + char_distribution(generator));
+    }
+  }
+  return res;
+}
+
+size_t CommonPrefixLength(const std::string& a, const std::string& b) {
+  size_t res = 0;
+  while (res < a.size() && res < b.size() && a[res] == b[res]) {
+    ++res;
+  }
+  return res;
+}
+
+void CheckSorted(const std::vector<std::string>& data,
+                 std::vector<std::string> reference,
+                 const std::vector<size_t>& lcp) {
+  std::sort(reference.begin(), reference.end());
+  assert(data == reference);
+  assert(lcp[0] == 0);
+  for (size_t i = 1; i < data.size(); ++i) {
+    assert(lcp[i] == CommonPrefixLength(data[i - 1], data[i]));
+  }
+}
+
+void TestSmallInputs() {
+  std::cout << "Testing small inputs..." << std::flush;
+  for (int n = 1; n < 300; ++n) {
+    for (int alphabet_size : {1, 2, 26}) {
+      auto data = GenerateRandomStrings(n, 6, alphabet_size, "");
+      auto reference = data;
+      std::vector<size_t> lcp(n);
+      MsdRadixSort(data.begin(), data.end(), lcp.data());
+      CheckSorted(data, reference, lcp);
+    }
+  }
+  std::cout << "ok!" << std::endl;
+}
+
+void TestBytes() {
+  std::cout << "Testing byte vectors..." << std::flush;
+  std::default_random_engine generator(0);
+  std::vector<std::vector<uint8_t>> data(10000);
+  for (auto& v : data) {
+    v.resize(generator() % 5);
+    for (auto& byte : v) {
+      byte = generator() % 4 == 0 ? 0 : 255;
+    }
+  }
+  auto reference = data;
+  std::sort(reference.begin(), reference.end());
+  MsdRadixSort(data.begin(), data.end());
+  assert(data == reference);
+  std::cout << "ok!" << std::endl;
+}
+
+void TestParallel(int n, const std::string& prefix) {
+  std::cout << "Testing parallel sort..." << std::flush;
+  auto data = GenerateRandomStrings(n, 20, 4, prefix);
+  auto reference = data;
+  std::vector<size_t> lcp(n);
+  ThreadPool pool;
+  ParallelMsdRadixSort(data.begin(), data.end(), pool, lcp.data());
+  CheckSorted(data, reference, lcp);
+  std::cout << "ok!" << std::endl;
+}
+
+void RunBenchmark(int n, const std::string& prefix) {
+  auto data = GenerateRandomStrings(n, 30, 26, prefix);
+  auto data_parallel = data;
+  auto data_reference = data;
+  std::vector<size_t> lcp(n);
+  ThreadPool pool;
+
+  const auto time_now = []() {
+    return std::chrono::high_resolution_clock::now();
+  };
+  const auto print_duration = [](const char *name, auto start, auto end) {
+    std::cout << name << ": "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     end - start).count()
+              << "ms" << std::endl;
+  };
+
+  std::cout << "Sorting " << n << " strings with " << prefix.size()
+            << " characters long common prefix:" << std::endl;
+  auto start1 = time_now();
+  MsdRadixSort(data.begin(), data.end(), lcp.data());
+  auto end1 = time_now();
+  auto start2 = time_now();
+  ParallelMsdRadixSort(data_parallel.begin(), data_parallel.end(), pool);
+  auto end2 = time_now();
+  auto start3 = time_now();
+  std::sort(data_reference.begin(), data_reference.end());
+  auto end3 = time_now();
+  assert(data == data_reference);
+  assert(data_parallel == data_reference);
+
+  print_duration("MsdRadixSort (with LCP)", start1, end1);
+  print_duration("ParallelMsdRadixSort", start2, end2);
+  print_duration("std::sort", start3, end3);
+}
+
+int main() {
+  TestSmallInputs();
+  TestBytes();
+  TestParallel(200000, "");
+  TestParallel(200000, std::string(100, 'x'));
+  RunBenchmark(1000 * 1000, "");
+  RunBenchmark(1000 * 1000, std::string(50, 'x'));
+  std::cout << "All tests passed! :)" << std::endl;
+  return 0;
+}
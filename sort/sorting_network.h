@@ -0,0 +1,372 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Branchless sorting of small blocks of arithmetic keys with AVX2 bitonic
+// sorting networks, and a vectorized merge of sorted arrays built on the same
+// bitonic merging network.
+//
+// SimdSortTraits<T>::kSupported tells whether the current target has kernels
+// for T (int32_t, float and int64_t with AVX2). Vectorized merging is not
+// stable, which is unobservable for integers; for floats +0.0 and -0.0 may
+// change their relative order.
+//
+// NaNs are not supported: vector min and max return one of their operands
+// for NaNs, so a network may duplicate some values and drop others. Callers
+// check their input with HasNaN and sort it with scalar code instead.
+
+template <typename T>
+struct SimdSortTraits {
+  static constexpr bool kSupported = false;
+};
+
+#ifdef __AVX2__
+
+namespace sorting_network_internal {
+
+// Returns blend mask of lanes which take the maximum on a compare-exchange
+// stage between lanes i and i ^ |stride|, in blocks of |block_size| lanes
+// sorted alternately ascending and descending.
+constexpr int GetMaxLanesMask(int lanes, int stride, int block_size) {
+  int mask = 0;
+  for (int i = 0; i < lanes; ++i) {
+    if (((i & stride) != 0) != ((i & block_size) != 0)) {
+      mask |= 1 << i;
+    }
+  }
+  return mask;
+}
+
+// Expands 4-lane blend mask to the corresponding 8-lane one.
+constexpr int ExpandMask64To32(int mask) {
+  int res = 0;
+  for (int i = 0; i < 4; ++i) {
+    if (mask & (1 << i)) {
+      res |= 3 << (2 * i);
+    }
+  }
+  return res;
+}
+
+struct Int32x8 {
+  using Value = int32_t;
+  using Vector = __m256i;
+  static constexpr int kLanes = 8;
+
+  static Vector Load(const Value *p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+  static void Store(Value *p, Vector v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+  }
+  static Vector Min(Vector a, Vector b) {
+    return _mm256_min_epi32(a, b);
+  }
+  static Vector Max(Vector a, Vector b) {
+    return _mm256_max_epi32(a, b);
+  }
+  // Swaps lanes i and i ^ kStride.
+  template <int kStride>
+  static Vector SwapLanes(Vector v) {
+    if constexpr (kStride == 1) {
+      return _mm256_shuffle_epi32(v, 0xB1);
+    } else if constexpr (kStride == 2) {
+      return _mm256_shuffle_epi32(v, 0x4E);
+    } else {
+      return _mm256_permute2x128_si256(v, v, 1);
+    }
+  }
+  template <int kMask>
+  static Vector Blend(Vector a, Vector b) {
+    return _mm256_blend_epi32(a, b, kMask);
+  }
+  static Vector Reverse(Vector v) {
+    return _mm256_permutevar8x32_epi32(
+        v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+  }
+};
+
+struct Float32x8 {
+  using Value = float;
+  using Vector = __m256;
+  static constexpr int kLanes = 8;
+
+  static Vector Load(const Value *p) {
+    return _mm256_loadu_ps(p);
+  }
+  static void Store(Value *p, Vector v) {
+    _mm256_storeu_ps(p, v);
+  }
+  static Vector Min(Vector a, Vector b) {
+    return _mm256_min_ps(a, b);
+  }
+  static Vector Max(Vector a, Vector b) {
+    return _mm256_max_ps(a, b);
+  }
+  template <int kStride>
+  static Vector SwapLanes(Vector v) {
+    if constexpr (kStride == 1) {
+      return _mm256_permute_ps(v, 0xB1);
+    } else if constexpr (kStride == 2) {
+      return _mm256_permute_ps(v, 0x4E);
+    } else {
+      return _mm256_permute2f128_ps(v, v, 1);
+    }
+  }
+  template <int kMask>
+  static Vector Blend(Vector a, Vector b) {
+    return _mm256_blend_ps(a, b, kMask);
+  }
+  static Vector Reverse(Vector v) {
+    return _mm256_permutevar8x32_ps(
+        v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+  }
+};
+
+// AVX2 has no 64-bit min/max, so they are emulated with compare and blend.
+struct Int64x4 {
+  using Value = int64_t;
+  using Vector = __m256i;
+  static constexpr int kLanes = 4;
+
+  static Vector Load(const Value *p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+  static void Store(Value *p, Vector v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+  }
+  static Vector Min(Vector a, Vector b) {
+    return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+  }
+  static Vector Max(Vector a, Vector b) {
+    return _mm256_blendv_epi8(b, a, _mm256_cmpgt_epi64(a, b));
+  }
+  template <int kStride>
+  static Vector SwapLanes(Vector v) {
+    if constexpr (kStride == 1) {
+      return _mm256_permute4x64_epi64(v, 0xB1);
+    } else {
+      return _mm256_permute4x64_epi64(v, 0x4E);
+    }
+  }
+  template <int kMask>
+  static Vector Blend(Vector a, Vector b) {
+    return _mm256_blend_epi32(a, b, ExpandMask64To32(kMask));
+  }
+  static Vector Reverse(Vector v) {
+    return _mm256_permute4x64_epi64(v, 0x1B);
+  }
+};
+
+template <typename Traits, int kStride, int kBlockSize>
+typename Traits::Vector CompareExchangeLanes(typename Traits::Vector v) {
+  const auto swapped = Traits::template SwapLanes<kStride>(v);
+  return Traits::template Blend<
+      GetMaxLanesMask(Traits::kLanes, kStride, kBlockSize)>(
+          Traits::Min(v, swapped), Traits::Max(v, swapped));
+}
+
+// Sorts a bitonic vector (the last log(kLanes) stages of bitonic merge).
+template <typename Traits>
+typename Traits::Vector MergeBitonicVector(typename Traits::Vector v) {
+  constexpr int kLanes = Traits::kLanes;
+  if constexpr (kLanes == 8) {
+    v = CompareExchangeLanes<Traits, 4, kLanes>(v);
+  }
+  v = CompareExchangeLanes<Traits, 2, kLanes>(v);
+  return CompareExchangeLanes<Traits, 1, kLanes>(v);
+}
+
+// Bitonic sort of a single vector.
+template <typename Traits>
+typename Traits::Vector SortVector(typename Traits::Vector v) {
+  v = CompareExchangeLanes<Traits, 1, 2>(v);
+  v = CompareExchangeLanes<Traits, 2, 4>(v);
+  v = CompareExchangeLanes<Traits, 1, 4>(v);
+  if constexpr (Traits::kLanes == 8) {
+    v = CompareExchangeLanes<Traits, 4, 8>(v);
+    v = CompareExchangeLanes<Traits, 2, 8>(v);
+    v = CompareExchangeLanes<Traits, 1, 8>(v);
+  }
+  return v;
+}
+
+// Sorts a bitonic sequence stored in |kVectors| vectors.
+template <typename Traits, int kVectors>
+void MergeBitonicVectors(typename Traits::Vector *v) {
+  for (int stride = kVectors / 2; stride > 0; stride /= 2) {
+    for (int i = 0; i < kVectors; ++i) {
+      if ((i & stride) == 0) {
+        const auto min = Traits::Min(v[i], v[i + stride]);
+        v[i + stride] = Traits::Max(v[i], v[i + stride]);
+        v[i] = min;
+      }
+    }
+  }
+  for (int i = 0; i < kVectors; ++i) {
+    v[i] = MergeBitonicVector<Traits>(v[i]);
+  }
+}
+
+// Sorts kVectors * kLanes elements stored in |v|.
+template <typename Traits, int kVectors>
+void SortVectors(typename Traits::Vector *v) {
+  if constexpr (kVectors == 1) {
+    v[0] = SortVector<Traits>(v[0]);
+  } else {
+    constexpr int kHalf = kVectors / 2;
+    SortVectors<Traits, kHalf>(v);
+    SortVectors<Traits, kHalf>(v + kHalf);
+    // Reversing the second half makes the whole sequence bitonic.
+    for (int i = 0; i < kHalf / 2; ++i) {
+      std::swap(v[kHalf + i], v[kVectors - 1 - i]);
+    }
+    for (int i = kHalf; i < kVectors; ++i) {
+      v[i] = Traits::Reverse(v[i]);
+    }
+    MergeBitonicVectors<Traits, kVectors>(v);
+  }
+}
+
+// Merges sorted vectors |a| and |b|: |a| receives the lower half of the
+// elements, |b| the upper one.
+template <typename Traits>
+void MergeVectors(typename Traits::Vector& a, typename Traits::Vector& b) {
+  typename Traits::Vector v[2] = {a, Traits::Reverse(b)};
+  MergeBitonicVectors<Traits, 2>(v);
+  a = v[0];
+  b = v[1];
+}
+
+}  // namespace sorting_network_internal
+
+template <>
+struct SimdSortTraits<int32_t> : sorting_network_internal::Int32x8 {
+  static constexpr bool kSupported = true;
+};
+
+template <>
+struct SimdSortTraits<float> : sorting_network_internal::Float32x8 {
+  static constexpr bool kSupported = true;
+};
+
+template <>
+struct SimdSortTraits<int64_t> : sorting_network_internal::Int64x4 {
+  static constexpr bool kSupported = true;
+};
+
+#endif  // __AVX2__
+
+// Sorts |kKeys| keys at |data| with a bitonic sorting network, for |kKeys| of
+// 8, 16 or 32. Requires SimdSortTraits<T>::kSupported.
+template <size_t kKeys, typename T>
+void SortNetwork(T *data) {
+  static_assert(kKeys == 8 || kKeys == 16 || kKeys == 32,
+                "No sorting network of this size");
+#ifdef __AVX2__
+  using Traits = SimdSortTraits<T>;
+  constexpr int kVectors = kKeys / Traits::kLanes;
+  typename Traits::Vector v[kVectors];
+  for (int i = 0; i < kVectors; ++i) {
+    v[i] = Traits::Load(data + i * Traits::kLanes);
+  }
+  sorting_network_internal::SortVectors<Traits, kVectors>(v);
+  for (int i = 0; i < kVectors; ++i) {
+    Traits::Store(data + i * Traits::kLanes, v[i]);
+  }
+#else
+  static_assert(SimdSortTraits<T>::kSupported, "No sorting network for T");
+#endif
+}
+
+// Number of keys sorted by a single call of SortNetworkBlock.
+constexpr size_t kSortingNetworkBlockSize = 32;
+
+// Sorts kSortingNetworkBlockSize keys at |data|, see SortNetwork.
+template <typename T>
+void SortNetworkBlock(T *data) {
+  SortNetwork<kSortingNetworkBlockSize>(data);
+}
+
+// Tells whether [data; data + size) has NaNs, which the kernels below can't
+// handle. Always false for integers.
+template <typename T>
+bool HasNaN(const T *data, size_t size) {
+  if constexpr (std::is_floating_point<T>::value) {
+    bool has_nan = false;
+    for (size_t i = 0; i < size; ++i) {
+      has_nan |= data[i] != data[i];
+    }
+    return has_nan;
+  } else {
+    return false;
+  }
+}
+
+// Merges sorted arrays [begin1; end1) and [begin2; end2) into |out| which
+// must not overlap with them. Requires SimdSortTraits<T>::kSupported.
+//
+// Both arrays are consumed by vectors: the merging network outputs the lower
+// half of two vectors, and the next vector is loaded from the array with the
+// smaller head. Leftovers shorter than a vector are merged by scalar code.
+template <typename T>
+T* MergeSortedArrays(const T *begin1, const T *end1, const T *begin2,
+                     const T *end2, T *out) {
+#ifdef __AVX2__
+  using Traits = SimdSortTraits<T>;
+  constexpr int kLanes = Traits::kLanes;
+  if (end1 - begin1 >= kLanes && end2 - begin2 >= kLanes) {
+    auto low = Traits::Load(begin1);
+    auto high = Traits::Load(begin2);
+    begin1 += kLanes;
+    begin2 += kLanes;
+    while (true) {
+      sorting_network_internal::MergeVectors<Traits>(low, high);
+      Traits::Store(out, low);
+      out += kLanes;
+      const bool take_first =
+          begin2 == end2 || (begin1 != end1 && *begin1 < *begin2);
+      const T*& next = take_first ? begin1 : begin2;
+      const T *next_end = take_first ? end1 : end2;
+      if (next_end - next < kLanes) {
+        break;
+      }
+      low = Traits::Load(next);
+      next += kLanes;
+    }
+    // Three sorted sequences are left: |high| and both arrays' leftovers.
+    alignas(32) T high_values[kLanes];
+    Traits::Store(high_values, high);
+    const T *begin3 = high_values;
+    const T *end3 = high_values + kLanes;
+    while (begin3 != end3) {
+      if (begin1 != end1 && !(*begin3 < *begin1) &&
+          (begin2 == end2 || !(*begin2 < *begin1))) {
+        *(out++) = *(begin1++);
+      } else if (begin2 != end2 && *begin2 < *begin3) {
+        *(out++) = *(begin2++);
+      } else {
+        *(out++) = *(begin3++);
+      }
+    }
+  }
+#else
+  static_assert(SimdSortTraits<T>::kSupported, "No merging network for T");
+#endif
+  while (begin1 != end1 && begin2 != end2) {
+    if (*begin2 < *begin1) {
+      *(out++) = *(begin2++);
+    } else {
+      *(out++) = *(begin1++);
+    }
+  }
+  out = std::copy(begin1, end1, out);
+  return std::copy(begin2, end2, out);
+}
@@ -0,0 +1,125 @@
+#include "sorting_network.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+template <typename T>
+std::vector<T> GenerateRandomArray(size_t n, int max_value) {
+  std::default_random_engine generator(n);
+  std::uniform_int_distribution<int> distribution(-max_value, max_value);
+  std::vector<T> a(n);
+  for (auto& value : a) {
+    value = static_cast<T>(distribution(generator));
+  }
+  return a;
+}
+
+template <typename T>
+void InsertionSortBlock(T *data, size_t n) {
+  for (size_t i = 1; i < n; ++i) {
+    T value = data[i];
+    size_t j = i;
+    while (j > 0 && value < data[j - 1]) {
+      data[j] = data[j - 1];
+      --j;
+    }
+    data[j] = value;
+  }
+}
+
+template <typename T, size_t kKeys>
+void TestSortNetwork() {
+  for (int max_value : {1, 10, 1000 * 1000}) {
+    std::vector<T> a = GenerateRandomArray<T>(1000 * kKeys, max_value);
+    std::vector<T> reference(a);
+    for (size_t i = 0; i < a.size(); i += kKeys) {
+      SortNetwork<kKeys>(a.data() + i);
+      std::sort(reference.begin() + i, reference.begin() + i + kKeys);
+    }
+    assert(a == reference);
+  }
+}
+
+template <typename T>
+void TestSortNetworks() {
+  TestSortNetwork<T, 8>();
+  TestSortNetwork<T, 16>();
+  TestSortNetwork<T, 32>();
+}
+
+template <typename T>
+void TestMergeSortedArrays() {
+  for (size_t n1 : {0, 1, 3, 8, 13, 64, 1000}) {
+    for (size_t n2 : {0, 2, 4, 9, 77, 512}) {
+      std::vector<T> a = GenerateRandomArray<T>(n1 + n2, 100);
+      std::sort(a.begin(), a.begin() + n1);
+      std::sort(a.begin() + n1, a.end());
+      std::vector<T> out(n1 + n2);
+      T *out_end = MergeSortedArrays(a.data(), a.data() + n1, a.data() + n1,
+                                     a.data() + n1 + n2, out.data());
+      assert(out_end == out.data() + out.size());
+      std::sort(a.begin(), a.end());
+      assert(out == a);
+    }
+  }
+}
+
+template <typename T, size_t kKeys>
+void RunBenchmark(const char *type_name) {
+  constexpr size_t n = 1 << 22;
+  const std::vector<T> a = GenerateRandomArray<T>(n, 1000 * 1000);
+  std::vector<T> a1(a), a2(a);
+
+  const auto time_now = []() {
+    return std::chrono::high_resolution_clock::now();
+  };
+  auto start1 = time_now();
+  for (size_t i = 0; i < n; i += kKeys) {
+    SortNetwork<kKeys>(a1.data() + i);
+  }
+  auto end1 = time_now();
+  auto start2 = time_now();
+  for (size_t i = 0; i < n; i += kKeys) {
+    InsertionSortBlock(a2.data() + i, kKeys);
+  }
+  auto end2 = time_now();
+  assert(a1 == a2);
+
+  std::cout << type_name << ", blocks of " << kKeys << ": sorting network "
+            << std::chrono::duration_cast<std::chrono::microseconds>(
+                   end1 - start1).count()
+            << "us, insertion sort "
+            << std::chrono::duration_cast<std::chrono::microseconds>(
+                   end2 - start2).count()
+            << "us" << std::endl;
+}
+
+template <typename T>
+void RunBenchmarks(const char *type_name) {
+  RunBenchmark<T, 8>(type_name);
+  RunBenchmark<T, 16>(type_name);
+  RunBenchmark<T, 32>(type_name);
+}
+
+int main() {
+#ifndef __AVX2__
+  std::cout << "Sorting networks are not supported on this target"
+            << std::endl;
+#else
+  TestSortNetworks<int32_t>();
+  TestSortNetworks<float>();
+  TestSortNetworks<int64_t>();
+  TestMergeSortedArrays<int32_t>();
+  TestMergeSortedArrays<float>();
+  TestMergeSortedArrays<int64_t>();
+  RunBenchmarks<int32_t>("int32");
+  RunBenchmarks<float>("float");
+  RunBenchmarks<int64_t>("int64");
+  std::cout << "All tests passed! :)" << std::endl;
+#endif
+  return 0;
+}